@@ -0,0 +1,169 @@
+/**
+ * File:   hdr_histogram.c
+ *
+ * High dynamic range histogram. Bucket layout follows HdrHistogram: bucket
+ * zero holds sub_bucket_count values of lowest discernible unit, every next
+ * bucket covers twice larger range with the upper half of sub-buckets of
+ * twice larger unit. Counts are updated with relaxed atomics, so recording
+ * threads don't synchronize, readers must run after recording is finished.
+ */
+
+#include "hdr_histogram.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+static int32_t _hdrBitLength(uint64_t value) {
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+static int32_t _hdrBucketIndex(const hdrHistogram *h, int64_t value) {
+    // Smallest power of two containing value, relative to bucket zero
+    const int32_t pow2ceiling =
+        _hdrBitLength((uint64_t)(value | h->sub_bucket_mask));
+    return pow2ceiling - h->unit_magnitude -
+           (h->sub_bucket_half_count_magnitude + 1);
+}
+
+static int32_t _hdrSubBucketIndex(const hdrHistogram *h, int64_t value,
+                                  int32_t bucket_index) {
+    return (int32_t)(value >> (bucket_index + h->unit_magnitude));
+}
+
+static int32_t _hdrCountsIndex(const hdrHistogram *h, int32_t bucket_index,
+                               int32_t sub_bucket_index) {
+    const int32_t bucket_base_index =
+        (bucket_index + 1) << h->sub_bucket_half_count_magnitude;
+    return bucket_base_index + sub_bucket_index - h->sub_bucket_half_count;
+}
+
+/**
+ * Get highest value counted at @a index
+ */
+static int64_t _hdrHighestValueAt(const hdrHistogram *h, int32_t index) {
+    int32_t bucket_index = (index >> h->sub_bucket_half_count_magnitude) - 1;
+    int32_t sub_bucket_index = (index & (h->sub_bucket_half_count - 1)) +
+                               h->sub_bucket_half_count;
+    if (bucket_index < 0) {
+        sub_bucket_index -= h->sub_bucket_half_count;
+        bucket_index = 0;
+    }
+
+    const int64_t lowest = (int64_t)sub_bucket_index
+                           << (bucket_index + h->unit_magnitude);
+    const int64_t range = (int64_t)1 << (bucket_index + h->unit_magnitude);
+    return lowest + range - 1;
+}
+
+bool hdrHistogramInit(hdrHistogram *histogram,
+                      int64_t lowest_discernible_value,
+                      int64_t highest_trackable_value,
+                      int significant_figures) {
+    if (lowest_discernible_value < 1 || significant_figures < 1 ||
+        significant_figures > 5 ||
+        highest_trackable_value < 2 * lowest_discernible_value) {
+        return false;
+    }
+
+    const int64_t largest_single_unit = 2 * (int64_t)pow(10, significant_figures);
+    const int32_t sub_bucket_count_magnitude =
+        _hdrBitLength((uint64_t)largest_single_unit - 1);
+
+    hdrHistogram *h = histogram;
+    h->highest_trackable_value = highest_trackable_value;
+    h->unit_magnitude = _hdrBitLength((uint64_t)lowest_discernible_value) - 1;
+    h->sub_bucket_half_count_magnitude = sub_bucket_count_magnitude - 1;
+    h->sub_bucket_half_count = 1 << h->sub_bucket_half_count_magnitude;
+    const int64_t sub_bucket_count = (int64_t)1 << sub_bucket_count_magnitude;
+    h->sub_bucket_mask = (sub_bucket_count - 1) << h->unit_magnitude;
+
+    // Buckets needed to cover highest trackable value
+    int32_t buckets_needed = 1;
+    int64_t smallest_untrackable = sub_bucket_count << h->unit_magnitude;
+    while (smallest_untrackable <= highest_trackable_value) {
+        if (smallest_untrackable > INT64_MAX / 2) {
+            buckets_needed++;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        buckets_needed++;
+    }
+    h->counts_len = (buckets_needed + 1) * h->sub_bucket_half_count;
+
+    h->counts = (uint64_t *)calloc((size_t)h->counts_len, sizeof(uint64_t));
+    h->total_count = 0;
+    h->min = INT64_MAX;
+    h->max = 0;
+    h->sum = 0;
+    return h->counts != NULL;
+}
+
+void hdrHistogramDestroy(hdrHistogram *histogram) {
+    free(histogram->counts);
+    histogram->counts = NULL;
+    histogram->counts_len = 0;
+}
+
+void hdrHistogramRecord(hdrHistogram *histogram, int64_t value) {
+    hdrHistogram *h = histogram;
+    if (value < 0) { value = 0; }
+    if (value > h->highest_trackable_value) {
+        value = h->highest_trackable_value;
+    }
+
+    const int32_t bucket_index = _hdrBucketIndex(h, value);
+    const int32_t index = _hdrCountsIndex(
+        h, bucket_index, _hdrSubBucketIndex(h, value, bucket_index));
+    __atomic_fetch_add(&h->counts[index], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->total_count, 1, __ATOMIC_RELAXED);
+
+    int64_t min = __atomic_load_n(&h->min, __ATOMIC_RELAXED);
+    while (value < min &&
+           !__atomic_compare_exchange_n(&h->min, &min, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    int64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&h->max, &max, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    __atomic_fetch_add(&h->sum, (uint64_t)value, __ATOMIC_RELAXED);
+}
+
+void hdrHistogramAdd(hdrHistogram *to, const hdrHistogram *from) {
+    for (int32_t i = 0; i < from->counts_len && i < to->counts_len; i++) {
+        to->counts[i] += from->counts[i];
+    }
+    to->total_count += from->total_count;
+    to->sum += from->sum;
+    if (from->min < to->min) { to->min = from->min; }
+    if (from->max > to->max) { to->max = from->max; }
+}
+
+int64_t hdrHistogramValueAtPercentile(const hdrHistogram *histogram,
+                                      double percentile) {
+    const hdrHistogram *h = histogram;
+    if (h->total_count == 0) { return 0; }
+    if (percentile > 100) { percentile = 100; }
+
+    uint64_t count_at_percentile =
+        (uint64_t)ceil(percentile / 100 * (double)h->total_count);
+    if (count_at_percentile == 0) { count_at_percentile = 1; }
+
+    uint64_t total = 0;
+    for (int32_t i = 0; i < h->counts_len; i++) {
+        total += h->counts[i];
+        if (total >= count_at_percentile) {
+            const int64_t value = _hdrHighestValueAt(h, i);
+            // Don't report more than really recorded
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+double hdrHistogramMean(const hdrHistogram *histogram) {
+    return histogram->total_count != 0
+               ? histogram->sum / (double)histogram->total_count
+               : 0;
+}
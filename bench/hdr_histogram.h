@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// High dynamic range histogram of latency values
+/////////////////
+
+/**
+ * Histogram with fixed relative precision over whole value range
+ *
+ * Values are counted in log-linear buckets: every power of two range is
+ * split to sub-buckets, so any recorded value is reported with precision of
+ * configured number of significant decimal digits. Recording is lock-free,
+ * many threads may record to the same histogram.
+ */
+typedef struct hdrHistogram {
+    int64_t highest_trackable_value; ///< Larger values are clamped to it
+    int32_t unit_magnitude;          ///< log2 of lowest discernible value
+    int32_t sub_bucket_half_count_magnitude;
+    int32_t sub_bucket_half_count;
+    int64_t sub_bucket_mask;
+    int32_t counts_len;
+    uint64_t *counts;
+
+    uint64_t total_count;
+    int64_t min;  ///< INT64_MAX if empty
+    int64_t max;  ///< Zero if empty
+    uint64_t sum; ///< Sum of recorded values for mean
+} hdrHistogram;
+
+/**
+ * Create histogram
+ *
+ * @param histogram Histogram to initialize
+ * @param lowest_discernible_value Smallest value distinguished from zero, >= 1
+ * @param highest_trackable_value Largest value tracked
+ * @param significant_figures Precision in decimal digits, 1 to 5
+ *
+ * @return false if parameters are invalid or memory can't be allocated
+ */
+bool hdrHistogramInit(hdrHistogram *histogram,
+                      int64_t lowest_discernible_value,
+                      int64_t highest_trackable_value,
+                      int significant_figures);
+
+/**
+ * Free histogram counts
+ */
+void hdrHistogramDestroy(hdrHistogram *histogram);
+
+/**
+ * Record value, negative values are counted as zero, values above highest
+ * trackable value are counted as highest one
+ */
+void hdrHistogramRecord(hdrHistogram *histogram, int64_t value);
+
+/**
+ * Add all values of @a from to @a to, histograms must be created with the
+ * same parameters
+ */
+void hdrHistogramAdd(hdrHistogram *to, const hdrHistogram *from);
+
+/**
+ * Get value at @a percentile of recorded values
+ *
+ * @param histogram Histogram
+ * @param percentile Percentile from 0 to 100
+ *
+ * @return Highest value equivalent to the percentile one within histogram
+ * precision, zero if histogram is empty
+ */
+int64_t hdrHistogramValueAtPercentile(const hdrHistogram *histogram,
+                                      double percentile);
+
+/**
+ * Get mean of recorded values, zero if histogram is empty
+ */
+double hdrHistogramMean(const hdrHistogram *histogram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HDR_HISTOGRAM_H */
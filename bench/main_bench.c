@@ -0,0 +1,707 @@
+/**
+ * \file   main_bench.c
+ *
+ * \example main_bench.c
+ *
+ * Microbenchmarks of Teocli library packet hot paths. No L0 server or network
+ * is needed: key exchange answer is made in process, packets are sent to
+ * local socket pair drained by a thread, end-to-end cases run against mock L0
+ * server started on localhost.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_bench [-o results.json] [-t min_time_ms] [-f filter]
+ *
+ * **Example:** ./teocli_bench -o bench.json -f PacketEncrypt
+ *
+ *   -o  write results to file instead of stdout
+ *   -t  minimal measured time of every case, 200 ms by default
+ *   -f  run only cases which name contains filter
+ *
+ * ### Measured cases:
+ *
+ * *  PacketCreate, get_byte_checksum, PacketGetFromBuffer
+ * *  PacketSplit/fragmented - every packet is received in 4 reads
+ * *  PacketSplit/coalesced - packets are received in L0_BUFFER_SIZE reads
+ * *  PacketEncrypt, PacketDecrypt of every encryption protocol, including
+ *    copy of the packet to work buffer
+ * *  Send - teoLNullSend to TCP connection without and with encryption
+ * *  Echo - round trip of CMD_L_ECHO to mock L0 server over TCP connection
+ *    without and with ENC_PROTO_ECDH_AES_128_V1 encryption, ns/op is RTT
+ *
+ * Every case is run for payload sizes from 16 to 16384 bytes. Results are
+ * JSON array of cases with ns/op, payload bytes/s and heap allocations per
+ * operation, allocations are counted with glibc only and are null otherwise.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+#include "teonet_l0_mock_server.h"
+
+#define TL0CB_VERSION "0.0.1"
+
+#define BENCH_DEFAULT_MIN_TIME_MS 200
+#define BENCH_PEER_NAME "bench-peer"
+#define BENCH_CMD 129
+// Nonce of server packets in PacketDecrypt, far from start to look real
+#define BENCH_RECEIVE_NONCE 1000
+
+static const size_t bench_sizes[] = {16, 64, 256, 1024, 4096, 16384};
+
+#if defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t bench_allocs;
+
+// Library allocations are counted by interposing allocator of the process
+void *malloc(size_t size) {
+    __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t _benchAllocs(void) {
+    return __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+}
+#endif
+
+/**
+ * Application parameters structure
+ */
+struct app_parameters {
+
+    const char *output;
+    const char *filter;
+    int64_t min_time_ns;
+};
+
+/**
+ * State of one benchmark case
+ */
+typedef struct benchState {
+
+    size_t size;                      ///< Payload size
+    teoLNullEncryptionProtocol proto; ///< Encryption protocol of the case
+
+    uint8_t *payload;         ///< Payload of size bytes
+    uint8_t *packet;          ///< Work packet buffer
+    uint8_t *packet_template; ///< Packet copied to work buffer
+    size_t packet_length;     ///< Length of packet_template
+    size_t packet_capacity;   ///< Size of packet buffers
+
+    teoLNullEncryptionContext *crypt; ///< Established context or NULL
+
+    teoLNullConnectData con; ///< Mocked TCP connection
+
+    uint8_t *stream;      ///< Concatenated packets received by PacketSplit
+    size_t stream_length; ///< Length of stream
+    size_t stream_offset; ///< Next byte of stream to receive
+    size_t chunk;         ///< Bytes received at once
+
+    int sink[2];           ///< Socket pair, sink[1] is drained
+    pthread_t sink_thread; ///< Thread draining sink[1]
+
+    teoLNullConnectData *echo_con; ///< Connection to mock L0 server or NULL
+} benchState;
+
+typedef uint64_t (*benchRunFn)(benchState *st, uint64_t iterations);
+
+/**
+ * Result of one benchmark case
+ */
+typedef struct benchResult {
+
+    char name[64];
+    size_t size;
+    uint64_t iterations;
+    double ns_per_op;
+    double bytes_per_second;
+    double allocs_per_op; ///< Negative if allocations aren't counted
+} benchResult;
+
+static benchResult *bench_results;
+static size_t bench_results_count;
+
+static int64_t _benchTimeNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static const char *_benchProtoName(teoLNullEncryptionProtocol proto) {
+    switch (proto) {
+    case ENC_PROTO_ECDH_AES_128_V1: return "v1";
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: return "v2";
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: return "v3";
+    default: return "plain";
+    }
+}
+
+#pragma pack(push)
+#pragma pack(1)
+// Key exchange answer of L0 server, ECDH protocols
+typedef struct benchKEX_ECDH {
+    KeyExchangePayload_Common common;
+    ECDHPubkey pubkey;
+    AES128_1_BLOCK salt;
+} benchKEX_ECDH;
+
+// Key exchange answer of L0 server, X25519 protocols
+typedef struct benchKEX_X25519 {
+    KeyExchangePayload_Common common;
+    X25519Key pubkey;
+    AES128_1_BLOCK salt;
+} benchKEX_X25519;
+#pragma pack(pop)
+
+/**
+ * Create encryption context and establish session with keys made the same
+ * way L0 server does
+ */
+static teoLNullEncryptionContext *
+_benchCryptCreate(teoLNullEncryptionProtocol proto) {
+    const size_t ctx_size = teoLNullEncryptionContextSize(proto);
+    teoLNullEncryptionContext *ctx =
+        (teoLNullEncryptionContext *)malloc(ctx_size);
+    teoLNullEncryptionContextCreate(proto, (uint8_t *)ctx, ctx_size);
+
+    uint8_t request[128];
+    teoLNullKEXCreate(ctx, request, teoLNullKEXBufferSize(proto));
+
+    bool applied = false;
+    if (proto == ENC_PROTO_X25519_CHACHA20_POLY1305_V3) {
+        const benchKEX_X25519 *client = (const benchKEX_X25519 *)request;
+        PeerKeyset_X25519 server;
+        initPeerKeys_X25519(&server);
+        initApplyRemoteKey_X25519(&server, &client->pubkey, &client->salt);
+
+        benchKEX_X25519 answer;
+        answer.common.nul_byte = 0;
+        answer.common.protocolId = proto;
+        answer.pubkey = server.pubkeylocal;
+        answer.salt = server.sessionsalt;
+        applied = teoLNullEncryptionContextApplyKEX(
+            ctx, &answer.common, sizeof(answer));
+    } else {
+        const benchKEX_ECDH *client = (const benchKEX_ECDH *)request;
+        PeerKeyset server;
+        initPeerKeys(&server);
+        initApplyRemoteKey(&server, &client->pubkey, &client->salt);
+
+        benchKEX_ECDH answer;
+        answer.common.nul_byte = 0;
+        answer.common.protocolId = proto;
+        answer.pubkey = server.pubkeylocal;
+        answer.salt = server.sessionsalt;
+        applied = teoLNullEncryptionContextApplyKEX(
+            ctx, &answer.common, sizeof(answer));
+    }
+
+    if (!applied) {
+        fprintf(stderr, "Can't establish %s session\n", _benchProtoName(proto));
+        exit(EXIT_FAILURE);
+    }
+    return ctx;
+}
+
+static void _benchCryptDestroy(teoLNullEncryptionContext *ctx) {
+    if (ctx != NULL) {
+        teoLNullEncryptionContextDestroy(ctx);
+        free(ctx);
+    }
+}
+
+/**
+ * AEAD nonce of L0 protocol: direction byte, zeros, little-endian counter
+ */
+static void _benchAeadNonce(uint8_t direction, uint32_t counter,
+                            uint8_t nonce[CHACHA20_NONCE_SIZE]) {
+    memset(nonce, 0, CHACHA20_NONCE_SIZE);
+    nonce[0] = direction;
+    nonce[4] = (uint8_t)counter;
+    nonce[5] = (uint8_t)(counter >> 8);
+    nonce[6] = (uint8_t)(counter >> 16);
+    nonce[7] = (uint8_t)(counter >> 24);
+}
+
+/**
+ * Turn packet encrypted by client with @a nonce into packet sent by server
+ * with the same nonce
+ */
+static void _benchMakeServerPacket(teoLNullEncryptionContext *ctx,
+                                   teoLNullCPacket *packet, uint32_t nonce) {
+    if (ctx->enc_proto == ENC_PROTO_ECDH_AES_128_V1) {
+        // CTR keystream doesn't depend on direction
+        return;
+    }
+
+    uint8_t aad[4 + UINT8_MAX];
+    aad[0] = packet->cmd;
+    aad[1] = packet->peer_name_length;
+    aad[2] = packet->reserved_1;
+    aad[3] = packet->reserved_2;
+    memcpy(aad + 4, packet->peer_name, packet->peer_name_length);
+    const size_t aad_len = 4 + packet->peer_name_length;
+
+    uint8_t *payload = teoLNullPacketGetPayload(packet);
+    const size_t message_length = packet->data_length - POLY1305_TAG_SIZE;
+    uint8_t aead_nonce[CHACHA20_NONCE_SIZE];
+
+    _benchAeadNonce(0, nonce, aead_nonce);
+    if (!Open_CHACHA20_POLY1305(&ctx->aeadKey, aead_nonce, aad, aad_len,
+                                payload, message_length,
+                                payload + message_length)) {
+        fprintf(stderr, "Can't open packet sealed by client\n");
+        exit(EXIT_FAILURE);
+    }
+    _benchAeadNonce(1, nonce, aead_nonce);
+    Seal_CHACHA20_POLY1305(&ctx->aeadKey, aead_nonce, aad, aad_len, payload,
+                           message_length, payload + message_length);
+}
+
+static void *_benchSinkThread(void *arg) {
+    benchState *st = (benchState *)arg;
+    uint8_t buf[64 * 1024];
+    while (read(st->sink[1], buf, sizeof(buf)) > 0) {}
+    return NULL;
+}
+
+static void _benchSetup(benchState *st, teoLNullEncryptionProtocol proto,
+                        size_t size) {
+    memset(st, 0, sizeof(*st));
+    st->size = size;
+    st->proto = proto;
+    st->sink[0] = st->sink[1] = -1;
+    teomutexInitialize(&st->con.write_guard);
+
+    st->payload = (uint8_t *)malloc(size);
+    for (size_t i = 0; i < size; i++) {
+        st->payload[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    st->packet_capacity = teoLNullBufferSize(sizeof(BENCH_PEER_NAME), size) +
+                          TEOLNULL_ENCRYPTION_MAX_OVERHEAD;
+    st->packet = (uint8_t *)malloc(st->packet_capacity);
+    st->packet_template = (uint8_t *)malloc(st->packet_capacity);
+    st->packet_length =
+        teoLNullPacketCreate(st->packet_template, st->packet_capacity,
+                             BENCH_CMD, BENCH_PEER_NAME, st->payload, size);
+
+    if (proto != ENC_PROTO_DISABLED) { st->crypt = _benchCryptCreate(proto); }
+}
+
+static void _benchTeardown(benchState *st) {
+    if (st->echo_con != NULL) { teoLNullDisconnect(st->echo_con); }
+    if (st->sink[0] != -1) {
+        shutdown(st->sink[0], SHUT_WR);
+        pthread_join(st->sink_thread, NULL);
+        close(st->sink[0]);
+        close(st->sink[1]);
+    }
+    free(st->con.read_buffer);
+    teomutexDestroy(&st->con.write_guard);
+    _benchCryptDestroy(st->crypt);
+    free(st->stream);
+    free(st->packet_template);
+    free(st->packet);
+    free(st->payload);
+}
+
+static uint64_t _benchPacketCreate(benchState *st, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        teoLNullPacketCreate(st->packet, st->packet_capacity, BENCH_CMD,
+                             BENCH_PEER_NAME, st->payload, st->size);
+    }
+    return iterations;
+}
+
+static uint64_t _benchChecksum(benchState *st, uint64_t iterations) {
+    volatile uint8_t checksum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        checksum ^= get_byte_checksum(st->payload, st->size);
+    }
+    (void)checksum;
+    return iterations;
+}
+
+static uint64_t _benchGetFromBuffer(benchState *st, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (teoLNullPacketGetFromBuffer(st->packet_template,
+                                        st->packet_length) == NULL) {
+            fprintf(stderr, "Valid packet is rejected\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return iterations;
+}
+
+/**
+ * Prepare stream of packets for PacketSplit, @a chunk bytes are received at
+ * once
+ */
+static void _benchSplitSetup(benchState *st, size_t chunk) {
+    // At least 8 packets and 64 KiB, so reads cross packet boundaries at
+    // different offsets
+    size_t count = 64 * 1024 / st->packet_length + 1;
+    if (count < 8) { count = 8; }
+
+    st->stream_length = count * st->packet_length;
+    st->stream = (uint8_t *)malloc(st->stream_length);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(st->stream + i * st->packet_length, st->packet_template,
+               st->packet_length);
+    }
+    st->chunk = chunk < L0_BUFFER_SIZE ? chunk : L0_BUFFER_SIZE;
+    st->con.tcp_f = 1;
+}
+
+static uint64_t _benchSplit(benchState *st, uint64_t iterations) {
+    uint64_t packets = 0;
+    while (packets < iterations) {
+        size_t chunk = st->stream_length - st->stream_offset;
+        if (chunk > st->chunk) { chunk = st->chunk; }
+
+        ssize_t rc = teoLNullRecvCheck(
+            &st->con, (char *)st->stream + st->stream_offset, chunk);
+        st->stream_offset += chunk;
+        if (st->stream_offset == st->stream_length) { st->stream_offset = 0; }
+
+        // Take all packets completed by this read
+        while (rc > 0) {
+            packets++;
+            rc = teoLNullRecvCheck(&st->con, NULL, -1);
+        }
+        if (rc == -2) {
+            fprintf(stderr, "Valid packet is dropped\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return packets;
+}
+
+static uint64_t _benchEncrypt(benchState *st, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        memcpy(st->packet, st->packet_template, st->packet_length);
+        teoLNullPacketEncryptBuffer(st->crypt, (teoLNullCPacket *)st->packet,
+                                    st->packet_capacity);
+    }
+    return iterations;
+}
+
+static void _benchDecryptSetup(benchState *st) {
+    // Encrypted packet becomes template, its length includes AEAD tag
+    teoLNullCPacket *packet = (teoLNullCPacket *)st->packet_template;
+    st->crypt->sendNonce = BENCH_RECEIVE_NONCE;
+    teoLNullPacketEncryptBuffer(st->crypt, packet, st->packet_capacity);
+    _benchMakeServerPacket(st->crypt, packet, BENCH_RECEIVE_NONCE);
+    st->packet_length =
+        teoLNullBufferSize(packet->peer_name_length, packet->data_length);
+}
+
+static uint64_t _benchDecrypt(benchState *st, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        memcpy(st->packet, st->packet_template, st->packet_length);
+        // Every copy is decrypted as the same packet received again
+        st->crypt->receiveNonce = BENCH_RECEIVE_NONCE;
+        if (!teoLNullPacketDecrypt(st->crypt, (teoLNullCPacket *)st->packet)) {
+            fprintf(stderr, "Can't decrypt packet\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return iterations;
+}
+
+static void _benchSendSetup(benchState *st) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, st->sink) != 0) {
+        perror("socketpair");
+        exit(EXIT_FAILURE);
+    }
+    pthread_create(&st->sink_thread, NULL, _benchSinkThread, st);
+
+    st->con.fd = st->sink[0];
+    st->con.tcp_f = 1;
+    st->con.status = CON_STATUS_CONNECTED;
+    st->con.client_crypt = st->crypt;
+}
+
+static uint64_t _benchSend(benchState *st, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (teoLNullSend(&st->con, BENCH_CMD, BENCH_PEER_NAME, st->payload,
+                         st->size) <= 0) {
+            fprintf(stderr, "Can't send packet\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return iterations;
+}
+
+// Started by first end-to-end case, stopped at exit
+static teoLNullMockServer *bench_mock_server;
+
+static void _benchEchoSetup(benchState *st) {
+    if (bench_mock_server == NULL) {
+        teoLNullMockServerConfig config = {0};
+        config.disable_trudp = true;
+        bench_mock_server = teoLNullMockServerStart(&config);
+        if (bench_mock_server == NULL) {
+            fprintf(stderr, "Can't start mock L0 server\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    teoLNUllSetOption_EncryptionProtocol(st->proto);
+    st->echo_con = teoLNullConnect(
+        "127.0.0.1", teoLNullMockServerTcpPort(bench_mock_server), TCP);
+    if (st->echo_con == NULL || st->echo_con->status != CON_STATUS_CONNECTED) {
+        fprintf(stderr, "Can't connect to mock L0 server\n");
+        exit(EXIT_FAILURE);
+    }
+    teoLNullLogin(st->echo_con, BENCH_PEER_NAME);
+}
+
+static uint64_t _benchEcho(benchState *st, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (teoLNullSend(st->echo_con, CMD_L_ECHO, "mock-l0", st->payload,
+                         st->size) <= 0) {
+            fprintf(stderr, "Can't send echo\n");
+            exit(EXIT_FAILURE);
+        }
+        for (;;) {
+            ssize_t rc = teoLNullRecvTimeout(st->echo_con, 1000);
+            if (rc > 0 && ((teoLNullCPacket *)st->echo_con->read_buffer)->cmd ==
+                              CMD_L_ECHO_ANSWER) {
+                break;
+            }
+            if (rc == 0 || rc == -1) {
+                fprintf(stderr, "No echo answer from mock L0 server\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    return iterations;
+}
+
+/**
+ * Run @a run until it takes at least min_time_ns and store result
+ */
+static void _benchMeasure(const struct app_parameters *param,
+                          const char *name, benchState *st, benchRunFn run) {
+    run(st, 1);
+
+    uint64_t iterations = 1;
+    uint64_t done = 0;
+    int64_t elapsed_ns = 0;
+    uint64_t allocs = 0;
+    for (;;) {
+#if defined(BENCH_COUNT_ALLOCS)
+        const uint64_t allocs_start = _benchAllocs();
+#endif
+        const int64_t start_ns = _benchTimeNs();
+        done = run(st, iterations);
+        elapsed_ns = _benchTimeNs() - start_ns;
+#if defined(BENCH_COUNT_ALLOCS)
+        allocs = _benchAllocs() - allocs_start;
+#endif
+        if (elapsed_ns >= param->min_time_ns || iterations >= (1u << 30)) {
+            break;
+        }
+
+        // Aim 20% over minimal time, grow at most 100 times per step
+        uint64_t next = elapsed_ns > 0
+                            ? (uint64_t)((double)param->min_time_ns * 1.2 *
+                                         done / elapsed_ns)
+                            : iterations * 100;
+        if (next > iterations * 100) { next = iterations * 100; }
+        if (next <= iterations) { next = iterations + 1; }
+        iterations = next;
+    }
+
+    bench_results = (benchResult *)realloc(
+        bench_results, sizeof(benchResult) * (bench_results_count + 1));
+    benchResult *result = &bench_results[bench_results_count++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->size = st->size;
+    result->iterations = done;
+    result->ns_per_op = (double)elapsed_ns / done;
+    result->bytes_per_second = (double)st->size * done * 1e9 / elapsed_ns;
+#if defined(BENCH_COUNT_ALLOCS)
+    result->allocs_per_op = (double)allocs / done;
+#else
+    (void)allocs;
+    result->allocs_per_op = -1;
+#endif
+
+    fprintf(stderr, "%-32s %6zu %12.1f ns/op %10.1f MB/s %6.2f allocs/op\n",
+            result->name, result->size, result->ns_per_op,
+            result->bytes_per_second / 1e6, result->allocs_per_op);
+}
+
+typedef enum benchSetupKind {
+    BENCH_SETUP_NONE,
+    BENCH_SETUP_SPLIT_FRAGMENTED,
+    BENCH_SETUP_SPLIT_COALESCED,
+    BENCH_SETUP_DECRYPT,
+    BENCH_SETUP_SEND,
+    BENCH_SETUP_ECHO,
+} benchSetupKind;
+
+/**
+ * Run case @a name with all payload sizes
+ */
+static void _benchCase(const struct app_parameters *param, const char *name,
+                       teoLNullEncryptionProtocol proto, benchSetupKind setup,
+                       benchRunFn run) {
+    char full_name[64];
+    if (setup == BENCH_SETUP_SEND || setup == BENCH_SETUP_ECHO ||
+        proto != ENC_PROTO_DISABLED) {
+        snprintf(full_name, sizeof(full_name), "%s/%s", name,
+                 _benchProtoName(proto));
+    } else {
+        snprintf(full_name, sizeof(full_name), "%s", name);
+    }
+    if (param->filter != NULL && strstr(full_name, param->filter) == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+        benchState st;
+        _benchSetup(&st, proto, bench_sizes[i]);
+
+        switch (setup) {
+        case BENCH_SETUP_SPLIT_FRAGMENTED:
+            _benchSplitSetup(&st, st.packet_length / 4 + 1);
+            break;
+        case BENCH_SETUP_SPLIT_COALESCED:
+            _benchSplitSetup(&st, L0_BUFFER_SIZE);
+            break;
+        case BENCH_SETUP_DECRYPT: _benchDecryptSetup(&st); break;
+        case BENCH_SETUP_SEND: _benchSendSetup(&st); break;
+        case BENCH_SETUP_ECHO: _benchEchoSetup(&st); break;
+        default: break;
+        }
+
+        _benchMeasure(param, full_name, &st, run);
+        _benchTeardown(&st);
+    }
+}
+
+static void _benchWriteJSON(FILE *out, const struct app_parameters *param) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"suite\": \"teocli_bench\",\n");
+    fprintf(out, "  \"version\": \"%s\",\n", TL0CB_VERSION);
+    fprintf(out, "  \"aes_backend\": \"%s\",\n", CTR_AES128_backend());
+    fprintf(out, "  \"min_time_ms\": %" PRId64 ",\n",
+            param->min_time_ns / 1000000);
+    fprintf(out, "  \"results\": [");
+    for (size_t i = 0; i < bench_results_count; i++) {
+        const benchResult *r = &bench_results[i];
+        fprintf(out,
+                "%s\n    {\"name\": \"%s\", \"size\": %zu, "
+                "\"iterations\": %" PRIu64 ", \"ns_per_op\": %.3f, "
+                "\"bytes_per_second\": %.1f, \"allocs_per_op\": ",
+                i == 0 ? "" : ",", r->name, r->size, r->iterations,
+                r->ns_per_op, r->bytes_per_second);
+        if (r->allocs_per_op >= 0) {
+            fprintf(out, "%.3f}", r->allocs_per_op);
+        } else {
+            fprintf(out, "null}");
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+int main(int argc, char **argv) {
+    struct app_parameters param = {NULL, NULL,
+                                   BENCH_DEFAULT_MIN_TIME_MS * 1000000LL};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:t:f:h")) != -1) {
+        switch (opt) {
+        case 'o': param.output = optarg; break;
+        case 'f': param.filter = optarg; break;
+        case 't': param.min_time_ns = atoll(optarg) * 1000000LL; break;
+        default:
+            fprintf(stderr,
+                    "Teocli packet hot paths benchmark ver " TL0CB_VERSION
+                    "\n\nUsage: %s [-o results.json] [-t min_time_ms] "
+                    "[-f filter]\n",
+                    argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    teoLNullInit();
+
+    _benchCase(&param, "PacketCreate", ENC_PROTO_DISABLED, BENCH_SETUP_NONE,
+               _benchPacketCreate);
+    _benchCase(&param, "get_byte_checksum", ENC_PROTO_DISABLED,
+               BENCH_SETUP_NONE, _benchChecksum);
+    _benchCase(&param, "PacketGetFromBuffer", ENC_PROTO_DISABLED,
+               BENCH_SETUP_NONE, _benchGetFromBuffer);
+    _benchCase(&param, "PacketSplit/fragmented", ENC_PROTO_DISABLED,
+               BENCH_SETUP_SPLIT_FRAGMENTED, _benchSplit);
+    _benchCase(&param, "PacketSplit/coalesced", ENC_PROTO_DISABLED,
+               BENCH_SETUP_SPLIT_COALESCED, _benchSplit);
+
+    const teoLNullEncryptionProtocol protos[] = {
+        ENC_PROTO_ECDH_AES_128_V1, ENC_PROTO_ECDH_CHACHA20_POLY1305_V2,
+        ENC_PROTO_X25519_CHACHA20_POLY1305_V3};
+    for (size_t i = 0; i < sizeof(protos) / sizeof(protos[0]); i++) {
+        _benchCase(&param, "PacketEncrypt", protos[i], BENCH_SETUP_NONE,
+                   _benchEncrypt);
+        _benchCase(&param, "PacketDecrypt", protos[i], BENCH_SETUP_DECRYPT,
+                   _benchDecrypt);
+    }
+
+    _benchCase(&param, "Send", ENC_PROTO_DISABLED, BENCH_SETUP_SEND,
+               _benchSend);
+    for (size_t i = 0; i < sizeof(protos) / sizeof(protos[0]); i++) {
+        _benchCase(&param, "Send", protos[i], BENCH_SETUP_SEND, _benchSend);
+    }
+
+    // Mock L0 server makes key exchange of ENC_PROTO_ECDH_AES_128_V1 only
+    _benchCase(&param, "Echo", ENC_PROTO_DISABLED, BENCH_SETUP_ECHO,
+               _benchEcho);
+    _benchCase(&param, "Echo", ENC_PROTO_ECDH_AES_128_V1, BENCH_SETUP_ECHO,
+               _benchEcho);
+    teoLNullMockServerStop(bench_mock_server);
+
+    teoLNullCleanup();
+
+    FILE *out = stdout;
+    if (param.output != NULL) {
+        out = fopen(param.output, "w");
+        if (out == NULL) {
+            perror(param.output);
+            return EXIT_FAILURE;
+        }
+    }
+    _benchWriteJSON(out, &param);
+    if (out != stdout) { fclose(out); }
+
+    free(bench_results);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,671 @@
+/**
+ * \file   main_loadgen.c
+ *
+ * \example main_loadgen.c
+ *
+ * Open-loop load generator of Teocli library. It opens number of connections
+ * to L0 server, logs them in and sends CMD_L_ECHO messages of configured
+ * sizes to target peer with configured total rate. Messages are sent by
+ * schedule independent of answers, so server stalls are seen as latency
+ * instead of lower send rate. Round trip time of every echo answer is
+ * recorded to HDR histograms, results are written as JSON.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_loadgen [-a address] [-p port] [-u] [-M] [-c connections]
+ *              [-r rate] [-s sizes] [-x] [-d duration_s] [-w warmup_s]
+ *              [-e encryption] [-P peer] [-n name] [-o report.json]
+ *              [-C capture]
+ *
+ * **Example:** ./teocli_loadgen -M -c 8 -r 20000 -s 64:9,1024:1 -d 10
+ *
+ *   -a  L0 server address, 127.0.0.1 by default
+ *   -p  L0 server port, 9000 by default
+ *   -u  connect with TR-UDP, TCP by default
+ *   -M  start mock L0 server in process and connect to it, -a and -p are
+ *       ignored
+ *   -c  number of connections, 1 by default
+ *   -r  total rate of messages per second of all connections, 1000 by default
+ *   -s  payload sizes: "N" fixed, "MIN-MAX" uniformly distributed or
+ *       "N:weight,N:weight,..." weighted list, 64 by default
+ *   -x  exponentially distributed (Poisson) intervals between messages,
+ *       equal intervals by default
+ *   -d  measured time in seconds, 10 by default
+ *   -w  warmup time in seconds before measurement, 1 by default
+ *   -e  encryption protocol: 0 disabled, 1 ECDH_AES_128_V1 (default),
+ *       2 ECDH_CHACHA20_POLY1305_V2, 3 X25519_CHACHA20_POLY1305_V3
+ *   -P  target peer answering CMD_L_ECHO, mock-l0 by default
+ *   -n  client name prefix, connection number is appended, loadgen by default
+ *   -o  write report to file instead of stdout
+ *   -C  capture bytes received by connections with session keys to files
+ *       "capture.N", N is connection number from 1, see teocli_replay
+ *
+ * ### Measurement:
+ *
+ * Echo payload starts with teoLNullSendEcho compatible part: message string
+ * and send time in ms, so any peer answering teoLNullSendEcho answers load
+ * generator too. It is followed by scheduled and real send time in ns of
+ * monotonic clock and filler up to payload size. Payload is at least
+ * LOADGEN_MIN_PAYLOAD bytes.
+ *
+ * Report contains two RTT histograms: "rtt_us" from real send time and
+ * "rtt_corrected_us" from scheduled send time, the last includes time message
+ * waited for its turn to be sent and is not affected by coordinated omission.
+ * Messages scheduled during warmup, or while connection is reconnecting, are
+ * not measured. Messages not answered in LOADGEN_DRAIN_MS after the end are
+ * reported as lost.
+ */
+
+#define _GNU_SOURCE // ppoll
+
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+#include "teobase/time.h"
+#include "hdr_histogram.h"
+#include "teonet_l0_mock_server.h"
+
+#define TL0LG_VERSION "0.0.1"
+
+#define LOADGEN_DEFAULT_PORT 9000
+#define LOADGEN_TAG "teocli_loadgen"
+#define LOADGEN_DRAIN_MS 1000
+#define LOADGEN_MAX_WAIT_MS 50
+#define LOADGEN_RECONNECT_MIN_MS 100
+#define LOADGEN_RECONNECT_MAX_MS 2000
+#define LOADGEN_MAX_SIZES 32
+// RTT histograms range is 1 ns to 100 s with 3 significant digits
+#define LOADGEN_HIST_MAX_NS 100000000000LL
+#define LOADGEN_HIST_DIGITS 3
+
+/**
+ * Scheduled and real send time of echo message
+ */
+typedef struct loadgenStamp {
+    int64_t scheduled_ns;
+    int64_t sent_ns;
+} loadgenStamp;
+
+#define LOADGEN_MIN_PAYLOAD                                                    \
+    (sizeof(LOADGEN_TAG) + sizeof(int64_t) + sizeof(loadgenStamp))
+
+/**
+ * Application parameters structure
+ */
+struct app_parameters {
+    const char *server;
+    uint16_t port;
+    PROTOCOL proto;
+    bool mock;
+    int connections;
+    double rate;
+    bool poisson;
+    int duration_s;
+    int warmup_s;
+    int encryption;
+    const char *peer;
+    const char *name;
+    const char *output;
+    const char *capture;
+    const char *sizes_spec;
+
+    // Parsed payload sizes distribution
+    size_t sizes[LOADGEN_MAX_SIZES];
+    uint32_t weights[LOADGEN_MAX_SIZES]; ///< Cumulative weights
+    size_t sizes_count;
+    bool sizes_range; ///< sizes[0]..sizes[1] uniformly
+};
+
+/**
+ * Load generator counters, updated by connection threads
+ */
+typedef struct loadgenCounters {
+    uint64_t sent;            ///< Measured messages sent
+    uint64_t sent_bytes;      ///< Payload bytes of measured messages sent
+    uint64_t received;        ///< Measured echo answers received
+    uint64_t received_bytes;  ///< Payload bytes of measured answers
+    uint64_t warmup_sent;     ///< Messages sent during warmup
+    uint64_t not_sent;        ///< Measured messages scheduled while offline
+    uint64_t send_errors;     ///< teoLNullSend failures
+    uint64_t connect_errors;  ///< Failed connections and logins
+    uint64_t disconnects;     ///< Connections closed by server or network
+    uint64_t reconnects;      ///< Successful connections after disconnect
+    uint64_t unexpected;      ///< Received packets which are not our answers
+} loadgenCounters;
+
+#define LOADGEN_COUNT(field, value)                                            \
+    __atomic_fetch_add(&loadgen_counters.field, (value), __ATOMIC_RELAXED)
+
+/**
+ * Connection thread data
+ */
+typedef struct loadgenConnection {
+    const struct app_parameters *param;
+    int index;
+    pthread_t thread;
+    teoLNullConnectData *con;
+    bool connected;
+    bool ever_connected;
+    uint64_t rng;   ///< xorshift64 state
+    int64_t next_ns; ///< Scheduled time of next message
+    uint8_t *payload;
+} loadgenConnection;
+
+static volatile sig_atomic_t quit_flag;
+static loadgenCounters loadgen_counters;
+static hdrHistogram loadgen_rtt;
+static hdrHistogram loadgen_rtt_corrected;
+static pthread_barrier_t loadgen_start_barrier;
+// Set by main thread between two waits of start barrier
+static int64_t loadgen_start_ns;
+static int64_t loadgen_measure_ns;
+static int64_t loadgen_end_ns;
+
+static void sig_handler(int signum) { quit_flag = 1; }
+
+static int64_t _loadgenTimeNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static uint64_t _loadgenRandom(loadgenConnection *lc) {
+    lc->rng ^= lc->rng << 13;
+    lc->rng ^= lc->rng >> 7;
+    lc->rng ^= lc->rng << 17;
+    return lc->rng;
+}
+
+/**
+ * Parse -s option to param->sizes
+ *
+ * @return false if sizes specification is invalid
+ */
+static bool _loadgenParseSizes(struct app_parameters *param) {
+    const char *spec = param->sizes_spec;
+    char *end;
+
+    param->sizes_count = 0;
+    param->sizes_range = false;
+
+    if (strchr(spec, '-') != NULL) {
+        param->sizes[0] = strtoul(spec, &end, 10);
+        if (*end != '-') { return false; }
+        param->sizes[1] = strtoul(end + 1, &end, 10);
+        if (*end != '\0' || param->sizes[1] < param->sizes[0]) { return false; }
+        param->sizes_count = 2;
+        param->sizes_range = true;
+        return true;
+    }
+
+    uint32_t total_weight = 0;
+    while (*spec != '\0') {
+        if (param->sizes_count == LOADGEN_MAX_SIZES) { return false; }
+        size_t size = strtoul(spec, &end, 10);
+        if (end == spec) { return false; }
+        uint32_t weight = 1;
+        if (*end == ':') {
+            spec = end + 1;
+            weight = (uint32_t)strtoul(spec, &end, 10);
+            if (end == spec || weight == 0) { return false; }
+        }
+        total_weight += weight;
+        param->sizes[param->sizes_count] = size;
+        param->weights[param->sizes_count] = total_weight;
+        param->sizes_count++;
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return false;
+        }
+        spec = end;
+    }
+    return param->sizes_count > 0;
+}
+
+static size_t _loadgenMaxSize(const struct app_parameters *param) {
+    size_t max = 0;
+    for (size_t i = 0; i < param->sizes_count; i++) {
+        if (param->sizes[i] > max) { max = param->sizes[i]; }
+    }
+    return max < LOADGEN_MIN_PAYLOAD ? LOADGEN_MIN_PAYLOAD : max;
+}
+
+static size_t _loadgenNextSize(loadgenConnection *lc) {
+    const struct app_parameters *param = lc->param;
+    size_t size;
+
+    if (param->sizes_range) {
+        const size_t span = param->sizes[1] - param->sizes[0] + 1;
+        size = param->sizes[0] + _loadgenRandom(lc) % span;
+    } else {
+        const uint32_t total = param->weights[param->sizes_count - 1];
+        const uint32_t pick = (uint32_t)(_loadgenRandom(lc) % total);
+        size_t i = 0;
+        while (param->weights[i] <= pick) { i++; }
+        size = param->sizes[i];
+    }
+    return size < LOADGEN_MIN_PAYLOAD ? LOADGEN_MIN_PAYLOAD : size;
+}
+
+/**
+ * Get interval to next message of connection in ns
+ */
+static int64_t _loadgenNextInterval(loadgenConnection *lc) {
+    const struct app_parameters *param = lc->param;
+    const double mean_ns = 1e9 * param->connections / param->rate;
+
+    int64_t interval = (int64_t)mean_ns;
+    if (param->poisson) {
+        // Uniform in (0, 1] from upper 53 bits
+        const double u =
+            ((_loadgenRandom(lc) >> 11) + 1) * (1.0 / 9007199254740992.0);
+        interval = (int64_t)(-log(u) * mean_ns);
+    }
+    return interval > 0 ? interval : 1;
+}
+
+/**
+ * Teonet L0 client event callback, records RTT of echo answers
+ */
+static void _loadgenEventCb(void *con, teoLNullEvents event, void *data,
+                            size_t data_len, void *user_data) {
+    if (event != EV_L_RECEIVED && event != EV_L_RECEIVED_UNRELIABLE) {
+        return;
+    }
+    const int64_t now = _loadgenTimeNs();
+
+    const teoLNullCPacket *cp = data;
+    const uint8_t *payload =
+        (const uint8_t *)cp->peer_name + cp->peer_name_length;
+    if (cp->cmd != CMD_L_ECHO_ANSWER || cp->data_length < LOADGEN_MIN_PAYLOAD ||
+        memcmp(payload, LOADGEN_TAG, sizeof(LOADGEN_TAG)) != 0) {
+        LOADGEN_COUNT(unexpected, 1);
+        return;
+    }
+
+    loadgenStamp stamp;
+    memcpy(&stamp, payload + sizeof(LOADGEN_TAG) + sizeof(int64_t),
+           sizeof(stamp));
+    if (stamp.scheduled_ns < loadgen_measure_ns) { return; }
+
+    hdrHistogramRecord(&loadgen_rtt, now - stamp.sent_ns);
+    hdrHistogramRecord(&loadgen_rtt_corrected, now - stamp.scheduled_ns);
+    LOADGEN_COUNT(received, 1);
+    LOADGEN_COUNT(received_bytes, cp->data_length);
+}
+
+/**
+ * Connect and login, on success lc->connected is set
+ */
+static void _loadgenConnect(loadgenConnection *lc) {
+    const struct app_parameters *param = lc->param;
+
+    lc->con = teoLNullConnectE(param->server, param->port, _loadgenEventCb, lc,
+                               param->proto);
+    if (lc->con == NULL || lc->con->status != CON_STATUS_CONNECTED) {
+        LOADGEN_COUNT(connect_errors, 1);
+        if (lc->con != NULL) { teoLNullDisconnect(lc->con); }
+        lc->con = NULL;
+        return;
+    }
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s-%d", param->name, lc->index);
+    if (teoLNullLogin(lc->con, name) <= 0) {
+        LOADGEN_COUNT(connect_errors, 1);
+        teoLNullDisconnect(lc->con);
+        lc->con = NULL;
+        return;
+    }
+
+    if (lc->ever_connected) { LOADGEN_COUNT(reconnects, 1); }
+    lc->ever_connected = true;
+    lc->connected = true;
+}
+
+/**
+ * Send message scheduled at @a scheduled_ns
+ */
+static void _loadgenSend(loadgenConnection *lc, int64_t scheduled_ns) {
+    const bool measured = scheduled_ns >= loadgen_measure_ns;
+
+    if (!lc->connected) {
+        if (measured) { LOADGEN_COUNT(not_sent, 1); }
+        return;
+    }
+
+    const size_t size = _loadgenNextSize(lc);
+    const int64_t now_ms = teotimeGetCurrentTimeMs();
+    const loadgenStamp stamp = {scheduled_ns, _loadgenTimeNs()};
+    memcpy(lc->payload + sizeof(LOADGEN_TAG), &now_ms, sizeof(now_ms));
+    memcpy(lc->payload + sizeof(LOADGEN_TAG) + sizeof(now_ms), &stamp,
+           sizeof(stamp));
+
+    if (teoLNullSend(lc->con, CMD_L_ECHO, lc->param->peer, lc->payload, size) <
+        0) {
+        LOADGEN_COUNT(send_errors, 1);
+        return;
+    }
+    if (measured) {
+        LOADGEN_COUNT(sent, 1);
+        LOADGEN_COUNT(sent_bytes, size);
+    } else {
+        LOADGEN_COUNT(warmup_sent, 1);
+    }
+}
+
+/**
+ * Wait for events not longer than up to @a deadline_ns
+ *
+ * Socket is polled with ns timeout and read with zero timeout of
+ * teoLNullReadEventLoop, its ms timeout would delay sends up to 1 ms.
+ */
+static void _loadgenWait(loadgenConnection *lc, int64_t deadline_ns) {
+    int64_t wait_ns = deadline_ns - _loadgenTimeNs();
+    if (wait_ns < 0) { wait_ns = 0; }
+    // TR-UDP retransmits and keepalives are processed by the event loop
+    if (wait_ns > LOADGEN_MAX_WAIT_MS * 1000000LL) {
+        wait_ns = LOADGEN_MAX_WAIT_MS * 1000000LL;
+    }
+    const struct timespec timeout = {wait_ns / 1000000000,
+                                     wait_ns % 1000000000};
+
+    if (!lc->connected) {
+        nanosleep(&timeout, NULL);
+        return;
+    }
+
+    struct pollfd pfd = {lc->con->fd, POLLIN, 0};
+    if (wait_ns > 0) { ppoll(&pfd, 1, &timeout, NULL); }
+    if (!teoLNullReadEventLoop(lc->con, 0) ||
+        lc->con->status != CON_STATUS_CONNECTED) {
+        LOADGEN_COUNT(disconnects, 1);
+        lc->connected = false;
+        teoLNullDisconnect(lc->con);
+        lc->con = NULL;
+    }
+}
+
+static void *_loadgenThread(void *arg) {
+    loadgenConnection *lc = arg;
+
+    _loadgenConnect(lc);
+    pthread_barrier_wait(&loadgen_start_barrier);
+    pthread_barrier_wait(&loadgen_start_barrier);
+
+    // Equal intervals start with phase offset, connections don't send at once
+    lc->next_ns = loadgen_start_ns;
+    if (lc->param->poisson) {
+        lc->next_ns += _loadgenNextInterval(lc);
+    } else {
+        lc->next_ns += _loadgenNextInterval(lc) * lc->index /
+                       lc->param->connections;
+    }
+
+    int64_t reconnect_ns = 0;
+    int reconnect_ms = LOADGEN_RECONNECT_MIN_MS;
+    int64_t now;
+    while (!quit_flag && (now = _loadgenTimeNs()) < loadgen_end_ns) {
+        // Open loop: everything scheduled by now is sent
+        while (lc->next_ns <= now && lc->next_ns < loadgen_end_ns) {
+            _loadgenSend(lc, lc->next_ns);
+            lc->next_ns += _loadgenNextInterval(lc);
+        }
+
+        if (!lc->connected && now >= reconnect_ns) {
+            _loadgenConnect(lc);
+            if (lc->connected) {
+                reconnect_ms = LOADGEN_RECONNECT_MIN_MS;
+            } else {
+                reconnect_ns = _loadgenTimeNs() + reconnect_ms * 1000000LL;
+                reconnect_ms *= 2;
+                if (reconnect_ms > LOADGEN_RECONNECT_MAX_MS) {
+                    reconnect_ms = LOADGEN_RECONNECT_MAX_MS;
+                }
+            }
+            continue;
+        }
+
+        int64_t deadline = lc->next_ns;
+        if (deadline > loadgen_end_ns) { deadline = loadgen_end_ns; }
+        if (!lc->connected && reconnect_ns < deadline) {
+            deadline = reconnect_ns;
+        }
+        _loadgenWait(lc, deadline);
+    }
+
+    // Wait for answers of last messages
+    const int64_t drain_ns = _loadgenTimeNs() + LOADGEN_DRAIN_MS * 1000000LL;
+    while (!quit_flag && lc->connected && _loadgenTimeNs() < drain_ns &&
+           __atomic_load_n(&loadgen_counters.received, __ATOMIC_RELAXED) <
+               __atomic_load_n(&loadgen_counters.sent, __ATOMIC_RELAXED)) {
+        _loadgenWait(lc, _loadgenTimeNs() + 10000000);
+    }
+
+    if (lc->con != NULL) { teoLNullDisconnect(lc->con); }
+    return NULL;
+}
+
+static void _loadgenWriteHistogram(FILE *out, const char *name,
+                                   const hdrHistogram *h) {
+    static const struct {
+        const char *name;
+        double percentile;
+    } percentiles[] = {{"p50", 50},      {"p90", 90},
+                       {"p99", 99},      {"p99_9", 99.9},
+                       {"p99_99", 99.99}};
+
+    fprintf(out, "  \"%s\": {", name);
+    fprintf(out, "\"count\": %" PRIu64 ", \"min\": %.3f, \"mean\": %.3f",
+            h->total_count,
+            h->total_count != 0 ? h->min / 1000.0 : 0.0,
+            hdrHistogramMean(h) / 1000.0);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        fprintf(out, ", \"%s\": %.3f", percentiles[i].name,
+                hdrHistogramValueAtPercentile(h, percentiles[i].percentile) /
+                    1000.0);
+    }
+    fprintf(out, ", \"max\": %.3f}", h->max / 1000.0);
+}
+
+static void _loadgenWriteJSON(FILE *out, const struct app_parameters *param,
+                              double elapsed_s) {
+    const loadgenCounters *c = &loadgen_counters;
+    const uint64_t lost = c->sent > c->received ? c->sent - c->received : 0;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"teocli_loadgen\",\n");
+    fprintf(out, "  \"version\": \"%s\",\n", TL0LG_VERSION);
+    fprintf(out,
+            "  \"config\": {\"server\": \"%s\", \"port\": %u, "
+            "\"transport\": \"%s\", \"mock\": %s, \"encryption\": %d, "
+            "\"connections\": %d, \"rate\": %.1f, \"intervals\": \"%s\", "
+            "\"sizes\": \"%s\", \"peer\": \"%s\", \"duration_s\": %d, "
+            "\"warmup_s\": %d},\n",
+            param->server, (unsigned)param->port,
+            param->proto == TCP ? "tcp" : "trudp",
+            param->mock ? "true" : "false", param->encryption,
+            param->connections, param->rate,
+            param->poisson ? "poisson" : "fixed", param->sizes_spec,
+            param->peer, param->duration_s, param->warmup_s);
+    fprintf(out, "  \"elapsed_s\": %.3f,\n", elapsed_s);
+    fprintf(out,
+            "  \"messages\": {\"sent\": %" PRIu64 ", \"received\": %" PRIu64
+            ", \"lost\": %" PRIu64 ", \"not_sent\": %" PRIu64
+            ", \"warmup_sent\": %" PRIu64 "},\n",
+            c->sent, c->received, lost, c->not_sent, c->warmup_sent);
+    fprintf(out,
+            "  \"throughput\": {\"sent_per_second\": %.1f, "
+            "\"received_per_second\": %.1f, \"sent_bytes_per_second\": %.1f, "
+            "\"received_bytes_per_second\": %.1f},\n",
+            c->sent / elapsed_s, c->received / elapsed_s,
+            c->sent_bytes / elapsed_s, c->received_bytes / elapsed_s);
+    fprintf(out, "  \"reconnects\": %" PRIu64 ",\n", c->reconnects);
+    fprintf(out,
+            "  \"errors\": {\"connect\": %" PRIu64 ", \"send\": %" PRIu64
+            ", \"disconnects\": %" PRIu64 ", \"unexpected_packets\": %" PRIu64
+            "},\n",
+            c->connect_errors, c->send_errors, c->disconnects, c->unexpected);
+    _loadgenWriteHistogram(out, "rtt_us", &loadgen_rtt);
+    fprintf(out, ",\n");
+    _loadgenWriteHistogram(out, "rtt_corrected_us", &loadgen_rtt_corrected);
+    fprintf(out, "\n}\n");
+}
+
+int main(int argc, char **argv) {
+    struct app_parameters param = {0};
+    param.server = "127.0.0.1";
+    param.port = LOADGEN_DEFAULT_PORT;
+    param.proto = TCP;
+    param.connections = 1;
+    param.rate = 1000;
+    param.duration_s = 10;
+    param.warmup_s = 1;
+    param.encryption = ENC_PROTO_ECDH_AES_128_V1;
+    param.peer = "mock-l0";
+    param.name = "loadgen";
+    param.sizes_spec = "64";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:uMc:r:s:xd:w:e:P:n:o:C:h")) != -1) {
+        switch (opt) {
+        case 'a': param.server = optarg; break;
+        case 'p': param.port = (uint16_t)atoi(optarg); break;
+        case 'u': param.proto = TRUDP; break;
+        case 'M': param.mock = true; break;
+        case 'c': param.connections = atoi(optarg); break;
+        case 'r': param.rate = atof(optarg); break;
+        case 's': param.sizes_spec = optarg; break;
+        case 'x': param.poisson = true; break;
+        case 'd': param.duration_s = atoi(optarg); break;
+        case 'w': param.warmup_s = atoi(optarg); break;
+        case 'e': param.encryption = atoi(optarg); break;
+        case 'P': param.peer = optarg; break;
+        case 'n': param.name = optarg; break;
+        case 'o': param.output = optarg; break;
+        case 'C': param.capture = optarg; break;
+        default:
+            fprintf(stderr,
+                    "Teocli open-loop load generator ver " TL0LG_VERSION
+                    "\n\nUsage: %s [-a address] [-p port] [-u] [-M] "
+                    "[-c connections] [-r rate] [-s sizes] [-x] "
+                    "[-d duration_s] [-w warmup_s] [-e encryption] [-P peer] "
+                    "[-n name] [-o report.json] [-C capture]\n",
+                    argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (param.connections < 1 || param.rate <= 0 || param.duration_s < 1 ||
+        param.warmup_s < 0 || param.encryption < ENC_PROTO_DISABLED ||
+        param.encryption > ENC_PROTO_X25519_CHACHA20_POLY1305_V3) {
+        fprintf(stderr, "Invalid parameters, see %s -h\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!_loadgenParseSizes(&param)) {
+        fprintf(stderr, "Invalid payload sizes: %s\n", param.sizes_spec);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+    // Default 50 us timer slack of threads would be seen in corrected RTT
+    prctl(PR_SET_TIMERSLACK, 1UL);
+
+    teoLNullInit();
+    teoLNUllSetOption_EncryptionProtocol(param.encryption);
+    if (param.capture != NULL) {
+        teoLNUllSetOption_Capture(param.capture, true);
+    }
+
+    teoLNullMockServer *mock = NULL;
+    if (param.mock) {
+        teoLNullMockServerConfig config = {0};
+        config.name = param.peer;
+        config.disable_tcp = param.proto != TCP;
+        config.disable_trudp = param.proto == TCP;
+        mock = teoLNullMockServerStart(&config);
+        if (mock == NULL) {
+            fprintf(stderr, "Can't start mock L0 server\n");
+            teoLNullCleanup();
+            return EXIT_FAILURE;
+        }
+        param.server = "127.0.0.1";
+        param.port = param.proto == TCP ? teoLNullMockServerTcpPort(mock)
+                                        : teoLNullMockServerUdpPort(mock);
+    }
+
+    if (!hdrHistogramInit(&loadgen_rtt, 1, LOADGEN_HIST_MAX_NS,
+                          LOADGEN_HIST_DIGITS) ||
+        !hdrHistogramInit(&loadgen_rtt_corrected, 1, LOADGEN_HIST_MAX_NS,
+                          LOADGEN_HIST_DIGITS)) {
+        fprintf(stderr, "Can't allocate histograms\n");
+        return EXIT_FAILURE;
+    }
+
+    // Nothing is measured until schedule is set
+    loadgen_measure_ns = INT64_MAX;
+    pthread_barrier_init(&loadgen_start_barrier, NULL,
+                         (unsigned)param.connections + 1);
+
+    const size_t payload_size = _loadgenMaxSize(&param);
+    loadgenConnection *connections =
+        calloc((size_t)param.connections, sizeof(loadgenConnection));
+    for (int i = 0; i < param.connections; i++) {
+        loadgenConnection *lc = &connections[i];
+        lc->param = &param;
+        lc->index = i;
+        lc->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+        lc->payload = malloc(payload_size);
+        memset(lc->payload, 'L', payload_size);
+        memcpy(lc->payload, LOADGEN_TAG, sizeof(LOADGEN_TAG));
+        pthread_create(&lc->thread, NULL, _loadgenThread, lc);
+    }
+
+    // All connections are made before schedule starts
+    pthread_barrier_wait(&loadgen_start_barrier);
+    loadgen_start_ns = _loadgenTimeNs();
+    loadgen_measure_ns = loadgen_start_ns + param.warmup_s * 1000000000LL;
+    loadgen_end_ns = loadgen_measure_ns + param.duration_s * 1000000000LL;
+    pthread_barrier_wait(&loadgen_start_barrier);
+
+    for (int i = 0; i < param.connections; i++) {
+        pthread_join(connections[i].thread, NULL);
+        free(connections[i].payload);
+    }
+    int64_t end_ns = _loadgenTimeNs();
+    if (end_ns > loadgen_end_ns) { end_ns = loadgen_end_ns; }
+    const double elapsed_s = (end_ns - loadgen_measure_ns) / 1e9;
+
+    free(connections);
+    pthread_barrier_destroy(&loadgen_start_barrier);
+    if (mock != NULL) { teoLNullMockServerStop(mock); }
+    teoLNullCleanup();
+
+    FILE *out = stdout;
+    if (param.output != NULL) {
+        out = fopen(param.output, "w");
+        if (out == NULL) {
+            perror(param.output);
+            return EXIT_FAILURE;
+        }
+    }
+    _loadgenWriteJSON(out, &param, elapsed_s > 0 ? elapsed_s : 1);
+    if (out != stdout) { fclose(out); }
+
+    hdrHistogramDestroy(&loadgen_rtt);
+    hdrHistogramDestroy(&loadgen_rtt_corrected);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/**
+ * \file   main_mock_server.c
+ *
+ * \example main_mock_server.c
+ *
+ * Loopback stand-in of L0 server to run examples, load generators and
+ * benchmarks without network L0 server. It accepts TCP and TR-UDP
+ * connections, performs ENC_PROTO_ECDH_AES_128_V1 key exchange, answers login,
+ * CMD_L_ECHO, CMD_L_PEERS and CMD_L_L0_CLIENTS and optionally routes packets
+ * between connected clients by their login names.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_mock_server [-a address] [-t tcp_port] [-u udp_port]
+ *              [-T] [-U] [-r] [-n name] [-s stats_interval_s]
+ *
+ * **Example:** ./teocli_mock_server -t 9000 -u 9000 -r
+ *
+ *   -a  address to listen on, 127.0.0.1 by default
+ *   -t  TCP port, 9000 by default, 0 to choose free one
+ *   -u  TR-UDP port, 9000 by default, 0 to choose free one
+ *   -T  don't accept TCP connections
+ *   -U  don't accept TR-UDP connections
+ *   -r  route packets addressed to other connected clients
+ *   -n  server peer name, mock-l0 by default
+ *   -s  print statistics every stats_interval_s seconds, 0 disables
+ *
+ * Server runs until SIGINT or SIGTERM and prints statistics at exit.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "teonet_l0_mock_server.h"
+
+#define TL0MS_VERSION "0.0.1"
+
+#define MOCK_DEFAULT_PORT 9000
+
+static volatile sig_atomic_t quit_flag;
+
+static void sig_handler(int signum) { quit_flag = 1; }
+
+static void print_stats(teoLNullMockServer *server) {
+    teoLNullMockServerStats stats;
+    teoLNullMockServerGetStats(server, &stats);
+    printf("clients %llu (connections %llu, logins %llu, key exchanges "
+           "%llu), packets in %llu out %llu, bytes in %llu out %llu, echoes "
+           "%llu, routed %llu, dropped %llu\n",
+           (unsigned long long)stats.clients,
+           (unsigned long long)stats.connections,
+           (unsigned long long)stats.logins,
+           (unsigned long long)stats.key_exchanges,
+           (unsigned long long)stats.packets_received,
+           (unsigned long long)stats.packets_sent,
+           (unsigned long long)stats.bytes_received,
+           (unsigned long long)stats.bytes_sent,
+           (unsigned long long)stats.echoes, (unsigned long long)stats.routed,
+           (unsigned long long)stats.dropped);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    teoLNullMockServerConfig config = {0};
+    config.tcp_port = MOCK_DEFAULT_PORT;
+    config.udp_port = MOCK_DEFAULT_PORT;
+    int stats_interval_s = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:t:u:TUrn:s:h")) != -1) {
+        switch (opt) {
+        case 'a': config.host = optarg; break;
+        case 't': config.tcp_port = (uint16_t)atoi(optarg); break;
+        case 'u': config.udp_port = (uint16_t)atoi(optarg); break;
+        case 'T': config.disable_tcp = true; break;
+        case 'U': config.disable_trudp = true; break;
+        case 'r': config.route = true; break;
+        case 'n': config.name = optarg; break;
+        case 's': stats_interval_s = atoi(optarg); break;
+        default:
+            fprintf(stderr,
+                    "Teocli mock L0 server ver " TL0MS_VERSION
+                    "\n\nUsage: %s [-a address] [-t tcp_port] [-u udp_port] "
+                    "[-T] [-U] [-r] [-n name] [-s stats_interval_s]\n",
+                    argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+
+    teoLNullInit();
+
+    teoLNullMockServer *server = teoLNullMockServerStart(&config);
+    if (server == NULL) {
+        fprintf(stderr, "Can't start mock L0 server\n");
+        teoLNullCleanup();
+        return EXIT_FAILURE;
+    }
+    printf("Mock L0 server listens on tcp port %u, udp port %u\n",
+           (unsigned)teoLNullMockServerTcpPort(server),
+           (unsigned)teoLNullMockServerUdpPort(server));
+    fflush(stdout);
+
+    int elapsed_s = 0;
+    while (!quit_flag) {
+        sleep(1);
+        if (!quit_flag && stats_interval_s > 0 &&
+            ++elapsed_s % stats_interval_s == 0) {
+            print_stats(server);
+        }
+    }
+
+    print_stats(server);
+    teoLNullMockServerStop(server);
+    teoLNullCleanup();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,644 @@
+/**
+ * \file   main_mpsend.c
+ *
+ * \example main_mpsend.c
+ *
+ * Multi-producer send benchmark of Teocli library. Number of producer threads
+ * call teoLNullSend concurrently on one TCP or TR-UDP connection to mock L0
+ * server started in process, while event loop runs in its own thread as in
+ * main_select_common_thread.c. Every combination of producer threads,
+ * message size, encryption and mode is run for the same time.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_mpsend [-u] [-t threads] [-s sizes] [-e encryption]
+ *              [-m modes] [-d duration_s] [-w window] [-o report.json]
+ *
+ * **Example:** ./teocli_mpsend -t 1,4,16 -s 64,1024 -e 1 -m echo -d 3
+ *
+ *   -u  connect with TR-UDP, TCP by default
+ *   -t  comma separated numbers of producer threads, 1,2,4,8,16,32 by default
+ *   -s  comma separated payload sizes, 64,1024 by default
+ *   -e  comma separated encryption protocols: 0 disabled, 1 ECDH_AES_128_V1,
+ *       0,1 by default
+ *   -m  comma separated modes, send,echo by default:
+ *       send - messages are sent to a peer server drops, only the send path
+ *              is loaded;
+ *       echo - messages are CMD_L_ECHO answered by server, event loop thread
+ *              receives and decrypts answers while producers send, it's
+ *              the send/receive contention case
+ *   -d  send time of every case in seconds, 2 by default
+ *   -w  most messages sent but not yet received by server (send mode) or
+ *       answered (echo mode), producers wait when it's reached, 4096 by
+ *       default, 0 - unlimited. TR-UDP send queue isn't limited by library,
+ *       so window keeps it from growing for the whole case
+ *   -o  write report to file instead of stdout
+ *
+ * ### Measurement:
+ *
+ * For every case report has messages enqueued by teoLNullSend and delivered
+ * to server per second, enqueue latency percentiles (teoLNullSend call time,
+ * window waits aren't included), CPU time of event loop thread and lock
+ * contention: number and time of pthread_mutex_lock calls which had to wait
+ * and of pthread_cond_wait sleeps in the whole process, including TCP
+ * senders waiting for socket write and sleeping until their encryption nonce
+ * turn. Contention is counted with glibc only and is null otherwise. Short
+ * nonce turn waits yield CPU instead of sleeping and aren't counted, library
+ * built with --enable-latency-trace adds mean time of send stages where they
+ * are part of the order stage.
+ */
+
+#define _GNU_SOURCE // RTLD_NEXT
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+#include "teobase/time.h"
+#include "hdr_histogram.h"
+#include "teonet_l0_mock_server.h"
+
+#define TL0MP_VERSION "0.0.1"
+
+#define MPSEND_TAG "teocli_mpsend"
+#define MPSEND_PEER "mock-l0"
+// Peer unknown to mock server, messages to it are dropped by server
+#define MPSEND_SINK "mpsend-sink"
+#define MPSEND_SINK_CMD 129
+#define MPSEND_MAX_LIST 16
+#define MPSEND_DRAIN_MS 5000
+#define MPSEND_LOOP_TIMEOUT_MS 10
+// Enqueue latency histogram range is 1 ns to 10 s with 3 significant digits
+#define MPSEND_HIST_MAX_NS 10000000000LL
+#define MPSEND_HIST_DIGITS 3
+
+#define MPSEND_MIN_PAYLOAD (sizeof(MPSEND_TAG) + sizeof(int64_t))
+
+enum { MODE_SEND, MODE_ECHO };
+
+/**
+ * Application parameters structure
+ */
+struct app_parameters {
+    PROTOCOL proto;
+    int threads[MPSEND_MAX_LIST];
+    size_t threads_count;
+    int sizes[MPSEND_MAX_LIST];
+    size_t sizes_count;
+    int encryption[MPSEND_MAX_LIST];
+    size_t encryption_count;
+    int modes[MPSEND_MAX_LIST];
+    size_t modes_count;
+    int duration_s;
+    uint64_t window;
+    const char *output;
+};
+
+/**
+ * Process wide lock contention counters
+ */
+typedef struct mpsendContention {
+    uint64_t mutex_waits;   ///< pthread_mutex_lock calls which waited
+    uint64_t mutex_wait_ns; ///< Time of these waits
+    uint64_t cond_waits;    ///< pthread_cond_wait sleeps
+    uint64_t cond_wait_ns;  ///< Time of these sleeps
+} mpsendContention;
+
+static mpsendContention mpsend_contention;
+
+#define MPSEND_CONTENTION_ADD(field, value)                                    \
+    __atomic_fetch_add(&mpsend_contention.field, (value), __ATOMIC_RELAXED)
+
+static int64_t _mpsendTimeNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#if defined(__GLIBC__)
+#define MPSEND_COUNT_CONTENTION 1
+
+typedef int (*mpsendMutexLock)(pthread_mutex_t *mutex);
+typedef int (*mpsendCondWait)(pthread_cond_t *cond, pthread_mutex_t *mutex);
+static mpsendMutexLock mpsend_mutex_lock;
+static mpsendCondWait mpsend_cond_wait;
+
+// Library locks are counted by interposing pthread functions of the process
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+    if (mpsend_mutex_lock == NULL) {
+        mpsend_mutex_lock =
+            (mpsendMutexLock)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    }
+    if (pthread_mutex_trylock(mutex) == 0) { return 0; }
+
+    const int64_t start_ns = _mpsendTimeNs();
+    const int rc = mpsend_mutex_lock(mutex);
+    MPSEND_CONTENTION_ADD(mutex_waits, 1);
+    MPSEND_CONTENTION_ADD(mutex_wait_ns, _mpsendTimeNs() - start_ns);
+    return rc;
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+    if (mpsend_cond_wait == NULL) {
+        mpsend_cond_wait = (mpsendCondWait)dlsym(RTLD_NEXT, "pthread_cond_wait");
+    }
+    const int64_t start_ns = _mpsendTimeNs();
+    const int rc = mpsend_cond_wait(cond, mutex);
+    MPSEND_CONTENTION_ADD(cond_waits, 1);
+    MPSEND_CONTENTION_ADD(cond_wait_ns, _mpsendTimeNs() - start_ns);
+    return rc;
+}
+#endif
+
+/**
+ * One case of benchmark matrix
+ */
+typedef struct mpsendCase {
+    int threads;
+    int size;
+    int encryption;
+    int mode;
+} mpsendCase;
+
+/**
+ * Case run shared by producers and event loop thread
+ */
+typedef struct mpsendRun {
+    const struct app_parameters *param;
+    const mpsendCase *c;
+    teoLNullConnectData *con;
+    teoLNullMockServer *mock;
+    uint64_t mock_received_base; ///< Server packets received before case
+
+    pthread_barrier_t start_barrier;
+    int64_t end_ns;   ///< Producers stop sending
+    bool loop_stop;   ///< Event loop thread stops
+
+    uint64_t sent;     ///< Messages enqueued by teoLNullSend
+    uint64_t errors;   ///< teoLNullSend failures
+    uint64_t answers;  ///< Echo answers received
+    int64_t loop_cpu_ns;  ///< CPU time of event loop thread
+    int64_t loop_wall_ns; ///< Run time of event loop thread
+
+    pthread_mutex_t histogram_lock;
+    hdrHistogram enqueue; ///< Enqueue latency of all producers
+} mpsendRun;
+
+/**
+ * Producer thread data
+ */
+typedef struct mpsendProducer {
+    mpsendRun *run;
+    pthread_t thread;
+    hdrHistogram enqueue;
+} mpsendProducer;
+
+static int64_t _mpsendThreadCpuNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Get number of messages received by server (send mode) or answered (echo
+ * mode) in current case
+ */
+static uint64_t _mpsendDelivered(mpsendRun *run) {
+    if (run->c->mode == MODE_ECHO) {
+        return __atomic_load_n(&run->answers, __ATOMIC_RELAXED);
+    }
+    teoLNullMockServerStats stats;
+    teoLNullMockServerGetStats(run->mock, &stats);
+    return stats.packets_received - run->mock_received_base;
+}
+
+static void _mpsendEventCb(void *con, teoLNullEvents event, void *data,
+                           size_t data_len, void *user_data) {
+    mpsendRun *run = (mpsendRun *)user_data;
+    if (event != EV_L_RECEIVED) { return; }
+
+    const teoLNullCPacket *cp = data;
+    if (cp->cmd == CMD_L_ECHO_ANSWER) {
+        __atomic_fetch_add(&run->answers, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void *_mpsendLoopThread(void *arg) {
+    mpsendRun *run = (mpsendRun *)arg;
+
+    const int64_t cpu_ns = _mpsendThreadCpuNs();
+    const int64_t wall_ns = _mpsendTimeNs();
+    while (!__atomic_load_n(&run->loop_stop, __ATOMIC_ACQUIRE)) {
+        if (!teoLNullReadEventLoop(run->con, MPSEND_LOOP_TIMEOUT_MS)) {
+            break;
+        }
+    }
+    run->loop_cpu_ns = _mpsendThreadCpuNs() - cpu_ns;
+    run->loop_wall_ns = _mpsendTimeNs() - wall_ns;
+    return NULL;
+}
+
+static void *_mpsendProducerThread(void *arg) {
+    mpsendProducer *producer = (mpsendProducer *)arg;
+    mpsendRun *run = producer->run;
+    const mpsendCase *c = run->c;
+    const uint64_t window = run->param->window;
+
+    const bool echo = c->mode == MODE_ECHO;
+    const uint8_t cmd = echo ? CMD_L_ECHO : MPSEND_SINK_CMD;
+    const char *peer = echo ? MPSEND_PEER : MPSEND_SINK;
+
+    uint8_t *payload = malloc((size_t)c->size);
+    memset(payload, 'M', (size_t)c->size);
+    memcpy(payload, MPSEND_TAG, sizeof(MPSEND_TAG));
+
+    pthread_barrier_wait(&run->start_barrier);
+
+    uint64_t sent = 0;
+    uint64_t errors = 0;
+    while (_mpsendTimeNs() < run->end_ns) {
+        // Window is checked every few messages, server stats are shared
+        if (window != 0 && (sent & 15) == 0) {
+            while (__atomic_load_n(&run->sent, __ATOMIC_RELAXED) -
+                           _mpsendDelivered(run) >=
+                       window &&
+                   _mpsendTimeNs() < run->end_ns) {
+                sched_yield();
+            }
+        }
+
+        // teoLNullSendEcho compatible part: message string and time in ms
+        const int64_t now_ms = teotimeGetCurrentTimeMs();
+        memcpy(payload + sizeof(MPSEND_TAG), &now_ms, sizeof(now_ms));
+
+        const int64_t start_ns = _mpsendTimeNs();
+        const ssize_t rc =
+            teoLNullSend(run->con, cmd, peer, payload, (size_t)c->size);
+        hdrHistogramRecord(&producer->enqueue, _mpsendTimeNs() - start_ns);
+        if (rc < 0) {
+            errors++;
+        } else {
+            sent++;
+            __atomic_fetch_add(&run->sent, 1, __ATOMIC_RELAXED);
+        }
+    }
+    free(payload);
+
+    __atomic_fetch_add(&run->errors, errors, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&run->histogram_lock);
+    hdrHistogramAdd(&run->enqueue, &producer->enqueue);
+    pthread_mutex_unlock(&run->histogram_lock);
+    return NULL;
+}
+
+static void _mpsendWriteStages(FILE *out, teoLNullConnectData *con) {
+    static const teoLNullStage stages[] = {STAGE_SEND_PIPE, STAGE_SEND_SEAL,
+                                           STAGE_SEND_ORDER, STAGE_SEND_WRITE};
+
+    teoLNullStageStats *stats =
+        (teoLNullStageStats *)malloc(sizeof(teoLNullStageStats));
+    if (!teoLNullGetStageStats(con, stats) || stats->sample_rate == 0) {
+        fprintf(out, "null");
+        free(stats);
+        return;
+    }
+    fprintf(out, "{");
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+        const teoLNullStageHistogram *h = &stats->stages[stages[i]];
+        fprintf(out, "%s\"%s_mean_ns\": %.1f", i > 0 ? ", " : "",
+                teoLNullStageName(stages[i]),
+                h->count > 0 ? (double)h->sum_ns / h->count : 0);
+    }
+    fprintf(out, "}");
+    free(stats);
+}
+
+static void _mpsendWriteHistogram(FILE *out, const hdrHistogram *h) {
+    static const struct {
+        const char *name;
+        double percentile;
+    } percentiles[] = {{"p50", 50}, {"p90", 90}, {"p99", 99},
+                       {"p99_9", 99.9}};
+
+    fprintf(out, "{\"count\": %" PRIu64 ", \"mean\": %.1f", h->total_count,
+            hdrHistogramMean(h));
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        fprintf(out, ", \"%s\": %" PRId64, percentiles[i].name,
+                hdrHistogramValueAtPercentile(h, percentiles[i].percentile));
+    }
+    fprintf(out, ", \"max\": %" PRId64 "}", h->max);
+}
+
+/**
+ * Run one case and write its report entry
+ *
+ * @return false if case can't be set up
+ */
+static bool _mpsendRunCase(FILE *out, const struct app_parameters *param,
+                           const mpsendCase *c) {
+    teoLNUllSetOption_EncryptionProtocol(c->encryption);
+
+    teoLNullMockServerConfig config = {0};
+    config.name = MPSEND_PEER;
+    config.disable_tcp = param->proto != TCP;
+    config.disable_trudp = param->proto == TCP;
+    teoLNullMockServer *mock = teoLNullMockServerStart(&config);
+    if (mock == NULL) { return false; }
+
+    mpsendRun *run = (mpsendRun *)calloc(1, sizeof(mpsendRun));
+    run->param = param;
+    run->c = c;
+    run->mock = mock;
+    pthread_mutex_init(&run->histogram_lock, NULL);
+    hdrHistogramInit(&run->enqueue, 1, MPSEND_HIST_MAX_NS, MPSEND_HIST_DIGITS);
+
+    run->con = teoLNullConnectE(
+        "127.0.0.1",
+        param->proto == TCP ? teoLNullMockServerTcpPort(mock)
+                            : teoLNullMockServerUdpPort(mock),
+        _mpsendEventCb, run, param->proto);
+    if (run->con->status != CON_STATUS_CONNECTED ||
+        teoLNullLogin(run->con, "mpsend") <= 0) {
+        teoLNullDisconnect(run->con);
+        teoLNullMockServerStop(mock);
+        hdrHistogramDestroy(&run->enqueue);
+        free(run);
+        return false;
+    }
+
+    pthread_t loop_thread;
+    pthread_create(&loop_thread, NULL, _mpsendLoopThread, run);
+
+    // Login is received by server before measurement
+    teoLNullMockServerStats mock_stats;
+    do {
+        sched_yield();
+        teoLNullMockServerGetStats(mock, &mock_stats);
+    } while (mock_stats.logins == 0);
+    run->mock_received_base = mock_stats.packets_received;
+
+    mpsendProducer *producers =
+        (mpsendProducer *)calloc((size_t)c->threads, sizeof(mpsendProducer));
+    pthread_barrier_init(&run->start_barrier, NULL, (unsigned)c->threads + 1);
+    for (int i = 0; i < c->threads; i++) {
+        producers[i].run = run;
+        hdrHistogramInit(&producers[i].enqueue, 1, MPSEND_HIST_MAX_NS,
+                         MPSEND_HIST_DIGITS);
+        pthread_create(&producers[i].thread, NULL, _mpsendProducerThread,
+                       &producers[i]);
+    }
+
+    const mpsendContention contention_base = mpsend_contention;
+    const int64_t start_ns = _mpsendTimeNs();
+    run->end_ns = start_ns + param->duration_s * 1000000000LL;
+    pthread_barrier_wait(&run->start_barrier);
+    for (int i = 0; i < c->threads; i++) {
+        pthread_join(producers[i].thread, NULL);
+        hdrHistogramDestroy(&producers[i].enqueue);
+    }
+    const int64_t send_ns = _mpsendTimeNs() - start_ns;
+
+    // Wait for server to receive or answer all messages
+    const int64_t drain_ns = _mpsendTimeNs() + MPSEND_DRAIN_MS * 1000000LL;
+    while (_mpsendDelivered(run) < run->sent && _mpsendTimeNs() < drain_ns) {
+        usleep(1000);
+    }
+    const uint64_t delivered = _mpsendDelivered(run);
+    const int64_t deliver_ns = _mpsendTimeNs() - start_ns;
+
+    __atomic_store_n(&run->loop_stop, true, __ATOMIC_RELEASE);
+    pthread_join(loop_thread, NULL);
+    mpsendContention contention = mpsend_contention;
+    contention.mutex_waits -= contention_base.mutex_waits;
+    contention.mutex_wait_ns -= contention_base.mutex_wait_ns;
+    contention.cond_waits -= contention_base.cond_waits;
+    contention.cond_wait_ns -= contention_base.cond_wait_ns;
+
+    const double send_s = send_ns / 1e9;
+    fprintf(out,
+            "    {\"threads\": %d, \"size\": %d, \"encryption\": %d, "
+            "\"mode\": \"%s\",\n",
+            c->threads, c->size, c->encryption,
+            c->mode == MODE_ECHO ? "echo" : "send");
+    fprintf(out,
+            "     \"sent\": %" PRIu64 ", \"delivered\": %" PRIu64
+            ", \"errors\": %" PRIu64 ",\n",
+            run->sent, delivered, run->errors);
+    fprintf(out,
+            "     \"enqueued_per_second\": %.1f, "
+            "\"delivered_per_second\": %.1f, "
+            "\"delivered_bytes_per_second\": %.1f,\n",
+            run->sent / send_s, delivered / (deliver_ns / 1e9),
+            (double)delivered * c->size / (deliver_ns / 1e9));
+    fprintf(out, "     \"enqueue_ns\": ");
+    _mpsendWriteHistogram(out, &run->enqueue);
+    fprintf(out, ",\n");
+    fprintf(out,
+            "     \"loop_cpu_ms\": %.3f, \"loop_cpu_percent\": %.1f, "
+            "\"loop_cpu_ns_per_message\": %.1f,\n",
+            run->loop_cpu_ns / 1e6,
+            run->loop_wall_ns > 0 ? 100.0 * run->loop_cpu_ns / run->loop_wall_ns
+                                  : 0,
+            run->sent > 0 ? (double)run->loop_cpu_ns / run->sent : 0);
+#if defined(MPSEND_COUNT_CONTENTION)
+    fprintf(out,
+            "     \"contention\": {\"mutex_waits\": %" PRIu64
+            ", \"mutex_wait_ms\": %.3f, \"cond_waits\": %" PRIu64
+            ", \"cond_wait_ms\": %.3f, \"wait_ns_per_message\": %.1f},\n",
+            contention.mutex_waits, contention.mutex_wait_ns / 1e6,
+            contention.cond_waits, contention.cond_wait_ns / 1e6,
+            run->sent > 0 ? (double)(contention.mutex_wait_ns +
+                                     contention.cond_wait_ns) /
+                                run->sent
+                          : 0);
+#else
+    fprintf(out, "     \"contention\": null,\n");
+#endif
+    fprintf(out, "     \"send_stages\": ");
+    _mpsendWriteStages(out, run->con);
+    fprintf(out, "}");
+
+    teoLNullDisconnect(run->con);
+    teoLNullMockServerStop(mock);
+    pthread_barrier_destroy(&run->start_barrier);
+    pthread_mutex_destroy(&run->histogram_lock);
+    hdrHistogramDestroy(&run->enqueue);
+    free(producers);
+    free(run);
+    return true;
+}
+
+/**
+ * Parse comma separated list of numbers
+ *
+ * @return false if list is empty or invalid
+ */
+static bool _mpsendParseList(const char *spec, int *values, size_t *count) {
+    char *end;
+    *count = 0;
+    while (*spec != '\0') {
+        if (*count == MPSEND_MAX_LIST) { return false; }
+        long value = strtol(spec, &end, 10);
+        if (end == spec || value < 0) { return false; }
+        values[(*count)++] = (int)value;
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return false;
+        }
+        spec = end;
+    }
+    return *count > 0;
+}
+
+/**
+ * Parse comma separated list of modes
+ *
+ * @return false if list is empty or invalid
+ */
+static bool _mpsendParseModes(const char *spec, int *modes, size_t *count) {
+    *count = 0;
+    while (*spec != '\0') {
+        if (*count == MPSEND_MAX_LIST) { return false; }
+        if (strncmp(spec, "send", 4) == 0) {
+            modes[(*count)++] = MODE_SEND;
+        } else if (strncmp(spec, "echo", 4) == 0) {
+            modes[(*count)++] = MODE_ECHO;
+        } else {
+            return false;
+        }
+        spec += 4;
+        if (*spec == ',') {
+            spec++;
+        } else if (*spec != '\0') {
+            return false;
+        }
+    }
+    return *count > 0;
+}
+
+int main(int argc, char **argv) {
+    struct app_parameters param = {0};
+    param.proto = TCP;
+    param.duration_s = 2;
+    param.window = 4096;
+    const char *threads = "1,2,4,8,16,32";
+    const char *sizes = "64,1024";
+    const char *encryption = "0,1";
+    const char *modes = "send,echo";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ut:s:e:m:d:w:o:h")) != -1) {
+        switch (opt) {
+        case 'u': param.proto = TRUDP; break;
+        case 't': threads = optarg; break;
+        case 's': sizes = optarg; break;
+        case 'e': encryption = optarg; break;
+        case 'm': modes = optarg; break;
+        case 'd': param.duration_s = atoi(optarg); break;
+        case 'w': param.window = strtoull(optarg, NULL, 10); break;
+        case 'o': param.output = optarg; break;
+        default:
+            fprintf(stderr,
+                    "Teocli multi-producer send benchmark ver " TL0MP_VERSION
+                    "\n\nUsage: %s [-u] [-t threads] [-s sizes] "
+                    "[-e encryption] [-m modes] [-d duration_s] [-w window] "
+                    "[-o report.json]\n",
+                    argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (!_mpsendParseList(threads, param.threads, &param.threads_count) ||
+        !_mpsendParseList(sizes, param.sizes, &param.sizes_count) ||
+        !_mpsendParseList(encryption, param.encryption,
+                          &param.encryption_count) ||
+        !_mpsendParseModes(modes, param.modes, &param.modes_count) ||
+        param.duration_s < 1) {
+        fprintf(stderr, "Invalid parameters, see %s -h\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < param.threads_count; i++) {
+        if (param.threads[i] < 1) {
+            fprintf(stderr, "Invalid number of threads %d\n", param.threads[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    for (size_t i = 0; i < param.sizes_count; i++) {
+        if (param.sizes[i] > UINT16_MAX) {
+            fprintf(stderr, "Invalid payload size %d\n", param.sizes[i]);
+            return EXIT_FAILURE;
+        }
+        if ((size_t)param.sizes[i] < MPSEND_MIN_PAYLOAD) {
+            param.sizes[i] = (int)MPSEND_MIN_PAYLOAD;
+        }
+    }
+    for (size_t i = 0; i < param.encryption_count; i++) {
+        // Mock L0 server makes ECDH_AES_128_V1 key exchange only
+        if (param.encryption[i] != ENC_PROTO_DISABLED &&
+            param.encryption[i] != ENC_PROTO_ECDH_AES_128_V1) {
+            fprintf(stderr, "Unsupported encryption %d\n",
+                    param.encryption[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *out = stdout;
+    if (param.output != NULL) {
+        out = fopen(param.output, "w");
+        if (out == NULL) {
+            perror(param.output);
+            return EXIT_FAILURE;
+        }
+    }
+
+    teoLNullInit();
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"teocli_mpsend\",\n");
+    fprintf(out, "  \"version\": \"%s\",\n", TL0MP_VERSION);
+    fprintf(out,
+            "  \"config\": {\"transport\": \"%s\", \"duration_s\": %d, "
+            "\"window\": %" PRIu64 "},\n",
+            param.proto == TCP ? "tcp" : "trudp", param.duration_s,
+            param.window);
+    fprintf(out, "  \"cases\": [\n");
+
+    bool first = true;
+    int rc = EXIT_SUCCESS;
+    for (size_t m = 0; m < param.modes_count && rc == EXIT_SUCCESS; m++) {
+        for (size_t e = 0; e < param.encryption_count; e++) {
+            for (size_t s = 0; s < param.sizes_count; s++) {
+                for (size_t t = 0; t < param.threads_count; t++) {
+                    const mpsendCase c = {param.threads[t], param.sizes[s],
+                                          param.encryption[e],
+                                          param.modes[m]};
+                    if (!first) { fprintf(out, ",\n"); }
+                    first = false;
+                    if (!_mpsendRunCase(out, &param, &c)) {
+                        fprintf(stderr, "Can't set up case\n");
+                        rc = EXIT_FAILURE;
+                        break;
+                    }
+                    fflush(out);
+                }
+                if (rc != EXIT_SUCCESS) { break; }
+            }
+            if (rc != EXIT_SUCCESS) { break; }
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) { fclose(out); }
+
+    teoLNullCleanup();
+    return rc;
+}
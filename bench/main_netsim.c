@@ -0,0 +1,442 @@
+/**
+ * \file   main_netsim.c
+ *
+ * \example main_netsim.c
+ *
+ * TR-UDP client benchmark under simulated network impairments. For every
+ * impairment profile mock L0 server and network simulator are started in
+ * process, TR-UDP connection is made through the simulator with
+ * teoLNUllSetOption_DatagramTransport, logged in and sends CMD_L_ECHO
+ * messages with fixed rate whether answers come or not. Retransmissions,
+ * keepalives and reordering of the library run against seeded loss, delay,
+ * jitter, duplication, reordering and bottleneck rate, so runs with the same
+ * seed are comparable.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_netsim [-f filter] [-r rate] [-s size] [-d duration_s]
+ *              [-S seed] [-l] [-o report.json]
+ *
+ * **Example:** ./teocli_netsim -f loss -r 200 -d 20 -o netsim.json
+ *
+ *   -f  run profiles which names contain filter only
+ *   -r  messages per second, 100 by default
+ *   -s  payload size, 256 by default
+ *   -d  send time of every profile in seconds, 10 by default
+ *   -S  seed of simulator PRNG, 1 by default
+ *   -l  list profiles and exit
+ *   -o  write report to file instead of stdout
+ *
+ * ### Measurement:
+ *
+ * Report has entry for every profile: messages sent, answered and lost after
+ * NETSIM_DRAIN_MS drain, goodput - answered payload bytes per second from
+ * first send to last answer, TR-UDP retransmissions and retransmission ratio
+ * - retransmits per sent L0 packet (payloads up to 512 bytes are sent in one
+ * datagram), RTT percentiles of answers in us and simulator counters of both
+ * directions. Connection time is measured too, key exchange runs through the
+ * simulator as well.
+ */
+
+#define _GNU_SOURCE // ppoll
+
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+#include "teobase/time.h"
+#include "hdr_histogram.h"
+#include "teonet_l0_mock_server.h"
+#include "teonet_l0_netsim.h"
+
+#define TL0NS_VERSION "0.0.1"
+
+#define NETSIM_TAG "teocli_netsim"
+#define NETSIM_PEER "mock-l0"
+#define NETSIM_DRAIN_MS 5000
+#define NETSIM_MAX_WAIT_MS 10
+// RTT histogram range is 1 ns to 100 s with 3 significant digits
+#define NETSIM_HIST_MAX_NS 100000000000LL
+#define NETSIM_HIST_DIGITS 3
+
+#define NETSIM_MIN_PAYLOAD                                                     \
+    (sizeof(NETSIM_TAG) + sizeof(int64_t) + sizeof(int64_t))
+
+/**
+ * Impairment profiles, delays are one way
+ */
+static const teoLNullNetsimProfile netsim_profiles[] = {
+    {.name = "clean"},
+    {.name = "rtt_50ms", .delay_us = 25000},
+    {.name = "rtt_300ms", .delay_us = 150000},
+    {.name = "jitter_20ms", .delay_us = 25000, .jitter_us = 20000},
+    {.name = "loss_1", .loss = 0.01, .delay_us = 25000},
+    {.name = "loss_5", .loss = 0.05, .delay_us = 25000},
+    {.name = "loss_10", .loss = 0.10, .delay_us = 25000},
+    {.name = "loss_5_rtt_300ms", .loss = 0.05, .delay_us = 150000},
+    {.name = "reorder_5",
+     .delay_us = 25000,
+     .reorder = 0.05,
+     .reorder_us = 10000},
+    {.name = "duplicate_2", .delay_us = 25000, .duplicate = 0.02},
+    {.name = "bandwidth_1mbit",
+     .delay_us = 25000,
+     .bandwidth_kbps = 1000,
+     .queue_ms = 100},
+    {.name = "mobile",
+     .loss = 0.03,
+     .delay_us = 60000,
+     .jitter_us = 30000,
+     .duplicate = 0.01,
+     .reorder = 0.02,
+     .reorder_us = 20000,
+     .bandwidth_kbps = 2000,
+     .queue_ms = 200},
+};
+
+#define NETSIM_PROFILES (sizeof(netsim_profiles) / sizeof(netsim_profiles[0]))
+
+/**
+ * Application parameters structure
+ */
+struct app_parameters {
+    const char *filter;
+    double rate;
+    size_t size;
+    int duration_s;
+    uint64_t seed;
+    const char *output;
+};
+
+/**
+ * Results of one profile
+ */
+typedef struct netsimResult {
+    const teoLNullNetsimProfile *profile;
+    bool connected;           ///< Connection and login succeeded
+    bool disconnected;        ///< Connection was lost while measured
+    int64_t connect_ns;       ///< Connection time
+    uint64_t sent;            ///< Messages sent
+    uint64_t sent_bytes;      ///< Payload bytes sent
+    uint64_t received;        ///< Echo answers received
+    uint64_t received_bytes;  ///< Payload bytes of answers
+    uint64_t unexpected;      ///< Received packets which are not our answers
+    int64_t start_ns;         ///< First send time
+    int64_t last_answer_ns;   ///< Last answer time
+    uint64_t packets_sent;    ///< L0 packets sent by connection
+    uint64_t retransmits;     ///< TR-UDP retransmissions
+    hdrHistogram rtt;         ///< Round trip times in ns
+    teoLNullNetsimStats sim;  ///< Simulator counters
+} netsimResult;
+
+static int64_t _netsimTimeNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Teonet L0 client event callback, records RTT of echo answers
+ */
+static void _netsimEventCb(void *con, teoLNullEvents event, void *data,
+                           size_t data_len, void *user_data) {
+    netsimResult *result = (netsimResult *)user_data;
+    if (event != EV_L_RECEIVED && event != EV_L_RECEIVED_UNRELIABLE) {
+        return;
+    }
+    const int64_t now = _netsimTimeNs();
+
+    const teoLNullCPacket *cp = data;
+    const uint8_t *payload =
+        (const uint8_t *)cp->peer_name + cp->peer_name_length;
+    if (cp->cmd != CMD_L_ECHO_ANSWER || cp->data_length < NETSIM_MIN_PAYLOAD ||
+        memcmp(payload, NETSIM_TAG, sizeof(NETSIM_TAG)) != 0) {
+        result->unexpected++;
+        return;
+    }
+
+    int64_t sent_ns;
+    memcpy(&sent_ns, payload + sizeof(NETSIM_TAG) + sizeof(int64_t),
+           sizeof(sent_ns));
+    hdrHistogramRecord(&result->rtt, now - sent_ns);
+    result->received++;
+    result->received_bytes += cp->data_length;
+    result->last_answer_ns = now;
+}
+
+static void _netsimSend(teoLNullConnectData *con, netsimResult *result,
+                        uint8_t *payload, size_t size) {
+    // teoLNullSendEcho compatible part: message string and time in ms
+    const int64_t now_ms = teotimeGetCurrentTimeMs();
+    const int64_t now_ns = _netsimTimeNs();
+    memcpy(payload + sizeof(NETSIM_TAG), &now_ms, sizeof(now_ms));
+    memcpy(payload + sizeof(NETSIM_TAG) + sizeof(now_ms), &now_ns,
+           sizeof(now_ns));
+
+    if (teoLNullSend(con, CMD_L_ECHO, NETSIM_PEER, payload, size) >= 0) {
+        result->sent++;
+        result->sent_bytes += size;
+    }
+}
+
+/**
+ * Wait for events not longer than up to @a deadline_ns
+ *
+ * @return false if connection is lost
+ */
+static bool _netsimWait(teoLNullConnectData *con, int64_t deadline_ns) {
+    int64_t wait_ns = deadline_ns - _netsimTimeNs();
+    if (wait_ns < 0) { wait_ns = 0; }
+    // TR-UDP retransmits and keepalives are processed by the event loop
+    if (wait_ns > NETSIM_MAX_WAIT_MS * 1000000LL) {
+        wait_ns = NETSIM_MAX_WAIT_MS * 1000000LL;
+    }
+    const struct timespec timeout = {wait_ns / 1000000000,
+                                     wait_ns % 1000000000};
+
+    struct pollfd pfd = {con->fd, POLLIN, 0};
+    if (wait_ns > 0) { ppoll(&pfd, 1, &timeout, NULL); }
+    return teoLNullReadEventLoop(con, 0) &&
+           con->status == CON_STATUS_CONNECTED;
+}
+
+/**
+ * Run echo load through simulator with @a result->profile
+ *
+ * @return false if mock server or simulator can't be started
+ */
+static bool _netsimRun(const struct app_parameters *param,
+                       netsimResult *result) {
+    teoLNullMockServerConfig config = {0};
+    config.disable_tcp = true;
+    config.name = NETSIM_PEER;
+    teoLNullMockServer *mock = teoLNullMockServerStart(&config);
+    if (mock == NULL) { return false; }
+
+    teoLNullNetsim *sim = teoLNullNetsimStart(result->profile, param->seed);
+    if (sim == NULL) {
+        teoLNullMockServerStop(mock);
+        return false;
+    }
+    teoLNUllSetOption_DatagramTransport(teoLNullNetsimTransport(sim));
+
+    uint8_t *payload = malloc(param->size);
+    memset(payload, 'N', param->size);
+    memcpy(payload, NETSIM_TAG, sizeof(NETSIM_TAG));
+
+    const int64_t connect_start_ns = _netsimTimeNs();
+    teoLNullConnectData *con =
+        teoLNullConnectE("127.0.0.1", teoLNullMockServerUdpPort(mock),
+                         _netsimEventCb, result, TRUDP);
+    result->connected = con->status == CON_STATUS_CONNECTED &&
+                        teoLNullLogin(con, "netsim") > 0;
+    result->connect_ns = _netsimTimeNs() - connect_start_ns;
+
+    if (result->connected) {
+        const int64_t interval_ns = (int64_t)(1e9 / param->rate);
+        const int64_t start_ns = _netsimTimeNs();
+        const int64_t end_ns = start_ns + param->duration_s * 1000000000LL;
+        int64_t next_ns = start_ns;
+        int64_t now;
+        result->start_ns = start_ns;
+
+        // Open loop: everything scheduled by now is sent
+        while (!result->disconnected && (now = _netsimTimeNs()) < end_ns) {
+            while (next_ns <= now && next_ns < end_ns) {
+                _netsimSend(con, result, payload, param->size);
+                next_ns += interval_ns;
+            }
+            result->disconnected = !_netsimWait(con, next_ns);
+        }
+
+        // Wait for answers of last messages and their retransmissions
+        const int64_t drain_ns =
+            _netsimTimeNs() + NETSIM_DRAIN_MS * 1000000LL;
+        while (!result->disconnected && result->received < result->sent &&
+               _netsimTimeNs() < drain_ns) {
+            result->disconnected = !_netsimWait(con, drain_ns);
+        }
+
+        teoLNullStats *stats = (teoLNullStats *)malloc(sizeof(teoLNullStats));
+        teoLNullGetStats(con, stats);
+        result->packets_sent = stats->packets_sent;
+        result->retransmits = stats->trudp_retransmits;
+        free(stats);
+    }
+
+    teoLNullDisconnect(con);
+    teoLNullNetsimGetStats(sim, &result->sim);
+    teoLNUllSetOption_DatagramTransport(NULL);
+    teoLNullNetsimStop(sim);
+    teoLNullMockServerStop(mock);
+    free(payload);
+    return true;
+}
+
+static void _netsimWriteDirection(FILE *out, const char *name,
+                                  const teoLNullNetsimDirectionStats *s) {
+    fprintf(out,
+            "\"%s\": {\"datagrams\": %" PRIu64 ", \"bytes\": %" PRIu64
+            ", \"delivered\": %" PRIu64 ", \"lost\": %" PRIu64
+            ", \"duplicated\": %" PRIu64 ", \"reordered\": %" PRIu64
+            ", \"queue_drops\": %" PRIu64 ", \"overflow\": %" PRIu64 "}",
+            name, s->datagrams, s->bytes, s->delivered, s->lost,
+            s->duplicated, s->reordered, s->queue_drops, s->overflow);
+}
+
+static void _netsimWriteResult(FILE *out, const netsimResult *r) {
+    static const struct {
+        const char *name;
+        double percentile;
+    } percentiles[] = {{"p50", 50}, {"p90", 90}, {"p99", 99},
+                       {"p99_9", 99.9}};
+    const teoLNullNetsimProfile *p = r->profile;
+    const double seconds =
+        r->last_answer_ns > r->start_ns
+            ? (r->last_answer_ns - r->start_ns) / 1e9
+            : 0;
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", p->name);
+    fprintf(out,
+            "      \"profile\": {\"loss\": %.3f, \"delay_us\": %u, "
+            "\"jitter_us\": %u, \"duplicate\": %.3f, \"reorder\": %.3f, "
+            "\"reorder_us\": %u, \"bandwidth_kbps\": %u, \"queue_ms\": %u},\n",
+            p->loss, p->delay_us, p->jitter_us, p->duplicate, p->reorder,
+            p->reorder_us, p->bandwidth_kbps, p->queue_ms);
+    fprintf(out, "      \"connected\": %s,\n",
+            r->connected ? "true" : "false");
+    fprintf(out, "      \"disconnected\": %s,\n",
+            r->disconnected ? "true" : "false");
+    fprintf(out, "      \"connect_ms\": %.3f,\n", r->connect_ns / 1e6);
+    fprintf(out,
+            "      \"messages\": {\"sent\": %" PRIu64 ", \"received\": %" PRIu64
+            ", \"lost\": %" PRIu64 ", \"unexpected\": %" PRIu64 "},\n",
+            r->sent, r->received,
+            r->sent > r->received ? r->sent - r->received : 0, r->unexpected);
+    fprintf(out, "      \"goodput_bytes_per_second\": %.1f,\n",
+            seconds > 0 ? r->received_bytes / seconds : 0);
+    fprintf(out, "      \"retransmits\": %" PRIu64 ",\n", r->retransmits);
+    fprintf(out, "      \"retransmission_ratio\": %.4f,\n",
+            r->packets_sent > 0 ? (double)r->retransmits / r->packets_sent
+                                : 0);
+
+    const hdrHistogram *h = &r->rtt;
+    fprintf(out, "      \"rtt_us\": {");
+    fprintf(out, "\"count\": %" PRIu64 ", \"min\": %.3f, \"mean\": %.3f",
+            h->total_count, h->total_count != 0 ? h->min / 1000.0 : 0.0,
+            hdrHistogramMean(h) / 1000.0);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        fprintf(out, ", \"%s\": %.3f", percentiles[i].name,
+                hdrHistogramValueAtPercentile(h, percentiles[i].percentile) /
+                    1000.0);
+    }
+    fprintf(out, ", \"max\": %.3f},\n", h->max / 1000.0);
+
+    fprintf(out, "      \"netsim\": {\"links\": %" PRIu64 ", ", r->sim.links);
+    _netsimWriteDirection(out, "upstream", &r->sim.upstream);
+    fprintf(out, ", ");
+    _netsimWriteDirection(out, "downstream", &r->sim.downstream);
+    fprintf(out, "}\n");
+    fprintf(out, "    }");
+}
+
+int main(int argc, char **argv) {
+    struct app_parameters param = {0};
+    param.rate = 100;
+    param.size = 256;
+    param.duration_s = 10;
+    param.seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:r:s:d:S:lo:h")) != -1) {
+        switch (opt) {
+        case 'f': param.filter = optarg; break;
+        case 'r': param.rate = atof(optarg); break;
+        case 's': param.size = strtoul(optarg, NULL, 10); break;
+        case 'd': param.duration_s = atoi(optarg); break;
+        case 'S': param.seed = strtoull(optarg, NULL, 10); break;
+        case 'l':
+            for (size_t i = 0; i < NETSIM_PROFILES; i++) {
+                printf("%s\n", netsim_profiles[i].name);
+            }
+            return EXIT_SUCCESS;
+        case 'o': param.output = optarg; break;
+        default:
+            fprintf(stderr,
+                    "Teocli TR-UDP network simulation benchmark ver "
+                    TL0NS_VERSION
+                    "\n\nUsage: %s [-f filter] [-r rate] [-s size] "
+                    "[-d duration_s] [-S seed] [-l] [-o report.json]\n",
+                    argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (param.rate <= 0 || param.duration_s < 1 || param.size > UINT16_MAX) {
+        fprintf(stderr, "Invalid parameters, see %s -h\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (param.size < NETSIM_MIN_PAYLOAD) { param.size = NETSIM_MIN_PAYLOAD; }
+
+    teoLNullInit();
+    // Mock L0 server makes ECDH_AES_128_V1 key exchange only
+    teoLNUllSetOption_EncryptionProtocol(ENC_PROTO_ECDH_AES_128_V1);
+
+    netsimResult *results = calloc(NETSIM_PROFILES, sizeof(netsimResult));
+    size_t results_count = 0;
+    for (size_t i = 0; i < NETSIM_PROFILES; i++) {
+        if (param.filter != NULL &&
+            strstr(netsim_profiles[i].name, param.filter) == NULL) {
+            continue;
+        }
+        netsimResult *result = &results[results_count];
+        result->profile = &netsim_profiles[i];
+        if (!hdrHistogramInit(&result->rtt, 1, NETSIM_HIST_MAX_NS,
+                              NETSIM_HIST_DIGITS)) {
+            fprintf(stderr, "Can't allocate histogram\n");
+            return EXIT_FAILURE;
+        }
+        results_count++;
+
+        fprintf(stderr, "Profile %s...\n", result->profile->name);
+        if (!_netsimRun(&param, result)) {
+            fprintf(stderr, "Can't start mock L0 server or simulator\n");
+            return EXIT_FAILURE;
+        }
+    }
+    teoLNullCleanup();
+
+    FILE *out = stdout;
+    if (param.output != NULL) {
+        out = fopen(param.output, "w");
+        if (out == NULL) {
+            perror(param.output);
+            return EXIT_FAILURE;
+        }
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"teocli_netsim\",\n");
+    fprintf(out, "  \"version\": \"%s\",\n", TL0NS_VERSION);
+    fprintf(out,
+            "  \"config\": {\"rate\": %.1f, \"size\": %zu, "
+            "\"duration_s\": %d, \"seed\": %" PRIu64 "},\n",
+            param.rate, param.size, param.duration_s, param.seed);
+    fprintf(out, "  \"profiles\": [\n");
+    for (size_t i = 0; i < results_count; i++) {
+        _netsimWriteResult(out, &results[i]);
+        fprintf(out, i + 1 < results_count ? ",\n" : "\n");
+        hdrHistogramDestroy(&results[i].rtt);
+    }
+    fprintf(out, "  ]\n}\n");
+    if (out != stdout) { fclose(out); }
+
+    free(results);
+    return EXIT_SUCCESS;
+}
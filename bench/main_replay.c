@@ -0,0 +1,269 @@
+/**
+ * \file   main_replay.c
+ *
+ * \example main_replay.c
+ *
+ * Replay of capture written by teoLNUllSetOption_Capture or
+ * teoLNullCaptureStart. Captured TCP reads and TR-UDP datagrams are fed to
+ * receive stack of replayed connection: TR-UDP processing, L0 packet split,
+ * decryption and event callback, no server or network is needed. Encrypted
+ * packets are decrypted if capture has session keys.
+ *
+ * ### This application parameters:
+ *
+ * **Usage:**   ./teocli_replay [-p] [-n repeat] [-o results.json] capture
+ *
+ * **Example:** ./teocli_replay -n 100 -o replay.json capture.tlcp.1
+ *
+ *   -p  replay at recorded pace, as fast as possible by default
+ *   -n  number of times capture is replayed, 1 by default
+ *   -o  write results to file instead of stdout
+ *
+ * Results are JSON object with received L0 packets and bytes, packets/s,
+ * bytes/s and heap allocations per packet. Every replay uses new connection,
+ * its setup isn't measured. Allocations are counted with glibc only and are
+ * null otherwise.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_capture.h"
+
+#define TL0RP_VERSION "0.0.1"
+
+#if defined(__GLIBC__)
+#define REPLAY_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t replay_allocs;
+
+// Library allocations are counted by interposing allocator of the process
+void *malloc(size_t size) {
+    __atomic_fetch_add(&replay_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&replay_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&replay_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t _replayAllocs(void) {
+    return __atomic_load_n(&replay_allocs, __ATOMIC_RELAXED);
+}
+#endif
+
+/**
+ * Application parameters structure
+ */
+struct app_parameters {
+
+    const char *capture;
+    const char *output;
+    bool paced;
+    int repeat;
+};
+
+/**
+ * Replay results of all repetitions
+ */
+typedef struct replayResult {
+
+    uint64_t packets;   ///< L0 packets sent to event callback
+    uint64_t bytes;     ///< Bytes of L0 packets sent to event callback
+    uint64_t dropped;   ///< Packets dropped by checksum or decryption
+    uint64_t connected; ///< Replays reached connected state
+    uint64_t allocs;    ///< Allocations while feeding records
+    int64_t elapsed_ns; ///< Time of feeding records
+} replayResult;
+
+static int64_t _replayTimeNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void _replaySleepUntil(int64_t deadline_ns) {
+    const struct timespec deadline = {(time_t)(deadline_ns / 1000000000),
+                                      (long)(deadline_ns % 1000000000)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) !=
+           0) {}
+}
+
+static void _replayEventCb(void *con, teoLNullEvents event, void *data,
+                           size_t data_len, void *user_data) {
+    replayResult *result = (replayResult *)user_data;
+
+    switch (event) {
+    case EV_L_CONNECTED:
+        if (*(int *)data == CON_STATUS_CONNECTED) { result->connected++; }
+        break;
+
+    case EV_L_RECEIVED:
+    case EV_L_RECEIVED_UNRELIABLE:
+        result->packets++;
+        result->bytes += data_len;
+        break;
+
+    default: break;
+    }
+}
+
+/**
+ * Feed all records of capture to new replayed connection
+ *
+ * @return false if replay can't be set up
+ */
+static bool _replayRun(const teoLNullCaptureFile *capture, bool paced,
+                       replayResult *result) {
+    teoLNullConnectData *con =
+        teoLNullReplayConnect(capture, _replayEventCb, result);
+    if (con->status < 0) {
+        teoLNullDisconnect(con);
+        return false;
+    }
+
+#if defined(REPLAY_COUNT_ALLOCS)
+    const uint64_t allocs = _replayAllocs();
+#endif
+    const int64_t start_ns = _replayTimeNs();
+    for (size_t i = 0; i < capture->records_count; i++) {
+        const teoLNullCaptureRecord *record = &capture->records[i];
+        if (paced) {
+            _replaySleepUntil(start_ns + (int64_t)record->time_us * 1000);
+        }
+        if (!teoLNullReplayFeed(con, record)) { break; }
+    }
+    result->elapsed_ns += _replayTimeNs() - start_ns;
+#if defined(REPLAY_COUNT_ALLOCS)
+    result->allocs += _replayAllocs() - allocs;
+#endif
+
+    teoLNullStats *stats = (teoLNullStats *)malloc(sizeof(teoLNullStats));
+    teoLNullGetStats(con, stats);
+    result->dropped += stats->checksum_errors + stats->decrypt_errors;
+    free(stats);
+
+    teoLNullDisconnect(con);
+    return true;
+}
+
+static void _replayWriteResult(FILE *out, const struct app_parameters *param,
+                               const teoLNullCaptureFile *capture,
+                               const replayResult *result) {
+    const double seconds = result->elapsed_ns / 1e9;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"capture\": \"%s\",\n", param->capture);
+    fprintf(out, "  \"server\": \"%s\",\n", capture->server);
+    fprintf(out, "  \"port\": %u,\n", (unsigned)capture->port);
+    fprintf(out, "  \"protocol\": \"%s\",\n", capture->tcp_f ? "tcp" : "trudp");
+    fprintf(out, "  \"encryption\": %d,\n", (int)capture->enc_proto);
+    fprintf(out, "  \"keys\": %s,\n", capture->keys != NULL ? "true" : "false");
+    fprintf(out, "  \"records\": %zu,\n", capture->records_count);
+    fprintf(out, "  \"captured_us\": %" PRIu64 ",\n",
+            capture->records_count > 0
+                ? capture->records[capture->records_count - 1].time_us
+                : 0);
+    fprintf(out, "  \"paced\": %s,\n", param->paced ? "true" : "false");
+    fprintf(out, "  \"repeat\": %d,\n", param->repeat);
+    fprintf(out, "  \"connected\": %" PRIu64 ",\n", result->connected);
+    fprintf(out, "  \"packets\": %" PRIu64 ",\n", result->packets);
+    fprintf(out, "  \"bytes\": %" PRIu64 ",\n", result->bytes);
+    fprintf(out, "  \"dropped\": %" PRIu64 ",\n", result->dropped);
+    fprintf(out, "  \"seconds\": %.6f,\n", seconds);
+    fprintf(out, "  \"packets_per_second\": %.1f,\n",
+            seconds > 0 ? result->packets / seconds : 0);
+    fprintf(out, "  \"bytes_per_second\": %.1f,\n",
+            seconds > 0 ? result->bytes / seconds : 0);
+#if defined(REPLAY_COUNT_ALLOCS)
+    fprintf(out, "  \"allocs_per_packet\": %.3f\n",
+            result->packets > 0 ? (double)result->allocs / result->packets
+                                : 0);
+#else
+    fprintf(out, "  \"allocs_per_packet\": null\n");
+#endif
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char **argv) {
+    struct app_parameters param = {0};
+    param.repeat = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "pn:o:h")) != -1) {
+        switch (opt) {
+        case 'p': param.paced = true; break;
+        case 'n': param.repeat = atoi(optarg); break;
+        case 'o': param.output = optarg; break;
+        default:
+            fprintf(stderr,
+                    "Teocli capture replay ver " TL0RP_VERSION
+                    "\n\nUsage: %s [-p] [-n repeat] [-o results.json] "
+                    "capture\n",
+                    argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1 || param.repeat < 1) {
+        fprintf(stderr, "Invalid parameters, see %s -h\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    param.capture = argv[optind];
+
+    teoLNullInit();
+
+    teoLNullCaptureFile *capture = teoLNullCaptureLoad(param.capture);
+    if (capture == NULL) {
+        fprintf(stderr, "Can't load capture %s\n", param.capture);
+        teoLNullCleanup();
+        return EXIT_FAILURE;
+    }
+    if (capture->enc_proto != ENC_PROTO_DISABLED && capture->keys == NULL) {
+        fprintf(stderr, "Capture has no session keys, encrypted packets are "
+                        "dropped\n");
+    }
+
+    replayResult result;
+    memset(&result, 0, sizeof(result));
+    for (int i = 0; i < param.repeat; i++) {
+        if (!_replayRun(capture, param.paced, &result)) {
+            fprintf(stderr, "Can't set up replay of %s\n", param.capture);
+            teoLNullCaptureFree(capture);
+            teoLNullCleanup();
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *out = stdout;
+    if (param.output != NULL) {
+        out = fopen(param.output, "w");
+        if (out == NULL) {
+            perror(param.output);
+            teoLNullCaptureFree(capture);
+            teoLNullCleanup();
+            return EXIT_FAILURE;
+        }
+    }
+    _replayWriteResult(out, &param, capture, &result);
+    if (out != stdout) { fclose(out); }
+
+    teoLNullCaptureFree(capture);
+    teoLNullCleanup();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,791 @@
+/**
+ * File:   teonet_l0_mock_server.c
+ *
+ * Loopback stand-in of L0 server. Single thread serves TCP connections and
+ * TR-UDP channels with the same packet handler: received stream is split to
+ * L0 packets, key exchange and system commands are answered by server, other
+ * packets are delivered to logged in clients if routing is enabled. Server
+ * side of encryption reuses client encryption context: ECDH_AES_128_V1 CTR
+ * keystream doesn't depend on direction, so context of the server is the
+ * mirror of client one.
+ */
+
+#include "teonet_l0_mock_server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+
+#include "teobase/logging.h"
+
+#define MOCK_DEFAULT_HOST "127.0.0.1"
+#define MOCK_DEFAULT_NAME "mock-l0"
+#define MOCK_PEER_TYPE "teo-l0"
+#define MOCK_NAME_SIZE 128
+
+// Largest L0 packet: header, peer name and data of maximal lengths
+#define MOCK_PACKET_MAX_SIZE                                                   \
+    (sizeof(teoLNullCPacket) + UINT8_MAX + UINT16_MAX)
+// Client sends L0 packets to TR-UDP channel by blocks of this size
+#define MOCK_TRUDP_BLOCK_SIZE 512
+// Datagrams received in one poll wakeup
+#define MOCK_TRUDP_RECEIVE_MAX 64
+// Poll timeout when TR-UDP send queue is empty
+#define MOCK_POLL_TIMEOUT_MS 100
+
+#define MOCK_STAT_ADD(server, field, value)                                    \
+    __atomic_fetch_add(&(server)->stats.field, (value), __ATOMIC_RELAXED)
+
+/**
+ * Connected client, TCP connection or TR-UDP channel
+ */
+typedef struct mockClient {
+    int fd;                ///< TCP socket, -1 for TR-UDP channel
+    trudpChannelData *tcd; ///< TR-UDP channel, NULL for TCP connection
+    bool closed;           ///< Removed after current loop iteration
+
+    uint8_t *buffer;       ///< Received bytes not split to packets yet
+    size_t buffer_length;  ///< Bytes in buffer
+    size_t buffer_size;    ///< Buffer capacity
+
+    teoLNullEncryptionContext *crypt; ///< Established session or NULL
+    char name[MOCK_NAME_SIZE];        ///< Login name, empty before login
+} mockClient;
+
+struct teoLNullMockServer {
+    char host[NI_MAXHOST];
+    char name[MOCK_NAME_SIZE];
+    bool route;
+
+    int listen_fd;        ///< TCP listening socket or -1
+    uint16_t tcp_port;
+    int udp_fd;           ///< TR-UDP socket or -1
+    uint16_t udp_port;
+    trudpData *td;        ///< TR-UDP data or NULL
+
+    int wake[2];          ///< Pipe to wake server thread on stop
+    pthread_t thread;
+    bool stop;
+
+    mockClient **clients; ///< Clients, removed ones are swept after poll
+    size_t clients_count;
+    size_t clients_size;
+
+    struct pollfd *pfd;   ///< Poll set built every loop iteration
+    size_t pfd_size;
+
+    uint8_t *packet;      ///< Work buffer of packets sent by server
+
+    teoLNullMockServerStats stats;
+};
+
+static mockClient *_mockClientAdd(teoLNullMockServer *server, int fd,
+                                  trudpChannelData *tcd) {
+    if (server->clients_count == server->clients_size) {
+        size_t size = server->clients_size ? server->clients_size * 2 : 16;
+        mockClient **clients = (mockClient **)realloc(
+            server->clients, size * sizeof(mockClient *));
+        if (clients == NULL) { return NULL; }
+        server->clients = clients;
+        server->clients_size = size;
+    }
+
+    mockClient *client = (mockClient *)calloc(1, sizeof(mockClient));
+    if (client == NULL) { return NULL; }
+    client->fd = fd;
+    client->tcd = tcd;
+    server->clients[server->clients_count++] = client;
+
+    MOCK_STAT_ADD(server, connections, 1);
+    MOCK_STAT_ADD(server, clients, 1);
+    return client;
+}
+
+static void _mockClientDestroyCrypt(mockClient *client) {
+    if (client->crypt != NULL) {
+        teoLNullEncryptionContextDestroy(client->crypt);
+        free(client->crypt);
+        client->crypt = NULL;
+    }
+}
+
+static void _mockClientResetSession(mockClient *client) {
+    _mockClientDestroyCrypt(client);
+    client->buffer_length = 0;
+    client->name[0] = 0;
+}
+
+static void _mockClientFree(teoLNullMockServer *server, mockClient *client) {
+    _mockClientResetSession(client);
+    if (client->fd != -1) { close(client->fd); }
+    free(client->buffer);
+    free(client);
+    __atomic_fetch_sub(&server->stats.clients, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Free clients closed in current loop iteration
+ */
+static void _mockClientsSweep(teoLNullMockServer *server) {
+    size_t kept = 0;
+    for (size_t i = 0; i < server->clients_count; i++) {
+        mockClient *client = server->clients[i];
+        if (client->closed) {
+            _mockClientFree(server, client);
+        } else {
+            server->clients[kept++] = client;
+        }
+    }
+    server->clients_count = kept;
+}
+
+static mockClient *_mockClientByName(teoLNullMockServer *server,
+                                     const char *name) {
+    if (name[0] == 0) { return NULL; }
+    for (size_t i = 0; i < server->clients_count; i++) {
+        mockClient *client = server->clients[i];
+        if (!client->closed && strcmp(client->name, name) == 0) {
+            return client;
+        }
+    }
+    return NULL;
+}
+
+static mockClient *_mockClientByChannel(teoLNullMockServer *server,
+                                        trudpChannelData *tcd) {
+    for (size_t i = 0; i < server->clients_count; i++) {
+        mockClient *client = server->clients[i];
+        if (!client->closed && client->tcd == tcd) { return client; }
+    }
+    return NULL;
+}
+
+/**
+ * Pass bytes to client transport, TCP client is closed on error
+ */
+static void _mockWrite(teoLNullMockServer *server, mockClient *client,
+                       const uint8_t *data, size_t length) {
+    if (client->closed) { return; }
+
+    MOCK_STAT_ADD(server, packets_sent, 1);
+    MOCK_STAT_ADD(server, bytes_sent, length);
+
+    if (client->tcd != NULL) {
+        while (length > 0) {
+            size_t block =
+                length > MOCK_TRUDP_BLOCK_SIZE ? MOCK_TRUDP_BLOCK_SIZE : length;
+            trudpChannelSendData(client->tcd, (void *)data, block);
+            data += block;
+            length -= block;
+        }
+        return;
+    }
+
+    while (length > 0) {
+        ssize_t sent = send(client->fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) { continue; }
+            client->closed = true;
+            return;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+}
+
+/**
+ * Create packet, encrypt it if client session is established and send it
+ */
+static void _mockSend(teoLNullMockServer *server, mockClient *client,
+                      uint8_t cmd, const char *peer, const uint8_t *data,
+                      size_t data_length) {
+    teoLNullCPacket *packet = (teoLNullCPacket *)server->packet;
+    teoLNullPacketCreate(packet, MOCK_PACKET_MAX_SIZE, cmd, peer, data,
+                         data_length);
+    // Answer which data doesn't leave room for AEAD tag isn't sent
+    if (!teoLNullPacketSealBuffer(client->crypt, true, packet,
+                                  MOCK_PACKET_MAX_SIZE)) {
+        return;
+    }
+    _mockWrite(server, client, server->packet,
+               teoLNullBufferSize(packet->peer_name_length,
+                                  packet->data_length));
+}
+
+/**
+ * Answer CMD_L_INIT key exchange or session resumption payload
+ *
+ * @return false if client must be disconnected
+ */
+static bool _mockKeyExchange(teoLNullMockServer *server, mockClient *client,
+                             KeyExchangePayload_Common *kex,
+                             size_t kex_length) {
+    const teoLNullKEXType type = TEOLNULL_KEX_TYPE(kex->protocolId);
+    const teoLNullEncryptionProtocol enc_proto =
+        TEOLNULL_KEX_PROTO(kex->protocolId);
+
+    // Server doesn't issue tickets, client falls back to key exchange
+    if (type == KEX_TYPE_RESUME) {
+        KeyExchangePayload_Common reject;
+        reject.nul_byte = 0;
+        reject.protocolId = TEOLNULL_KEX_ID(KEX_TYPE_RESUME_REJECT, enc_proto);
+        _mockSend(server, client, CMD_L_INIT, "", (uint8_t *)&reject,
+                  sizeof(reject));
+        return true;
+    }
+
+    if (type != KEX_TYPE_KEY_EXCHANGE ||
+        enc_proto != ENC_PROTO_ECDH_AES_128_V1) {
+        LTRACK_E("MockL0", "Unsupported key exchange %s(%d) type %d",
+                 STRING_teoLNullEncryptionProtocol(enc_proto), (int)enc_proto,
+                 (int)type);
+        return false;
+    }
+
+    // Client starts new session after TR-UDP reset
+    _mockClientDestroyCrypt(client);
+
+    const size_t ctx_size = teoLNullEncryptionContextSize(enc_proto);
+    teoLNullEncryptionContext *ctx =
+        (teoLNullEncryptionContext *)malloc(ctx_size);
+    if (ctx == NULL) { return false; }
+    teoLNullEncryptionContextCreate(enc_proto, (uint8_t *)ctx, ctx_size);
+    if (!teoLNullEncryptionContextApplyKEX(ctx, kex, kex_length)) {
+        teoLNullEncryptionContextDestroy(ctx);
+        free(ctx);
+        return false;
+    }
+
+    uint8_t answer[64];
+    const size_t answer_length = teoLNullKEXBufferSize(enc_proto);
+    teoLNullKEXCreate(ctx, answer, answer_length);
+    // Answer is sent unencrypted, session starts after it
+    _mockSend(server, client, CMD_L_INIT, "", answer, answer_length);
+    client->crypt = ctx;
+
+    MOCK_STAT_ADD(server, key_exchanges, 1);
+    return true;
+}
+
+static void _mockLogin(teoLNullMockServer *server, mockClient *client,
+                       const uint8_t *data, size_t data_length) {
+    size_t length = strnlen((const char *)data, data_length);
+    if (length >= sizeof(client->name)) { length = sizeof(client->name) - 1; }
+    memcpy(client->name, data, length);
+    client->name[length] = 0;
+
+    MOCK_STAT_ADD(server, logins, 1);
+    LTRACK("MockL0", "Client %s logged in", client->name);
+}
+
+/**
+ * Answer CMD_L_PEERS with the only peer, server itself
+ */
+static void _mockPeersAnswer(teoLNullMockServer *server, mockClient *client,
+                             const char *peer) {
+    uint8_t buffer[sizeof(ksnet_arp_data_ext_ar) +
+                   sizeof(((ksnet_arp_data_ext_ar *)NULL)->arp_data[0])];
+    memset(buffer, 0, sizeof(buffer));
+
+    ksnet_arp_data_ext_ar *peers = (ksnet_arp_data_ext_ar *)buffer;
+    peers->length = 1;
+    strncpy(peers->arp_data[0].name, server->name,
+            sizeof(peers->arp_data[0].name) - 1);
+
+    ksnet_arp_data_ext_N *peer_data = &peers->arp_data[0].data;
+    peer_data->data.mode = -1;
+    strncpy(peer_data->data.addr, server->host,
+            sizeof(peer_data->data.addr) - 1);
+    peer_data->data.port =
+        client->tcd != NULL ? server->udp_port : server->tcp_port;
+    strncpy(peer_data->type, MOCK_PEER_TYPE, sizeof(peer_data->type) - 1);
+
+    _mockSend(server, client, CMD_L_PEERS_ANSWER, peer, buffer,
+              sizeof(buffer));
+}
+
+/**
+ * Answer CMD_L_L0_CLIENTS with names of logged in clients
+ */
+static void _mockClientsAnswer(teoLNullMockServer *server, mockClient *client,
+                               const char *peer) {
+    const size_t record_size = sizeof(((teonet_client_data_ar *)NULL)
+                                          ->client_data[0]);
+    const size_t max_count =
+        (UINT16_MAX - sizeof(teonet_client_data_ar)) / record_size;
+
+    size_t count = 0;
+    for (size_t i = 0; i < server->clients_count; i++) {
+        if (!server->clients[i]->closed && server->clients[i]->name[0]) {
+            count++;
+        }
+    }
+    if (count > max_count) { count = max_count; }
+
+    const size_t length = sizeof(teonet_client_data_ar) + count * record_size;
+    teonet_client_data_ar *list = (teonet_client_data_ar *)calloc(1, length);
+    if (list == NULL) { return; }
+
+    for (size_t i = 0; i < server->clients_count && list->length < count;
+         i++) {
+        mockClient *listed = server->clients[i];
+        if (!listed->closed && listed->name[0]) {
+            strncpy(list->client_data[list->length++].name, listed->name,
+                    record_size - 1);
+        }
+    }
+
+    _mockSend(server, client, CMD_L_L0_CLIENTS_ANSWER, peer, (uint8_t *)list,
+              length);
+    free(list);
+}
+
+/**
+ * Process one decrypted packet received from client
+ *
+ * @return false if client must be disconnected
+ */
+static bool _mockProcessPacket(teoLNullMockServer *server, mockClient *client,
+                               teoLNullCPacket *packet) {
+    MOCK_STAT_ADD(server, packets_received, 1);
+
+    uint8_t *data = teoLNullPacketGetPayload(packet);
+    if (packet->cmd == CMD_L_INIT && !teoLNullPacketIsEncrypted(packet)) {
+        KeyExchangePayload_Common *kex =
+            teoLNullKEXGetFromPayload(data, packet->data_length);
+        if (kex != NULL) {
+            return _mockKeyExchange(server, client, kex, packet->data_length);
+        }
+    }
+
+    if (!teoLNullPacketDecrypt(client->crypt, packet)) {
+        MOCK_STAT_ADD(server, dropped, 1);
+        return true;
+    }
+
+    const char *peer = packet->peer_name;
+    switch (packet->cmd) {
+    case CMD_L_INIT: {
+        _mockLogin(server, client, data, packet->data_length);
+    } break;
+
+    case CMD_L_PEERS: {
+        _mockPeersAnswer(server, client, peer);
+    } break;
+
+    case CMD_L_L0_CLIENTS: {
+        _mockClientsAnswer(server, client, peer);
+    } break;
+
+    default: {
+        mockClient *target =
+            server->route ? _mockClientByName(server, peer) : NULL;
+        if (target != NULL) {
+            // Echo is answered by target client and routed back
+            _mockSend(server, target, packet->cmd, client->name, data,
+                      packet->data_length);
+            MOCK_STAT_ADD(server, routed, 1);
+        } else if (packet->cmd == CMD_L_ECHO) {
+            _mockSend(server, client, CMD_L_ECHO_ANSWER, peer, data,
+                      packet->data_length);
+            MOCK_STAT_ADD(server, echoes, 1);
+        } else {
+            MOCK_STAT_ADD(server, dropped, 1);
+        }
+    } break;
+    }
+
+    return true;
+}
+
+/**
+ * Split bytes received from client to packets and process them
+ *
+ * @return false if stream is broken and client must be disconnected
+ */
+static bool _mockReceived(teoLNullMockServer *server, mockClient *client,
+                          const uint8_t *data, size_t length) {
+    MOCK_STAT_ADD(server, bytes_received, length);
+
+    if (client->buffer_length + length > client->buffer_size) {
+        size_t size = client->buffer_size ? client->buffer_size : L0_BUFFER_SIZE;
+        while (size < client->buffer_length + length) { size *= 2; }
+        uint8_t *buffer = (uint8_t *)realloc(client->buffer, size);
+        if (buffer == NULL) { return false; }
+        client->buffer = buffer;
+        client->buffer_size = size;
+    }
+    memcpy(client->buffer + client->buffer_length, data, length);
+    client->buffer_length += length;
+
+    // Packet is processed at buffer start, so packet fields are aligned
+    while (client->buffer_length >= sizeof(teoLNullCPacket) &&
+           !client->closed) {
+        teoLNullCPacket *packet = (teoLNullCPacket *)client->buffer;
+        const uint8_t header_checksum = get_byte_checksum(
+            client->buffer, sizeof(teoLNullCPacket) - 1);
+        if (header_checksum != packet->header_checksum) {
+            LTRACK_E("MockL0", "Broken packet header, disconnecting");
+            MOCK_STAT_ADD(server, dropped, 1);
+            return false;
+        }
+
+        const size_t packet_length =
+            teoLNullBufferSize(packet->peer_name_length, packet->data_length);
+        if (packet_length > client->buffer_length) { break; }
+
+        if (teoLNullPacketGetFromBuffer(client->buffer, packet_length) ==
+            NULL) {
+            LTRACK_E("MockL0", "Broken packet checksum, disconnecting");
+            MOCK_STAT_ADD(server, dropped, 1);
+            return false;
+        }
+        if (!_mockProcessPacket(server, client, packet)) { return false; }
+
+        client->buffer_length -= packet_length;
+        memmove(client->buffer, client->buffer + packet_length,
+                client->buffer_length);
+    }
+
+    return true;
+}
+
+static void _mockAccept(teoLNullMockServer *server) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) { return; }
+
+    // Latency of small packets is measured, don't delay them
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    if (_mockClientAdd(server, fd, NULL) == NULL) { close(fd); }
+}
+
+static void _mockTcpReceive(teoLNullMockServer *server, mockClient *client) {
+    uint8_t buffer[L0_BUFFER_SIZE * 4];
+    ssize_t received = recv(client->fd, buffer, sizeof(buffer), 0);
+    if (received < 0 && (errno == EINTR || errno == EAGAIN)) { return; }
+
+    if (received <= 0 ||
+        !_mockReceived(server, client, buffer, (size_t)received)) {
+        client->closed = true;
+    }
+}
+
+/**
+ * TR-UDP event callback of server channels
+ */
+static void _mockTrudpEvent(void *tcd_pointer, int event, void *data,
+                            size_t data_length, void *user_data) {
+    trudpChannelData *tcd = (trudpChannelData *)tcd_pointer;
+    teoLNullMockServer *server = (teoLNullMockServer *)user_data;
+
+    switch (event) {
+    case GOT_RESET: {
+        mockClient *client = _mockClientByChannel(server, tcd);
+        if (client != NULL) { _mockClientResetSession(client); }
+    } break;
+
+    case DISCONNECTED: {
+        mockClient *client = _mockClientByChannel(server, tcd);
+        if (client != NULL) { client->closed = true; }
+    } break;
+
+    case GOT_DATA: {
+        trudpPacket *packet = (trudpPacket *)data;
+        size_t block_length = trudpPacketGetDataLength(packet);
+        if (block_length == 0) {
+            // Client checks server is reachable with empty packet
+            break;
+        }
+
+        mockClient *client = _mockClientByChannel(server, tcd);
+        if (client == NULL) { client = _mockClientAdd(server, -1, tcd); }
+        if (client == NULL) { break; }
+
+        if (!_mockReceived(server, client,
+                           (uint8_t *)trudpPacketGetData(packet),
+                           block_length)) {
+            // Channel stays, new session starts with key exchange or login
+            _mockClientResetSession(client);
+        }
+    } break;
+
+    case GOT_DATA_NO_TRUDP: {
+        MOCK_STAT_ADD(server, dropped, 1);
+    } break;
+
+    case PROCESS_RECEIVE: {
+        trudpProcessReceived((trudpData *)tcd, data, data_length);
+    } break;
+
+    case PROCESS_SEND: {
+        trudpUdpSendto(tcd->td->fd, data, data_length,
+                       (__CONST_SOCKADDR_ARG)&tcd->remaddr, tcd->addrlen);
+    } break;
+
+    default: break;
+    }
+}
+
+static void _mockTrudpReceive(teoLNullMockServer *server) {
+    uint8_t buffer[L0_BUFFER_SIZE];
+    struct sockaddr_storage remaddr;
+
+    for (int i = 0; i < MOCK_TRUDP_RECEIVE_MAX; i++) {
+        socklen_t addr_len = sizeof(remaddr);
+        size_t received = 0;
+        int error_code = 0;
+        teosockRecvfromResult result =
+            trudpUdpRecvfrom(server->udp_fd, buffer, sizeof(buffer),
+                             (__SOCKADDR_ARG)&remaddr, &addr_len, &received,
+                             &error_code);
+        if (result != TEOSOCK_RECVFROM_DATA_RECEIVED) { break; }
+
+        trudpChannelData *tcd = trudpGetChannelCreate(
+            server->td, (__SOCKADDR_ARG)&remaddr, addr_len, 0);
+        trudpChannelProcessReceivedPacket(tcd, buffer, received);
+    }
+}
+
+static int _mockPollTimeoutMs(teoLNullMockServer *server) {
+    if (server->td == NULL) { return MOCK_POLL_TIMEOUT_MS; }
+
+    uint32_t timeout_us =
+        trudpGetSendQueueTimeout(server->td, teoGetTimestampFull());
+    int timeout_ms = (int)((timeout_us + 999) / 1000);
+    return timeout_ms < MOCK_POLL_TIMEOUT_MS ? timeout_ms
+                                             : MOCK_POLL_TIMEOUT_MS;
+}
+
+static bool _mockPollSetReserve(teoLNullMockServer *server, size_t size) {
+    if (size <= server->pfd_size) { return true; }
+
+    struct pollfd *pfd =
+        (struct pollfd *)realloc(server->pfd, size * sizeof(struct pollfd));
+    if (pfd == NULL) { return false; }
+    server->pfd = pfd;
+    server->pfd_size = size;
+    return true;
+}
+
+static void *_mockServerThread(void *arg) {
+    teoLNullMockServer *server = (teoLNullMockServer *)arg;
+
+    // Poll set: wake pipe, TCP listener, TR-UDP socket, TCP clients
+    enum { PFD_WAKE, PFD_LISTEN, PFD_UDP, PFD_CLIENTS };
+
+    while (!__atomic_load_n(&server->stop, __ATOMIC_ACQUIRE)) {
+        if (!_mockPollSetReserve(server,
+                                 PFD_CLIENTS + server->clients_count)) {
+            break;
+        }
+        struct pollfd *pfd = server->pfd;
+        pfd[PFD_WAKE].fd = server->wake[0];
+        pfd[PFD_LISTEN].fd = server->listen_fd;
+        pfd[PFD_UDP].fd = server->udp_fd;
+        // Clients accepted in this iteration are polled in next one
+        const size_t clients_count = server->clients_count;
+        for (size_t i = 0; i < clients_count; i++) {
+            pfd[PFD_CLIENTS + i].fd = server->clients[i]->fd;
+        }
+        for (size_t i = 0; i < PFD_CLIENTS + clients_count; i++) {
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+
+        int ready = poll(pfd, PFD_CLIENTS + clients_count,
+                         _mockPollTimeoutMs(server));
+        if (ready < 0 && errno != EINTR) {
+            LTRACK_E("MockL0", "poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (ready > 0) {
+            if (pfd[PFD_WAKE].revents) { continue; }
+            if (pfd[PFD_LISTEN].revents & POLLIN) { _mockAccept(server); }
+            if (pfd[PFD_UDP].revents & POLLIN) { _mockTrudpReceive(server); }
+            for (size_t i = 0; i < clients_count; i++) {
+                if (pfd[PFD_CLIENTS + i].revents) {
+                    _mockTcpReceive(server, server->clients[i]);
+                }
+            }
+        }
+
+        if (server->td != NULL) {
+            trudpProcessSendQueue(server->td, 0);
+            trudpProcessKeepConnection(server->td);
+        }
+        _mockClientsSweep(server);
+    }
+
+    return NULL;
+}
+
+/**
+ * Bind socket of @a type to server host and @a port, zero port is replaced
+ * with chosen one
+ *
+ * @return socket or -1
+ */
+static int _mockBind(teoLNullMockServer *server, int type, uint16_t *port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = type;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)*port);
+
+    struct addrinfo *info = NULL;
+    if (getaddrinfo(server->host, service, &hints, &info) != 0) {
+        LTRACK_E("MockL0", "Can't resolve %s", server->host);
+        return -1;
+    }
+
+    int fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd >= 0) {
+        int flag = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+        if (bind(fd, info->ai_addr, info->ai_addrlen) != 0 ||
+            (type == SOCK_STREAM && listen(fd, SOMAXCONN) != 0)) {
+            LTRACK_E("MockL0", "Can't listen on %s:%u: %s", server->host,
+                     (unsigned)*port, strerror(errno));
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(info);
+    if (fd < 0) { return -1; }
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+    *port = ntohs(addr.ss_family == AF_INET6
+                      ? ((struct sockaddr_in6 *)&addr)->sin6_port
+                      : ((struct sockaddr_in *)&addr)->sin_port);
+
+    // Server thread must not block on socket it's polled for
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void _mockServerFree(teoLNullMockServer *server) {
+    for (size_t i = 0; i < server->clients_count; i++) {
+        _mockClientFree(server, server->clients[i]);
+    }
+    if (server->td != NULL) {
+        trudpChannelDestroyAll(server->td);
+        trudpDestroy(server->td);
+    }
+    if (server->udp_fd != -1) { close(server->udp_fd); }
+    if (server->listen_fd != -1) { close(server->listen_fd); }
+    if (server->wake[0] != -1) {
+        close(server->wake[0]);
+        close(server->wake[1]);
+    }
+    free(server->clients);
+    free(server->pfd);
+    free(server->packet);
+    free(server);
+}
+
+teoLNullMockServer *
+teoLNullMockServerStart(const teoLNullMockServerConfig *config) {
+    teoLNullMockServerConfig defaults;
+    if (config == NULL) {
+        memset(&defaults, 0, sizeof(defaults));
+        config = &defaults;
+    }
+
+    teoLNullMockServer *server =
+        (teoLNullMockServer *)calloc(1, sizeof(teoLNullMockServer));
+    if (server == NULL) { return NULL; }
+    server->listen_fd = -1;
+    server->udp_fd = -1;
+    server->wake[0] = server->wake[1] = -1;
+
+    strncpy(server->host, config->host ? config->host : MOCK_DEFAULT_HOST,
+            sizeof(server->host) - 1);
+    strncpy(server->name, config->name ? config->name : MOCK_DEFAULT_NAME,
+            sizeof(server->name) - 1);
+    server->route = config->route;
+
+    server->packet = (uint8_t *)malloc(MOCK_PACKET_MAX_SIZE +
+                                       TEOLNULL_ENCRYPTION_MAX_OVERHEAD);
+    if (server->packet == NULL || pipe(server->wake) != 0) {
+        _mockServerFree(server);
+        return NULL;
+    }
+
+    if (!config->disable_tcp) {
+        server->tcp_port = config->tcp_port;
+        server->listen_fd = _mockBind(server, SOCK_STREAM, &server->tcp_port);
+        if (server->listen_fd == -1) {
+            _mockServerFree(server);
+            return NULL;
+        }
+    }
+
+    if (!config->disable_trudp) {
+        server->udp_port = config->udp_port;
+        server->udp_fd = _mockBind(server, SOCK_DGRAM, &server->udp_port);
+        if (server->udp_fd == -1) {
+            _mockServerFree(server);
+            return NULL;
+        }
+        server->td = trudpInit(server->udp_fd, server->udp_port,
+                               _mockTrudpEvent, server);
+    }
+
+    if (pthread_create(&server->thread, NULL, _mockServerThread, server) !=
+        0) {
+        _mockServerFree(server);
+        return NULL;
+    }
+
+    LTRACK_I("MockL0", "Mock L0 server %s started, tcp port %u, udp port %u",
+             server->name, (unsigned)server->tcp_port,
+             (unsigned)server->udp_port);
+    return server;
+}
+
+void teoLNullMockServerStop(teoLNullMockServer *server) {
+    if (server == NULL) { return; }
+
+    __atomic_store_n(&server->stop, true, __ATOMIC_RELEASE);
+    const char wake = 0;
+    while (write(server->wake[1], &wake, 1) < 0 && errno == EINTR) {}
+    pthread_join(server->thread, NULL);
+
+    _mockServerFree(server);
+}
+
+uint16_t teoLNullMockServerTcpPort(teoLNullMockServer *server) {
+    return server->tcp_port;
+}
+
+uint16_t teoLNullMockServerUdpPort(teoLNullMockServer *server) {
+    return server->udp_port;
+}
+
+void teoLNullMockServerGetStats(teoLNullMockServer *server,
+                                teoLNullMockServerStats *stats) {
+    const uint64_t *from = (const uint64_t *)&server->stats;
+    uint64_t *to = (uint64_t *)stats;
+    for (size_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++) {
+        to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+    }
+}
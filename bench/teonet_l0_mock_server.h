@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef TEONET_L0_MOCK_SERVER_H
+#define TEONET_L0_MOCK_SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Loopback stand-in of L0 server for end-to-end tests and benchmarks
+/////////////////
+
+/**
+ * Mock L0 server configuration, zero-initialized configuration listens on
+ * free TCP and TR-UDP ports of 127.0.0.1 without routing
+ */
+typedef struct teoLNullMockServerConfig {
+    const char *host;   ///< Address to listen on, "127.0.0.1" if NULL
+    uint16_t tcp_port;  ///< TCP port, zero to choose free one
+    uint16_t udp_port;  ///< TR-UDP port, zero to choose free one
+    bool disable_tcp;   ///< Don't accept TCP connections
+    bool disable_trudp; ///< Don't accept TR-UDP connections
+    //! Deliver packets addressed to name of other logged in client to it,
+    //! peer name of delivered packet is name of sender
+    bool route;
+    //! Server peer name in CMD_L_PEERS answer, "mock-l0" if NULL
+    const char *name;
+} teoLNullMockServerConfig;
+
+/**
+ * Mock L0 server statistics
+ */
+typedef struct teoLNullMockServerStats {
+    uint64_t connections;      ///< Accepted TCP connections, TR-UDP channels
+    uint64_t clients;          ///< Currently connected clients
+    uint64_t logins;           ///< Login packets received
+    uint64_t key_exchanges;    ///< Established encrypted sessions
+    uint64_t packets_received; ///< Valid packets received from clients
+    uint64_t packets_sent;     ///< Packets sent to clients
+    uint64_t bytes_received;   ///< Transport bytes received from clients
+    uint64_t bytes_sent;       ///< Transport bytes sent to clients
+    uint64_t echoes;           ///< CMD_L_ECHO answered by server
+    uint64_t routed;           ///< Packets delivered to other clients
+    uint64_t dropped; ///< Broken, undecryptable or undeliverable packets
+} teoLNullMockServerStats;
+
+typedef struct teoLNullMockServer teoLNullMockServer;
+
+/**
+ * Start mock L0 server in its own thread
+ *
+ * Server performs CMD_L_INIT key exchange of ENC_PROTO_ECDH_AES_128_V1 and
+ * rejects session resumption requests, connections requesting other
+ * encryption protocols are closed. Login, CMD_L_ECHO, CMD_L_PEERS and
+ * CMD_L_L0_CLIENTS are answered by server, other packets are routed to
+ * connected clients if enabled or dropped.
+ *
+ * @param config Server configuration, NULL for defaults
+ *
+ * @return Running server or NULL if it can't listen
+ */
+teoLNullMockServer *
+teoLNullMockServerStart(const teoLNullMockServerConfig *config);
+
+/**
+ * Stop server thread, close all connections and free the server
+ *
+ * @param server Server returned by teoLNullMockServerStart
+ */
+void teoLNullMockServerStop(teoLNullMockServer *server);
+
+/**
+ * Get TCP port server listens on, zero if TCP is disabled
+ */
+uint16_t teoLNullMockServerTcpPort(teoLNullMockServer *server);
+
+/**
+ * Get TR-UDP port server listens on, zero if TR-UDP is disabled
+ */
+uint16_t teoLNullMockServerUdpPort(teoLNullMockServer *server);
+
+/**
+ * Get server statistics, may be called from any thread
+ *
+ * @param server Running server
+ * @param stats Statistics to fill
+ */
+void teoLNullMockServerGetStats(teoLNullMockServer *server,
+                                teoLNullMockServerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_MOCK_SERVER_H */
@@ -0,0 +1,556 @@
+/**
+ * File:   teonet_l0_netsim.c
+ *
+ * In process datagram network simulator. Connection sends datagrams to its
+ * end of socketpair, simulator thread reads them from the other end,
+ * applies loss, bottleneck rate, delay, jitter, reordering and duplication
+ * of the profile and schedules them to min-heap by delivery time. Due
+ * datagrams are sent to server by UDP socket of the link or back to the
+ * socketpair. Server answers take the same way in opposite direction.
+ */
+
+#define _GNU_SOURCE // ppoll
+
+#include "teonet_l0_netsim.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "teobase/logging.h"
+
+// Datagrams read from one socket in one wakeup
+#define NETSIM_RECEIVE_MAX 64
+// Largest datagram passed through link
+#define NETSIM_DATAGRAM_MAX 65536
+// Socket buffers of link, bursts shouldn't be dropped by local sockets
+#define NETSIM_SOCKET_BUFFER (1 << 20)
+// Poll timeout when no datagram is scheduled
+#define NETSIM_POLL_TIMEOUT_NS 100000000LL
+
+enum { NETSIM_UPSTREAM, NETSIM_DOWNSTREAM, NETSIM_DIRECTIONS };
+
+/**
+ * Link of one connection to server
+ */
+typedef struct netsimLink {
+    int client_fd; ///< Connection end of socketpair
+    int sim_fd;    ///< Simulator end of socketpair, -1 when closed
+    int udp_fd;    ///< UDP socket connected to server, -1 when closed
+    bool closed;   ///< Closed by connection, sockets are closed by thread
+
+    uint64_t rng[NETSIM_DIRECTIONS];          ///< splitmix64 states
+    int64_t link_free_ns[NETSIM_DIRECTIONS];  ///< Bottleneck is busy until
+} netsimLink;
+
+/**
+ * Datagram scheduled for delivery
+ */
+typedef struct netsimDatagram {
+    netsimLink *link;
+    int direction;
+    int64_t due_ns; ///< Delivery time
+    uint64_t seq;   ///< Keeps order of datagrams due at the same time
+    size_t length;
+    uint8_t data[];
+} netsimDatagram;
+
+struct teoLNullNetsim {
+    teoLNullNetsimProfile profile;
+    uint64_t seed;
+    teoLNullDatagramTransport transport;
+
+    pthread_mutex_t mutex; ///< Guards links, schedule and stats
+    int wake[2];           ///< Pipe to wake simulator thread
+    pthread_t thread;
+    bool stop;
+
+    netsimLink **links; ///< Links, freed by teoLNullNetsimStop
+    size_t links_count;
+    size_t links_size;
+
+    netsimDatagram **heap; ///< Scheduled datagrams, min-heap by due time
+    size_t heap_count;
+    size_t heap_size;
+    uint64_t seq;
+
+    struct pollfd *pfd; ///< Poll set built every loop iteration
+    size_t pfd_size;
+
+    uint8_t buffer[NETSIM_DATAGRAM_MAX];
+
+    teoLNullNetsimStats stats;
+};
+
+static int64_t _netsimTimeNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static uint64_t _netsimRandom(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Get uniformly distributed value in [0, 1)
+ */
+static double _netsimChance(uint64_t *state) {
+    return (_netsimRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void _netsimWake(teoLNullNetsim *sim) {
+    const char wake = 0;
+    while (write(sim->wake[1], &wake, 1) < 0 && errno == EINTR) {}
+}
+
+static bool _netsimBefore(const netsimDatagram *a, const netsimDatagram *b) {
+    return a->due_ns < b->due_ns || (a->due_ns == b->due_ns && a->seq < b->seq);
+}
+
+static bool _netsimHeapPush(teoLNullNetsim *sim, netsimDatagram *datagram) {
+    if (sim->heap_count == sim->heap_size) {
+        size_t size = sim->heap_size ? sim->heap_size * 2 : 256;
+        netsimDatagram **heap = (netsimDatagram **)realloc(
+            sim->heap, size * sizeof(netsimDatagram *));
+        if (heap == NULL) { return false; }
+        sim->heap = heap;
+        sim->heap_size = size;
+    }
+
+    size_t i = sim->heap_count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!_netsimBefore(datagram, sim->heap[parent])) { break; }
+        sim->heap[i] = sim->heap[parent];
+        i = parent;
+    }
+    sim->heap[i] = datagram;
+    return true;
+}
+
+static netsimDatagram *_netsimHeapPop(teoLNullNetsim *sim) {
+    netsimDatagram *top = sim->heap[0];
+    netsimDatagram *last = sim->heap[--sim->heap_count];
+
+    size_t i = 0;
+    for (;;) {
+        size_t child = i * 2 + 1;
+        if (child >= sim->heap_count) { break; }
+        if (child + 1 < sim->heap_count &&
+            _netsimBefore(sim->heap[child + 1], sim->heap[child])) {
+            child++;
+        }
+        if (!_netsimBefore(sim->heap[child], last)) { break; }
+        sim->heap[i] = sim->heap[child];
+        i = child;
+    }
+    if (sim->heap_count > 0) { sim->heap[i] = last; }
+    return top;
+}
+
+static teoLNullNetsimDirectionStats *_netsimStats(teoLNullNetsim *sim,
+                                                  int direction) {
+    return direction == NETSIM_UPSTREAM ? &sim->stats.upstream
+                                        : &sim->stats.downstream;
+}
+
+static void _netsimSchedule(teoLNullNetsim *sim, netsimLink *link,
+                            int direction, const uint8_t *data, size_t length,
+                            int64_t due_ns) {
+    netsimDatagram *datagram =
+        (netsimDatagram *)malloc(sizeof(netsimDatagram) + length);
+    if (datagram == NULL) {
+        _netsimStats(sim, direction)->overflow++;
+        return;
+    }
+    datagram->link = link;
+    datagram->direction = direction;
+    datagram->due_ns = due_ns;
+    datagram->seq = sim->seq++;
+    datagram->length = length;
+    memcpy(datagram->data, data, length);
+
+    if (!_netsimHeapPush(sim, datagram)) {
+        _netsimStats(sim, direction)->overflow++;
+        free(datagram);
+    }
+}
+
+/**
+ * Apply profile to datagram entered link at @a now_ns
+ */
+static void _netsimEnqueue(teoLNullNetsim *sim, netsimLink *link,
+                           int direction, const uint8_t *data, size_t length,
+                           int64_t now_ns) {
+    const teoLNullNetsimProfile *profile = &sim->profile;
+    teoLNullNetsimDirectionStats *stats = _netsimStats(sim, direction);
+    uint64_t *rng = &link->rng[direction];
+
+    stats->datagrams++;
+    stats->bytes += length;
+
+    if (profile->loss > 0 && _netsimChance(rng) < profile->loss) {
+        stats->lost++;
+        return;
+    }
+
+    int64_t due_ns = now_ns;
+    if (profile->bandwidth_kbps > 0) {
+        int64_t *link_free_ns = &link->link_free_ns[direction];
+        const int64_t start_ns = *link_free_ns > now_ns ? *link_free_ns
+                                                        : now_ns;
+        if (profile->queue_ms > 0 &&
+            start_ns - now_ns > (int64_t)profile->queue_ms * 1000000) {
+            stats->queue_drops++;
+            return;
+        }
+        *link_free_ns =
+            start_ns + (int64_t)length * 8000000 / profile->bandwidth_kbps;
+        due_ns = *link_free_ns;
+    }
+
+    due_ns += (int64_t)profile->delay_us * 1000;
+    if (profile->jitter_us > 0) {
+        due_ns += (int64_t)(_netsimChance(rng) * profile->jitter_us * 1000);
+    }
+    if (profile->reorder > 0 && _netsimChance(rng) < profile->reorder) {
+        due_ns += (int64_t)profile->reorder_us * 1000;
+        stats->reordered++;
+    }
+    _netsimSchedule(sim, link, direction, data, length, due_ns);
+
+    if (profile->duplicate > 0 && _netsimChance(rng) < profile->duplicate) {
+        stats->duplicated++;
+        _netsimSchedule(sim, link, direction, data, length, due_ns);
+    }
+}
+
+static void _netsimReceive(teoLNullNetsim *sim, netsimLink *link,
+                           int direction) {
+    const int fd =
+        direction == NETSIM_UPSTREAM ? link->sim_fd : link->udp_fd;
+
+    for (int i = 0; i < NETSIM_RECEIVE_MAX; i++) {
+        ssize_t received =
+            recv(fd, sim->buffer, sizeof(sim->buffer), MSG_DONTWAIT);
+        if (received < 0) { break; }
+        _netsimEnqueue(sim, link, direction, sim->buffer, (size_t)received,
+                       _netsimTimeNs());
+    }
+}
+
+/**
+ * Send datagrams due by @a now_ns
+ */
+static void _netsimDeliver(teoLNullNetsim *sim, int64_t now_ns) {
+    while (sim->heap_count > 0 && sim->heap[0]->due_ns <= now_ns) {
+        netsimDatagram *datagram = _netsimHeapPop(sim);
+        netsimLink *link = datagram->link;
+
+        if (!link->closed) {
+            const int fd = datagram->direction == NETSIM_UPSTREAM
+                               ? link->udp_fd
+                               : link->sim_fd;
+            teoLNullNetsimDirectionStats *stats =
+                _netsimStats(sim, datagram->direction);
+            if (send(fd, datagram->data, datagram->length, MSG_DONTWAIT) <
+                0) {
+                stats->overflow++;
+            } else {
+                stats->delivered++;
+            }
+        }
+        free(datagram);
+    }
+}
+
+static bool _netsimPollSetReserve(teoLNullNetsim *sim, size_t size) {
+    if (size <= sim->pfd_size) { return true; }
+
+    struct pollfd *pfd =
+        (struct pollfd *)realloc(sim->pfd, size * sizeof(struct pollfd));
+    if (pfd == NULL) { return false; }
+    sim->pfd = pfd;
+    sim->pfd_size = size;
+    return true;
+}
+
+static void _netsimLinkCloseSockets(netsimLink *link) {
+    if (link->sim_fd != -1) {
+        close(link->sim_fd);
+        link->sim_fd = -1;
+    }
+    if (link->udp_fd != -1) {
+        close(link->udp_fd);
+        link->udp_fd = -1;
+    }
+}
+
+static void *_netsimThread(void *arg) {
+    teoLNullNetsim *sim = (teoLNullNetsim *)arg;
+
+    // Poll set: wake pipe, then socketpair end and UDP socket of every link
+    enum { PFD_WAKE, PFD_LINKS };
+
+    pthread_mutex_lock(&sim->mutex);
+    while (!__atomic_load_n(&sim->stop, __ATOMIC_ACQUIRE)) {
+        if (!_netsimPollSetReserve(sim, PFD_LINKS + sim->links_count * 2)) {
+            break;
+        }
+        struct pollfd *pfd = sim->pfd;
+        pfd[PFD_WAKE].fd = sim->wake[0];
+        // Links opened while polling are polled in next iteration
+        const size_t links_count = sim->links_count;
+        for (size_t i = 0; i < links_count; i++) {
+            netsimLink *link = sim->links[i];
+            if (link->closed) { _netsimLinkCloseSockets(link); }
+            // Negative descriptors of closed links are ignored by poll
+            pfd[PFD_LINKS + i * 2].fd = link->sim_fd;
+            pfd[PFD_LINKS + i * 2 + 1].fd = link->udp_fd;
+        }
+        for (size_t i = 0; i < PFD_LINKS + links_count * 2; i++) {
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+
+        int64_t timeout_ns = NETSIM_POLL_TIMEOUT_NS;
+        if (sim->heap_count > 0) {
+            timeout_ns = sim->heap[0]->due_ns - _netsimTimeNs();
+            if (timeout_ns < 0) { timeout_ns = 0; }
+            if (timeout_ns > NETSIM_POLL_TIMEOUT_NS) {
+                timeout_ns = NETSIM_POLL_TIMEOUT_NS;
+            }
+        }
+        const struct timespec timeout = {timeout_ns / 1000000000,
+                                         timeout_ns % 1000000000};
+
+        pthread_mutex_unlock(&sim->mutex);
+        int ready = ppoll(pfd, PFD_LINKS + links_count * 2, &timeout, NULL);
+        pthread_mutex_lock(&sim->mutex);
+
+        if (ready < 0 && errno != EINTR) {
+            LTRACK_E("Netsim", "poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (ready > 0) {
+            if (pfd[PFD_WAKE].revents) {
+                char drain[64];
+                while (read(sim->wake[0], drain, sizeof(drain)) ==
+                       sizeof(drain)) {}
+            }
+            for (size_t i = 0; i < links_count; i++) {
+                netsimLink *link = sim->links[i];
+                if (link->closed) { continue; }
+                if (pfd[PFD_LINKS + i * 2].revents & POLLIN) {
+                    _netsimReceive(sim, link, NETSIM_UPSTREAM);
+                }
+                if (pfd[PFD_LINKS + i * 2 + 1].revents & POLLIN) {
+                    _netsimReceive(sim, link, NETSIM_DOWNSTREAM);
+                }
+            }
+        }
+
+        _netsimDeliver(sim, _netsimTimeNs());
+    }
+    pthread_mutex_unlock(&sim->mutex);
+
+    return NULL;
+}
+
+static void _netsimSetBuffers(int fd) {
+    const int size = NETSIM_SOCKET_BUFFER;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/**
+ * Connect UDP socket to @a server and @a port
+ *
+ * @return socket or -1
+ */
+static int _netsimConnectUdp(const char *server, uint16_t port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+
+    struct addrinfo *info = NULL;
+    if (getaddrinfo(server, service, &hints, &info) != 0) {
+        LTRACK_E("Netsim", "Can't resolve %s", server);
+        return -1;
+    }
+
+    int fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) != 0) {
+        LTRACK_E("Netsim", "Can't connect to %s:%u: %s", server,
+                 (unsigned)port, strerror(errno));
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(info);
+    return fd;
+}
+
+static int _netsimOpen(void *user_data, const char *server, uint16_t port) {
+    teoLNullNetsim *sim = (teoLNullNetsim *)user_data;
+
+    netsimLink *link = (netsimLink *)calloc(1, sizeof(netsimLink));
+    if (link == NULL) { return -1; }
+
+    int pair[2];
+    link->udp_fd = _netsimConnectUdp(server, port);
+    if (link->udp_fd == -1 ||
+        socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) != 0) {
+        if (link->udp_fd != -1) { close(link->udp_fd); }
+        free(link);
+        return -1;
+    }
+    link->client_fd = pair[0];
+    link->sim_fd = pair[1];
+    _netsimSetBuffers(link->udp_fd);
+    _netsimSetBuffers(link->client_fd);
+    _netsimSetBuffers(link->sim_fd);
+
+    pthread_mutex_lock(&sim->mutex);
+    if (sim->links_count == sim->links_size) {
+        size_t size = sim->links_size ? sim->links_size * 2 : 16;
+        netsimLink **links =
+            (netsimLink **)realloc(sim->links, size * sizeof(netsimLink *));
+        if (links == NULL) {
+            pthread_mutex_unlock(&sim->mutex);
+            close(link->client_fd);
+            _netsimLinkCloseSockets(link);
+            free(link);
+            return -1;
+        }
+        sim->links = links;
+        sim->links_size = size;
+    }
+    // Every link and direction has own random sequence
+    const uint64_t number = sim->links_count;
+    for (int direction = 0; direction < NETSIM_DIRECTIONS; direction++) {
+        link->rng[direction] =
+            sim->seed ^ ((number * NETSIM_DIRECTIONS + direction + 1) *
+                         0xD1B54A32D192ED03ULL);
+    }
+    sim->links[sim->links_count++] = link;
+    sim->stats.links++;
+    pthread_mutex_unlock(&sim->mutex);
+
+    _netsimWake(sim);
+    return link->client_fd;
+}
+
+static ssize_t _netsimSend(void *user_data, int fd, const void *data,
+                           size_t length) {
+    return send(fd, data, length, 0);
+}
+
+static ssize_t _netsimRecv(void *user_data, int fd, void *buffer,
+                           size_t size) {
+    return recv(fd, buffer, size, 0);
+}
+
+static void _netsimClose(void *user_data, int fd) {
+    teoLNullNetsim *sim = (teoLNullNetsim *)user_data;
+
+    pthread_mutex_lock(&sim->mutex);
+    for (size_t i = 0; i < sim->links_count; i++) {
+        if (sim->links[i]->client_fd == fd && !sim->links[i]->closed) {
+            sim->links[i]->closed = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sim->mutex);
+
+    close(fd);
+    _netsimWake(sim);
+}
+
+static void _netsimFree(teoLNullNetsim *sim) {
+    for (size_t i = 0; i < sim->links_count; i++) {
+        _netsimLinkCloseSockets(sim->links[i]);
+        free(sim->links[i]);
+    }
+    for (size_t i = 0; i < sim->heap_count; i++) { free(sim->heap[i]); }
+    if (sim->wake[0] != -1) {
+        close(sim->wake[0]);
+        close(sim->wake[1]);
+    }
+    pthread_mutex_destroy(&sim->mutex);
+    free(sim->links);
+    free(sim->heap);
+    free(sim->pfd);
+    free(sim);
+}
+
+teoLNullNetsim *teoLNullNetsimStart(const teoLNullNetsimProfile *profile,
+                                    uint64_t seed) {
+    teoLNullNetsim *sim = (teoLNullNetsim *)calloc(1, sizeof(teoLNullNetsim));
+    if (sim == NULL) { return NULL; }
+    sim->profile = *profile;
+    sim->seed = seed;
+    sim->wake[0] = sim->wake[1] = -1;
+    pthread_mutex_init(&sim->mutex, NULL);
+
+    sim->transport.open = _netsimOpen;
+    sim->transport.send = _netsimSend;
+    sim->transport.recv = _netsimRecv;
+    sim->transport.close = _netsimClose;
+    sim->transport.user_data = sim;
+
+    if (pipe(sim->wake) != 0) {
+        sim->wake[0] = sim->wake[1] = -1;
+        _netsimFree(sim);
+        return NULL;
+    }
+    fcntl(sim->wake[0], F_SETFL, fcntl(sim->wake[0], F_GETFL) | O_NONBLOCK);
+
+    if (pthread_create(&sim->thread, NULL, _netsimThread, sim) != 0) {
+        _netsimFree(sim);
+        return NULL;
+    }
+
+    LTRACK_I("Netsim", "Network simulator %s started, seed %llu",
+             profile->name != NULL ? profile->name : "",
+             (unsigned long long)seed);
+    return sim;
+}
+
+void teoLNullNetsimStop(teoLNullNetsim *sim) {
+    if (sim == NULL) { return; }
+
+    __atomic_store_n(&sim->stop, true, __ATOMIC_RELEASE);
+    _netsimWake(sim);
+    pthread_join(sim->thread, NULL);
+
+    _netsimFree(sim);
+}
+
+const teoLNullDatagramTransport *teoLNullNetsimTransport(teoLNullNetsim *sim) {
+    return &sim->transport;
+}
+
+void teoLNullNetsimGetStats(teoLNullNetsim *sim, teoLNullNetsimStats *stats) {
+    pthread_mutex_lock(&sim->mutex);
+    *stats = sim->stats;
+    pthread_mutex_unlock(&sim->mutex);
+}
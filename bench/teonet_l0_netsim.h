@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef TEONET_L0_NETSIM_H
+#define TEONET_L0_NETSIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libteol0/teonet_l0_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// In process datagram network simulator for TR-UDP tests and benchmarks
+/////////////////
+
+/**
+ * Impairments of simulated link, applied to both directions independently
+ */
+typedef struct teoLNullNetsimProfile {
+    const char *name;    ///< Profile name in reports
+    double loss;         ///< Probability datagram is lost, 0..1
+    uint32_t delay_us;   ///< One way delay, RTT is twice of it
+    uint32_t jitter_us;  ///< Uniformly distributed extra delay up to it
+    double duplicate;    ///< Probability datagram is delivered twice
+    double reorder;      ///< Probability datagram is held back
+    uint32_t reorder_us; ///< Extra delay of held back datagram
+    //! Link rate in kbit/s, datagrams wait for their turn, zero - unlimited
+    uint32_t bandwidth_kbps;
+    //! Bottleneck queue length in ms of link rate, datagrams which would
+    //! wait longer are dropped, zero - unlimited
+    uint32_t queue_ms;
+} teoLNullNetsimProfile;
+
+/**
+ * Counters of one link direction
+ */
+typedef struct teoLNullNetsimDirectionStats {
+    uint64_t datagrams;   ///< Datagrams entered link
+    uint64_t bytes;       ///< Bytes of datagrams entered link
+    uint64_t delivered;   ///< Datagrams delivered, duplicates included
+    uint64_t lost;        ///< Datagrams dropped by loss probability
+    uint64_t duplicated;  ///< Extra copies scheduled
+    uint64_t reordered;   ///< Datagrams held back
+    uint64_t queue_drops; ///< Datagrams dropped by full bottleneck queue
+    uint64_t overflow;    ///< Datagrams receiver had no room for
+} teoLNullNetsimDirectionStats;
+
+/**
+ * Simulator counters of all links
+ */
+typedef struct teoLNullNetsimStats {
+    uint64_t links;                        ///< Links opened by connections
+    teoLNullNetsimDirectionStats upstream; ///< Client to server
+    teoLNullNetsimDirectionStats downstream; ///< Server to client
+} teoLNullNetsimStats;
+
+typedef struct teoLNullNetsim teoLNullNetsim;
+
+/**
+ * Start simulator in its own thread
+ *
+ * Every link opened through simulator transport is a socketpair to
+ * connection and UDP socket connected to server, datagrams between them are
+ * scheduled by the profile. Random decisions use PRNG seeded by @a seed and
+ * link number, so the same seed gives the same impairments of the same
+ * traffic.
+ *
+ * @param profile Link impairments, copied
+ * @param seed PRNG seed
+ *
+ * @return Running simulator or NULL on error
+ */
+teoLNullNetsim *teoLNullNetsimStart(const teoLNullNetsimProfile *profile,
+                                    uint64_t seed);
+
+/**
+ * Stop simulator thread, close links and free the simulator, connections
+ * using it must be disconnected before
+ *
+ * @param sim Simulator returned by teoLNullNetsimStart
+ */
+void teoLNullNetsimStop(teoLNullNetsim *sim);
+
+/**
+ * Get datagram transport of simulator for teoLNUllSetOption_DatagramTransport,
+ * valid until teoLNullNetsimStop
+ */
+const teoLNullDatagramTransport *teoLNullNetsimTransport(teoLNullNetsim *sim);
+
+/**
+ * Get simulator statistics, may be called from any thread
+ *
+ * @param sim Running simulator
+ * @param stats Statistics to fill
+ */
+void teoLNullNetsimGetStats(teoLNullNetsim *sim, teoLNullNetsimStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_NETSIM_H */
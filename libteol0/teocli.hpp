@@ -144,9 +144,57 @@ public:
         con = teoLNullConnectE(server, port,
                 eventCallBack == NULL ? NULL : callbackBind, this, connection_flag);
 
+        // Default callback drops tick and idle events, don't send them at all
+        if(con != NULL && event_cb == NULL) {
+            setEventMask(EV_L_MASK_ALL &
+                ~(EV_L_MASK(EV_L_TICK) | EV_L_MASK(EV_L_IDLE)));
+        }
+
         return connected();
     }
 
+    /**
+     * Set events which are sent to event callback
+     *
+     * @param mask Events mask, combination of EV_L_MASK(event) values
+     */
+    void setEventMask(teoLNullEventMask mask) {
+        teoLNullSetEventMask(con, mask);
+    }
+
+    /**
+     * Deliver received packets through receive ring instead of event callback
+     *
+     * @param size_bytes Ring size in bytes
+     *
+     * @return true if ring is enabled
+     */
+    bool enableRecvRing(size_t size_bytes) {
+        return teoLNullEnableRecvRing(con, size_bytes);
+    }
+
+    /**
+     * Get received packets from receive ring
+     *
+     * @param out Array of packet views
+     * @param max Array size
+     * @param timeout Time to wait for first packet in ms, negative - infinite
+     *
+     * @return Number of received packets or -1 if receive ring isn't enabled
+     */
+    ssize_t poll(teoLNullPacketView *out, size_t max, int timeout) {
+        return teoLNullPoll(con, out, max, timeout);
+    }
+
+    /**
+     * Release oldest packets returned by poll
+     *
+     * @param count Number of packets to release
+     */
+    void pollRelease(size_t count) {
+        teoLNullPollRelease(con, count);
+    }
+
     /**
      * Disconnect from server and free teoLNullConnectData
      *
@@ -284,9 +332,9 @@ public:
      * Receive data from L0 server during timeout
      *
      * @param con Pointer to teoLNullConnectData
-     * @param timeout Timeout in uSeconds
+     * @param timeout Timeout in ms
      *
-     * @return Number of received bytes or -1 at timeout
+     * @return Number of received bytes, 0 if disconnected or -1 at timeout
      */
     ssize_t recvTimeout(uint32_t timeout) {
         return teoLNullRecvTimeout(con, timeout);
@@ -14,8 +14,16 @@
 #endif
 
 #include "teonet_l0_client.h"
+#include "teonet_l0_client_capture.h"
 #include "teonet_l0_client_crypt.h"
+#include "teonet_l0_client_metrics.h"
 #include "teonet_l0_client_options.h"
+#include "teonet_l0_client_probes.h"
+#include "teonet_l0_client_reconnect.h"
+#include "teonet_l0_client_ring.h"
+#include "teonet_l0_client_stats.h"
+#include "teonet_l0_client_ticket.h"
+#include "teonet_l0_client_trace.h"
 
 #include <errno.h>
 #include <inttypes.h>
@@ -54,6 +62,25 @@
 
 #define SEND_MESSAGE_AFTER 1000000
 
+// Maximum time to wait in one select call when waiting for a deadline
+#define WAIT_SLICE_MAX_MS 1000
+
+// Maximum sleep after repeated select returns without any progress
+#define WAIT_BACKOFF_MAX_MS 50
+
+// Maximum sleep of tickless event loop without user and keepalive deadline
+#define TICKLESS_MAX_SLEEP_MS 60000
+
+// Batch event callback buffers
+#define EVENT_BATCH_INITIAL_SIZE 16
+#define EVENT_BATCH_ALIGN(len) (((len) + 7) & ~(size_t)7)
+
+// Address replayed TR-UDP connection sends ACK and answers to
+#define REPLAY_LOOPBACK "127.0.0.1"
+
+// Keystream generated per event loop call, bounds crypto lock hold time
+#define KEYSTREAM_PRECOMPUTE_MAX_BYTES (16 * 1024)
+
 // Global teocli options
 extern bool teocliOpt_DBG_packetFlow;
 extern bool teocliOpt_DBG_selectLoop;
@@ -62,7 +89,16 @@ extern bool teocliOpt_DBG_sentPackets;
 extern bool teocliOpt_PacketDataChecksumInR2;
 extern int32_t teocliOpt_MaximumReceiveInSelect;
 extern int32_t teocliOpt_ConnectTimeoutMs;
+extern bool teocliOpt_TicklessIdle;
+extern bool teocliOpt_TickEvent;
+extern int32_t teocliOpt_KeepaliveIntervalMs;
+extern uint32_t teocliOpt_KeystreamCacheBytes;
 extern teoLNullEncryptionProtocol teocliOpt_EncryptionProtocol;
+extern bool teocliOpt_SessionResumption;
+extern const teoLNullDatagramTransport *teocliOpt_DatagramTransport;
+extern uint32_t teocliOpt_ReconnectMinMs;
+extern uint32_t teocliOpt_ReconnectMaxMs;
+extern uint32_t teocliOpt_ReconnectQueueBytes;
 extern teocliDataSentCallback_t teocliOpt_STAT_dataSentCallback;
 extern teocliDataReceivedCallback_t teocliOpt_STAT_dataReceivedCallback;
 
@@ -77,6 +113,8 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
 static void teoLNullPacketUpdateHeaderChecksum(teoLNullCPacket *packet);
 
 static void _teocliCallDataSentCallback(int bytes_sent);
+static bool _teoLNullReconnectLinkDown(teoLNullConnectData *con);
+static bool _teoLNullReconnectWait(teoLNullConnectData *con, int timeout);
 static void _teocliCallDataReceivedCallback(int bytes_received);
 
 #if defined(HAVE_MINGW) || defined(_WIN32)
@@ -87,15 +125,134 @@ typedef struct teoPipeSendData {
     size_t packet_length;
     teoLNullCPacket *packet;
     bool with_encryption;
+    uint64_t queued_us; ///< teoGetTimestampFull when packet was queued
+    uint64_t trace_ns;  ///< Send stage start, 0 if send isn't traced
 } teoPipeSendData;
 
+/**
+ * Add event to the batch collected during event loop iteration
+ *
+ * Event data is copied because read buffer is reused by next packet. Until
+ * batch is sent, view data pointer only marks that event has data.
+ */
+static void _teoLNullEventBatchAdd(teoLNullConnectData *con,
+                                   teoLNullEvents event, void *data,
+                                   size_t data_length) {
+    if (con->event_batch_len == con->event_batch_size) {
+        con->event_batch_size = con->event_batch_size ? con->event_batch_size * 2
+                                                      : EVENT_BATCH_INITIAL_SIZE;
+        con->event_batch = (teoLNullEventView *)ccl_realloc(
+            con->event_batch, con->event_batch_size * sizeof(teoLNullEventView));
+    }
+
+    teoLNullEventView *view = &con->event_batch[con->event_batch_len++];
+    view->event = event;
+    view->data = data;
+    view->data_len = data != NULL ? data_length : 0;
+    if (data == NULL) { return; }
+
+    const size_t aligned_length = EVENT_BATCH_ALIGN(data_length);
+    if (con->event_batch_data_len + aligned_length >
+        con->event_batch_data_size) {
+        size_t size = con->event_batch_data_size ? con->event_batch_data_size
+                                                 : L0_BUFFER_SIZE;
+        while (size < con->event_batch_data_len + aligned_length) {
+            size *= 2;
+        }
+        con->event_batch_data =
+            (uint8_t *)ccl_realloc(con->event_batch_data, size);
+        con->event_batch_data_size = size;
+    }
+
+    memcpy(con->event_batch_data + con->event_batch_data_len, data,
+           data_length);
+    con->event_batch_data_len += aligned_length;
+}
+
+/**
+ * Send events collected during event loop iteration to batch callback
+ */
+static void _teoLNullEventBatchFlush(teoLNullConnectData *con) {
+    con->event_batch_f = 0;
+    if (con->event_batch_len == 0) { return; }
+
+    // Resolve data pointers, data of events stored one by one
+    size_t offset = 0;
+    for (size_t i = 0; i < con->event_batch_len; ++i) {
+        teoLNullEventView *view = &con->event_batch[i];
+        if (view->data != NULL) {
+            view->data = con->event_batch_data + offset;
+            offset += EVENT_BATCH_ALIGN(view->data_len);
+        }
+    }
+
+    const size_t events_count = con->event_batch_len;
+    con->event_batch_len = 0;
+    con->event_batch_data_len = 0;
+
+    if (con->event_batch_cb != NULL) {
+        con->event_batch_cb(con, con->event_batch, events_count,
+                            con->user_data);
+    }
+}
+
 static void send_l0_event(teoLNullConnectData *con, teoLNullEvents event,
                           void *data, size_t data_length) {
-    if (con->event_cb != NULL) {
+    if (event == EV_L_CONNECTED && con->status == CON_STATUS_CONNECTED) {
+        teoLNullStatsCountConnect(con->stats);
+    }
+
+    if ((con->event_mask & EV_L_MASK(event)) == 0) { return; }
+
+    if (con->recv_ring != NULL &&
+        (event == EV_L_RECEIVED || event == EV_L_RECEIVED_UNRELIABLE)) {
+        teoLNullRecvRingPush(con->recv_ring, event, data, data_length);
+        return;
+    }
+
+    if (con->event_batch_cb != NULL) {
+        if (con->event_batch_f) {
+            _teoLNullEventBatchAdd(con, event, data, data_length);
+        } else {
+            teoLNullEventView view = {event, data, data_length};
+            con->event_batch_cb(con, &view, 1, con->user_data);
+        }
+    } else if (con->event_cb != NULL) {
         con->event_cb(con, event, data, data_length, con->user_data);
     }
 }
 
+/**
+ * Set events which are sent to event callbacks
+ *
+ * Events excluded from @a mask are suppressed before any callback call, masked
+ * received packets aren't put to receive ring either. All events are enabled
+ * by default.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param mask Events mask, combination of EV_L_MASK(event) values
+ */
+void teoLNullSetEventMask(teoLNullConnectData *con, teoLNullEventMask mask) {
+    con->event_mask = mask;
+}
+
+/**
+ * Set batch event callback
+ *
+ * Events of one teoLNullReadEventLoop call are collected and delivered in
+ * single callback call after the loop iteration, events outside of event loop
+ * are delivered immediately as batch of one event. When batch callback is set
+ * teoLNullEventsCb isn't called. Events data is valid until callback returns.
+ * teoLNullReadEventLoop must not be called from batch callback.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param event_batch_cb Batch event callback, NULL to use event callback
+ */
+void teoLNullSetEventBatchCb(teoLNullConnectData *con,
+                             teoLNullEventsBatchCb event_batch_cb) {
+    con->event_batch_cb = event_batch_cb;
+}
+
 static inline char *teoLNullPacketGetPeerName(teoLNullCPacket *packet) {
     return (char *)packet->peer_name;
 }
@@ -118,13 +275,7 @@ static inline size_t teoLNullPacketGetFullPayloadSize(teoLNullCPacket *packet) {
  * Startup windows socket library.
  * Calls once per application to initialize this client library.
  */
-void teoLNullInit() {
-    teosockInit();
-
-    // seed random generator
-    int64_t now = teotimeGetCurrentTimeMs();
-    srand((unsigned int)now);
-}
+void teoLNullInit() { teosockInit(); }
 
 /**
  * Cleanup L0 client library.
@@ -158,23 +309,102 @@ void teoLNullUnlockCrypto(teoLNullEncryptionContext *ctx) {
     }
 }
 
+/**
+ * Get number of bytes encryption may add to packets of connection
+ */
+static inline size_t _encryptionOverhead(teoLNullConnectData *con) {
+    // enc_proto is set once at connect, so it's read without lock
+    return con->client_crypt != NULL
+               ? teoLNullEncryptionOverhead(con->client_crypt->enc_proto)
+               : 0;
+}
+
+/**
+ * Check if payload of received @a packet is authenticated by AEAD tag, such
+ * packets have no payload checksum
+ */
+static inline bool _packetPayloadAuthenticated(teoLNullConnectData *con,
+                                               teoLNullCPacket *packet) {
+    return teoLNullPacketIsEncrypted(packet) && _encryptionOverhead(con) > 0;
+}
+
+/**
+ * Seals packet like teoLNullPacketSeal and reports nonce reserved for it
+ *
+ * @return true if packet is encrypted and must be passed to transport between
+ *  teoLNullSendOrderWait and teoLNullSendOrderCommit
+ */
+static bool _packetSealOrdered(teoLNullEncryptionContext *ctx,
+                               bool with_encryption, teoLNullCPacket *packet,
+                               uint32_t *nonce) {
+    if (!with_encryption) {
+        return false;
+    }
+
+    const bool ordered = teoLNullPacketEncryptOrdered(ctx, packet, nonce);
+    if (ordered && teoLNullEncryptionOverhead(ctx->enc_proto) > 0) {
+        packet->checksum = 0;
+        teoLNullPacketUpdateHeaderChecksum(packet);
+    } else {
+        teoLNullPacketUpdateChecksums(packet);
+    }
+    return ordered;
+}
+
 /**
  * Ensures @a packet checksums, encrypts packet inplace (if applicable)
  * If ctx is NULL or ctx->state != SESCRYPT_ESTABLISHED then encryption isn't
  * performed, but checksums calculated anyway
  *
+ * Nothing is appended to packet data, so packets with data aren't encrypted
+ * by AEAD protocols, use teoLNullPacketSealBuffer for them
+ *
  * @param ctx encryption context
  * @param with_encryption flag allowing encryption
  * @param packet LNull packet to encrypt and seal
  */
 void teoLNullPacketSeal(teoLNullEncryptionContext *ctx, bool with_encryption,
                         teoLNullCPacket *packet) {
-    if (!with_encryption) {
-        return;
+    if (!teoLNullPacketSealBuffer(
+            ctx, with_encryption, packet,
+            teoLNullBufferSize(packet->peer_name_length,
+                               packet->data_length))) {
+        teoLNullPacketUpdateChecksums(packet);
+    }
+}
+
+/**
+ * Seals packet like teoLNullPacketSeal in buffer of @a capacity bytes
+ *
+ * Payload of packet encrypted with AEAD protocol is authenticated by the tag
+ * appended to packet data, its payload checksum is set to zero instead of
+ * calculating
+ *
+ * @param ctx encryption context
+ * @param with_encryption flag allowing encryption
+ * @param packet LNull packet to encrypt and seal
+ * @param capacity Size of buffer packet is created in
+ *
+ * @return false if encrypted packet doesn't fit to buffer, packet is left
+ *  unchanged then
+ */
+bool teoLNullPacketSealBuffer(teoLNullEncryptionContext *ctx,
+                              bool with_encryption, teoLNullCPacket *packet,
+                              size_t capacity) {
+    if (with_encryption &&
+        !teoLNullPacketEncryptionFits(ctx, packet, capacity)) {
+        LTRACK_E("TeonetClient",
+                 "Packet data of %u bytes with %s tag doesn't fit to %u bytes "
+                 "buffer",
+                 (uint32_t)packet->data_length,
+                 STRING_teoLNullEncryptionProtocol(ctx->enc_proto),
+                 (uint32_t)capacity);
+        return false;
     }
 
-    teoLNullPacketEncrypt(ctx, packet);
-    teoLNullPacketUpdateChecksums(packet);
+    uint32_t nonce;
+    _packetSealOrdered(ctx, with_encryption, packet, &nonce);
+    return true;
 }
 
 /**
@@ -251,15 +481,127 @@ size_t teoLNullPacketCreate(void *buffer, size_t buffer_length, uint8_t command,
     return teoLNullBufferSize(pkg->peer_name_length, pkg->data_length);
 }
 
+/**
+ * Send TR-UDP datagram to server by UDP socket or datagram transport
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param tcd TR-UDP channel of server
+ */
+static ssize_t _teoLNullUdpSend(teoLNullConnectData *con,
+                                trudpChannelData *tcd, const void *data,
+                                size_t length) {
+    if (con->transport != NULL) {
+        return con->transport->send(con->transport->user_data, con->fd, data,
+                                    length);
+    }
+    return trudpUdpSendto(tcd->td->fd, (const uint8_t *)data, length,
+                          (__CONST_SOCKADDR_ARG)&tcd->remaddr, tcd->addrlen);
+}
+
+/**
+ * Receive TR-UDP datagram from datagram transport
+ *
+ * @return Result as of trudpUdpRecvfrom
+ */
+static teosockRecvfromResult
+_teoLNullTransportRecv(teoLNullConnectData *con, uint8_t *buffer, size_t size,
+                       size_t *recvlen, int *error_code) {
+    ssize_t received =
+        con->transport->recv(con->transport->user_data, con->fd, buffer, size);
+    if (received > 0) {
+        *recvlen = (size_t)received;
+        return TEOSOCK_RECVFROM_DATA_RECEIVED;
+    }
+    if (received == 0) { return TEOSOCK_RECVFROM_ORDERLY_CLOSED; }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return TEOSOCK_RECVFROM_TRY_AGAIN;
+    }
+    *error_code = errno;
+    return TEOSOCK_RECVFROM_FATAL_ERROR;
+}
+
+/**
+ * Check that packet data with encryption @a overhead fits to L0 packet
+ *
+ * @return false if packet is too large, error is logged
+ */
+static bool _packetSizeValid(const teoLNullCPacket *packet, size_t overhead) {
+    if (packet->data_length + overhead <= UINT16_MAX) { return true; }
+
+    LTRACK_E("TeonetClient",
+             "Packet data of %u bytes is too large, at most %u bytes may be "
+             "sent encrypted",
+             (uint32_t)packet->data_length, (uint32_t)(UINT16_MAX - overhead));
+    return false;
+}
+
+/**
+ * Seal and send packet
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param with_encryption flag allowing encryption
+ * @param packet Packet to send, may be encrypted in place
+ * @param length Packet length
+ * @param capacity Packet buffer size, packet is copied to larger buffer if
+ *  encryption overhead doesn't fit to it
+ *
+ * @return Length of send data or -1 at error, packet too large to encrypt is
+ *  an error
+ */
 static ssize_t _teosockSend(teoLNullConnectData *con, bool with_encryption,
-                            teoLNullCPacket *packet, size_t length) {
+                            teoLNullCPacket *packet, size_t length,
+                            size_t capacity) {
+    const size_t overhead = with_encryption ? _encryptionOverhead(con) : 0;
+    const uint8_t cmd = packet->cmd;
+
+    // AEAD tag is appended to packet data, data length field must hold it
+    if (!_packetSizeValid(packet, overhead)) {
+        teoLNullStatsCountError(con->stats, STAT_ERROR_SEND);
+        return -1;
+    }
+
     if (con->tcp_f) {
-        // for TCP connection packet sent immediately, so we should seal it right now
-        teoLNullEncryptionContext *locked_crypt = teoLNullAcquireCrypto(con);
-        teoLNullPacketSeal(locked_crypt, with_encryption, packet);
-        ssize_t res = teosockSend(con->fd, (const uint8_t *)packet, length);
-        teoLNullUnlockCrypto(locked_crypt);
+        const uint64_t started_us = teoGetTimestampFull();
+        TRACE_SEND_BEGIN(con, trace);
+        teoLNullCPacket *send_packet = packet;
+        if (length + overhead > capacity) {
+            send_packet = (teoLNullCPacket *)ccl_malloc(length + overhead);
+            memcpy(send_packet, packet, length);
+        }
+
+        // for TCP connection packet sent immediately, so we should seal it
+        // right now. Senders encrypt concurrently, encrypted packets are
+        // written to socket in nonce order, every write holds write_guard
+        // so plain packets of other senders don't get in the middle of it
+        teoLNullEncryptionContext *crypt = con->client_crypt;
+        uint32_t nonce = 0;
+        const bool ordered =
+            _packetSealOrdered(crypt, with_encryption, send_packet, &nonce);
+        length = teoLNullBufferSize(send_packet->peer_name_length,
+                                    send_packet->data_length);
+        TRACE_SEND_STAGE(con, trace, STAGE_SEND_SEAL);
+        // Wait fails if session is closed by disconnect or new login, the
+        // packet is dropped then
+        const bool turn = !ordered || teoLNullSendOrderWait(crypt, nonce);
+        TRACE_SEND_STAGE(con, trace, STAGE_SEND_ORDER);
+        ssize_t res = -1;
+        if (turn) {
+            teomutexLock(&con->write_guard);
+            res = teosockSend(con->fd, (const uint8_t *)send_packet, length);
+            teomutexUnlock(&con->write_guard);
+            if (ordered) { teoLNullSendOrderCommit(crypt, nonce); }
+        }
+        TRACE_SEND_STAGE(con, trace, STAGE_SEND_WRITE);
+
+        if (send_packet != packet) { free(send_packet); }
 
+        if (res < 0) {
+            teoLNullStatsCountError(con->stats, STAT_ERROR_SEND);
+        } else {
+            teoLNullStatsCountSent(con->stats, cmd, length);
+            teoLNullStatsRecordLatency(con->stats, STAT_LATENCY_SEND,
+                                       teoGetTimestampFull() - started_us);
+        }
         _teocliCallDataSentCallback(length);
 
         return res;
@@ -271,7 +613,11 @@ static ssize_t _teosockSend(teoLNullConnectData *con, bool with_encryption,
         // just before sending to network
         pipe_send_data.with_encryption = with_encryption;
         pipe_send_data.packet_length = length;
-        pipe_send_data.packet = (teoLNullCPacket *)ccl_malloc(length);
+        pipe_send_data.queued_us = teoGetTimestampFull();
+        TRACE_SEND_BEGIN(con, trace);
+        TRACE_SEND_SAVE(trace, pipe_send_data.trace_ns);
+        pipe_send_data.packet =
+            (teoLNullCPacket *)ccl_malloc(length + overhead);
         memcpy(pipe_send_data.packet, packet, length);
 
 // Write to pipe
@@ -296,12 +642,59 @@ static ssize_t _teosockSend(teoLNullConnectData *con, bool with_encryption,
             abort();
         }
 
+        teoLNullStatsCountSent(con->stats, cmd, length);
         _teocliCallDataSentCallback(length);
 
         return length;
     }
 }
 
+/**
+ * Send packet of application, packet of managed connection is queued while
+ * link is down
+ *
+ * @return Length of sent or queued data or -1 at error
+ */
+static ssize_t _teoLNullSendManaged(teoLNullConnectData *con,
+                                    bool with_encryption,
+                                    teoLNullCPacket *packet, size_t length,
+                                    size_t capacity) {
+    teoLNullReconnect *rc = con->reconnect;
+    if (rc == NULL) {
+        return _teosockSend(con, with_encryption, packet, length, capacity);
+    }
+
+    for (;;) {
+        if (teoLNullReconnectEnter(rc)) {
+            ssize_t res =
+                _teosockSend(con, with_encryption, packet, length, capacity);
+            teoLNullReconnectLeave(rc);
+            return res;
+        }
+
+        // Queued packet is sent by _teosockSend later, check it now. Context
+        // is recreated by reconnect, so protocol is taken from rc
+        const size_t overhead =
+            with_encryption ? teoLNullEncryptionOverhead(
+                                  (teoLNullEncryptionProtocol)rc->enc_proto)
+                            : 0;
+        if (!_packetSizeValid(packet, overhead)) {
+            teoLNullStatsCountError(con->stats, STAT_ERROR_SEND);
+            return -1;
+        }
+
+        switch (teoLNullReconnectQueuePush(
+            rc, with_encryption, packet, length,
+            length + TEOLNULL_ENCRYPTION_MAX_OVERHEAD, false)) {
+        case RECONNECT_QUEUED: return (ssize_t)length;
+        case RECONNECT_QUEUE_FULL:
+            teoLNullStatsCountReconnect(con->stats, STAT_RECONNECT_DROPPED);
+            return -1;
+        case RECONNECT_LINK_UP: break; // replay is done, send it now
+        }
+    }
+}
+
 /**
  * Send packet to L0 server/client
  *
@@ -314,7 +707,8 @@ static ssize_t _teosockSend(teoLNullConnectData *con, bool with_encryption,
 ssize_t teoLNullPacketSend(teoLNullConnectData *con, bool with_encryption,
                            teoLNullCPacket *packet, size_t packet_length) {
     if (con != NULL) {
-        return _teosockSend(con, with_encryption, packet, packet_length);
+        return _teoLNullSendManaged(con, with_encryption, packet,
+                                    packet_length, packet_length);
     } else {
         return -1;
     }
@@ -336,18 +730,23 @@ ssize_t teoLNullPacketSend(teoLNullConnectData *con, bool with_encryption,
 ssize_t teoLNullSend(teoLNullConnectData *con, uint8_t cmd,
                      const char *peer_name, const void *data,
                      size_t data_length) {
-    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
-            "Sending reliable data %u bytes.", (uint32_t)data_length);
+    TEOCLI_PROBE2(send, cmd, data_length);
+    CLTRACK_HOT(teocliOpt_DBG_sentPackets, "TeonetClient",
+                "Sending reliable data %u bytes.", (uint32_t)data_length);
 
     if (data == NULL) { data_length = 0; }
 
     const size_t peer_length = strlen(peer_name) + 1;
     const size_t buf_length = teoLNullBufferSize(peer_length, data_length);
-    teoLNullCPacket *buf = (teoLNullCPacket *)ccl_malloc(buf_length);
+    // Reserve space for encryption overhead to seal packet in place
+    teoLNullCPacket *buf = (teoLNullCPacket *)ccl_malloc(
+        buf_length + TEOLNULL_ENCRYPTION_MAX_OVERHEAD);
 
     size_t pkg_length = teoLNullPacketCreate(buf, buf_length,
                                              cmd, peer_name, data, data_length);
-    ssize_t snd = _teosockSend(con, true, buf, pkg_length);
+    ssize_t snd = _teoLNullSendManaged(
+        con, true, buf, pkg_length,
+        buf_length + TEOLNULL_ENCRYPTION_MAX_OVERHEAD);
 
     free(buf);
 
@@ -357,8 +756,9 @@ ssize_t teoLNullSend(teoLNullConnectData *con, uint8_t cmd,
 ssize_t teoLNullSendUnreliable(teoLNullConnectData *con, uint8_t cmd,
                                const char *peer_name, const void *data,
                                size_t data_length) {
-    CLTRACK(teocliOpt_DBG_sentPackets, "TeonetClient",
-            "Sending unreliable data %u bytes.", (uint32_t)data_length);
+    TEOCLI_PROBE2(send_unreliable, cmd, data_length);
+    CLTRACK_HOT(teocliOpt_DBG_sentPackets, "TeonetClient",
+                "Sending unreliable data %u bytes.", (uint32_t)data_length);
 
     if (data == NULL) { data_length = 0; }
 
@@ -372,17 +772,26 @@ ssize_t teoLNullSendUnreliable(teoLNullConnectData *con, uint8_t cmd,
 
     // Unreliable packets couldn't be encrypted/decrypted due to it's
     // unreliability - we can't correctly count them and seed encryption algo
-    // with identifier
+    // with identifier. They aren't queued while link is down
+    if (con->reconnect != NULL && !teoLNullReconnectEnter(con->reconnect)) {
+        free(buf);
+        return -1;
+    }
+
     ssize_t snd = 0;
     if (con->tcp_f) {
-        snd = _teosockSend(con, false, buf, pkg_length);
+        snd = _teosockSend(con, false, buf, pkg_length, buf_length);
     } else {
-        snd = trudpUdpSendto(con->td->fd, (const uint8_t *)buf, pkg_length,
-                             (__CONST_SOCKADDR_ARG)&con->tcd->remaddr,
-                             con->tcd->addrlen);
+        snd = _teoLNullUdpSend(con, con->tcd, buf, pkg_length);
 
+        if (snd < 0) {
+            teoLNullStatsCountError(con->stats, STAT_ERROR_SEND);
+        } else {
+            teoLNullStatsCountSent(con->stats, cmd, pkg_length);
+        }
         _teocliCallDataSentCallback(pkg_length);
     }
+    if (con->reconnect != NULL) { teoLNullReconnectLeave(con->reconnect); }
     free(buf);
 
     return snd;
@@ -438,7 +847,8 @@ ssize_t teoLNullSendEcho(teoLNullConnectData *con, const char *peer_name,
         teoLNullPacketCreateEcho(buf, L0_BUFFER_SIZE, peer_name, msg);
 
     // Send message with time
-    ssize_t snd = _teosockSend(con, true, (teoLNullCPacket *)buf, pkg_length);
+    ssize_t snd = _teoLNullSendManaged(con, true, (teoLNullCPacket *)buf,
+                                       pkg_length, sizeof(buf));
 
     return snd;
 }
@@ -522,10 +932,13 @@ void teoLNullPacketUpdateChecksums(teoLNullCPacket *packet) {
  * Check teoLNullCPacket checksums.
  *
  * @param packet Pointer to packet
+ * @param payload_authenticated Packet payload is authenticated by AEAD tag,
+ *  check header checksum only
  *
  * @return true if packet checksums are valid or false otherwise.
  */
-static bool teoLNullPacketChecksumCheck(teoLNullCPacket *packet) {
+static bool teoLNullPacketChecksumCheck(teoLNullCPacket *packet,
+                                        bool payload_authenticated) {
     uint8_t *packet_buffer = (uint8_t *)packet;
     size_t header_size_without_checksum =
         sizeof(teoLNullCPacket) - sizeof(packet->header_checksum);
@@ -535,6 +948,8 @@ static bool teoLNullPacketChecksumCheck(teoLNullCPacket *packet) {
 
     if (packet->header_checksum != header_checksum) { return false; }
 
+    if (payload_authenticated) { return true; }
+
     uint8_t *packet_full_pauload = teoLNullPacketGetFullPayload(packet);
     size_t packet_payload_size = teoLNullPacketGetFullPayloadSize(packet);
 
@@ -546,9 +961,36 @@ static bool teoLNullPacketChecksumCheck(teoLNullCPacket *packet) {
     return true;
 }
 
+static inline uint8_t *_createKEXPayload(teoLNullConnectData *con,
+                                         teoLNullEncryptionProtocol enc_proto,
+                                         size_t *payload_len);
+static inline ssize_t _sendKEXPayload(teoLNullConnectData *con,
+                                      uint8_t *kex_buf, size_t kex_len);
+
+/**
+ * Stores resumption ticket received in encryption context to tickets cache,
+ * must be called with crypto locked
+ */
+static inline void _storeResumptionTicket(teoLNullConnectData *con,
+                                          teoLNullEncryptionContext *crypt) {
+    if (crypt->ticket.ticket_length == 0) { return; }
+
+    if (con->resume_server != NULL) {
+        teoLNullResumptionTicketStore(con->resume_server, con->resume_port,
+                                      &crypt->ticket);
+    }
+    zero_bytes((uint8_t *)&crypt->ticket, sizeof(crypt->ticket));
+}
+
+/**
+ * Applies KEX answer of server
+ *
+ * @param kex_required Set to true if server rejected resumption ticket and
+ * regular key exchange must be sent
+ */
 static inline bool _applyKEXAnswer(teoLNullConnectData *con,
                                    KeyExchangePayload_Common *kex,
-                                   size_t kex_length) {
+                                   size_t kex_length, bool *kex_required) {
     const bool was_connected = (con->status == CON_STATUS_CONNECTED);
     teoLNullEncryptionContext *locked_crypt = teoLNullAcquireCrypto(con);
     if (locked_crypt == NULL) {
@@ -571,8 +1013,17 @@ static inline bool _applyKEXAnswer(teoLNullConnectData *con,
         return false;
     }
 
+    if (locked_crypt->state == SESCRYPT_ESTABLISHED) {
+        _storeResumptionTicket(con, locked_crypt);
+        if (con->capture != NULL) {
+            teoLNullCaptureKeys(con->capture, locked_crypt);
+        }
+    }
+    *kex_required = (locked_crypt->state == SESCRYPT_PENDING);
     teoLNullUnlockCrypto(locked_crypt);
-    if (was_connected) {
+    if (*kex_required) {
+        LTRACK_I("TeonetClient", "Resumption rejected, sending KEX");
+    } else if (was_connected) {
         LTRACK("TeonetClient", "Re-confirmed KEX answer");
     } else {
         LTRACK_I("TeonetClient", "Applied KEX answer");
@@ -589,7 +1040,20 @@ static inline bool _applyKEXAnswer(teoLNullConnectData *con,
 static inline bool _teoLNullProccessKEXAnswer(teoLNullConnectData *con,
                                               KeyExchangePayload_Common *kex, size_t kex_length) {
     const bool was_connected = (con->status == CON_STATUS_CONNECTED);
-    if (_applyKEXAnswer(con, kex, kex_length)) {
+    bool kex_required = false;
+    bool applied = _applyKEXAnswer(con, kex, kex_length, &kex_required);
+    if (applied && kex_required) {
+        // Resumption ticket rejected, regular key exchange of the same context
+        size_t kex_len = 0;
+        uint8_t *kex_buf =
+            _createKEXPayload(con, con->client_crypt->enc_proto, &kex_len);
+        applied = kex_buf != NULL && _sendKEXPayload(con, kex_buf, kex_len) > 0;
+        if (kex_buf != NULL) { free(kex_buf); }
+        if (applied) { return true; }
+        LTRACK_E("TeonetClient", "Failed to send KEX after rejected ticket");
+    }
+
+    if (applied) {
         if (!was_connected) {
             con->status = CON_STATUS_CONNECTED;
             send_l0_event(con, EV_L_CONNECTED, &con->status,
@@ -626,8 +1090,10 @@ static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
                                    size_t data_len, ssize_t received) {
     ssize_t retval = -1;
 
-    CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-            "L0 Client: Got %" PRId32 " bytes of packet...\n", (int)received);
+    TEOCLI_PROBE2(packet_split, received, kld->read_buffer_offset);
+    CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "L0 Client: Got %" PRId32 " bytes of packet...\n",
+                (int)received);
 
     // Check end of previous buffer
     if (kld->last_packet_offset > 0) {
@@ -637,10 +1103,10 @@ static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
 
         if (kld->read_buffer_offset > 0) {
 
-            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                    "L0 Client: Use %" PRId32
-                    " bytes from previously received data...\n",
-                    (int)(kld->read_buffer_offset));
+            CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                        "L0 Client: Use %" PRId32
+                        " bytes from previously received data...\n",
+                        (int)(kld->read_buffer_offset));
 
             memmove(kld->read_buffer,
                     (char *)kld->read_buffer + kld->last_packet_offset,
@@ -660,10 +1126,10 @@ static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
             kld->read_buffer = ccl_malloc(kld->read_buffer_size);
         }
 
-        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "L0 Client: Increase read buffer to new size: %" PRId32
-                " bytes ...\n",
-                (int)kld->read_buffer_size);
+        CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                    "L0 Client: Increase read buffer to new size: %" PRId32
+                    " bytes ...\n",
+                    (int)kld->read_buffer_size);
     }
 
     // Add received data to the read buffer
@@ -671,6 +1137,8 @@ static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
         memmove((char *)kld->read_buffer + kld->read_buffer_offset, data,
                 received);
         kld->read_buffer_offset += received;
+        teoLNullStatsReadBufferUsed(kld->stats, kld->read_buffer_offset,
+                                    kld->read_buffer_size);
     }
 
     teoLNullCPacket *packet = (teoLNullCPacket *)kld->read_buffer;
@@ -684,35 +1152,54 @@ static ssize_t teoLNullPacketSplit(teoLNullConnectData *kld, void *data,
             (size_t)(len = teoLNullBufferSize(packet->peer_name_length,
                                               packet->data_length))) {
 
-        if (teoLNullPacketChecksumCheck(packet)) {
-            // Packet has received - return packet size
-            retval = len;
-            kld->last_packet_offset += len;
+        TRACE_RECV_BEGIN(kld, decrypt);
+        bool decrypted = false;
+        if (teoLNullPacketChecksumCheck(
+                packet, _packetPayloadAuthenticated(kld, packet))) {
+            // Receive half of encryption context is locked inside. Packet
+            // which isn't decrypted without AEAD tag is still delivered as
+            // before, but counted as decrypt error
+            decrypted = teoLNullPacketDecrypt(kld->client_crypt, packet);
+            if (!decrypted) {
+                teoLNullStatsCountError(kld->stats, STAT_ERROR_DECRYPT);
+                decrypted = _encryptionOverhead(kld) == 0;
+            }
+        } else {
+            teoLNullStatsCountError(kld->stats, STAT_ERROR_CHECKSUM);
+        }
+        TRACE_RECV_END(kld, decrypt, STAGE_RECV_DECRYPT);
 
-            teoLNullEncryptionContext *locked_crypt = teoLNullAcquireCrypto(kld);
-            teoLNullPacketDecrypt(locked_crypt, packet);
-            teoLNullUnlockCrypto(locked_crypt);
+        if (decrypted) {
+            // Packet has received - return packet size, AEAD tag is removed
+            // from decrypted packet, so it may be less than received length
+            retval = teoLNullBufferSize(packet->peer_name_length,
+                                        packet->data_length);
+            kld->last_packet_offset += len;
+            TEOCLI_PROBE2(packet_received, retval, packet->cmd);
 
-            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                    "L0 Server: Identify packet %" PRId32 " bytes length ...\n",
-                    (int)retval);
+            CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                        "L0 Server: Identify packet %" PRId32
+                        " bytes length ...\n",
+                        (int)retval);
 
-        } else { // Wrong checksum, wrong packet - drop this packet and return
-                 // -2
+        } else { // Wrong checksum or AEAD tag, wrong packet - drop this packet
+                 // and return -2
             kld->read_buffer_offset = 0;
             kld->last_packet_offset = 0;
             retval = -2;
+            TEOCLI_PROBE1(packet_dropped, len);
 
-            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                    "L0 Client: Wrong packet %" PRId32
-                    " bytes length; dropped ...\n",
-                    (int)len);
+            CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                        "L0 Client: Wrong packet %" PRId32
+                        " bytes length; dropped ...\n",
+                        (int)len);
         }
     } else {
-        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "L0 Client: Wait next part of packet, now it has %" PRId32
-                " bytes ...\n",
-                (int)kld->read_buffer_offset);
+        TEOCLI_PROBE1(packet_partial, kld->read_buffer_offset);
+        CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                    "L0 Client: Wait next part of packet, now it has %" PRId32
+                    " bytes ...\n",
+                    (int)kld->read_buffer_offset);
     }
 
     return retval;
@@ -735,7 +1222,7 @@ static inline bool teoLNullPacketCheck(uint8_t *data, size_t data_len) {
 
     if (data_len != len) { return false; }
 
-    return teoLNullPacketChecksumCheck(packet);
+    return teoLNullPacketChecksumCheck(packet, false);
 }
 
 /**
@@ -768,12 +1255,33 @@ teoLNullCPacket *teoLNullPacketGetFromBuffer(uint8_t *data, size_t data_len) {
 ssize_t teoLNullRecv(teoLNullConnectData *con) {
     uint8_t buf[L0_BUFFER_SIZE];
 
+    TRACE_RECV_BEGIN(con, read);
     ssize_t rc = teosockRecv(con->fd, buf, L0_BUFFER_SIZE);
+    TRACE_RECV_END(con, read, STAGE_RECV_READ);
+    if (rc > 0 && con->capture != NULL) {
+        teoLNullCaptureWrite(con->capture, CAPTURE_TCP_DATA, buf, rc);
+    }
     if (rc != 0) { rc = teoLNullRecvCheck(con, (char*)buf, rc); }
 
     return rc;
 }
 
+/**
+ * Record round trip time of echo answer to teoLNullSendEcho, answers of
+ * other payload layout are skipped
+ */
+static void _recordEchoRtt(teoLNullConnectData *con, teoLNullCPacket *cp) {
+    const char *msg = cp->peer_name + cp->peer_name_length;
+    const size_t msg_len = strnlen(msg, cp->data_length);
+    if (msg_len + 1 + sizeof(int64_t) != cp->data_length) { return; }
+
+    const int64_t trip_time_ms = teoLNullProccessEchoAnswer(msg);
+    if (trip_time_ms >= 0) {
+        teoLNullStatsRecordLatency(con->stats, STAT_LATENCY_ECHO_RTT,
+                                   (uint64_t)trip_time_ms * 1000);
+    }
+}
+
 /**
  * Check received packet
  *
@@ -788,12 +1296,16 @@ ssize_t teoLNullRecv(teoLNullConnectData *con) {
  * @retval -2 Wrong packet received (dropped)
  */
 ssize_t teoLNullRecvCheck(teoLNullConnectData *con, char *buf, ssize_t rc) {
+    TRACE_RECV_BEGIN(con, split);
     rc = teoLNullPacketSplit(con, buf, L0_BUFFER_SIZE, rc != -1 ? rc : 0);
+    TRACE_RECV_END(con, split, STAGE_RECV_SPLIT);
     if (rc <= 0) {
         return rc; // No packet to check
     }
 
     teoLNullCPacket *cp = (teoLNullCPacket *)con->read_buffer;
+    teoLNullStatsCountReceived(con->stats, cp->cmd, rc);
+
     if (cp->cmd == CMD_L_INIT) {
         KeyExchangePayload_Common *kex =
             (KeyExchangePayload_Common *)teoLNullPacketGetPayload(cp);
@@ -805,6 +1317,8 @@ ssize_t teoLNullRecvCheck(teoLNullConnectData *con, char *buf, ssize_t rc) {
         // return 0; // Disconnect
     }
 
+    if (cp->cmd == CMD_L_ECHO_ANSWER) { _recordEchoRtt(con, cp); }
+
     if (cp->cmd == CMD_L_ECHO && con->fd) {
         // Send echo answer to echo command
         char *data = cp->peer_name + cp->peer_name_length;
@@ -815,23 +1329,118 @@ ssize_t teoLNullRecvCheck(teoLNullConnectData *con, char *buf, ssize_t rc) {
     return rc;  // Pass as-is
 }
 
+/**
+ * Get time left to absolute deadline limited to one wait slice
+ *
+ * @param deadline_ms Deadline in teotimeGetCurrentTimeMs() time base
+ *
+ * @return Time to wait in ms, 0 if deadline passed
+ */
+static int _teoLNullWaitSliceMs(int64_t deadline_ms) {
+    const int64_t left_ms = deadline_ms - teotimeGetCurrentTimeMs();
+    if (left_ms <= 0) { return 0; }
+
+    // Select loop gets timeout in uSeconds, keep it far from int overflow
+    return left_ms > WAIT_SLICE_MAX_MS ? WAIT_SLICE_MAX_MS : (int)left_ms;
+}
+
+/**
+ * Put packet captured by teoLNullRecvTimeout back to the read buffer head
+ *
+ * Packets processed after the captured one were moved out of the read buffer,
+ * so restore buffer state as if captured packet is the last one received:
+ * captured packet at offset 0 followed by unprocessed bytes.
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+static void _teoLNullRecvCaptureRestore(teoLNullConnectData *con) {
+    const size_t len = con->recv_capture_len;
+    const size_t tail = con->read_buffer_offset - con->last_packet_offset;
+
+    if (len + tail > con->read_buffer_size) {
+        con->read_buffer_size = len + tail;
+        con->read_buffer = ccl_realloc(con->read_buffer, con->read_buffer_size);
+    }
+
+    memmove((char *)con->read_buffer + len,
+            (char *)con->read_buffer + con->last_packet_offset, tail);
+    memcpy(con->read_buffer, con->recv_capture, len);
+
+    con->last_packet_offset = len;
+    con->read_buffer_offset = len + tail;
+}
+
+/**
+ * Receive data from TR-UDP connection during timeout
+ *
+ * Runs select loop until first L0 packet assembled, the packet is returned in
+ * read buffer like teoLNullRecv do. Other packets received in the same loop
+ * iteration are sent to event callback.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param deadline_ms Absolute deadline in teotimeGetCurrentTimeMs() time base
+ *
+ * @return Number of received bytes, 0 if disconnected or -1 at timeout
+ */
+static ssize_t _teoLNullRecvTimeoutTrudp(teoLNullConnectData *con,
+                                         int64_t deadline_ms) {
+    ssize_t rc = -1;
+
+    con->recv_capture_f = 1;
+    for (;;) {
+        if (!teoLNullReadEventLoop(con, _teoLNullWaitSliceMs(deadline_ms))) {
+            rc = 0;
+            break;
+        }
+        if (con->recv_capture != NULL ||
+            teotimeGetCurrentTimeMs() >= deadline_ms) {
+            break;
+        }
+    }
+    con->recv_capture_f = 0;
+
+    if (con->recv_capture != NULL) {
+        _teoLNullRecvCaptureRestore(con);
+        rc = con->recv_capture_len;
+
+        free(con->recv_capture);
+        con->recv_capture = NULL;
+        con->recv_capture_len = 0;
+    }
+
+    return rc;
+}
+
 /**
  * Receive data from L0 server during timeout
  *
+ * Waits for socket readiness and returns as soon as packet assembled.
+ *
  * @param con Pointer to teoLNullConnectData
- * @param timeout Timeout in uSeconds
+ * @param timeout Timeout in ms
  *
- * @return Number of received bytes or -1 at timeout
+ * @return Number of received bytes, 0 if disconnected or -1 at timeout
  */
 ssize_t teoLNullRecvTimeout(teoLNullConnectData *con, uint32_t timeout) {
+    const int64_t deadline_ms = teotimeGetCurrentTimeMs() + timeout;
+
+    if (!con->tcp_f) { return _teoLNullRecvTimeoutTrudp(con, deadline_ms); }
+
+    // Receive answer from server, CMD_L_L0_CLIENTS_ANSWER. Packets already
+    // buffered are returned before socket is checked for readiness
     ssize_t rc;
-    uint32_t t = 0;
-    const uint32_t wait = 50;
+    while ((rc = teoLNullRecv(con)) == -1) {
+        const int wait_ms = _teoLNullWaitSliceMs(deadline_ms);
+        if (wait_ms == 0) { break; }
 
-    // Receive answer from server, CMD_L_L0_CLIENTS_ANSWER
-    while ((rc = teoLNullRecv(con)) == -1 && t < timeout) {
-        teoLNullSleep(wait);
-        t += wait;
+        int rv = teosockSelect(con->fd, TEOSOCK_SELECT_MODE_READ, wait_ms);
+        if (rv == TEOSOCK_SELECT_ERROR && errno != EINTR) {
+            int error = errno;
+            LTRACK_E("TeonetClient",
+                     "select(fd = %" PRId32 ") handle error %" PRId32 ": %s",
+                     (int)con->fd, error, strerror(error));
+            break;
+        }
     }
 
     return rc;
@@ -864,11 +1473,17 @@ size_t teoLNullPacketCreateLogin(void *buffer,
  * @return Length of send data or -1 at error
  */
 ssize_t teoLNullLogin(teoLNullConnectData *con, const char *host_name) {
+    if (con->reconnect != NULL) {
+        teoLNullReconnectSetLogin(con->reconnect, host_name);
+    }
+
     const size_t buf_len = teoLNullBufferSize(1, strlen(host_name) + 1);
-    teoLNullCPacket *buf = (teoLNullCPacket *)ccl_malloc(buf_len);
+    teoLNullCPacket *buf = (teoLNullCPacket *)ccl_malloc(
+        buf_len + TEOLNULL_ENCRYPTION_MAX_OVERHEAD);
 
     size_t pkg_length = teoLNullPacketCreateLogin(buf, buf_len, host_name);
-    ssize_t snd = _teosockSend(con, true, buf, pkg_length);
+    ssize_t snd = _teosockSend(con, true, buf, pkg_length,
+                               buf_len + TEOLNULL_ENCRYPTION_MAX_OVERHEAD);
 
     free(buf);
     return snd;
@@ -915,6 +1530,24 @@ uint8_t *teoLNullPacketGetPayload(teoLNullCPacket *packet) {
 #define SELECT_RESULT_ERROR -1
 #endif
 
+/**
+ * Write sealed packet to TR-UDP channel, called by event loop thread only
+ */
+static void _teoLNullTrudpWrite(teoLNullConnectData *con,
+                                teoLNullCPacket *packet) {
+    // Encryption may append authentication tag
+    uint8_t *ptr = (uint8_t *)packet;
+    size_t length =
+        teoLNullBufferSize(packet->peer_name_length, packet->data_length);
+    for (;;) {
+        size_t len = length > 512 ? 512 : length;
+        trudpChannelSendData(con->tcd, ptr, len);
+        length -= len;
+        if (!length) break;
+        ptr += len;
+    }
+}
+
 /**
  * The TR-UDP cat network loop with select function
  *
@@ -927,7 +1560,8 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
 
     teosockSelectResult retval;
 
-    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient", "Entered select loop.");
+    CLTRACK_HOT(teocliOpt_DBG_selectLoop, "TeonetClient",
+                "Entered select loop.");
 
 #if !defined(_WIN32)
     // Watch server_socket to see when it has input.
@@ -952,7 +1586,11 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
     struct timeval tv;
     usecToTv(&tv, t);
 
+    TEOCLI_PROBE1(select_enter, t);
+    TRACE_RECV_BEGIN(con, wait);
     int select_result = select(nfds + 1, &rfds, NULL, NULL, &tv);
+    TEOCLI_PROBE1(select_exit, select_result);
+    if (select_result > 0) { TRACE_RECV_END(con, wait, STAGE_RECV_WAIT); }
 #endif
 
     // Error
@@ -963,8 +1601,8 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
         int select_errno = errno;
 
         if (select_errno == EINTR) {
-            CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                    "Exiting select loop by interrupt signal.");
+            CLTRACK_HOT(teocliOpt_DBG_selectLoop, "TeonetClient",
+                        "Exiting select loop by interrupt signal.");
         } else {
             const size_t buffer_size = 512;
             char error_text_buffer[buffer_size];
@@ -989,8 +1627,8 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
         // \TODO: need information
         retval = TEOSOCK_SELECT_TIMEOUT;
 
-        CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                "Exiting select by timeout.");
+        CLTRACK_HOT(teocliOpt_DBG_selectLoop, "TeonetClient",
+                    "Exiting select by timeout.");
     } else { // There is a data in fd
              // Process read fd
 #if defined(_WIN32)
@@ -1010,21 +1648,35 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
                 size_t recvlen = 0;
                 int error_code = 0;
 
+                TRACE_RECV_BEGIN(con, read);
                 teosockRecvfromResult recvfrom_result =
-                    trudpUdpRecvfrom(td->fd, buffer, BUFFER_SIZE,
+                    con->transport != NULL
+                        ? _teoLNullTransportRecv(con, buffer, BUFFER_SIZE,
+                                                 &recvlen, &error_code)
+                        : trudpUdpRecvfrom(td->fd, buffer, BUFFER_SIZE,
                                      (__SOCKADDR_ARG)&remaddr, &addr_len, &recvlen, &error_code);
+                TRACE_RECV_END(con, read, STAGE_RECV_READ);
                 // Process received packet
                 if (recvfrom_result == TEOSOCK_RECVFROM_DATA_RECEIVED) {
+                    if (con->capture != NULL) {
+                        teoLNullCaptureWrite(con->capture, CAPTURE_UDP_DATAGRAM,
+                                             buffer, recvlen);
+                    }
+                    // Datagram transport carries server channel only
                     trudpChannelData *tcd =
-                        trudpGetChannelCreate(td, (__SOCKADDR_ARG)&remaddr, addr_len, 0);
+                        con->transport != NULL
+                            ? con->tcd
+                            : trudpGetChannelCreate(td, (__SOCKADDR_ARG)&remaddr, addr_len, 0);
+                    TRACE_RECV_BEGIN(con, process);
                     trudpChannelProcessReceivedPacket(tcd, buffer, recvlen);
+                    TRACE_RECV_END(con, process, STAGE_RECV_TRUDP);
                 } else if (recvfrom_result == TEOSOCK_RECVFROM_ORDERLY_CLOSED) {
                     // TODO: In UDP it's possible to receive 0 bytes message.
                     LTRACK_E("TeonetClient", "Receiving data using recvfrom() returned 0 (connection closed).");
                 } else if (recvfrom_result == TEOSOCK_RECVFROM_TRY_AGAIN) {
 #if defined(_WIN32)
-                    CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                            "Resetting socket receive state.");
+                    CLTRACK_HOT(teocliOpt_DBG_selectLoop, "TeonetClient",
+                                "Resetting socket receive state.");
 
                     WSANETWORKEVENTS network_events;
                     memset(&network_events, 0, sizeof(network_events));
@@ -1053,8 +1705,8 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
 #else
         if (FD_ISSET(con->pipefd[0], &rfds)) {
 #endif
-            CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                    "Checking sent data on pipe.");
+            CLTRACK_HOT(teocliOpt_DBG_selectLoop, "TeonetClient",
+                        "Checking sent data on pipe.");
 
             teoPipeSendData pipe_send_data;
             memset(&pipe_send_data, 0, sizeof(pipe_send_data));
@@ -1082,26 +1734,30 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
                     abort();
                 }
 
-                CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                        "Received message %u bytes from pipe.",
-                        (uint32_t)pipe_send_data.packet_length);
-
-                teoLNullEncryptionContext *locked_crypt = teoLNullAcquireCrypto(con);
-                teoLNullPacketSeal(locked_crypt,
-                                   pipe_send_data.with_encryption,
-                                   pipe_send_data.packet);
-                teoLNullUnlockCrypto(locked_crypt);
-
-                uint8_t *ptr = (uint8_t *)pipe_send_data.packet;
-                size_t length = pipe_send_data.packet_length;
-                for (;;) {
-                    size_t len = length > 512 ? 512 : length;
-                    trudpChannelSendData(con->tcd, ptr, len);
-                    length -= len;
-                    if (!length) break;
-                    ptr += len;
+                TEOCLI_PROBE2(pipe_send, pipe_send_data.packet_length,
+                              pipe_send_data.queued_us);
+                CLTRACK_HOT(teocliOpt_DBG_selectLoop, "TeonetClient",
+                            "Received message %u bytes from pipe.",
+                            (uint32_t)pipe_send_data.packet_length);
+
+                TRACE_SEND_RESTORE(trace, pipe_send_data.trace_ns);
+                TRACE_SEND_STAGE(con, trace, STAGE_SEND_PIPE);
+
+                // Pipe is drained by this thread only, nonces are in order.
+                // Size was checked by sender, buffer has room for overhead
+                if (teoLNullPacketSealBuffer(
+                        con->client_crypt, pipe_send_data.with_encryption,
+                        pipe_send_data.packet,
+                        pipe_send_data.packet_length +
+                            _encryptionOverhead(con))) {
+                    TRACE_SEND_STAGE(con, trace, STAGE_SEND_SEAL);
+                    _teoLNullTrudpWrite(con, pipe_send_data.packet);
+                    TRACE_SEND_STAGE(con, trace, STAGE_SEND_WRITE);
                 }
                 free(pipe_send_data.packet);
+                teoLNullStatsRecordLatency(
+                    con->stats, STAT_LATENCY_SEND,
+                    teoGetTimestampFull() - pipe_send_data.queued_us);
 
 #if defined(_WIN32)
                 SetEvent(con->handles[1]);
@@ -1117,56 +1773,302 @@ static teosockSelectResult trudpNetworkSelectLoop(teoLNullConnectData *con,
     }
 
     if (select_result != SELECT_RESULT_ERROR && timeout_sq != UINT32_MAX) {
-        CLTRACK(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
-                "Processing send queue.");
+        CLTRACK_HOT(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
+                    "Processing send queue.");
         int process_queue_result = trudpProcessSendQueue(td, 0);
-        CLTRACK(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
-                "Send queue processing finished with result %d.",
-                process_queue_result);
+        TEOCLI_PROBE1(send_queue, process_queue_result);
+        CLTRACK_HOT(DEBUG || teocliOpt_DBG_selectLoop, "TeonetClient",
+                    "Send queue processing finished with result %d.",
+                    process_queue_result);
     } else {
-        CLTRACK(teocliOpt_DBG_selectLoop, "TeonetClient",
-                "Skipping processing send queue.");
+        CLTRACK_HOT(teocliOpt_DBG_selectLoop, "TeonetClient",
+                    "Skipping processing send queue.");
     }
 
     return retval;
 }
 
 /**
- * Wait socket data during timeout and call callback if data received
+ * Get tickless event loop wait time
+ *
+ * The loop wakes up at the user deadline or at the keepalive deadline,
+ * whichever comes first. TR-UDP retransmit deadline is applied in select loop.
  *
  * @param con Pointer to teoLNullConnectData
- * @param timeout Timeout of wait socket read event in ms
+ * @param timeout User timeout in ms, negative if there is no user deadline
+ * @param user_deadline_f [out] true if the user deadline is the nearest one
  *
- * @return 0 - if disconnected or 1 other way
+ * @return Time to wait in ms
  */
-bool teoLNullReadEventLoop(teoLNullConnectData *con, int timeout) {
-    bool can_continue = true;
-    int rv;
+static int _teoLNullTicklessWaitMs(teoLNullConnectData *con, int timeout,
+                                   bool *user_deadline_f) {
+    int64_t wait_ms = TICKLESS_MAX_SLEEP_MS;
+    *user_deadline_f = false;
 
-    if (con->tcp_f) {
-        rv = teosockSelect(con->fd, TEOSOCK_SELECT_MODE_READ, timeout);
-    } else {
-        rv = trudpNetworkSelectLoop(con, timeout * 1000);
+    if (!con->tcp_f) {
+        const int64_t keepalive_left_ms = con->keepalive_ms +
+                                          teocliOpt_KeepaliveIntervalMs -
+                                          teotimeGetCurrentTimeMs();
+        wait_ms = keepalive_left_ms > 0 ? keepalive_left_ms : 0;
     }
 
-    if (rv == TEOSOCK_SELECT_ERROR) {
-        int error = errno;
-        if (error != EINTR) {
-            LTRACK_E("TeonetClient",
-                   "select(fd = %" PRId32 ") handle error %" PRId32 ": %s",
-                   (int)con->fd, error, strerror(error));
-        }
-    } else if (rv == TEOSOCK_SELECT_TIMEOUT) { // Idle or Timeout event
-        send_l0_event(con, EV_L_IDLE, NULL, 0);
-        if (!con->tcp_f) { trudpProcessKeepConnection(con->td); }
-    } else { // There is a data in sd. We should send TCP-data to event-loop,
-             // UDP-data has been send in trudp-eventloop
-        if (con->tcp_f) {
+    if (timeout >= 0 && timeout <= wait_ms) {
+        wait_ms = timeout;
+        *user_deadline_f = true;
+    }
 
-            ssize_t rc;
-            while ((rc = teoLNullRecv(con)) != -1) {
+    return (int)wait_ms;
+}
+
+/**
+ * Process TR-UDP keepalive in tickless event loop
+ *
+ * Keepalive is processed when its interval elapsed. If the loop is already
+ * awake for I/O and keepalive is due within half of interval, it is processed
+ * now to coalesce ping with data and save separate wakeup.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param io_f true if the loop was woken up by I/O
+ */
+static void _teoLNullTicklessKeepConnection(teoLNullConnectData *con,
+                                            bool io_f) {
+    const int64_t now_ms = teotimeGetCurrentTimeMs();
+    int64_t due_ms = con->keepalive_ms + teocliOpt_KeepaliveIntervalMs;
+    if (io_f) { due_ms -= teocliOpt_KeepaliveIntervalMs / 2; }
+
+    if (now_ms >= due_ms) {
+        trudpProcessKeepConnection(con->td);
+        con->keepalive_ms = now_ms;
+    }
+}
+
+/**
+ * Get event loop wakeup statistic
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param stats [out] Wakeup statistic
+ */
+void teoLNullGetWakeupStats(teoLNullConnectData *con,
+                            teoLNullWakeupStats *stats) {
+    stats->wakeups = con->wakeups;
+    stats->idle_wakeups = con->idle_wakeups;
+    stats->elapsed_ms = teotimeGetTimePassedMs(con->wakeups_since_ms);
+    stats->idle_wakeups_per_second =
+        stats->elapsed_ms > 0
+            ? (double)con->idle_wakeups * 1000.0 / (double)stats->elapsed_ms
+            : 0.0;
+}
+
+/**
+ * Get connection statistic
+ *
+ * May be called by any thread while connection is used. Counters are read
+ * without locking, TR-UDP values are copied from channel by event loop thread
+ * once per teoLNullReadEventLoop call, so they are approximate.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param stats [out] Connection statistic
+ */
+void teoLNullGetStats(teoLNullConnectData *con, teoLNullStats *stats) {
+    memset(stats, 0, sizeof(teoLNullStats));
+    if (con->stats != NULL) { teoLNullStatsRead(con->stats, stats); }
+
+    // Read buffer and TR-UDP channel values are copied to counters by event
+    // loop thread, see _teoLNullStatsStoreTrudp
+    if (con->recv_ring != NULL) {
+        stats->recv_ring_used = teoLNullRecvRingUsed(con->recv_ring);
+    }
+    if (con->reconnect != NULL) {
+        stats->reconnect_queue = teoLNullReconnectQueueUsed(con->reconnect);
+    }
+}
+
+/**
+ * Copy TR-UDP channel values of teoLNullStats to counters, called by event
+ * loop thread which owns the channel once per iteration
+ */
+static void _teoLNullStatsStoreTrudp(teoLNullConnectData *con) {
+    if (con->tcp_f) { return; }
+
+    // Channels are destroyed at disconnect
+    if (con->tcd == NULL || con->status != CON_STATUS_CONNECTED) {
+        teoLNullStatsStoreTrudp(con->stats, NULL);
+        return;
+    }
+
+    trudpChannelData *tcd = con->tcd;
+    teoLNullStatTrudp trudp;
+    trudp.retransmits = tcd->stat.packets_attempt;
+    trudp.triptime = tcd->triptime;
+    trudp.triptime_middle = tcd->triptimeMiddle;
+    trudp.send_queue = trudpSendQueueSize(tcd->sendQueue);
+    trudp.write_queue = trudpGetWriteQueueSize(con->td);
+    teoLNullStatsStoreTrudp(con->stats, &trudp);
+}
+
+/**
+ * Get per stage latency statistic of connection
+ *
+ * Stages are measured in sampled event loop iterations and send calls, see
+ * teoLNUllSetOption_LatencySampleRate. Histograms are read without stopping
+ * event loop and senders.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param stats [out] Stage statistic, zeroed if tracing is off
+ *
+ * @return false if library is built without TEOCLI_LATENCY_TRACE or tracing
+ *  is disabled for connection
+ */
+bool teoLNullGetStageStats(teoLNullConnectData *con,
+                           teoLNullStageStats *stats) {
+    memset(stats, 0, sizeof(teoLNullStageStats));
+    if (con->trace == NULL) { return false; }
+
+    teoLNullTraceRead(con->trace, stats);
+    return true;
+}
+
+/**
+ * Get name of latency tracing stage
+ *
+ * @param stage Stage
+ *
+ * @return Stage name, e.g. "recv_decrypt"
+ */
+const char *teoLNullStageName(teoLNullStage stage) {
+    switch (stage) {
+    case STAGE_RECV_WAIT: return "recv_wait";
+    case STAGE_RECV_READ: return "recv_read";
+    case STAGE_RECV_TRUDP: return "recv_trudp";
+    case STAGE_RECV_SPLIT: return "recv_split";
+    case STAGE_RECV_DECRYPT: return "recv_decrypt";
+    case STAGE_RECV_CALLBACK: return "recv_callback";
+    case STAGE_SEND_PIPE: return "send_pipe";
+    case STAGE_SEND_SEAL: return "send_seal";
+    case STAGE_SEND_ORDER: return "send_order";
+    case STAGE_SEND_WRITE: return "send_write";
+    case STAGE_SEND_ACK: return "send_ack";
+    default: return "unknown";
+    }
+}
+
+/**
+ * Enable delivery of received packets through receive ring
+ *
+ * Received packets are no longer sent to event callbacks, they are copied to
+ * the ring by the event loop thread and taken by other thread with
+ * teoLNullPoll. Event loop waits for free space when the ring is full. Must be
+ * called before event loop is started in other thread.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param size_bytes Ring size in bytes, smaller size is enlarged to hold the
+ *  largest L0 packet (about 64 KiB)
+ *
+ * @return true if ring is enabled
+ */
+bool teoLNullEnableRecvRing(teoLNullConnectData *con, size_t size_bytes) {
+    if (con->recv_ring != NULL) { return true; }
+
+    con->recv_ring = teoLNullRecvRingCreate(size_bytes);
+    return con->recv_ring != NULL;
+}
+
+/**
+ * Get received packets from receive ring
+ *
+ * Returned views point into the ring and are valid until released by
+ * teoLNullPollRelease. Must be called from one thread which is not the event
+ * loop thread.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param out [out] Array of packet views
+ * @param max @a out array size
+ * @param timeout Time to wait for first packet in ms, 0 - don't wait,
+ *                negative - wait infinitely
+ *
+ * @return Number of received packets or -1 if receive ring isn't enabled
+ */
+ssize_t teoLNullPoll(teoLNullConnectData *con, teoLNullPacketView *out,
+                     size_t max, int timeout) {
+    if (con->recv_ring == NULL) { return -1; }
+
+    return (ssize_t)teoLNullRecvRingPoll(con->recv_ring, out, max, timeout);
+}
+
+/**
+ * Release oldest packets returned by teoLNullPoll
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param count Number of packets to release
+ */
+void teoLNullPollRelease(teoLNullConnectData *con, size_t count) {
+    if (con->recv_ring == NULL) { return; }
+
+    teoLNullRecvRingRelease(con->recv_ring, count);
+}
+
+/**
+ * Wait socket data during timeout and call callback if data received
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param timeout Timeout of wait socket read event in ms, in tickless mode
+ *                negative value means wait until next event or deadline
+ *
+ * @return 0 - if disconnected or 1 other way
+ */
+bool teoLNullReadEventLoop(teoLNullConnectData *con, int timeout) {
+    bool can_continue = true;
+    const bool tickless = teocliOpt_TicklessIdle;
+    bool user_deadline_f = true;
+    int rv;
+
+    // Managed connection which link is down waits for reconnect attempt
+    if (con->reconnect != NULL && !con->reconnect->attempting &&
+        teoLNullReconnectIsDown(con->reconnect)) {
+        return _teoLNullReconnectWait(con, timeout);
+    }
+
+    if (tickless) {
+        timeout = _teoLNullTicklessWaitMs(con, timeout, &user_deadline_f);
+    }
+
+    con->event_batch_f = (con->event_batch_cb != NULL);
+    TRACE_RECV_SAMPLE(con);
+
+    if (con->tcp_f) {
+        TRACE_RECV_BEGIN(con, wait);
+        rv = teosockSelect(con->fd, TEOSOCK_SELECT_MODE_READ, timeout);
+        if (rv == TEOSOCK_SELECT_READY) {
+            TRACE_RECV_END(con, wait, STAGE_RECV_WAIT);
+        }
+    } else {
+        rv = trudpNetworkSelectLoop(con, timeout * 1000);
+    }
+
+    con->wakeups++;
+    if (rv == TEOSOCK_SELECT_TIMEOUT) { con->idle_wakeups++; }
+
+    if (rv == TEOSOCK_SELECT_ERROR) {
+        int error = errno;
+        if (error != EINTR) {
+            LTRACK_E("TeonetClient",
+                   "select(fd = %" PRId32 ") handle error %" PRId32 ": %s",
+                   (int)con->fd, error, strerror(error));
+        }
+    } else if (rv == TEOSOCK_SELECT_TIMEOUT) { // Idle or Timeout event
+        // In tickless mode internal deadlines are not reported as idle
+        if (user_deadline_f) { send_l0_event(con, EV_L_IDLE, NULL, 0); }
+        if (!con->tcp_f && !tickless) { trudpProcessKeepConnection(con->td); }
+    } else { // There is a data in sd. We should send TCP-data to event-loop,
+             // UDP-data has been send in trudp-eventloop
+        if (con->tcp_f) {
+
+            ssize_t rc;
+            while ((rc = teoLNullRecv(con)) != -1) {
                 if (rc > 0) {
+                    TRACE_RECV_BEGIN(con, callback);
                     send_l0_event(con, EV_L_RECEIVED, con->read_buffer, rc);
+                    TRACE_RECV_END(con, callback, STAGE_RECV_CALLBACK);
 
                     _teocliCallDataReceivedCallback(rc);
                 } else if (rc == 0) {
@@ -1203,8 +2105,32 @@ bool teoLNullReadEventLoop(teoLNullConnectData *con, int timeout) {
                 can_continue = false;
             }
         }
+
+        if (tickless && can_continue) {
+            _teoLNullTicklessKeepConnection(con, rv == TEOSOCK_SELECT_READY);
+        }
+    }
+    if (!tickless || teocliOpt_TickEvent) {
+        send_l0_event(con, EV_L_TICK, NULL, 0);
+    }
+
+    if (con->event_batch_f) { _teoLNullEventBatchFlush(con); }
+
+    // Prepare keystream for next packets after events are processed
+    if (teocliOpt_KeystreamCacheBytes != 0 && can_continue) {
+        if (con->client_crypt != NULL) {
+            teoLNullEncryptionContextPrecompute(con->client_crypt,
+                                                KEYSTREAM_PRECOMPUTE_MAX_BYTES);
+        }
     }
-    send_l0_event(con, EV_L_TICK, NULL, 0);
+
+    // Managed connection reconnects instead of stopping the loop
+    if (con->status != CON_STATUS_CONNECTED &&
+        _teoLNullReconnectLinkDown(con)) {
+        can_continue = true;
+    }
+
+    _teoLNullStatsStoreTrudp(con);
 
     return can_continue;
 }
@@ -1220,7 +2146,22 @@ _setupEncryptionContext(teoLNullConnectData *con,
     size_t crypt_size = teoLNullEncryptionContextSize(enc_proto);
     if (crypt_size == 0) { return false; }
 
-    con->client_crypt = (teoLNullEncryptionContext *)ccl_malloc(crypt_size);
+    // Reconnect creates context of new session in memory of previous one
+    if (con->client_crypt != NULL) {
+        const bool same_size =
+            teoLNullEncryptionContextSize(con->client_crypt->enc_proto) ==
+            crypt_size;
+        teoLNullEncryptionContextDestroy(con->client_crypt);
+        if (!same_size) {
+            free(con->client_crypt);
+            con->client_crypt = NULL;
+        }
+    }
+
+    if (con->client_crypt == NULL) {
+        con->client_crypt =
+            (teoLNullEncryptionContext *)ccl_malloc(crypt_size);
+    }
     size_t result = teoLNullEncryptionContextCreate(
         enc_proto, (uint8_t *)con->client_crypt, crypt_size);
     if (result == 0) { return false; }
@@ -1250,6 +2191,70 @@ static inline uint8_t *_createKEXPayload(teoLNullConnectData *con,
     return kex_buf;
 }
 
+/**
+ * Creates session resumption payload if resumption is enabled and tickets
+ * cache has ticket of the server
+ *
+ * @return payload to be sent instead of KEX or NULL
+ */
+static inline uint8_t *_createResumePayload(teoLNullConnectData *con,
+                                            teoLNullEncryptionProtocol enc_proto,
+                                            size_t *payload_len) {
+    teoLNullResumptionTicket ticket;
+    if (con->resume_server == NULL ||
+        !teoLNullResumptionTicketTake(con->resume_server, con->resume_port,
+                                      enc_proto, &ticket)) {
+        return NULL;
+    }
+
+    uint8_t *kex_buf = (uint8_t *)ccl_malloc(TEOLNULL_KEX_RESUME_MAX_SIZE);
+    teoLNullEncryptionContext *locked_crypt = teoLNullAcquireCrypto(con);
+    size_t result = teoLNullKEXCreateResume(locked_crypt, &ticket, kex_buf,
+                                            TEOLNULL_KEX_RESUME_MAX_SIZE);
+    teoLNullUnlockCrypto(locked_crypt);
+    zero_bytes((uint8_t *)&ticket, sizeof(ticket));
+    if (result == 0) {
+        free(kex_buf);
+        return NULL;
+    }
+
+    CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
+              "Resuming session with ticket");
+    (*payload_len) = result;
+    return kex_buf;
+}
+
+/**
+ * Wraps key exchange payload to CMD_L_INIT packet and sends it unencrypted
+ *
+ * @return result of _teosockSend
+ */
+static inline ssize_t _sendKEXPayload(teoLNullConnectData *con,
+                                      uint8_t *kex_buf, size_t kex_len) {
+    const size_t packet_buf_len = teoLNullBufferSize(1, kex_len);
+    teoLNullCPacket *packet = (teoLNullCPacket *)ccl_malloc(packet_buf_len);
+
+    const size_t packet_len = teoLNullPacketCreate(
+        packet, packet_buf_len, CMD_L_INIT, "", kex_buf, kex_len);
+
+    ssize_t send_result =
+        _teosockSend(con, false, packet, packet_len, packet_len);
+
+    free(packet);
+    return send_result;
+}
+
+/**
+ * Close socket of connection failed to initiate, managed TR-UDP connection
+ * keeps its socket for next reconnect attempt
+ */
+static void _teoLNullConnectionAbort(teoLNullConnectData *con) {
+    if (con->reconnect != NULL && !con->tcp_f) { return; }
+
+    teosockClose(con->fd);
+    con->fd = -1;
+}
+
 /**
  * Performs connection handshake if required
  * TCP connection without encryption considered established instantly
@@ -1289,8 +2294,7 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
                      (int)enc_proto);
 
             con->status = CON_STATUS_ENCRYPTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
+            _teoLNullConnectionAbort(con);
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
             return con;
@@ -1298,9 +2302,12 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
 
         // Prepare and send key exchange packet to establish encryption
 
-        // Create key exchange payload
+        // Create session resumption or key exchange payload
         size_t kex_len = 0;
-        uint8_t *kex_buf = _createKEXPayload(con, enc_proto, &kex_len);
+        uint8_t *kex_buf = _createResumePayload(con, enc_proto, &kex_len);
+        if (kex_buf == NULL) {
+            kex_buf = _createKEXPayload(con, enc_proto, &kex_len);
+        }
         if (kex_buf == NULL) {
             const char *proto_name =
                 STRING_teoLNullEncryptionProtocol(enc_proto);
@@ -1308,25 +2315,14 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
                      proto_name, (int)enc_proto);
 
             con->status = CON_STATUS_ENCRYPTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
+            _teoLNullConnectionAbort(con);
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
             return con;
         }
 
-        // Wrap it via teoLNullCPacket
-        const size_t packet_buf_len = teoLNullBufferSize(1, kex_len);
-        teoLNullCPacket *packet = (teoLNullCPacket *)ccl_malloc(packet_buf_len);
-
-        const size_t packet_len =
-            teoLNullPacketCreate(packet, packet_buf_len,
-                                 CMD_L_INIT, "", kex_buf, kex_len);
-
-        // Send packet, unencrypted
-        ssize_t send_result = _teosockSend(con, false, packet, packet_len);
-
-        free(packet);
+        // Wrap it via teoLNullCPacket and send, unencrypted
+        ssize_t send_result = _sendKEXPayload(con, kex_buf, kex_len);
         free(kex_buf);
 
         if (send_result <= 0) {
@@ -1334,39 +2330,50 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
                      (int)send_result);
 
             con->status = CON_STATUS_ENCRYPTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
+            _teoLNullConnectionAbort(con);
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
             return con;
         }
     }
 
-    int64_t connect_start_time_ms = teotimeGetCurrentTimeMs();
+    const int64_t connect_deadline_ms =
+        teotimeGetCurrentTimeMs() + teocliOpt_ConnectTimeoutMs;
+    int idle_wakeups = 0;
     while (con->status == CON_STATUS_NOT_CONNECTED) {
-        bool can_continue = teoLNullReadEventLoop(con, 50);
+        const int64_t wait_start_time_ms = teotimeGetCurrentTimeMs();
+        bool can_continue = teoLNullReadEventLoop(
+            con, _teoLNullWaitSliceMs(connect_deadline_ms));
         if (!can_continue) {
             CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
                       "connection event loop stopped");
             break;
         }
-        const int64_t connection_time_ms =
-            teotimeGetTimePassedMs(connect_start_time_ms);
-        if (connection_time_ms > teocliOpt_ConnectTimeoutMs) {
+        if (con->status != CON_STATUS_NOT_CONNECTED) { break; }
+
+        if (teotimeGetCurrentTimeMs() >= connect_deadline_ms) {
 
             CLTRACK_I(teocliOpt_DBG_packetFlow, "TeonetClient",
                       "connection timed out");
             con->status = CON_STATUS_CONNECTION_ERROR;
-            teosockClose(con->fd);
-            con->fd = -1;
+            _teoLNullConnectionAbort(con);
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
             return con;
         }
-        // In case of network some error teoLNullReadEventLoop returns immediately
-        // and here we sleep for short time to avoid CPU burnout
-        // It's not such critical during connect
-        teoLNullSleep(50);
+        // In case of network some error teoLNullReadEventLoop returns
+        // immediately, sleep with growing interval to avoid CPU burnout.
+        // Regular wakeups (pipe drain, TR-UDP resend) don't repeat instantly
+        if (teotimeGetTimePassedMs(wait_start_time_ms) == 0) {
+            if (++idle_wakeups > 2) {
+                const int backoff_ms = idle_wakeups < WAIT_BACKOFF_MAX_MS
+                                           ? idle_wakeups
+                                           : WAIT_BACKOFF_MAX_MS;
+                teoLNullSleep(backoff_ms);
+            }
+        } else {
+            idle_wakeups = 0;
+        }
     }
 
     if (con->status != CON_STATUS_CONNECTED) {
@@ -1374,8 +2381,7 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
                   "Connection canceled by status %s (%d)",
                   STRING_teoLNullConnectionStatus(con->status),
                   (int)con->status);
-        teosockClose(con->fd);
-        con->fd = -1;
+        _teoLNullConnectionAbort(con);
         return con;
     }
 
@@ -1384,24 +2390,14 @@ _teoLNullConnectionInitiate(teoLNullConnectData *con,
 }
 
 /**
- * Create TCP client and connect to server with event callback
- *
- * @param server Server IP or name
- * @param port Server port
- * @param event_cb Pointer to event callback function
- * @param user_data Pointer to user data which will be send to event callback
+ * Allocate connection data in not connected state without socket
  *
- * @return Pointer to teoLNullConnectData. Null if no memory error
- * @retval teoLNullConnectData::status== 1 - Success connection
- * @retval teoLNullConnectData::status==-1 - Create socket error
- * @retval teoLNullConnectData::status==-2 - HOST NOT FOUND error
- * @retval teoLNullConnectData::status==-3 - Client-connect() error
- * @retval teoLNullConnectData::status==-4 - Pipe creation error
+ * @param server Server of resumption tickets or NULL
  */
-teoLNullConnectData *teoLNullConnectE(const char *server, uint16_t port,
-                                      teoLNullEventsCb event_cb,
-                                      void *user_data,
-                                      PROTOCOL connection_flag) {
+static teoLNullConnectData *
+_teoLNullConnectDataCreate(const char *server, uint16_t port,
+                           teoLNullEventsCb event_cb, void *user_data,
+                           PROTOCOL connection_flag) {
     teoLNullConnectData *con =
         (teoLNullConnectData *)ccl_malloc(sizeof(teoLNullConnectData));
     if (con == NULL) {
@@ -1409,19 +2405,49 @@ teoLNullConnectData *teoLNullConnectE(const char *server, uint16_t port,
         abort();
     }
 
+    con->fd = -1;
     con->last_packet_offset = 0;
     con->read_buffer = NULL;
     con->read_buffer_offset = 0;
     con->read_buffer_size = 0;
     con->client_crypt = NULL;
+    teomutexInitialize(&con->write_guard);
+    con->resume_server = NULL;
+    con->resume_port = port;
+    if (teocliOpt_SessionResumption && server != NULL) {
+        con->resume_server = (char *)ccl_malloc(strlen(server) + 1);
+        strcpy(con->resume_server, server);
+    }
     con->event_cb = event_cb;
     con->user_data = user_data;
+    con->event_mask = EV_L_MASK_ALL;
+    con->event_batch_cb = NULL;
+    con->event_batch_f = 0;
+    con->event_batch = NULL;
+    con->event_batch_len = 0;
+    con->event_batch_size = 0;
+    con->event_batch_data = NULL;
+    con->event_batch_data_len = 0;
+    con->event_batch_data_size = 0;
+    con->recv_ring = NULL;
+    con->stats = teoLNullStatsCreate();
+    con->trace = teoLNullTraceCreate();
+    con->capture = NULL;
+    con->transport = NULL;
+    con->reconnect = NULL;
     con->udp_reset_f = 0;
     con->td = NULL;
     con->tcp_f = connection_flag;
     con->tcd = NULL;
     con->pipefd[0] = -1;
     con->pipefd[1] = -1;
+    con->recv_capture_f = 0;
+    con->recv_capture = NULL;
+    con->recv_capture_len = 0;
+    con->keepalive_ms = teotimeGetCurrentTimeMs();
+    con->wakeups = 0;
+    con->idle_wakeups = 0;
+    con->wakeups_since_ms = con->keepalive_ms;
     con->status = CON_STATUS_NOT_CONNECTED;
 
 #if defined(_WIN32)
@@ -1429,42 +2455,95 @@ teoLNullConnectData *teoLNullConnectE(const char *server, uint16_t port,
     con->handles[1] = NULL;
 #endif
 
-    // Connect to TCP
-    if (con->tcp_f) {
-        int result =
-            teosockConnectTimeout(&con->fd, server, port, teocliOpt_ConnectTimeoutMs);
+    return con;
+}
 
-        if (result == TEOSOCK_CONNECT_HOST_NOT_FOUND) {
-            LTRACK_E("TeonetClient", "HOST NOT FOUND --> h_errno = %" PRId32,
-                     h_errno);
-            teosockClose(con->fd);
-            con->fd = -1;
-            con->status = CON_STATUS_HOST_ERROR;
-            send_l0_event(con, EV_L_CONNECTED, &con->status,
-                          sizeof(con->status));
-            return con;
-        }
+/**
+ * Connect TCP socket of connection, failure is sent with EV_L_CONNECTED
+ *
+ * @return true on success
+ */
+static bool _teoLNullConnectTcp(teoLNullConnectData *con, const char *server,
+                                uint16_t port) {
+    int result =
+        teosockConnectTimeout(&con->fd, server, port, teocliOpt_ConnectTimeoutMs);
+
+    if (result == TEOSOCK_CONNECT_HOST_NOT_FOUND) {
+        LTRACK_E("TeonetClient", "HOST NOT FOUND --> h_errno = %" PRId32,
+                 h_errno);
+        teosockClose(con->fd);
+        con->fd = -1;
+        con->status = CON_STATUS_HOST_ERROR;
+        send_l0_event(con, EV_L_CONNECTED, &con->status, sizeof(con->status));
+        return false;
+    }
 
-        if (result == TEOSOCK_CONNECT_FAILED) {
-            int error = errno;
-            LTRACK_E("TeonetClient", "Client-connect() error: %" PRId32 ", %s",
-                     error, strerror(error));
-            teosockClose(con->fd);
-            con->fd = -1;
-            con->status = CON_STATUS_CONNECTION_ERROR;
-            send_l0_event(con, EV_L_CONNECTED, &con->status,
-                          sizeof(con->status));
-            return con;
-        }
+    if (result == TEOSOCK_CONNECT_FAILED) {
+        int error = errno;
+        LTRACK_E("TeonetClient", "Client-connect() error: %" PRId32 ", %s",
+                 error, strerror(error));
+        teosockClose(con->fd);
+        con->fd = -1;
+        con->status = CON_STATUS_CONNECTION_ERROR;
+        send_l0_event(con, EV_L_CONNECTED, &con->status, sizeof(con->status));
+        return false;
+    }
+
+    // Set TCP_NODELAY option
+    teosockSetTcpNodelay(con->fd);
+    return true;
+}
+
+/**
+ * Create TCP client and connect to server with event callback
+ *
+ * @param server Server IP or name
+ * @param port Server port
+ * @param event_cb Pointer to event callback function
+ * @param user_data Pointer to user data which will be send to event callback
+ *
+ * @return Pointer to teoLNullConnectData. Null if no memory error
+ * @retval teoLNullConnectData::status== 1 - Success connection
+ * @retval teoLNullConnectData::status==-1 - Create socket error
+ * @retval teoLNullConnectData::status==-2 - HOST NOT FOUND error
+ * @retval teoLNullConnectData::status==-3 - Client-connect() error
+ * @retval teoLNullConnectData::status==-4 - Pipe creation error
+ */
+teoLNullConnectData *teoLNullConnectE(const char *server, uint16_t port,
+                                      teoLNullEventsCb event_cb,
+                                      void *user_data,
+                                      PROTOCOL connection_flag) {
+    teoLNullConnectData *con = _teoLNullConnectDataCreate(
+        server, port, event_cb, user_data, connection_flag);
 
-        // Set TCP_NODELAY option
-        teosockSetTcpNodelay(con->fd);
+    teoLNullMetricsRegister(con, server, port);
+
+    // Created before connect to remember login sent from EV_L_CONNECTED
+    if (teocliOpt_ReconnectMinMs != 0) {
+        con->reconnect = teoLNullReconnectCreate(
+            server, port, teocliOpt_EncryptionProtocol,
+            teocliOpt_ReconnectMinMs, teocliOpt_ReconnectMaxMs,
+            teocliOpt_ReconnectQueueBytes);
+    }
+
+    // Connect to TCP
+    if (con->tcp_f) {
+        if (!_teoLNullConnectTcp(con, server, port)) { return con; }
+        teoLNullCaptureConnect(con);
 
     } else {
         // Connect to UDP
         int port_local = 0;
-        con->fd = trudpUdpBindRaw_cli(server, &port_local, 1);
-        teosockSetBlockingMode(con->fd, TEOSOCK_NON_BLOCKING_MODE);
+#if !defined(_WIN32)
+        con->transport = teocliOpt_DatagramTransport;
+#endif
+        if (con->transport != NULL) {
+            con->fd = con->transport->open(con->transport->user_data, server,
+                                           port);
+        } else {
+            con->fd = trudpUdpBindRaw_cli(server, &port_local, 1);
+            teosockSetBlockingMode(con->fd, TEOSOCK_NON_BLOCKING_MODE);
+        }
         if (con->fd < 0) {
             LTRACK_E("TeonetClient", "Failed to bind UDP socket.");
             con->status = CON_STATUS_SOCKET_ERROR;
@@ -1476,6 +2555,7 @@ teoLNullConnectData *teoLNullConnectE(const char *server, uint16_t port,
 
         con->td = trudpInit(con->fd, port, trudpEventCback, con);
         con->tcd = trudpChannelNew(con->td, (char *)server, port, 0);
+        teoLNullCaptureConnect(con);
         LTRACK_I("TeonetClient", "TR-UDP port = %d created, fd = %d",
                  port_local, (int)con->fd);
 
@@ -1566,7 +2646,11 @@ teoLNullConnectData *teoLNullConnectE(const char *server, uint16_t port,
         con->status = CON_STATUS_NOT_CONNECTED;
     }
 
-    return _teoLNullConnectionInitiate(con, teocliOpt_EncryptionProtocol);
+    _teoLNullConnectionInitiate(con, teocliOpt_EncryptionProtocol);
+    if (con->reconnect != NULL && con->status == CON_STATUS_CONNECTED) {
+        con->reconnect->established = true;
+    }
+    return con;
 }
 
 /**
@@ -1586,6 +2670,372 @@ teoLNullConnectData *teoLNullConnect(const char *server, uint16_t port,
     return teoLNullConnectE(server, port, NULL, NULL, connection_flag);
 }
 
+/**
+ * Release transport of lost link, buffers, TR-UDP socket and pipe are kept
+ * for reconnect
+ */
+static void _teoLNullReconnectClose(teoLNullConnectData *con) {
+    if (con->tcp_f) {
+        if (con->fd > 0) { teosockClose(con->fd); }
+        con->fd = -1;
+    } else if (con->td != NULL) {
+        trudpChannelDestroyAll(con->td);
+        con->tcd = NULL;
+    }
+    con->udp_reset_f = 0;
+    con->read_buffer_offset = 0;
+    con->last_packet_offset = 0;
+    con->status = CON_STATUS_NOT_CONNECTED;
+}
+
+/**
+ * Empty TR-UDP pipe. Packets of lost link are moved to reconnect queue and
+ * sealed with keys of new session after re-login, packets of login sent
+ * during attempt are written to channel before queue is replayed
+ */
+static void _teoLNullReconnectDrainPipe(teoLNullConnectData *con, bool send) {
+    if (con->pipefd[0] == -1) { return; }
+
+    for (;;) {
+        teoPipeSendData pipe_send_data;
+#if defined(_WIN32)
+        struct _stat status;
+        memset(&status, 0, sizeof(status));
+        if (_fstat(con->pipefd[0], &status) != 0 || status.st_size <= 0) {
+            break;
+        }
+        int read_result =
+            _read(con->pipefd[0], &pipe_send_data, sizeof(pipe_send_data));
+#else
+        if (teosockSelect(con->pipefd[0], TEOSOCK_SELECT_MODE_READ, 0) !=
+            TEOSOCK_SELECT_READY) {
+            break;
+        }
+        ssize_t read_result =
+            read(con->pipefd[0], &pipe_send_data, sizeof(pipe_send_data));
+#endif
+        if (read_result <= 0) { break; }
+        if ((size_t)read_result != sizeof(pipe_send_data)) {
+            LTRACK_E("TeonetClient", "Failed to read message from the "
+                                     "pipe: message read partially.");
+            abort();
+        }
+
+        if (send) {
+            if (teoLNullPacketSealBuffer(con->client_crypt,
+                                         pipe_send_data.with_encryption,
+                                         pipe_send_data.packet,
+                                         pipe_send_data.packet_length +
+                                             _encryptionOverhead(con))) {
+                _teoLNullTrudpWrite(con, pipe_send_data.packet);
+            }
+        } else {
+            // Packets were accepted by send calls already, queue takes them
+            // over its limit
+            teoLNullReconnectQueuePush(
+                con->reconnect, pipe_send_data.with_encryption,
+                pipe_send_data.packet, pipe_send_data.packet_length,
+                pipe_send_data.packet_length +
+                    TEOLNULL_ENCRYPTION_MAX_OVERHEAD,
+                true);
+        }
+        free(pipe_send_data.packet);
+    }
+
+#if defined(_WIN32)
+    ResetEvent(con->handles[1]);
+#endif
+}
+
+/**
+ * Drain callback of teoLNullReconnectLinkDown: senders of TR-UDP connection
+ * may be blocked by full pipe, only event loop thread empties it
+ */
+static void _teoLNullReconnectQueuePipe(void *arg) {
+    _teoLNullReconnectDrainPipe((teoLNullConnectData *)arg, false);
+}
+
+/**
+ * Start reconnect of managed connection which link is lost, called by event
+ * loop thread
+ *
+ * @return true if connection reconnects, false if it isn't managed or
+ *  reconnect is stopped by teoLNullShutdown
+ */
+static bool _teoLNullReconnectLinkDown(teoLNullConnectData *con) {
+    teoLNullReconnect *rc = con->reconnect;
+    if (rc == NULL || !rc->established || rc->attempting ||
+        teoLNullReconnectIsStopped(rc)) {
+        return false;
+    }
+
+    LTRACK_I("TeonetClient", "Link to %s:%u lost, reconnecting", rc->server,
+             (unsigned)rc->port);
+
+    // Wake senders blocked in socket write, they fail and leave the gate.
+    // Senders blocked in pipe write leave it when pipe is drained to queue
+    if (con->tcp_f) {
+        if (con->fd > 0) { teosockShutdown(con->fd, TEOSOCK_SHUTDOWN_RDWR); }
+        teoLNullReconnectLinkDown(rc, NULL, NULL);
+    } else {
+        teoLNullReconnectLinkDown(rc, _teoLNullReconnectQueuePipe, con);
+    }
+
+    // Capture holds bytes of one session
+    teoLNullCaptureStop(con);
+
+    _teoLNullReconnectClose(con);
+
+    return true;
+}
+
+/**
+ * Send packets queued while link was down and open send gate
+ *
+ * @return false if link is lost again
+ */
+static bool _teoLNullReconnectReplay(teoLNullConnectData *con) {
+    teoLNullReconnect *rc = con->reconnect;
+
+    // Login goes first
+    if (!con->tcp_f) { _teoLNullReconnectDrainPipe(con, true); }
+
+    for (;;) {
+        bool with_encryption;
+        void *data;
+        size_t length;
+        size_t capacity;
+        if (!teoLNullReconnectQueueFront(rc, &with_encryption, &data, &length,
+                                         &capacity)) {
+            // Senders queue packets until gate is opened with empty queue
+            if (teoLNullReconnectLinkUp(rc)) { return true; }
+            continue;
+        }
+
+        teoLNullCPacket *packet = (teoLNullCPacket *)data;
+        if (con->tcp_f) {
+            if (_teosockSend(con, with_encryption, packet, length, capacity) <
+                0) {
+                return false;
+            }
+        } else {
+            // Queue may be larger than pipe, so it's written to channel
+            // directly
+            if (teoLNullPacketSealBuffer(con->client_crypt, with_encryption,
+                                         packet, capacity)) {
+                _teoLNullTrudpWrite(con, packet);
+                teoLNullStatsCountSent(con->stats, packet->cmd, length);
+            }
+        }
+        teoLNullReconnectQueuePop(rc);
+        teoLNullStatsCountReconnect(con->stats, STAT_RECONNECT_REPLAYED);
+    }
+}
+
+/**
+ * Make reconnect attempt: connect, establish session in nested event loop,
+ * log in again and send queued packets. Failed attempt schedules next one
+ */
+static void _teoLNullReconnectAttempt(teoLNullConnectData *con) {
+    teoLNullReconnect *rc = con->reconnect;
+
+    LTRACK_I("TeonetClient", "Reconnect attempt %u to %s:%u", rc->attempts,
+             rc->server, (unsigned)rc->port);
+    teoLNullStatsCountReconnect(con->stats, STAT_RECONNECT_ATTEMPT);
+
+    rc->attempting = true;
+    rc->login_f = false;
+    con->status = CON_STATUS_NOT_CONNECTED;
+
+    bool connected;
+    if (con->tcp_f) {
+        connected = _teoLNullConnectTcp(con, rc->server, rc->port);
+    } else {
+        con->tcd = trudpChannelNew(con->td, rc->server, rc->port, 0);
+        connected = con->tcd != NULL;
+    }
+    if (connected) {
+        _teoLNullConnectionInitiate(con,
+                                    (teoLNullEncryptionProtocol)rc->enc_proto);
+        connected = con->status == CON_STATUS_CONNECTED;
+    }
+
+    // Application may log in from EV_L_CONNECTED itself
+    if (connected && !rc->login_f && rc->host_name != NULL) {
+        connected = teoLNullLogin(con, rc->host_name) >= 0;
+    }
+    if (connected) { connected = _teoLNullReconnectReplay(con); }
+    rc->attempting = false;
+
+    if (!connected) {
+        _teoLNullReconnectClose(con);
+        teoLNullReconnectScheduleNext(rc);
+        return;
+    }
+
+    const int64_t downtime_ms = teotimeGetTimePassedMs(rc->down_ms);
+    teoLNullStatsRecordLatency(con->stats, STAT_LATENCY_RECONNECT,
+                               (uint64_t)downtime_ms * 1000);
+    LTRACK_I("TeonetClient", "Reconnected to %s:%u in %" PRId64 " ms",
+             rc->server, (unsigned)rc->port, downtime_ms);
+}
+
+// Backoff sleep is made of slices this long, so teoLNullShutdown stops it
+#define RECONNECT_SLEEP_SLICE_MS 10
+
+/**
+ * Sleep @a sleep_ms ms or until reconnect is stopped
+ *
+ * @return false if reconnect is stopped
+ */
+static bool _teoLNullReconnectSleep(teoLNullReconnect *rc, int64_t sleep_ms) {
+    const int64_t deadline_ms = teotimeGetCurrentTimeMs() + sleep_ms;
+    for (;;) {
+        if (teoLNullReconnectIsStopped(rc)) { return false; }
+
+        const int64_t left_ms = deadline_ms - teotimeGetCurrentTimeMs();
+        if (left_ms <= 0) { return true; }
+        teoLNullSleep((int)(left_ms < RECONNECT_SLEEP_SLICE_MS
+                                ? left_ms
+                                : RECONNECT_SLEEP_SLICE_MS));
+    }
+}
+
+/**
+ * Event loop iteration of managed connection which link is down: wait for
+ * next reconnect attempt up to @a timeout and make it
+ *
+ * @return false if reconnect is stopped by teoLNullShutdown
+ */
+static bool _teoLNullReconnectWait(teoLNullConnectData *con, int timeout) {
+    teoLNullReconnect *rc = con->reconnect;
+    if (teoLNullReconnectIsStopped(rc)) { return false; }
+
+    con->event_batch_f = (con->event_batch_cb != NULL);
+
+    const int64_t left_ms = rc->next_attempt_ms - teotimeGetCurrentTimeMs();
+    if (left_ms > 0 && timeout >= 0 && timeout < left_ms) {
+        if (!_teoLNullReconnectSleep(rc, timeout)) { return false; }
+        send_l0_event(con, EV_L_IDLE, NULL, 0);
+    } else {
+        if (!_teoLNullReconnectSleep(rc, left_ms)) { return false; }
+        _teoLNullReconnectAttempt(con);
+    }
+
+    if (!teocliOpt_TicklessIdle || teocliOpt_TickEvent) {
+        send_l0_event(con, EV_L_TICK, NULL, 0);
+    }
+    if (con->event_batch_f) { _teoLNullEventBatchFlush(con); }
+
+    return !teoLNullReconnectIsStopped(rc);
+}
+
+/**
+ * Bind TR-UDP of replayed connection to loopback socket sending to itself,
+ * nobody reads the socket and kernel drops ACK and answers sent to it
+ *
+ * @return true on success
+ */
+static bool _teoLNullReplayTrudp(teoLNullConnectData *con) {
+    int port_local = 0;
+    con->fd = trudpUdpBindRaw_cli(REPLAY_LOOPBACK, &port_local, 1);
+    if (con->fd < 0) { return false; }
+    teosockSetBlockingMode(con->fd, TEOSOCK_NON_BLOCKING_MODE);
+
+    struct sockaddr_storage local;
+    socklen_t local_len = sizeof(local);
+    if (getsockname(con->fd, (struct sockaddr *)&local, &local_len) != 0) {
+        return false;
+    }
+    port_local = local.ss_family == AF_INET6
+                     ? ntohs(((struct sockaddr_in6 *)&local)->sin6_port)
+                     : ntohs(((struct sockaddr_in *)&local)->sin_port);
+
+    con->td = trudpInit(con->fd, port_local, trudpEventCback, con);
+    con->tcd = trudpChannelNew(con->td, REPLAY_LOOPBACK, port_local, 0);
+    return true;
+}
+
+/**
+ * Create connection replaying captured bytes instead of receiving them
+ *
+ * @param capture Loaded capture
+ * @param event_cb Pointer to event callback function
+ * @param user_data Pointer to user data which will be send to event callback
+ *
+ * @return Pointer to teoLNullConnectData
+ */
+teoLNullConnectData *teoLNullReplayConnect(const teoLNullCaptureFile *capture,
+                                           teoLNullEventsCb event_cb,
+                                           void *user_data) {
+    teoLNullConnectData *con =
+        _teoLNullConnectDataCreate(NULL, capture->port, event_cb, user_data,
+                                   capture->tcp_f ? TCP : TRUDP);
+
+    if (!con->tcp_f && !_teoLNullReplayTrudp(con)) {
+        LTRACK_E("TeonetClient", "Failed to bind UDP socket of replay.");
+        con->status = CON_STATUS_SOCKET_ERROR;
+        return con;
+    }
+
+    if (capture->enc_proto == ENC_PROTO_DISABLED) {
+        con->status = CON_STATUS_CONNECTED;
+        send_l0_event(con, EV_L_CONNECTED, &con->status, sizeof(con->status));
+        return con;
+    }
+
+    // Captured KEX answer re-confirms imported session and connects
+    if (!_setupEncryptionContext(con, capture->enc_proto) ||
+        (capture->keys != NULL &&
+         !teoLNullEncryptionContextImportSession(
+             con->client_crypt, capture->keys->data, capture->keys->length))) {
+        con->status = CON_STATUS_ENCRYPTION_ERROR;
+        return con;
+    }
+    if (capture->keys == NULL) {
+        LTRACK_I("TeonetClient", "Capture has no session keys, encrypted "
+                                 "packets of replay are dropped");
+    }
+
+    return con;
+}
+
+/**
+ * Process captured record by replayed connection as if it is received from
+ * socket
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param record Capture record
+ *
+ * @return false if replayed connection is disconnected
+ */
+bool teoLNullReplayFeed(teoLNullConnectData *con,
+                        const teoLNullCaptureRecord *record) {
+    con->event_batch_f = (con->event_batch_cb != NULL);
+
+    if (record->type == CAPTURE_TCP_DATA && con->tcp_f) {
+        ssize_t rc =
+            teoLNullRecvCheck(con, (char *)record->data, record->length);
+        while (rc != -1) {
+            if (rc > 0) {
+                send_l0_event(con, EV_L_RECEIVED, con->read_buffer, rc);
+                _teocliCallDataReceivedCallback(rc);
+            }
+            rc = teoLNullRecvCheck(con, NULL, -1);
+        }
+    } else if (record->type == CAPTURE_UDP_DATAGRAM && !con->tcp_f &&
+               record->length <= BUFFER_SIZE) {
+        // Datagram is received to stack buffer as in select loop
+        uint8_t buffer[BUFFER_SIZE];
+        memcpy(buffer, record->data, record->length);
+        trudpChannelProcessReceivedPacket(con->tcd, buffer, record->length);
+    }
+
+    if (con->event_batch_f) { _teoLNullEventBatchFlush(con); }
+
+    return con->status >= 0 && !con->udp_reset_f;
+}
+
 /**
  * Disconnect from server and free teoLNullConnectData
  *
@@ -1593,15 +3043,41 @@ teoLNullConnectData *teoLNullConnect(const char *server, uint16_t port,
  */
 void teoLNullDisconnect(teoLNullConnectData *con) {
     if (con != NULL) {
-        if (con->fd > 0) { teosockClose(con->fd); }
+        teoLNullMetricsUnregister(con);
+
+        teoLNullCaptureStop(con);
+
+        if (con->fd > 0 && con->transport != NULL) {
+            con->transport->close(con->transport->user_data, con->fd);
+        } else if (con->fd > 0) {
+            teosockClose(con->fd);
+        }
 
         if (con->read_buffer != NULL) { free(con->read_buffer); }
 
+        if (con->recv_capture != NULL) { free(con->recv_capture); }
+
+        if (con->event_batch != NULL) { free(con->event_batch); }
+
+        if (con->event_batch_data != NULL) { free(con->event_batch_data); }
+
+        teoLNullRecvRingDestroy(con->recv_ring);
+
+        teoLNullStatsDestroy(con->stats);
+
+        teoLNullTraceDestroy(con->trace);
+
         if (con->client_crypt != NULL) {
             teoLNullEncryptionContextDestroy(con->client_crypt);
             free(con->client_crypt);
         }
 
+        teomutexDestroy(&con->write_guard);
+
+        teoLNullReconnectDestroy(con->reconnect);
+
+        if (con->resume_server != NULL) { free(con->resume_server); }
+
         if (!con->tcp_f && con->td) {
             trudpChannelDestroyAll(con->td);
             trudpDestroy(con->td);
@@ -1645,6 +3121,10 @@ void teoLNullDisconnect(teoLNullConnectData *con) {
  * @param con Pointer to teoLNullConnectData
  */
 void teoLNullShutdown(teoLNullConnectData *con) {
+    if (con != NULL && con->reconnect != NULL) {
+        teoLNullReconnectStop(con->reconnect);
+    }
+
     if (con != NULL && con->fd > 0) {
         if (con->tcp_f) {
             teosockShutdown(con->fd, TEOSOCK_SHUTDOWN_RDWR);
@@ -1666,8 +3146,10 @@ void teoLNullShutdown(teoLNullConnectData *con) {
 static void trudpEventCback(void *tcd_pointer, int event, void *data,
                             size_t data_length, void *user_data) {
     trudpChannelData *tcd = (trudpChannelData *)tcd_pointer;
-    CLTRACK(DEBUG, "TeonetClient", "chan %s event %s data_length %u",
-            tcd->channel_key, STRING_trudpEvent(event), (uint32_t)data_length);
+    TEOCLI_PROBE3(trudp_event, event, data, data_length);
+    CLTRACK_HOT(DEBUG, "TeonetClient", "chan %s event %s data_length %u",
+                tcd->channel_key, STRING_trudpEvent(event),
+                (uint32_t)data_length);
 
     switch (event) {
 
@@ -1817,10 +3299,14 @@ static void trudpEventCback(void *tcd_pointer, int event, void *data,
             send_l0_event(con, EV_L_CONNECTED, &con->status,
                           sizeof(con->status));
         }
-        CLTRACK(DEBUG, "TeonetClient",
-                "got ACK id=%u at channel %s, %.3f(%.3f) ms", id,
-                tcd->channel_key, (tcd->triptime) / 1000.0,
-                (tcd->triptimeMiddle) / 1000.0);
+        teoLNullStatsRecordLatency(con->stats, STAT_LATENCY_TRUDP_RTT,
+                                   tcd->triptime);
+        TRACE_RECV_RECORD(con, STAGE_SEND_ACK, (uint64_t)tcd->triptime * 1000);
+        TEOCLI_PROBE2(trudp_ack, id, tcd->triptime);
+        CLTRACK_HOT(DEBUG, "TeonetClient",
+                    "got ACK id=%u at channel %s, %.3f(%.3f) ms", id,
+                    tcd->channel_key, (tcd->triptime) / 1000.0,
+                    (tcd->triptimeMiddle) / 1000.0);
     } break;
 
     // Got DATA event
@@ -1835,32 +3321,45 @@ static void trudpEventCback(void *tcd_pointer, int event, void *data,
         size_t block_len = trudpPacketGetDataLength(packet);
         void* block = trudpPacketGetData(packet);
         ssize_t ready_bytes_count = teoLNullRecvCheck(con, block, block_len);
+        TEOCLI_PROBE3(trudp_data, id, block_len, ready_bytes_count);
         if (ready_bytes_count <= 0) {
-            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                    "Got block id=%u chan=%s of %u bytes", id, tcd->channel_key,
-                    (uint32_t)block_len);
+            CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                        "Got block id=%u chan=%s of %u bytes", id,
+                        tcd->channel_key, (uint32_t)block_len);
             break;
         }
-        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "Got block id=%u chan=%s of %u bytes, assembled L0 packet of "
-                "%d bytes",
-                id, tcd->channel_key, (uint32_t)block_len,
-                (int32_t)ready_bytes_count);
+        CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                    "Got block id=%u chan=%s of %u bytes, assembled L0 "
+                    "packet of %d bytes",
+                    id, tcd->channel_key, (uint32_t)block_len,
+                    (int32_t)ready_bytes_count);
 
         teoLNullCPacket *cp = (teoLNullCPacket *)con->read_buffer;
-        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "trip(mid)=[%.3f(%.3f) ms] peer=%s, cmd=%d, payload=%u",
-                (double)tcd->triptime / 1000.0,
-                (double)tcd->triptimeMiddle / 1000.0, cp->peer_name,
-                (int32_t)cp->cmd, (uint32_t)cp->data_length);
+        CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                    "trip(mid)=[%.3f(%.3f) ms] peer=%s, cmd=%d, payload=%u",
+                    (double)tcd->triptime / 1000.0,
+                    (double)tcd->triptimeMiddle / 1000.0, cp->peer_name,
+                    (int32_t)cp->cmd, (uint32_t)cp->data_length);
 
         // Process commands
         if (cp->cmd == CMD_L_ECHO) {
             cp->cmd = CMD_L_ECHO_ANSWER;
-            teoLNullPacketUpdateHeaderChecksum(cp);
+            // Payload checksum is missing in packet decrypted from AEAD
+            teoLNullPacketUpdateChecksums(cp);
             trudpChannelSendData(tcd, cp, ready_bytes_count);
+            teoLNullStatsCountSent(con->stats, cp->cmd, ready_bytes_count);
+        } else if (con->recv_capture_f && con->recv_capture == NULL) {
+            // Return packet from teoLNullRecvTimeout, keep a copy as next
+            // packets of this loop iteration reuse the read buffer
+            con->recv_capture = ccl_malloc(ready_bytes_count);
+            memcpy(con->recv_capture, cp, ready_bytes_count);
+            con->recv_capture_len = ready_bytes_count;
+
+            _teocliCallDataReceivedCallback(ready_bytes_count);
         } else { // Send other commands to L0 event loop
+            TRACE_RECV_BEGIN(con, callback);
             send_l0_event(con, EV_L_RECEIVED, cp, ready_bytes_count);
+            TRACE_RECV_END(con, callback, STAGE_RECV_CALLBACK);
 
             _teocliCallDataReceivedCallback(ready_bytes_count);
         }
@@ -1874,16 +3373,22 @@ static void trudpEventCback(void *tcd_pointer, int event, void *data,
         teoLNullConnectData *con = (teoLNullConnectData*)user_data;
 
         if (!teoLNullPacketCheck(data, data_length)) {
-            CLTRACK(DEBUG, "TeonetClient",
-                    "got invalid non TR-UDP data packet with %u bytes of data",
-                    (uint32_t)data_length);
+            teoLNullStatsCountError(con->stats, STAT_ERROR_CHECKSUM);
+            CLTRACK_HOT(DEBUG, "TeonetClient",
+                        "got invalid non TR-UDP data packet with %u bytes "
+                        "of data",
+                        (uint32_t)data_length);
             break;
         }
 
-        CLTRACK(DEBUG, "TeonetClient",
-                "got valid non TR-UDP data packet with %u bytes of data",
-                (uint32_t)data_length);
+        CLTRACK_HOT(DEBUG, "TeonetClient",
+                    "got valid non TR-UDP data packet with %u bytes of data",
+                    (uint32_t)data_length);
+        teoLNullStatsCountReceived(con->stats, ((teoLNullCPacket *)data)->cmd,
+                                   data_length);
+        TRACE_RECV_BEGIN(con, callback);
         send_l0_event(con, EV_L_RECEIVED_UNRELIABLE, data, data_length);
+        TRACE_RECV_END(con, callback, STAGE_RECV_CALLBACK);
 
         _teocliCallDataReceivedCallback(data_length);
     } break;
@@ -1901,27 +3406,27 @@ static void trudpEventCback(void *tcd_pointer, int event, void *data,
     // Process send data
     // @param data Pointer to send data
     // @param data_length Length of send
-    // @param user_data NULL
+    // @param user_data Pointer to teoLNullConnectData
     case PROCESS_SEND: {
         // Send to UDP
-        trudpUdpSendto(tcd->td->fd, data, data_length,
-                       (__CONST_SOCKADDR_ARG)&tcd->remaddr,
-                       tcd->addrlen);
+        _teoLNullUdpSend((teoLNullConnectData *)user_data, tcd, data,
+                         data_length);
+        TEOCLI_PROBE2(trudp_send, data, data_length);
 
         if (DEBUG) {
             trudpPacket* packet = (trudpPacket*)data;
             uint32_t id = trudpPacketGetId(packet);
             trudpPacketType type = trudpPacketGetType(packet);
             if (type == TRU_DATA) {
-                CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                        "send %u bytes data id=%u, to %s",
-                        (uint32_t)data_length, id, tcd->channel_key);
+                CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                            "send %u bytes data id=%u, to %s",
+                            (uint32_t)data_length, id, tcd->channel_key);
 
             } else {
-                CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
-                        "send %u bytes type=%s(%d) id=%u, to %s",
-                        (uint32_t)data_length, STRING_trudpPacketType(type),
-                        (int)type, id, tcd->channel_key);
+                CLTRACK_HOT(teocliOpt_DBG_packetFlow, "TeonetClient",
+                            "send %u bytes type=%s(%d) id=%u, to %s",
+                            (uint32_t)data_length, STRING_trudpPacketType(type),
+                            (int)type, id, tcd->channel_key);
             }
         }
     } break;
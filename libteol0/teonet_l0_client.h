@@ -30,6 +30,7 @@ extern int usleep(__useconds_t __useconds);
 #endif
 #endif
 
+#include "teobase/mutex.h"
 #include "teobase/socket.h"
 #include "trudp.h"
 #include "trudp_utils.h"
@@ -78,6 +79,29 @@ typedef enum teoLNullEvents {
 typedef void (*teoLNullEventsCb)(void *kc, teoLNullEvents event, void *data,
                                  size_t data_len, void *user_data);
 
+/**
+ * L0 client events subscription mask
+ */
+typedef uint32_t teoLNullEventMask;
+
+#define EV_L_MASK(event) ((teoLNullEventMask)1 << (event))
+#define EV_L_MASK_ALL ((teoLNullEventMask)UINT32_MAX)
+
+/**
+ * L0 client event delivered by batch event callback
+ */
+typedef struct teoLNullEventView {
+
+    teoLNullEvents event; ///< Event
+    void *data;           ///< Event data, valid until callback returns
+    size_t data_len;      ///< Event data length
+
+} teoLNullEventView;
+
+typedef void (*teoLNullEventsBatchCb)(void *kc,
+                                      const teoLNullEventView *events,
+                                      size_t events_count, void *user_data);
+
 /**
  * L0 client connection status
  */
@@ -95,9 +119,190 @@ typedef enum teoLNullConnectionStatus {
 
 typedef enum PROTOCOL { TRUDP = 0, TCP = 1 } PROTOCOL;
 
+/**
+ * L0 client event loop wakeup statistic
+ */
+typedef struct teoLNullWakeupStats {
+
+    uint64_t wakeups;      ///< Event loop wakeups
+    uint64_t idle_wakeups; ///< Event loop wakeups without I/O
+    int64_t elapsed_ms;    ///< Time since connection created
+    double idle_wakeups_per_second; ///< Idle wakeups rate
+
+} teoLNullWakeupStats;
+
+#define TEOLNULL_STATS_COMMANDS 256
+#define TEOLNULL_LATENCY_BUCKETS 26
+
+/**
+ * L0 client latency histogram
+ *
+ * Bucket i counts values above 2^(i-1) and up to 2^i us, bucket 0 counts
+ * values up to 1 us, the last bucket counts all values above 2^24 us.
+ */
+typedef struct teoLNullLatencyHistogram {
+
+    uint64_t buckets[TEOLNULL_LATENCY_BUCKETS]; ///< Not cumulative counts
+    uint64_t count;                             ///< Number of values
+    uint64_t sum;                               ///< Sum of values in us
+
+} teoLNullLatencyHistogram;
+
+/**
+ * L0 client packets statistic of one command id
+ */
+typedef struct teoLNullCommandStats {
+
+    uint64_t packets_sent;     ///< Packets sent
+    uint64_t bytes_sent;       ///< Bytes of sent packets
+    uint64_t packets_received; ///< Packets received
+    uint64_t bytes_received;   ///< Bytes of received packets
+
+} teoLNullCommandStats;
+
+/**
+ * L0 client connection statistic
+ *
+ * Packets are counted when they are passed to the socket or assembled from
+ * received data, including key exchange and echo packets processed inside
+ * the library. Bytes are packet lengths without transport headers.
+ */
+typedef struct teoLNullStats {
+
+    uint64_t packets_sent;     ///< Packets sent of all commands
+    uint64_t bytes_sent;       ///< Bytes sent of all commands
+    uint64_t packets_received; ///< Packets received of all commands
+    uint64_t bytes_received;   ///< Bytes received of all commands
+    //! Packets and bytes by command id
+    teoLNullCommandStats commands[TEOLNULL_STATS_COMMANDS];
+
+    uint64_t send_errors;     ///< Failed sends, packets too large included
+    uint64_t checksum_errors; ///< Dropped packets with wrong checksum
+    uint64_t decrypt_errors;  ///< Packets failed to decrypt, dropped if
+                              ///< protocol has AEAD tag
+    uint64_t connects;        ///< Times connection was established
+    uint64_t reconnects;      ///< Times connection was established again
+    //! Managed reconnect attempts, see teoLNUllSetOption_AutoReconnect
+    uint64_t reconnect_attempts;
+    uint64_t reconnect_replayed; ///< Packets sent after re-login from queue
+    uint64_t reconnect_dropped;  ///< Packets dropped by full reconnect queue
+
+    size_t read_buffer_size;       ///< Read buffer size
+    size_t read_buffer_high_water; ///< Most bytes waited in read buffer
+    size_t recv_ring_used;         ///< Bytes in receive ring, 0 if disabled
+    size_t reconnect_queue;        ///< Bytes waiting for re-login
+
+    // TR-UDP channel, zero for TCP connection or if not connected
+    uint64_t trudp_retransmits;   ///< Packets sent again after timeout
+    uint32_t trudp_triptime;      ///< Last round trip time in us
+    double trudp_triptime_middle; ///< Smoothed round trip time in us
+    size_t trudp_send_queue;      ///< Packets waiting for ACK
+    size_t trudp_write_queue;     ///< Packets waiting for socket write
+
+    //! Time from send call to socket write, TR-UDP packets wait in pipe to
+    //! event loop thread
+    teoLNullLatencyHistogram send_latency;
+    teoLNullLatencyHistogram trudp_rtt; ///< Round trip time of TR-UDP ACKs
+    //! Round trip time of teoLNullSendEcho answers, ms resolution
+    teoLNullLatencyHistogram echo_rtt;
+    //! Time from link loss to re-login of managed reconnect, ms resolution
+    teoLNullLatencyHistogram reconnect_downtime;
+
+} teoLNullStats;
+
+/**
+ * Packet processing stages measured by latency tracing
+ *
+ * Receive stages of sampled event loop iterations are measured exclusive of
+ * stages nested in them, e.g. TR-UDP processing time doesn't include L0
+ * packet assembly and callbacks called from it.
+ */
+typedef enum teoLNullStage {
+
+    STAGE_RECV_WAIT,     ///< Event loop wait which ended with received data
+    STAGE_RECV_READ,     ///< Socket read
+    STAGE_RECV_TRUDP,    ///< TR-UDP packet processing and reassembly
+    STAGE_RECV_SPLIT,    ///< L0 packet assembly in read buffer
+    STAGE_RECV_DECRYPT,  ///< Checksum check and decryption with lock wait
+    STAGE_RECV_CALLBACK, ///< Event callback or receive ring push
+    STAGE_SEND_PIPE,     ///< TR-UDP packet wait in pipe to event loop
+    STAGE_SEND_SEAL,     ///< Checksums and encryption
+    STAGE_SEND_ORDER,    ///< TCP sender wait for encryption nonce order
+    STAGE_SEND_WRITE,    ///< Socket write or TR-UDP send queueing
+    STAGE_SEND_ACK,      ///< TR-UDP send to ACK
+    TEOLNULL_STAGES
+
+} teoLNullStage;
+
+#define TEOLNULL_STAGE_BUCKETS 32
+
+/**
+ * L0 client stage time histogram
+ *
+ * Bucket i counts values above 2^(i-1) and up to 2^i ns, bucket 0 counts
+ * values up to 1 ns, the last bucket counts all values above 2^30 ns.
+ */
+typedef struct teoLNullStageHistogram {
+
+    uint64_t buckets[TEOLNULL_STAGE_BUCKETS]; ///< Not cumulative counts
+    uint64_t count;                           ///< Number of values
+    uint64_t sum_ns;                          ///< Sum of values in ns
+
+} teoLNullStageHistogram;
+
+/**
+ * L0 client per stage latency statistic
+ */
+typedef struct teoLNullStageStats {
+
+    uint32_t sample_rate; ///< One of sample_rate iterations is measured
+    teoLNullStageHistogram stages[TEOLNULL_STAGES]; ///< By teoLNullStage
+
+} teoLNullStageStats;
+
 // forward declaration, complete type in libteol0/teonet_l0_client_crypt.h
 typedef struct teoLNullEncryptionContext teoLNullEncryptionContext;
 
+// forward declaration, complete type in libteol0/teonet_l0_client_ring.c
+typedef struct teoLNullRecvRing teoLNullRecvRing;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_stats.c
+typedef struct teoLNullStatCounters teoLNullStatCounters;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_trace.h
+typedef struct teoLNullTrace teoLNullTrace;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_capture.c
+typedef struct teoLNullCapture teoLNullCapture;
+
+// forward declaration, complete type in libteol0/teonet_l0_client_reconnect.h
+typedef struct teoLNullReconnect teoLNullReconnect;
+
+/**
+ * Datagram transport used by TR-UDP connections instead of UDP socket, set
+ * with teoLNUllSetOption_DatagramTransport
+ *
+ * Transport carries datagrams between connection and one server, e.g.
+ * through network simulator. Functions are called from the thread running
+ * connection event loop, except open which is called by teoLNullConnectE.
+ */
+typedef struct teoLNullDatagramTransport {
+
+    /// Open link to server, return nonblocking descriptor readable by select
+    /// when datagram is received or -1 on error
+    int (*open)(void *user_data, const char *server, uint16_t port);
+    /// Send datagram to server, return sent length or -1
+    ssize_t (*send)(void *user_data, int fd, const void *data, size_t length);
+    /// Receive one datagram, return its length or -1 with errno EAGAIN when
+    /// there is no datagram
+    ssize_t (*recv)(void *user_data, int fd, void *buffer, size_t size);
+    /// Close link opened by open, descriptor of failed connect may be
+    /// closed by close() instead
+    void (*close)(void *user_data, int fd);
+    void *user_data; ///< Passed to transport functions
+
+} teoLNullDatagramTransport;
+
 /**
  * L0 client connect data
  */
@@ -115,6 +320,16 @@ typedef struct teoLNullConnectData {
     teoLNullEventsCb event_cb; ///< Event callback function
     void *user_data;           ///< User data
 
+    teoLNullEventMask event_mask;          ///< Events sent to callbacks
+    teoLNullEventsBatchCb event_batch_cb;  ///< Batch event callback function
+    int event_batch_f;                     ///< Collect events to batch
+    teoLNullEventView *event_batch;        ///< Collected events
+    size_t event_batch_len;                ///< Number of collected events
+    size_t event_batch_size;               ///< Collected events array size
+    uint8_t *event_batch_data;             ///< Collected events data
+    size_t event_batch_data_len;           ///< Collected events data length
+    size_t event_batch_data_size;          ///< Collected events data size
+
     int tcp_f; ///< TCP or UDP flag: TCP == 1
     int udp_reset_f;
     trudpData *td;         ///< TRUDP connection data
@@ -122,10 +337,36 @@ typedef struct teoLNullConnectData {
 
     int pipefd[2]; ///< Pipe to use it in thread safe write function
 
-    //! encryption context, in multithreaded environment must be used in between
-    //! pair of calls teoLNullAcquireCrypto/teoLNullUnlockCrypto
+    int recv_capture_f;       ///< teoLNullRecvTimeout waits for TR-UDP packet
+    void *recv_capture;       ///< Copy of packet captured by teoLNullRecvTimeout
+    size_t recv_capture_len;  ///< Length of captured packet
+
+    int64_t keepalive_ms;     ///< Last keepalive processing time (tickless)
+    uint64_t wakeups;         ///< Number of event loop wakeups
+    uint64_t idle_wakeups;    ///< Number of event loop wakeups without I/O
+    int64_t wakeups_since_ms; ///< Wakeups counting start time
+
+    teoLNullRecvRing *recv_ring; ///< Received packets ring, NULL if disabled
+
+    teoLNullStatCounters *stats; ///< Connection statistic counters
+    teoLNullTrace *trace; ///< Stage latency tracing, NULL if not built in
+    teoLNullCapture *capture; ///< Capture of received bytes or NULL
+    const teoLNullDatagramTransport *transport; ///< TR-UDP transport or NULL
+    teoLNullReconnect *reconnect; ///< Managed reconnect state or NULL
+
+    //! encryption context, key exchange in multithreaded environment must be
+    //! made in between pair of calls teoLNullAcquireCrypto/teoLNullUnlockCrypto,
+    //! packets encryption and decryption synchronize send and receive halves
+    //! of the context inside
     teoLNullEncryptionContext *client_crypt;
 
+    //! serializes TCP socket writes of concurrent senders, so packets aren't
+    //! interleaved in the stream; encrypted packets take it in nonce order
+    teonetMutex write_guard;
+
+    char *resume_server;  ///< Server of resumption tickets, NULL if disabled
+    uint16_t resume_port; ///< Server port of resumption tickets
+
 #if defined(_WIN32)
     HANDLE handles[2];
 #endif
@@ -239,6 +480,15 @@ typedef struct teoLNullCPacket {
 
 } teoLNullCPacket;
 
+/**
+ * Received packet view returned by teoLNullPoll
+ */
+typedef struct teoLNullPacketView {
+    teoLNullEvents event;    ///< EV_L_RECEIVED or EV_L_RECEIVED_UNRELIABLE
+    teoLNullCPacket *packet; ///< Packet, valid until teoLNullPollRelease
+    size_t packet_len;       ///< Packet length
+} teoLNullPacketView;
+
 /**
  * L0 Server statistic data structure
  *
@@ -361,6 +611,23 @@ TEOCLI_API ssize_t teoLNullRecvCheck(teoLNullConnectData *con, char *buf,
 TEOCLI_API ssize_t teoLNullRecvTimeout(teoLNullConnectData *con,
                                        uint32_t timeout);
 TEOCLI_API bool teoLNullReadEventLoop(teoLNullConnectData *con, int timeout);
+TEOCLI_API void teoLNullSetEventMask(teoLNullConnectData *con,
+                                     teoLNullEventMask mask);
+TEOCLI_API void teoLNullSetEventBatchCb(teoLNullConnectData *con,
+                                        teoLNullEventsBatchCb event_batch_cb);
+TEOCLI_API void teoLNullGetWakeupStats(teoLNullConnectData *con,
+                                       teoLNullWakeupStats *stats);
+TEOCLI_API void teoLNullGetStats(teoLNullConnectData *con,
+                                 teoLNullStats *stats);
+TEOCLI_API bool teoLNullGetStageStats(teoLNullConnectData *con,
+                                      teoLNullStageStats *stats);
+TEOCLI_API const char *teoLNullStageName(teoLNullStage stage);
+TEOCLI_API bool teoLNullEnableRecvRing(teoLNullConnectData *con,
+                                       size_t size_bytes);
+TEOCLI_API ssize_t teoLNullPoll(teoLNullConnectData *con,
+                                teoLNullPacketView *out, size_t max,
+                                int timeout);
+TEOCLI_API void teoLNullPollRelease(teoLNullConnectData *con, size_t count);
 
 // Low level functions
 TEOCLI_API size_t teoLNullPacketCreateLogin(void *buffer, size_t buffer_length,
@@ -371,9 +638,17 @@ TEOCLI_API size_t teoLNullPacketCreateEcho(void *msg_buf, size_t buf_len,
 TEOCLI_API size_t teoLNullPacketCreate(void *buffer, size_t buffer_length,
                                        uint8_t command, const char *peer,
                                        const uint8_t *data, size_t data_length);
+// teoLNullPacketSeal appends nothing to packet data, packets with data aren't
+// encrypted by AEAD protocols (ENC_PROTO_*_POLY1305_*) then. With them use
+// teoLNullPacketSealBuffer and buffer of teoLNullBufferSize +
+// TEOLNULL_ENCRYPTION_MAX_OVERHEAD bytes, it returns false if tag doesn't fit
 TEOCLI_API void teoLNullPacketSeal(teoLNullEncryptionContext *ctx,
                                    bool with_encryption,
                                    teoLNullCPacket *packet);
+TEOCLI_API bool teoLNullPacketSealBuffer(teoLNullEncryptionContext *ctx,
+                                         bool with_encryption,
+                                         teoLNullCPacket *packet,
+                                         size_t capacity);
 TEOCLI_API ssize_t teoLNullPacketSend(teoLNullConnectData *con, bool with_encryption,
                                       teoLNullCPacket *data, size_t data_length);
 TEOCLI_API void teoLNullPacketUpdateChecksums(teoLNullCPacket *packet);
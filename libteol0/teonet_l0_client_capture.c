@@ -0,0 +1,353 @@
+/**
+ * File:   teonet_l0_client_capture.c
+ *
+ * Capture of bytes received by connection. Every TCP socket read and every
+ * TR-UDP datagram is written to buffered file as is, so replay repeats
+ * fragmentation and coalescing of real traffic. Capture is written by event
+ * loop thread only and costs nothing to connections without capture.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_capture.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+#define CAPTURE_MAGIC "TLCP"
+#define CAPTURE_MAGIC_LENGTH 4
+#define CAPTURE_FLAG_TCP 0x01
+
+// Magic, version, flags, protocol, zero byte, port, time, address length
+#define CAPTURE_HEADER_LENGTH (CAPTURE_MAGIC_LENGTH + 4 + 2 + 8 + 1)
+
+// Maximum length of LEB128 encoded 64 bit value
+#define VARINT_MAX_LENGTH 10
+
+// Buffer of capture file, records are small and written often
+#define CAPTURE_FILE_BUFFER_SIZE (64 * 1024)
+
+#if defined(TEONET_COMPILER_MSVC)
+#define CAPTURE_ADD(ptr, value)                                                \
+    ((uint32_t)InterlockedExchangeAdd((volatile LONG *)(ptr), (LONG)(value)))
+#else
+#define CAPTURE_ADD(ptr, value)                                                \
+    __atomic_fetch_add((ptr), (uint32_t)(value), __ATOMIC_RELAXED)
+#endif
+
+extern char *teocliOpt_CapturePath;
+extern bool teocliOpt_CaptureKeys;
+extern teoLNullEncryptionProtocol teocliOpt_EncryptionProtocol;
+
+// Number of connections captured by teoLNUllSetOption_Capture
+static uint32_t _captureConnections;
+
+struct teoLNullCapture {
+    FILE *file;        ///< Capture file, NULL after write error
+    bool with_keys;    ///< Record session keys
+    bool keys_written; ///< Session keys are recorded
+    uint64_t last_us;  ///< Time of previous record
+};
+
+static size_t _varintPut(uint8_t *out, uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static bool _varintGet(const uint8_t **in, const uint8_t *end,
+                       uint64_t *value) {
+    *value = 0;
+    for (unsigned shift = 0; shift < 64 && *in < end; shift += 7) {
+        const uint8_t byte = *(*in)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) { return true; }
+    }
+    return false;
+}
+
+/**
+ * Numeric address and port of server connection is made to
+ */
+static bool _captureServer(teoLNullConnectData *con, char *host,
+                           size_t host_length, uint16_t *port) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+
+    if (con->tcp_f) {
+        if (getpeername(con->fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+            return false;
+        }
+    } else {
+        if (con->tcd == NULL) { return false; }
+        memcpy(&addr, &con->tcd->remaddr, sizeof(addr));
+        addr_len = con->tcd->addrlen;
+    }
+
+    char service[8];
+    if (getnameinfo((struct sockaddr *)&addr, addr_len, host,
+                    (socklen_t)host_length, service, sizeof(service),
+                    NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+        return false;
+    }
+    *port = (uint16_t)strtoul(service, NULL, 10);
+    return true;
+}
+
+static void _captureClose(teoLNullCapture *capture) {
+    if (capture->file != NULL) {
+        fclose(capture->file);
+        capture->file = NULL;
+    }
+}
+
+/**
+ * Create capture file of connection and write its header
+ */
+static bool _captureOpen(teoLNullConnectData *con, const char *path,
+                         bool with_keys) {
+    char host[NI_MAXHOST];
+    uint16_t port = 0;
+    if (!_captureServer(con, host, sizeof(host), &port)) {
+        LTRACK_E("TeonetClient", "Can't get server address to capture");
+        return false;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        int error = errno;
+        LTRACK_E("TeonetClient", "Can't create capture %s: %s", path,
+                 strerror(error));
+        return false;
+    }
+    setvbuf(file, NULL, _IOFBF, CAPTURE_FILE_BUFFER_SIZE);
+
+    const size_t host_length = strlen(host);
+    const uint64_t start_time = (uint64_t)time(NULL);
+    uint8_t header[CAPTURE_HEADER_LENGTH];
+    memcpy(header, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH);
+    header[4] = TEOLNULL_CAPTURE_VERSION;
+    header[5] = con->tcp_f ? CAPTURE_FLAG_TCP : 0;
+    // Connection captured from teoLNullConnectE has no context yet
+    header[6] = con->client_crypt != NULL ? con->client_crypt->enc_proto
+                                          : teocliOpt_EncryptionProtocol;
+    header[7] = 0;
+    header[8] = (uint8_t)port;
+    header[9] = (uint8_t)(port >> 8);
+    for (int i = 0; i < 8; i++) {
+        header[10 + i] = (uint8_t)(start_time >> (8 * i));
+    }
+    header[18] = (uint8_t)host_length;
+
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+        fwrite(host, 1, host_length, file) != host_length) {
+        LTRACK_E("TeonetClient", "Can't write capture %s", path);
+        fclose(file);
+        return false;
+    }
+
+    teoLNullCapture *capture =
+        (teoLNullCapture *)ccl_malloc(sizeof(teoLNullCapture));
+    capture->file = file;
+    capture->with_keys = with_keys;
+    capture->keys_written = false;
+    capture->last_us = teoGetTimestampFull();
+    con->capture = capture;
+
+    // Session established before capture start
+    if (con->client_crypt != NULL) {
+        teoLNullCaptureKeys(capture, con->client_crypt);
+    }
+
+    LTRACK_I("TeonetClient", "Capture of %s:%u to %s started", host,
+             (unsigned)port, path);
+    return true;
+}
+
+bool teoLNullCaptureStart(teoLNullConnectData *con, const char *path,
+                          bool with_keys) {
+    if (con == NULL || path == NULL) { return false; }
+    teoLNullCaptureStop(con);
+
+    if (!con->tcp_f && con->status != CON_STATUS_NOT_CONNECTED) {
+        LTRACK_E("TeonetClient", "TR-UDP connection is captured from connect "
+                                 "only, use teoLNUllSetOption_Capture");
+        return false;
+    }
+
+    return _captureOpen(con, path, with_keys);
+}
+
+void teoLNullCaptureConnect(teoLNullConnectData *con) {
+    if (teocliOpt_CapturePath == NULL) { return; }
+
+    const uint32_t number = CAPTURE_ADD(&_captureConnections, 1) + 1;
+    const size_t path_length = strlen(teocliOpt_CapturePath) + 12;
+    char *path = (char *)ccl_malloc(path_length);
+    snprintf(path, path_length, "%s.%u", teocliOpt_CapturePath, number);
+    _captureOpen(con, path, teocliOpt_CaptureKeys);
+    free(path);
+}
+
+void teoLNullCaptureStop(teoLNullConnectData *con) {
+    if (con == NULL || con->capture == NULL) { return; }
+
+    _captureClose(con->capture);
+    free(con->capture);
+    con->capture = NULL;
+}
+
+void teoLNullCaptureWrite(teoLNullCapture *capture,
+                          teoLNullCaptureRecordType type, const void *data,
+                          size_t length) {
+    if (capture->file == NULL) { return; }
+
+    const uint64_t now_us = teoGetTimestampFull();
+    uint8_t head[1 + 2 * VARINT_MAX_LENGTH];
+    size_t head_length = 0;
+    head[head_length++] = (uint8_t)type;
+    head_length += _varintPut(head + head_length, now_us - capture->last_us);
+    head_length += _varintPut(head + head_length, length);
+    capture->last_us = now_us;
+
+    if (fwrite(head, 1, head_length, capture->file) != head_length ||
+        fwrite(data, 1, length, capture->file) != length) {
+        LTRACK_E("TeonetClient", "Capture write failed, capture stopped");
+        _captureClose(capture);
+    }
+}
+
+void teoLNullCaptureKeys(teoLNullCapture *capture,
+                         teoLNullEncryptionContext *crypt) {
+    if (!capture->with_keys || capture->keys_written) { return; }
+
+    uint8_t keys[TEOLNULL_SESSION_EXPORT_MAX_SIZE];
+    const size_t length = teoLNullEncryptionContextExportSession(crypt, keys);
+    if (length == 0) { return; }
+
+    teoLNullCaptureWrite(capture, CAPTURE_SESSION_KEYS, keys, length);
+    capture->keys_written = true;
+}
+
+/**
+ * Parse records of capture content, count them only if @a records is NULL
+ *
+ * @return Number of records or -1 if content is broken
+ */
+static ssize_t _captureParse(const uint8_t *in, const uint8_t *end,
+                             teoLNullCaptureRecord *records) {
+    size_t count = 0;
+    uint64_t time_us = 0;
+    while (in < end) {
+        const uint8_t type = *in++;
+        uint64_t delta_us = 0, length = 0;
+        if (type < CAPTURE_TCP_DATA || type > CAPTURE_SESSION_KEYS ||
+            !_varintGet(&in, end, &delta_us) ||
+            !_varintGet(&in, end, &length) || length > (uint64_t)(end - in)) {
+            return -1;
+        }
+        time_us += delta_us;
+
+        if (records != NULL) {
+            records[count].type = (teoLNullCaptureRecordType)type;
+            records[count].time_us = time_us;
+            records[count].data = in;
+            records[count].length = (size_t)length;
+        }
+        in += length;
+        count++;
+    }
+    return (ssize_t)count;
+}
+
+teoLNullCaptureFile *teoLNullCaptureLoad(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        int error = errno;
+        LTRACK_E("TeonetClient", "Can't open capture %s: %s", path,
+                 strerror(error));
+        return NULL;
+    }
+
+    uint8_t *content = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) { size = ftell(file); }
+    if (size >= CAPTURE_HEADER_LENGTH && fseek(file, 0, SEEK_SET) == 0) {
+        content = (uint8_t *)ccl_malloc((size_t)size);
+        if (fread(content, 1, (size_t)size, file) != (size_t)size) {
+            free(content);
+            content = NULL;
+        }
+    }
+    fclose(file);
+
+    if (content == NULL ||
+        memcmp(content, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH) != 0 ||
+        content[4] != TEOLNULL_CAPTURE_VERSION ||
+        content[18] > size - CAPTURE_HEADER_LENGTH) {
+        LTRACK_E("TeonetClient", "%s isn't capture of this version", path);
+        free(content);
+        return NULL;
+    }
+    const uint8_t *end = content + size;
+    const uint8_t *records = content + CAPTURE_HEADER_LENGTH + content[18];
+
+    const ssize_t count = _captureParse(records, end, NULL);
+    if (count < 0) {
+        LTRACK_E("TeonetClient", "Capture %s is broken", path);
+        free(content);
+        return NULL;
+    }
+
+    teoLNullCaptureFile *capture =
+        (teoLNullCaptureFile *)ccl_malloc(sizeof(teoLNullCaptureFile));
+    memset(capture, 0, sizeof(teoLNullCaptureFile));
+    memcpy(capture->server, content + CAPTURE_HEADER_LENGTH, content[18]);
+    capture->port = (uint16_t)(content[8] | content[9] << 8);
+    capture->tcp_f = (content[5] & CAPTURE_FLAG_TCP) != 0;
+    capture->enc_proto = (teoLNullEncryptionProtocol)content[6];
+    for (int i = 0; i < 8; i++) {
+        capture->start_time |= (int64_t)content[10 + i] << (8 * i);
+    }
+    capture->content = content;
+    capture->records_count = (size_t)count;
+    capture->records = (teoLNullCaptureRecord *)ccl_malloc(
+        (count > 0 ? count : 1) * sizeof(teoLNullCaptureRecord));
+    _captureParse(records, end, capture->records);
+
+    for (size_t i = 0; i < capture->records_count; i++) {
+        if (capture->records[i].type == CAPTURE_SESSION_KEYS) {
+            capture->keys = &capture->records[i];
+            break;
+        }
+    }
+
+    return capture;
+}
+
+void teoLNullCaptureFree(teoLNullCaptureFile *capture) {
+    if (capture == NULL) { return; }
+
+    free(capture->records);
+    free(capture->content);
+    free(capture);
+}
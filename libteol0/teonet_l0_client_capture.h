@@ -0,0 +1,163 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_CAPTURE_H
+#define TEONET_L0_CLIENT_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+#include "teonet_l0_client.h"
+#include "teonet_l0_client_crypt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Capture and replay of received byte streams
+//
+// Capture file starts with header: "TLCP" magic, format version byte,
+// flags byte (bit 0 - TCP connection), encryption protocol byte, zero byte,
+// little-endian server port (2 bytes) and capture start Unix time in seconds
+// (8 bytes), server address length byte and numeric server address. Records
+// follow: record type byte, microseconds since previous record and data
+// length as LEB128 varints, data bytes.
+/////////////////
+
+#define TEOLNULL_CAPTURE_VERSION 1
+
+/**
+ * Capture record types
+ */
+typedef enum teoLNullCaptureRecordType {
+    CAPTURE_TCP_DATA = 1, ///< Bytes of one TCP socket read
+    CAPTURE_UDP_DATAGRAM, ///< One TR-UDP datagram
+    CAPTURE_SESSION_KEYS, ///< Keys of established encrypted session
+} teoLNullCaptureRecordType;
+
+/**
+ * Capture record
+ */
+typedef struct teoLNullCaptureRecord {
+    teoLNullCaptureRecordType type;
+    uint64_t time_us; ///< Time since capture start
+    const uint8_t *data;
+    size_t length;
+} teoLNullCaptureRecord;
+
+/**
+ * Capture loaded to memory
+ */
+typedef struct teoLNullCaptureFile {
+    char server[256];                     ///< Numeric address of server
+    uint16_t port;                        ///< Server port
+    int tcp_f;                            ///< TCP or UDP flag: TCP == 1
+    teoLNullEncryptionProtocol enc_proto; ///< Encryption of connection
+    int64_t start_time;                   ///< Capture start Unix time
+
+    teoLNullCaptureRecord *records;    ///< Records in order of capture
+    size_t records_count;              ///< Number of records
+    const teoLNullCaptureRecord *keys; ///< Session keys record or NULL
+
+    uint8_t *content; ///< File content records data points to
+} teoLNullCaptureFile;
+
+/**
+ * Start capture of bytes received by connection
+ *
+ * TR-UDP replay starts from first datagram of connection, so TR-UDP
+ * connections are captured from connect by teoLNUllSetOption_Capture only.
+ * Must be called from the thread running connection event loop or while
+ * event loop isn't running.
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param path Capture file path, file is overwritten
+ * @param with_keys Record keys of encrypted session, so replay decrypts
+ *  packets. Use in test environments only, capture decrypts whole session.
+ *
+ * @return true if capture is started
+ */
+TEOCLI_API bool teoLNullCaptureStart(teoLNullConnectData *con,
+                                     const char *path, bool with_keys);
+
+/**
+ * Stop capture started by teoLNullCaptureStart and close its file, called
+ * by teoLNullDisconnect too
+ *
+ * @param con Pointer to teoLNullConnectData
+ */
+TEOCLI_API void teoLNullCaptureStop(teoLNullConnectData *con);
+
+/**
+ * Load capture file to memory
+ *
+ * @param path Capture file path
+ *
+ * @return Loaded capture or NULL if file can't be read or isn't valid
+ *  capture, free with teoLNullCaptureFree
+ */
+TEOCLI_API teoLNullCaptureFile *teoLNullCaptureLoad(const char *path);
+
+/**
+ * Free capture loaded by teoLNullCaptureLoad
+ */
+TEOCLI_API void teoLNullCaptureFree(teoLNullCaptureFile *capture);
+
+/**
+ * Create connection replaying captured bytes instead of receiving them
+ *
+ * Connection has no server, its events are sent to @a event_cb as received
+ * from server. Session keys recorded in capture are applied before any
+ * record, so encrypted packets are decrypted. Replayed TR-UDP connection
+ * sends ACK and answers to its own loopback socket, TCP connection answers
+ * aren't sent and are counted as send errors. Free with teoLNullDisconnect.
+ *
+ * @param capture Loaded capture
+ * @param event_cb Pointer to event callback function
+ * @param user_data Pointer to user data which will be send to event callback
+ *
+ * @return Pointer to teoLNullConnectData, status is CON_STATUS_SOCKET_ERROR or
+ *  CON_STATUS_ENCRYPTION_ERROR if replay can't be set up
+ */
+TEOCLI_API teoLNullConnectData *
+teoLNullReplayConnect(const teoLNullCaptureFile *capture,
+                      teoLNullEventsCb event_cb, void *user_data);
+
+/**
+ * Process captured record by connection created by teoLNullReplayConnect as
+ * if it is received from socket
+ *
+ * @param con Pointer to teoLNullConnectData
+ * @param record Capture record, session keys records are skipped
+ *
+ * @return false if replayed connection is disconnected
+ */
+TEOCLI_API bool teoLNullReplayFeed(teoLNullConnectData *con,
+                                   const teoLNullCaptureRecord *record);
+
+/**
+ * Start capture of connection being connected if teoLNUllSetOption_Capture
+ * is set, called by teoLNullConnectE when socket is ready
+ */
+TEOCLI_INTERNAL void teoLNullCaptureConnect(teoLNullConnectData *con);
+
+/**
+ * Record received bytes to capture of connection
+ */
+TEOCLI_INTERNAL void teoLNullCaptureWrite(teoLNullCapture *capture,
+                                          teoLNullCaptureRecordType type,
+                                          const void *data, size_t length);
+
+/**
+ * Record keys of established session if capture records keys
+ */
+TEOCLI_INTERNAL void teoLNullCaptureKeys(teoLNullCapture *capture,
+                                         teoLNullEncryptionContext *crypt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_CAPTURE_H */
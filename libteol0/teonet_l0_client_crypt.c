@@ -1,9 +1,86 @@
+#include "teobase/platform.h"
+
 #include "teonet_l0_client_crypt.h"
 #include "teonet_l0_client.h"
+#include "teonet_l0_client_keypool.h"
 #include "teobase/logging.h"
+#include "teobase/time.h"
+#include "teoccl/memory.h"
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Lock-free access to session state and send nonce counters
+#if defined(TEONET_COMPILER_MSVC)
+#define CRYPT_LOAD_ACQUIRE(ptr)                                                \
+    ((uint32_t)InterlockedOr((volatile LONG *)(ptr), 0))
+#define CRYPT_STORE_RELEASE(ptr, value)                                        \
+    InterlockedExchange((volatile LONG *)(ptr), (LONG)(value))
+#define CRYPT_FETCH_ADD(ptr, value)                                            \
+    ((uint32_t)InterlockedExchangeAdd((volatile LONG *)(ptr), (LONG)(value)))
+#define CRYPT_EXCHANGE(ptr, value)                                             \
+    InterlockedExchange((volatile LONG *)(ptr), (LONG)(value))
+#define CRYPT_ADD_FENCED(ptr, value)                                           \
+    InterlockedExchangeAdd((volatile LONG *)(ptr), (LONG)(value))
+#define CRYPT_LOAD_FENCED(ptr) CRYPT_LOAD_ACQUIRE(ptr)
+#define CRYPT_YIELD() SwitchToThread()
+#else
+#define CRYPT_LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define CRYPT_STORE_RELEASE(ptr, value)                                        \
+    __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define CRYPT_FETCH_ADD(ptr, value)                                            \
+    __atomic_fetch_add((ptr), (value), __ATOMIC_RELAXED)
+#define CRYPT_EXCHANGE(ptr, value)                                             \
+    __atomic_exchange_n((ptr), (value), __ATOMIC_SEQ_CST)
+#define CRYPT_ADD_FENCED(ptr, value)                                           \
+    __atomic_fetch_add((ptr), (value), __ATOMIC_SEQ_CST)
+#define CRYPT_LOAD_FENCED(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define CRYPT_YIELD() sched_yield()
+#endif
+
+// Sender waiting for its turn yields this many times, then sleeps until woken
+// by commit, so that preempted previous sender gets the CPU when threads
+// outnumber cores
+#define SEND_ORDER_YIELDS 16
+// Sleeping senders of all contexts share this many lock/condition pairs
+#define SEND_ORDER_STRIPES 16
+
+typedef struct sendOrderStripe {
+#if defined(TEONET_OS_WINDOWS)
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} sendOrderStripe;
+
+static sendOrderStripe _sendOrderStripes[SEND_ORDER_STRIPES];
+
+static void _sendOrderClose(teoLNullEncryptionContext *ctx);
+
+// Packets up to this payload size are encrypted by XOR with precomputed
+// keystream only, larger ones compute the rest of keystream inline
+#define KEYSTREAM_SLOT_SIZE 512
+
+// AEAD nonce direction byte, nonces of both directions differ with same counter
+#define AEAD_DIRECTION_CLIENT_TO_SERVER 0
+#define AEAD_DIRECTION_SERVER_TO_CLIENT 1
+
+// AEAD additional data: packet header fields except length and checksums, and
+// peer name of up to 255 bytes
+#define AEAD_HEADER_AAD_SIZE 4
+#define AEAD_MAX_AAD_SIZE (AEAD_HEADER_AAD_SIZE + UINT8_MAX)
 
 extern bool teocliOpt_DBG_packetFlow;
+extern uint32_t teocliOpt_KeystreamCacheBytes;
 
 typedef struct KeyExchangePayload_ECDH_AES_128_V1 {
     //! common.protocolId, must be ENC_PROTO_ECDH_AES_128_V1
@@ -14,6 +91,170 @@ typedef struct KeyExchangePayload_ECDH_AES_128_V1 {
     AES128_1_BLOCK salt; ///< common salt
 } KeyExchangePayload_ECDH_AES_128_V1;
 
+// ENC_PROTO_ECDH_CHACHA20_POLY1305_V2 uses the same key exchange payload
+typedef KeyExchangePayload_ECDH_AES_128_V1
+    KeyExchangePayload_ECDH_CHACHA20_POLY1305_V2;
+
+typedef struct KeyExchangePayload_X25519_CHACHA20_POLY1305_V3 {
+    //! common.protocolId, must be ENC_PROTO_X25519_CHACHA20_POLY1305_V3
+    KeyExchangePayload_Common common;
+
+    // Protocol-dependent encryption parameters
+    X25519Key pubkey;    ///< public key
+    AES128_1_BLOCK salt; ///< common salt
+} KeyExchangePayload_X25519_CHACHA20_POLY1305_V3;
+
+// Resumption payloads of all protocols, tickets are sent with actual length
+#pragma pack(push)
+#pragma pack(1)
+typedef struct KeyExchangePayload_Ticket {
+    //! common.protocolId, KEX_TYPE_TICKET and session protocol
+    KeyExchangePayload_Common common;
+
+    uint32_t lifetime_s;   ///< ticket lifetime in seconds
+    AES128_1_BLOCK nonce;  ///< resumption secret derivation nonce
+    uint8_t ticket_length; ///< opaque ticket length
+    uint8_t ticket[TEOLNULL_RESUMPTION_TICKET_MAX_SIZE];
+} KeyExchangePayload_Ticket;
+
+typedef struct KeyExchangePayload_Resume {
+    //! common.protocolId, KEX_TYPE_RESUME and session protocol
+    KeyExchangePayload_Common common;
+
+    AES128_1_BLOCK salt;   ///< fresh salt of sender
+    uint8_t ticket_length; ///< opaque ticket length, zero in server answer
+    uint8_t ticket[TEOLNULL_RESUMPTION_TICKET_MAX_SIZE];
+} KeyExchangePayload_Resume;
+#pragma pack(pop)
+
+// KEX_TYPE_RESUME_REJECT payload is KeyExchangePayload_Common only
+
+static_assert(TEOLNULL_KEX_RESUME_MAX_SIZE == sizeof(KeyExchangePayload_Resume),
+              "TEOLNULL_KEX_RESUME_MAX_SIZE must fit resume payload");
+
+/**
+ * Session key and salt of protocol key exchange keyset
+ */
+static AES128_1_KEY *_sessionKey(teoLNullEncryptionContext *ctx) {
+    return ctx->enc_proto == ENC_PROTO_X25519_CHACHA20_POLY1305_V3
+               ? &ctx->x25519Keys.sessionkey
+               : &ctx->keys.sessionkey;
+}
+
+static AES128_1_BLOCK *_sessionSalt(teoLNullEncryptionContext *ctx) {
+    return ctx->enc_proto == ENC_PROTO_X25519_CHACHA20_POLY1305_V3
+               ? &ctx->x25519Keys.sessionsalt
+               : &ctx->keys.sessionsalt;
+}
+
+static void _keystreamCacheInit(teoLNullKeystreamCache *cache,
+                                uint32_t budget, uint32_t first_nonce) {
+    cache->slots_count = budget / KEYSTREAM_SLOT_SIZE;
+    cache->data = cache->slots_count != 0
+                      ? (uint8_t *)ccl_malloc((size_t)cache->slots_count *
+                                              KEYSTREAM_SLOT_SIZE)
+                      : NULL;
+    cache->head = 0;
+    cache->ready = 0;
+    cache->first_nonce = first_nonce;
+}
+
+static void _keystreamCacheFree(teoLNullKeystreamCache *cache) {
+    if (cache->data != NULL) {
+        zero_bytes(cache->data,
+                   (size_t)cache->slots_count * KEYSTREAM_SLOT_SIZE);
+        free(cache->data);
+    }
+    memset(cache, 0, sizeof(teoLNullKeystreamCache));
+}
+
+static size_t _keystreamCacheFill(const AES128_1_SCHEDULE *schedule,
+                                  teoLNullKeystreamCache *cache,
+                                  size_t max_bytes) {
+    size_t generated = 0;
+    while (cache->ready < cache->slots_count && generated < max_bytes) {
+        uint32_t slot = (cache->head + cache->ready) % cache->slots_count;
+        uint8_t *keystream = cache->data + (size_t)slot * KEYSTREAM_SLOT_SIZE;
+
+        memset(keystream, 0, KEYSTREAM_SLOT_SIZE);
+        XCryptScheduled_AES128_1(schedule, cache->first_nonce + cache->ready,
+                                 keystream, KEYSTREAM_SLOT_SIZE);
+        cache->ready++;
+        generated += KEYSTREAM_SLOT_SIZE;
+    }
+
+    return generated;
+}
+
+/**
+ * Build AEAD nonce from direction and packet counter
+ */
+static void _aeadNonce(uint8_t direction, uint32_t counter,
+                       uint8_t nonce[CHACHA20_NONCE_SIZE]) {
+    memset(nonce, 0, CHACHA20_NONCE_SIZE);
+    nonce[0] = direction;
+    nonce[4] = (uint8_t)counter;
+    nonce[5] = (uint8_t)(counter >> 8);
+    nonce[6] = (uint8_t)(counter >> 16);
+    nonce[7] = (uint8_t)(counter >> 24);
+}
+
+/**
+ * Build AEAD additional data of encrypted @a packet: cmd, peer_name_length,
+ * reserved_1 with encrypted flag, reserved_2 and peer name
+ *
+ * @return additional data size
+ */
+static size_t _aeadAdditionalData(const teoLNullCPacket *packet,
+                                  uint8_t aad[AEAD_MAX_AAD_SIZE]) {
+    aad[0] = packet->cmd;
+    aad[1] = packet->peer_name_length;
+    aad[2] = packet->reserved_1;
+    aad[3] = packet->reserved_2;
+    memcpy(aad + AEAD_HEADER_AAD_SIZE, packet->peer_name,
+           packet->peer_name_length);
+    return AEAD_HEADER_AAD_SIZE + packet->peer_name_length;
+}
+
+/**
+ * Encrypt or decrypt with precomputed keystream if it's ready for @a nonce
+ */
+static void _keystreamXCrypt(const AES128_1_SCHEDULE *schedule,
+                             teoLNullKeystreamCache *cache, uint32_t nonce,
+                             uint8_t *data, size_t data_length) {
+    const uint32_t distance = nonce - cache->first_nonce;
+
+    if (distance >= cache->ready) {
+        // Precomputed keystream is behind the nonce, start over after it
+        if ((int32_t)distance >= 0) {
+            cache->ready = 0;
+            cache->first_nonce = nonce + 1;
+        }
+        XCryptScheduled_AES128_1(schedule, nonce, data, data_length);
+        return;
+    }
+
+    // Drop keystream of skipped nonces
+    cache->head = (cache->head + distance) % cache->slots_count;
+    cache->ready -= distance;
+
+    const uint8_t *keystream =
+        cache->data + (size_t)cache->head * KEYSTREAM_SLOT_SIZE;
+    const size_t cached = data_length < KEYSTREAM_SLOT_SIZE
+                              ? data_length
+                              : KEYSTREAM_SLOT_SIZE;
+    xor_keystream(data, keystream, cached);
+    if (data_length > cached) {
+        XCryptScheduledAt_AES128_1(schedule, nonce,
+                                   KEYSTREAM_SLOT_SIZE / AES_BLOCKLEN,
+                                   data + cached, data_length - cached);
+    }
+
+    cache->head = (cache->head + 1) % cache->slots_count;
+    cache->ready--;
+    cache->first_nonce = nonce + 1;
+}
+
 size_t teoLNullKEXBufferSize(teoLNullEncryptionProtocol enc_proto) {
     static_assert(3 == sizeof(KeyExchangePayload_Common),
                   "KeyExchangePayload_Common memory layout must be 1+2 bytes");
@@ -23,6 +264,14 @@ size_t teoLNullKEXBufferSize(teoLNullEncryptionProtocol enc_proto) {
         return sizeof(KeyExchangePayload_ECDH_AES_128_V1);
     }
 
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: {
+        return sizeof(KeyExchangePayload_ECDH_CHACHA20_POLY1305_V2);
+    }
+
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
+        return sizeof(KeyExchangePayload_X25519_CHACHA20_POLY1305_V3);
+    }
+
     default: {
         return 0;
     }
@@ -32,7 +281,8 @@ size_t teoLNullKEXBufferSize(teoLNullEncryptionProtocol enc_proto) {
 size_t teoLNullKEXCreate(teoLNullEncryptionContext *ctx, uint8_t *buffer,
                          size_t buffer_length) {
     switch (ctx->enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1: // fallthrough
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: {
         const size_t payload_len = teoLNullKEXBufferSize(ctx->enc_proto);
         if (payload_len != buffer_length) {
             LTRACK_E("TeonetClient", "Buffer size mismatch in KEXCreate");
@@ -49,6 +299,23 @@ size_t teoLNullKEXCreate(teoLNullEncryptionContext *ctx, uint8_t *buffer,
         return payload_len;
     }
 
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
+        const size_t payload_len = teoLNullKEXBufferSize(ctx->enc_proto);
+        if (payload_len != buffer_length) {
+            LTRACK_E("TeonetClient", "Buffer size mismatch in KEXCreate");
+            abort();
+        }
+
+        KeyExchangePayload_X25519_CHACHA20_POLY1305_V3 *kex =
+            (KeyExchangePayload_X25519_CHACHA20_POLY1305_V3 *)buffer;
+
+        kex->common.nul_byte = 0;
+        kex->common.protocolId = ctx->enc_proto;
+        kex->pubkey = ctx->x25519Keys.pubkeylocal;
+        kex->salt = ctx->x25519Keys.sessionsalt;
+        return payload_len;
+    }
+
     default: {
         return 0;
     }
@@ -64,29 +331,107 @@ KeyExchangePayload_Common *teoLNullKEXGetFromPayload(uint8_t *buffer,
     return (KeyExchangePayload_Common *)buffer;
 }
 
+/**
+ * Validate resumption payload, @a buffer protocolId type isn't key exchange
+ */
+static bool _resumptionValidate(teoLNullEncryptionContext *ctx,
+                                KeyExchangePayload_Common *buffer,
+                                size_t buffer_length) {
+    const teoLNullKEXType type = TEOLNULL_KEX_TYPE(buffer->protocolId);
+    const teoLNullEncryptionProtocol enc_proto =
+        TEOLNULL_KEX_PROTO(buffer->protocolId);
+
+    if (ctx == NULL || ctx->enc_proto != enc_proto) {
+        LTRACK_E("TeonetClient", "KEX_PACKET type %d proto %s(%d) mismatch",
+                 (int)type, STRING_teoLNullEncryptionProtocol(enc_proto),
+                 (int)enc_proto);
+        return false;
+    }
+
+    size_t min_len = sizeof(KeyExchangePayload_Common);
+    teoLNullEncryptedSessionState state = SESCRYPT_RESUMING;
+    switch (type) {
+    case KEX_TYPE_TICKET: {
+        min_len = offsetof(KeyExchangePayload_Ticket, ticket);
+        state = SESCRYPT_ESTABLISHED;
+        break;
+    }
+
+    case KEX_TYPE_RESUME: {
+        min_len = offsetof(KeyExchangePayload_Resume, ticket);
+        break;
+    }
+
+    case KEX_TYPE_RESUME_REJECT: {
+        break;
+    }
+
+    default: {
+        LTRACK_E("TeonetClient", "KEX_PACKET broken: Unknown type %d",
+                 (int)type);
+        return false;
+    }
+    }
+
+    if (buffer_length < min_len) {
+        LTRACK_E("TeonetClient", "KEX_PACKET type %d size %u too small",
+                 (int)type, (uint32_t)buffer_length);
+        return false;
+    }
+
+    if (type == KEX_TYPE_TICKET) {
+        const KeyExchangePayload_Ticket *kex =
+            (const KeyExchangePayload_Ticket *)buffer;
+        if (kex->ticket_length == 0 ||
+            min_len + kex->ticket_length != buffer_length) {
+            LTRACK_E("TeonetClient", "KEX_PACKET ticket size %u mismatch",
+                     (uint32_t)buffer_length);
+            return false;
+        }
+    } else if (min_len != buffer_length) {
+        LTRACK_E("TeonetClient", "KEX_PACKET type %d size %u mismatch",
+                 (int)type, (uint32_t)buffer_length);
+        return false;
+    }
+
+    if (ctx->state != state) {
+        LTRACK_E("TeonetClient", "KEX_PACKET type %d unexpected in state %s",
+                 (int)type, STRING_teoLNullEncryptedSessionState(ctx->state));
+        return false;
+    }
+    return true;
+}
+
 bool teoLNullKEXValidate(teoLNullEncryptionContext *ctx,
                          KeyExchangePayload_Common *buffer,
                          size_t buffer_length) {
+    if (TEOLNULL_KEX_TYPE(buffer->protocolId) != KEX_TYPE_KEY_EXCHANGE) {
+        return _resumptionValidate(ctx, buffer, buffer_length);
+    }
+
     switch (buffer->protocolId) {
     case ENC_PROTO_DISABLED: {
         LTRACK_E("TeonetClient", "KEX_PACKET broken ENC_PROTO_DISABLED");
         return false;
     }
 
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1:           // fallthrough
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: // fallthrough
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
+        const char *proto_name =
+            STRING_teoLNullEncryptionProtocol(buffer->protocolId);
         const size_t kex_len = teoLNullKEXBufferSize(buffer->protocolId);
         if (kex_len != buffer_length) {
             LTRACK_E("TeonetClient",
-                     "KEX_PACKET broken ECDH_AES_128_V1 size %u mismatch "
-                     "buffer %u bytes",
-                     (uint32_t)kex_len, (uint32_t)buffer_length);
+                     "KEX_PACKET broken %s size %u mismatch buffer %u bytes",
+                     proto_name, (uint32_t)kex_len, (uint32_t)buffer_length);
             return false;
         }
 
         if (ctx && ctx->enc_proto != buffer->protocolId) {
             LTRACK_E("TeonetClient",
-                     "KEX_PACKET broken ECDH_AES_128_V1 proto mismatch "
-                     "ctx %s(%d)",
+                     "KEX_PACKET broken %s proto mismatch ctx %s(%d)",
+                     proto_name,
                      STRING_teoLNullEncryptionProtocol(ctx->enc_proto),
                      (int)ctx->enc_proto);
             return false;
@@ -105,7 +450,9 @@ bool teoLNullKEXValidate(teoLNullEncryptionContext *ctx,
 
 size_t teoLNullEncryptionContextSize(teoLNullEncryptionProtocol enc_proto) {
     switch (enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1:           // fallthrough
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: // fallthrough
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
         return sizeof(teoLNullEncryptionContext);
     }
 
@@ -118,7 +465,9 @@ size_t teoLNullEncryptionContextSize(teoLNullEncryptionProtocol enc_proto) {
 size_t teoLNullEncryptionContextCreate(teoLNullEncryptionProtocol enc_proto,
                                        uint8_t *buffer, size_t buffer_length) {
     switch (enc_proto) {
-    case ENC_PROTO_ECDH_AES_128_V1: {
+    case ENC_PROTO_ECDH_AES_128_V1:           // fallthrough
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: // fallthrough
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
         if (buffer_length != sizeof(teoLNullEncryptionContext)) {
             LTRACK_E("TeonetClient",
                      "Buffer size mismatch in EncryptioContextCreate");
@@ -129,9 +478,31 @@ size_t teoLNullEncryptionContextCreate(teoLNullEncryptionProtocol enc_proto,
         ctx->enc_proto = enc_proto;
         ctx->receiveNonce = 1;
         ctx->sendNonce = 1;
+        ctx->sendCommitted = 1;
+        ctx->sendWaiters = 0;
+        ctx->sendSleepers = 0;
+        ctx->sendClosed = 0;
         ctx->state = SESCRYPT_PENDING;
-        initPeerKeys(&ctx->keys);
+        // Generate keys of protocol key exchange only
+        if (enc_proto == ENC_PROTO_X25519_CHACHA20_POLY1305_V3) {
+            zero_bytes((uint8_t *)&ctx->keys, sizeof(ctx->keys));
+            initPeerKeys_X25519(&ctx->x25519Keys);
+        } else {
+            // Pre-generated keypair if pool is enabled and not empty
+            if (!teoLNullKeyPoolTake(&ctx->keys)) {
+                initPeerKeys(&ctx->keys);
+            }
+            zero_bytes((uint8_t *)&ctx->x25519Keys, sizeof(ctx->x25519Keys));
+        }
+        zero_bytes(ctx->sessionSchedule.round_keys,
+                   sizeof(ctx->sessionSchedule.round_keys));
+        zero_bytes(ctx->aeadKey.data, sizeof(ctx->aeadKey.data));
+        memset(&ctx->sendKeystream, 0, sizeof(ctx->sendKeystream));
+        memset(&ctx->receiveKeystream, 0, sizeof(ctx->receiveKeystream));
+        zero_bytes((uint8_t *)&ctx->ticket, sizeof(ctx->ticket));
         teomutexInitialize(&ctx->encryptionGuard);
+        teomutexInitialize(&ctx->sendGuard);
+        teomutexInitialize(&ctx->receiveGuard);
 
         return sizeof(teoLNullEncryptionContext);
     }
@@ -144,12 +515,153 @@ size_t teoLNullEncryptionContextCreate(teoLNullEncryptionProtocol enc_proto,
 
 TEOCLI_API void
 teoLNullEncryptionContextDestroy(teoLNullEncryptionContext *ctx) {
+    _sendOrderClose(ctx);
     ctx->enc_proto = ENC_PROTO_DISABLED;
     ctx->receiveNonce = -1;
     ctx->sendNonce = -1;
+    ctx->sendCommitted = -1;
     ctx->state = SESCRYPT_PENDING;
-    initPeerKeys(&ctx->keys);
+    zero_bytes((uint8_t *)&ctx->keys, sizeof(ctx->keys));
+    zero_bytes((uint8_t *)&ctx->x25519Keys, sizeof(ctx->x25519Keys));
+    zero_bytes(ctx->sessionSchedule.round_keys,
+               sizeof(ctx->sessionSchedule.round_keys));
+    zero_bytes(ctx->aeadKey.data, sizeof(ctx->aeadKey.data));
+    _keystreamCacheFree(&ctx->sendKeystream);
+    _keystreamCacheFree(&ctx->receiveKeystream);
+    zero_bytes((uint8_t *)&ctx->ticket, sizeof(ctx->ticket));
     teomutexDestroy(&ctx->encryptionGuard);
+    teomutexDestroy(&ctx->sendGuard);
+    teomutexDestroy(&ctx->receiveGuard);
+}
+
+/**
+ * Prepare encryption keys from session key of protocol keyset and switch
+ * context to SESCRYPT_ESTABLISHED, once per context
+ */
+static void _contextEstablished(teoLNullEncryptionContext *ctx) {
+    if (ctx->enc_proto == ENC_PROTO_ECDH_AES_128_V1) {
+        ExpandKey_AES128_1(_sessionKey(ctx), &ctx->sessionSchedule);
+        _keystreamCacheFree(&ctx->sendKeystream);
+        _keystreamCacheFree(&ctx->receiveKeystream);
+        _keystreamCacheInit(&ctx->sendKeystream, teocliOpt_KeystreamCacheBytes,
+                            ctx->sendNonce);
+        _keystreamCacheInit(&ctx->receiveKeystream,
+                            teocliOpt_KeystreamCacheBytes, ctx->receiveNonce);
+    } else {
+        // Session key is 16 bytes, stretch it to 32 bytes ChaCha20 key
+        PBKDF2_AES128_1(_sessionKey(ctx), _sessionSalt(ctx), 1,
+                        ctx->aeadKey.data, sizeof(ctx->aeadKey.data));
+    }
+    // Keys are read-only from now, halves read them after state
+    CRYPT_STORE_RELEASE(&ctx->state, SESCRYPT_ESTABLISHED);
+}
+
+size_t teoLNullKEXCreateResume(teoLNullEncryptionContext *ctx,
+                               const teoLNullResumptionTicket *ticket,
+                               uint8_t *buffer, size_t buffer_length) {
+    if (ctx->state != SESCRYPT_PENDING || ticket->enc_proto != ctx->enc_proto ||
+        ticket->ticket_length == 0 ||
+        ticket->expires_ms <= teotimeGetCurrentTimeMs()) {
+        return 0;
+    }
+
+    const size_t payload_len =
+        offsetof(KeyExchangePayload_Resume, ticket) + ticket->ticket_length;
+    if (payload_len > buffer_length) {
+        LTRACK_E("TeonetClient", "Buffer too small in KEXCreateResume");
+        return 0;
+    }
+
+    KeyExchangePayload_Resume *kex = (KeyExchangePayload_Resume *)buffer;
+    kex->common.nul_byte = 0;
+    kex->common.protocolId = TEOLNULL_KEX_ID(KEX_TYPE_RESUME, ctx->enc_proto);
+    // Salt of context is fresh random, sent in regular KEX otherwise
+    kex->salt = *_sessionSalt(ctx);
+    kex->ticket_length = ticket->ticket_length;
+    memcpy(kex->ticket, ticket->ticket, ticket->ticket_length);
+
+    ctx->ticket = *ticket;
+    ctx->state = SESCRYPT_RESUMING;
+    return payload_len;
+}
+
+/**
+ * Apply validated resumption payload
+ */
+static bool _resumptionApply(teoLNullEncryptionContext *ctx,
+                             KeyExchangePayload_Common *buffer) {
+    switch (TEOLNULL_KEX_TYPE(buffer->protocolId)) {
+    case KEX_TYPE_TICKET: {
+        KeyExchangePayload_Ticket *kex = (KeyExchangePayload_Ticket *)buffer;
+
+        ctx->ticket.enc_proto = ctx->enc_proto;
+        ctx->ticket.expires_ms =
+            teotimeGetCurrentTimeMs() + (int64_t)kex->lifetime_s * 1000;
+        initResumptionSecret(_sessionKey(ctx), &kex->nonce,
+                             &ctx->ticket.secret);
+        ctx->ticket.ticket_length = kex->ticket_length;
+        memcpy(ctx->ticket.ticket, kex->ticket, kex->ticket_length);
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "KEX_PACKET ticket for %u seconds", kex->lifetime_s);
+        return true;
+    }
+
+    case KEX_TYPE_RESUME: {
+        KeyExchangePayload_Resume *kex = (KeyExchangePayload_Resume *)buffer;
+
+        const AES128_1_BLOCK client_salt = *_sessionSalt(ctx);
+        initResumedSessionKey(&ctx->ticket.secret, &client_salt, &kex->salt,
+                              _sessionKey(ctx), _sessionSalt(ctx));
+        zero_bytes((uint8_t *)&ctx->ticket, sizeof(ctx->ticket));
+        _contextEstablished(ctx);
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "KEX_PACKET session resumed");
+        return true;
+    }
+
+    case KEX_TYPE_RESUME_REJECT: {
+        zero_bytes((uint8_t *)&ctx->ticket, sizeof(ctx->ticket));
+        ctx->state = SESCRYPT_PENDING;
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "KEX_PACKET resumption rejected");
+        return true;
+    }
+
+    default: {
+        // Already checked in teoLNullKEXValidate
+        return false;
+    }
+    }
+}
+
+/**
+ * Check repeated KEX payload of established session, keys are read-only by
+ * then, so payload must be the one already applied
+ */
+static bool _kexReconfirm(teoLNullEncryptionContext *ctx,
+                          KeyExchangePayload_Common *buffer) {
+    bool same = false;
+    if (buffer->protocolId == ENC_PROTO_X25519_CHACHA20_POLY1305_V3) {
+        KeyExchangePayload_X25519_CHACHA20_POLY1305_V3 *kex =
+            (KeyExchangePayload_X25519_CHACHA20_POLY1305_V3 *)buffer;
+        same = memcmp(&kex->pubkey, &ctx->x25519Keys.pubkeyremote,
+                      sizeof(kex->pubkey)) == 0 &&
+               memcmp(&kex->salt, &ctx->x25519Keys.sessionsalt,
+                      sizeof(kex->salt)) == 0;
+    } else {
+        KeyExchangePayload_ECDH_AES_128_V1 *kex =
+            (KeyExchangePayload_ECDH_AES_128_V1 *)buffer;
+        same = memcmp(&kex->pubkey, &ctx->keys.pubkeyremote,
+                      sizeof(kex->pubkey)) == 0 &&
+               memcmp(&kex->salt, &ctx->keys.sessionsalt,
+                      sizeof(kex->salt)) == 0;
+    }
+
+    if (!same) {
+        LTRACK_E("TeonetClient",
+                 "KEX_PACKET differs from applied in established session");
+    }
+    return same;
 }
 
 bool teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
@@ -160,6 +672,14 @@ bool teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
         return false;
     }
 
+    if (TEOLNULL_KEX_TYPE(buffer->protocolId) != KEX_TYPE_KEY_EXCHANGE) {
+        return _resumptionApply(ctx, buffer);
+    }
+
+    if (ctx->state == SESCRYPT_ESTABLISHED) {
+        return _kexReconfirm(ctx, buffer);
+    }
+
     switch (buffer->protocolId) {
     case ENC_PROTO_ECDH_AES_128_V1: {
         KeyExchangePayload_ECDH_AES_128_V1 *kex =
@@ -172,13 +692,51 @@ bool teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
                      "KEX_PACKET ECDH_AES_128_V1 failed apply: %s", err);
             return false;
         }
-        ctx->state = SESCRYPT_ESTABLISHED;
+        _contextEstablished(ctx);
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                 "KEX_PACKET ECDH_AES_128_V1");
 
         return true;
     }
 
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: {
+        KeyExchangePayload_ECDH_CHACHA20_POLY1305_V2 *kex =
+            (KeyExchangePayload_ECDH_CHACHA20_POLY1305_V2 *)buffer;
+
+        const char *err =
+            initApplyRemoteKey(&ctx->keys, &kex->pubkey, &kex->salt);
+        if (err != NULL) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET ECDH_CHACHA20_POLY1305_V2 failed apply: %s",
+                     err);
+            return false;
+        }
+        _contextEstablished(ctx);
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "KEX_PACKET ECDH_CHACHA20_POLY1305_V2");
+
+        return true;
+    }
+
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
+        KeyExchangePayload_X25519_CHACHA20_POLY1305_V3 *kex =
+            (KeyExchangePayload_X25519_CHACHA20_POLY1305_V3 *)buffer;
+
+        const char *err = initApplyRemoteKey_X25519(&ctx->x25519Keys,
+                                                    &kex->pubkey, &kex->salt);
+        if (err != NULL) {
+            LTRACK_E("TeonetClient",
+                     "KEX_PACKET X25519_CHACHA20_POLY1305_V3 failed apply: %s",
+                     err);
+            return false;
+        }
+        _contextEstablished(ctx);
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "KEX_PACKET X25519_CHACHA20_POLY1305_V3");
+
+        return true;
+    }
+
     default: {
         // Already checked in teoLNullKEXValidate
         return false;
@@ -186,6 +744,96 @@ bool teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
     }
 }
 
+/**
+ * Public key of server in protocol key exchange keyset
+ */
+static uint8_t *_remotePubkey(teoLNullEncryptionContext *ctx, size_t *size) {
+    if (ctx->enc_proto == ENC_PROTO_X25519_CHACHA20_POLY1305_V3) {
+        *size = sizeof(ctx->x25519Keys.pubkeyremote);
+        return ctx->x25519Keys.pubkeyremote.data;
+    }
+    *size = sizeof(ctx->keys.pubkeyremote);
+    return ctx->keys.pubkeyremote.data;
+}
+
+size_t teoLNullEncryptionContextExportSession(teoLNullEncryptionContext *ctx,
+                                              uint8_t *buffer) {
+    if (CRYPT_LOAD_ACQUIRE(&ctx->state) != SESCRYPT_ESTABLISHED) { return 0; }
+
+    size_t pubkey_size = 0;
+    const uint8_t *pubkey = _remotePubkey(ctx, &pubkey_size);
+
+    uint8_t *out = buffer;
+    *out++ = (uint8_t)ctx->enc_proto;
+    memcpy(out, _sessionKey(ctx), sizeof(AES128_1_KEY));
+    out += sizeof(AES128_1_KEY);
+    memcpy(out, _sessionSalt(ctx), sizeof(AES128_1_BLOCK));
+    out += sizeof(AES128_1_BLOCK);
+    memcpy(out, pubkey, pubkey_size);
+    out += pubkey_size;
+
+    return (size_t)(out - buffer);
+}
+
+bool teoLNullEncryptionContextImportSession(teoLNullEncryptionContext *ctx,
+                                            const uint8_t *buffer,
+                                            size_t buffer_length) {
+    size_t pubkey_size = 0;
+    uint8_t *pubkey = _remotePubkey(ctx, &pubkey_size);
+
+    if (ctx->state != SESCRYPT_PENDING || buffer_length == 0 ||
+        buffer[0] != ctx->enc_proto ||
+        buffer_length != 1 + sizeof(AES128_1_KEY) + sizeof(AES128_1_BLOCK) +
+                             pubkey_size) {
+        LTRACK_E("TeonetClient", "Exported session doesn't match context");
+        return false;
+    }
+
+    const uint8_t *in = buffer + 1;
+    memcpy(_sessionKey(ctx), in, sizeof(AES128_1_KEY));
+    in += sizeof(AES128_1_KEY);
+    memcpy(_sessionSalt(ctx), in, sizeof(AES128_1_BLOCK));
+    in += sizeof(AES128_1_BLOCK);
+    memcpy(pubkey, in, pubkey_size);
+
+    _contextEstablished(ctx);
+    return true;
+}
+
+size_t teoLNullEncryptionContextPrecompute(teoLNullEncryptionContext *ctx,
+                                           size_t max_bytes) {
+    if (CRYPT_LOAD_ACQUIRE(&ctx->state) != SESCRYPT_ESTABLISHED ||
+        ctx->enc_proto != ENC_PROTO_ECDH_AES_128_V1) {
+        return 0;
+    }
+
+    // Sending is usually more latency sensitive, fill it first
+    teomutexLock(&ctx->sendGuard);
+    size_t generated = _keystreamCacheFill(&ctx->sessionSchedule,
+                                           &ctx->sendKeystream, max_bytes);
+    teomutexUnlock(&ctx->sendGuard);
+
+    teomutexLock(&ctx->receiveGuard);
+    generated += _keystreamCacheFill(&ctx->sessionSchedule,
+                                     &ctx->receiveKeystream,
+                                     max_bytes - generated);
+    teomutexUnlock(&ctx->receiveGuard);
+    return generated;
+}
+
+size_t teoLNullEncryptionOverhead(teoLNullEncryptionProtocol enc_proto) {
+    switch (enc_proto) {
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: // fallthrough
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
+        return POLY1305_TAG_SIZE;
+    }
+
+    default: {
+        return 0;
+    }
+    }
+}
+
 const uint32_t PACKET_ENCRYPTED_FLAG = 0x80;
 
 bool teoLNullPacketIsEncrypted(teoLNullCPacket *packet) {
@@ -201,20 +849,62 @@ inline static void _packetSetIsEncrypted(teoLNullCPacket *packet, bool is_encryp
     }
 }
 
+bool teoLNullPacketEncryptionFits(const teoLNullEncryptionContext *ctx,
+                                  const teoLNullCPacket *packet,
+                                  size_t capacity) {
+    // enc_proto is set once at context creation, so result doesn't depend on
+    // whether session is established already
+    const size_t overhead =
+        ctx != NULL ? teoLNullEncryptionOverhead(ctx->enc_proto) : 0;
+    if (overhead == 0 || packet->data_length == 0) { return true; }
+
+    return packet->data_length <= UINT16_MAX - overhead &&
+           teoLNullBufferSize(packet->peer_name_length, packet->data_length) +
+                   overhead <=
+               capacity;
+}
+
 void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *packet) {
+    // Buffer size isn't known, so nothing may be appended to packet data
+    teoLNullPacketEncryptBuffer(
+        ctx, packet,
+        teoLNullBufferSize(packet->peer_name_length, packet->data_length));
+}
+
+bool teoLNullPacketEncryptBuffer(teoLNullEncryptionContext *ctx,
+                                 teoLNullCPacket *packet, size_t capacity) {
+    if (!teoLNullPacketEncryptionFits(ctx, packet, capacity)) {
+        LTRACK_E("TeonetClient",
+                 "Packet data of %u bytes with %s tag doesn't fit to %u bytes "
+                 "buffer",
+                 (uint32_t)packet->data_length,
+                 STRING_teoLNullEncryptionProtocol(ctx->enc_proto),
+                 (uint32_t)capacity);
+        return false;
+    }
+
+    uint32_t nonce;
+    teoLNullPacketEncryptOrdered(ctx, packet, &nonce);
+    return true;
+}
+
+bool teoLNullPacketEncryptOrdered(teoLNullEncryptionContext *ctx,
+                                  teoLNullCPacket *packet, uint32_t *nonce) {
     if (ctx == NULL) {
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                 "Skip encryption - NO CTX");
-        return;
+        return false;
     }
 
-    if (ctx->state != SESCRYPT_ESTABLISHED) {
+    const teoLNullEncryptedSessionState state = CRYPT_LOAD_ACQUIRE(&ctx->state);
+    if (state != SESCRYPT_ESTABLISHED) {
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                 "Skip - CTX_STATE %s (%d)\n",
-                STRING_teoLNullEncryptedSessionState(ctx->state), (int)ctx->state);
-        return;
+                STRING_teoLNullEncryptedSessionState(state), (int)state);
+        return false;
     }
 
+    bool encrypted = false;
     switch (ctx->enc_proto) {
     case ENC_PROTO_DISABLED: {
         CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
@@ -223,12 +913,21 @@ void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
 
     case ENC_PROTO_ECDH_AES_128_V1: {
         if (packet->data_length) {
-            XCrypt_AES128_1(&ctx->keys.sessionkey, ctx->sendNonce,
-                            teoLNullPacketGetPayload(packet),
-                            packet->data_length);
+            *nonce = CRYPT_FETCH_ADD(&ctx->sendNonce, 1);
+            if (ctx->sendKeystream.slots_count != 0) {
+                teomutexLock(&ctx->sendGuard);
+                _keystreamXCrypt(&ctx->sessionSchedule, &ctx->sendKeystream,
+                                 *nonce, teoLNullPacketGetPayload(packet),
+                                 packet->data_length);
+                teomutexUnlock(&ctx->sendGuard);
+            } else {
+                XCryptScheduled_AES128_1(&ctx->sessionSchedule, *nonce,
+                                         teoLNullPacketGetPayload(packet),
+                                         packet->data_length);
+            }
 
             _packetSetIsEncrypted(packet, true);
-            ctx->sendNonce++;
+            encrypted = true;
             CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                     "Encrypted - ENC_PROTO_ECDH_AES_128_V1");
         } else {
@@ -237,6 +936,41 @@ void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
         }
     } break;
 
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: // fallthrough
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
+        if (packet->data_length) {
+            // Callers check teoLNullPacketEncryptionFits, packet is left
+            // unchanged if they didn't
+            if (packet->data_length > UINT16_MAX - POLY1305_TAG_SIZE) {
+                LTRACK_E("TeonetClient",
+                         "Packet data of %u bytes is too large for AEAD tag",
+                         (uint32_t)packet->data_length);
+                return false;
+            }
+
+            _packetSetIsEncrypted(packet, true);
+
+            *nonce = CRYPT_FETCH_ADD(&ctx->sendNonce, 1);
+            uint8_t aead_nonce[CHACHA20_NONCE_SIZE];
+            _aeadNonce(AEAD_DIRECTION_CLIENT_TO_SERVER, *nonce, aead_nonce);
+            uint8_t aad[AEAD_MAX_AAD_SIZE];
+            const size_t aad_len = _aeadAdditionalData(packet, aad);
+
+            uint8_t *payload = teoLNullPacketGetPayload(packet);
+            Seal_CHACHA20_POLY1305(&ctx->aeadKey, aead_nonce, aad, aad_len,
+                                   payload, packet->data_length,
+                                   payload + packet->data_length);
+            packet->data_length += POLY1305_TAG_SIZE;
+            encrypted = true;
+
+            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "Encrypted - %s",
+                    STRING_teoLNullEncryptionProtocol(ctx->enc_proto));
+        } else {
+            CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
+                    "Skip - NO_DATA_TO_ENCRYPT\n");
+        }
+    } break;
+
     default: {
         // Invalid/unknown encryption
         LTRACK("TeonetClient", "Unexpected teoLNullEncryptionProtocol (%d)",
@@ -244,39 +978,160 @@ void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
         abort();
     } break;
     }
+
+    return encrypted;
 }
 
-bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *packet) {
-    // HINT: check is_encrypted flag first
-    const bool encrypted = teoLNullPacketIsEncrypted(packet);
-    if (!encrypted) {
-        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "Skip - NOT_ENCRYPTED\n");
-        // unencrypted packets always return success
-        return true;
+#if defined(TEONET_OS_WINDOWS)
+static INIT_ONCE _sendOrderOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK _sendOrderInitOnce(PINIT_ONCE once, PVOID param,
+                                        PVOID *context) {
+    for (int i = 0; i < SEND_ORDER_STRIPES; i++) {
+        InitializeCriticalSection(&_sendOrderStripes[i].lock);
+        InitializeConditionVariable(&_sendOrderStripes[i].cond);
     }
+    return TRUE;
+}
 
-    if (ctx == NULL) {
-        // TODO : separate log control
-        CLTRACK_E(teocliOpt_DBG_packetFlow, "TeonetClient", "Skip - NO CTX");
-        return false;
+static void _sendOrderInit(void) {
+    InitOnceExecuteOnce(&_sendOrderOnce, _sendOrderInitOnce, NULL, NULL);
+}
+
+static void _sendOrderLock(sendOrderStripe *stripe) {
+    EnterCriticalSection(&stripe->lock);
+}
+
+static void _sendOrderUnlock(sendOrderStripe *stripe) {
+    LeaveCriticalSection(&stripe->lock);
+}
+
+static void _sendOrderSleep(sendOrderStripe *stripe) {
+    SleepConditionVariableCS(&stripe->cond, &stripe->lock, INFINITE);
+}
+
+static void _sendOrderWake(sendOrderStripe *stripe) {
+    WakeAllConditionVariable(&stripe->cond);
+}
+#else
+static pthread_once_t _sendOrderOnce = PTHREAD_ONCE_INIT;
+
+static void _sendOrderInitOnce(void) {
+    for (int i = 0; i < SEND_ORDER_STRIPES; i++) {
+        pthread_mutex_init(&_sendOrderStripes[i].lock, NULL);
+        pthread_cond_init(&_sendOrderStripes[i].cond, NULL);
     }
+}
 
-    if (ctx->state != SESCRYPT_ESTABLISHED) {
-        // TODO : separate log control
-        CLTRACK_E(teocliOpt_DBG_packetFlow, "TeonetClient",
-                "Skip - CTX_STATE %s (%d)\n",
-                STRING_teoLNullEncryptedSessionState(ctx->state), (int)ctx->state);
-        return false;
+static void _sendOrderInit(void) {
+    pthread_once(&_sendOrderOnce, _sendOrderInitOnce);
+}
+
+static void _sendOrderLock(sendOrderStripe *stripe) {
+    pthread_mutex_lock(&stripe->lock);
+}
+
+static void _sendOrderUnlock(sendOrderStripe *stripe) {
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+static void _sendOrderSleep(sendOrderStripe *stripe) {
+    pthread_cond_wait(&stripe->cond, &stripe->lock);
+}
+
+static void _sendOrderWake(sendOrderStripe *stripe) {
+    pthread_cond_broadcast(&stripe->cond);
+}
+#endif
+
+static sendOrderStripe *_sendOrderStripe(teoLNullEncryptionContext *ctx) {
+    return &_sendOrderStripes[((uintptr_t)ctx >> 6) % SEND_ORDER_STRIPES];
+}
+
+/**
+ * Wait for turn of @a nonce until context is closed
+ *
+ * @return false if context is closed
+ */
+static bool _sendOrderWaitTurn(teoLNullEncryptionContext *ctx,
+                               uint32_t nonce) {
+    // Previous sender has reserved its nonce and is encrypting or sending
+    // already, so the wait is short unless it was preempted
+    for (int i = 0; i < SEND_ORDER_YIELDS; i++) {
+        CRYPT_YIELD();
+        if (CRYPT_LOAD_ACQUIRE(&ctx->sendCommitted) == nonce) { return true; }
+        if (CRYPT_LOAD_ACQUIRE(&ctx->sendClosed) != 0) { return false; }
+    }
+
+    _sendOrderInit();
+    sendOrderStripe *stripe = _sendOrderStripe(ctx);
+
+    // Sleepers counter is published before sendCommitted is checked, commit
+    // updates sendCommitted before it checks sleepers, so wakeup isn't lost.
+    // Close sets sendClosed before it wakes the stripe under its lock
+    _sendOrderLock(stripe);
+    CRYPT_ADD_FENCED(&ctx->sendSleepers, 1);
+    bool closed = false;
+    while (CRYPT_LOAD_FENCED(&ctx->sendCommitted) != nonce) {
+        closed = CRYPT_LOAD_FENCED(&ctx->sendClosed) != 0;
+        if (closed) { break; }
+        _sendOrderSleep(stripe);
     }
+    CRYPT_ADD_FENCED(&ctx->sendSleepers, -1);
+    _sendOrderUnlock(stripe);
+    return !closed;
+}
+
+bool teoLNullSendOrderWait(teoLNullEncryptionContext *ctx, uint32_t nonce) {
+    if (CRYPT_LOAD_ACQUIRE(&ctx->sendCommitted) == nonce) { return true; }
+
+    // Context isn't torn down while counted waiters may access it
+    CRYPT_ADD_FENCED(&ctx->sendWaiters, 1);
+    const bool turn = _sendOrderWaitTurn(ctx, nonce);
+    CRYPT_ADD_FENCED(&ctx->sendWaiters, -1);
+    return turn;
+}
 
+/**
+ * Fail waits of senders for their turn and wait until they leave, nonces
+ * they wait for will never be committed
+ */
+static void _sendOrderClose(teoLNullEncryptionContext *ctx) {
+    CRYPT_EXCHANGE(&ctx->sendClosed, 1);
+
+    _sendOrderInit();
+    sendOrderStripe *stripe = _sendOrderStripe(ctx);
+    _sendOrderLock(stripe);
+    _sendOrderWake(stripe);
+    _sendOrderUnlock(stripe);
+
+    while (CRYPT_LOAD_FENCED(&ctx->sendWaiters) != 0) { CRYPT_YIELD(); }
+}
+
+void teoLNullSendOrderCommit(teoLNullEncryptionContext *ctx, uint32_t nonce) {
+    CRYPT_EXCHANGE(&ctx->sendCommitted, nonce + 1);
+    if (CRYPT_LOAD_FENCED(&ctx->sendSleepers) != 0) {
+        sendOrderStripe *stripe = _sendOrderStripe(ctx);
+        _sendOrderLock(stripe);
+        _sendOrderWake(stripe);
+        _sendOrderUnlock(stripe);
+    }
+}
+
+/**
+ * Decrypt packet with receive half locked
+ */
+static bool _packetDecrypt(teoLNullEncryptionContext *ctx,
+                           teoLNullCPacket *packet) {
     // encrypted packet
     switch (ctx->enc_proto) {
     case ENC_PROTO_ECDH_AES_128_V1: {
         // decrypt packet payload
         if (packet->data_length) {
-            XCrypt_AES128_1(&ctx->keys.sessionkey, ctx->receiveNonce,
-                            teoLNullPacketGetPayload(packet),
-                            packet->data_length);
+            _keystreamXCrypt(&ctx->sessionSchedule, &ctx->receiveKeystream,
+                             ctx->receiveNonce,
+                             teoLNullPacketGetPayload(packet),
+                             packet->data_length);
             CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient",
                     "Decrypted - ENC_PROTO_ECDH_AES_128_V1");
             // Not encrypted anymore, clear is_encrypted flag
@@ -289,6 +1144,37 @@ bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
         }
     } break;
 
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: // fallthrough
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3: {
+        if (packet->data_length < POLY1305_TAG_SIZE) {
+            CLTRACK_E(teocliOpt_DBG_packetFlow, "TeonetClient",
+                      "Broken - NO_AEAD_TAG");
+            return false;
+        }
+
+        uint8_t nonce[CHACHA20_NONCE_SIZE];
+        _aeadNonce(AEAD_DIRECTION_SERVER_TO_CLIENT, ctx->receiveNonce, nonce);
+        uint8_t aad[AEAD_MAX_AAD_SIZE];
+        const size_t aad_len = _aeadAdditionalData(packet, aad);
+
+        uint8_t *payload = teoLNullPacketGetPayload(packet);
+        const uint16_t message_length =
+            packet->data_length - POLY1305_TAG_SIZE;
+        if (!Open_CHACHA20_POLY1305(&ctx->aeadKey, nonce, aad, aad_len,
+                                    payload, message_length,
+                                    payload + message_length)) {
+            CLTRACK_E(teocliOpt_DBG_packetFlow, "TeonetClient",
+                      "Broken - AEAD_TAG_MISMATCH");
+            return false;
+        }
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "Decrypted - %s",
+                STRING_teoLNullEncryptionProtocol(ctx->enc_proto));
+
+        packet->data_length = message_length;
+        _packetSetIsEncrypted(packet, false);
+        ctx->receiveNonce++;
+    } break;
+
     case ENC_PROTO_DISABLED: {
         // TODO : separate log control
         // encryption disabled
@@ -308,10 +1194,44 @@ bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *pack
     return true;
 }
 
+bool teoLNullPacketDecrypt(teoLNullEncryptionContext *ctx, teoLNullCPacket *packet) {
+    // HINT: check is_encrypted flag first
+    const bool encrypted = teoLNullPacketIsEncrypted(packet);
+    if (!encrypted) {
+        CLTRACK(teocliOpt_DBG_packetFlow, "TeonetClient", "Skip - NOT_ENCRYPTED\n");
+        // unencrypted packets always return success
+        return true;
+    }
+
+    if (ctx == NULL) {
+        // TODO : separate log control
+        CLTRACK_E(teocliOpt_DBG_packetFlow, "TeonetClient", "Skip - NO CTX");
+        return false;
+    }
+
+    const teoLNullEncryptedSessionState state = CRYPT_LOAD_ACQUIRE(&ctx->state);
+    if (state != SESCRYPT_ESTABLISHED) {
+        // TODO : separate log control
+        CLTRACK_E(teocliOpt_DBG_packetFlow, "TeonetClient",
+                "Skip - CTX_STATE %s (%d)\n",
+                STRING_teoLNullEncryptedSessionState(state), (int)state);
+        return false;
+    }
+
+    teomutexLock(&ctx->receiveGuard);
+    const bool result = _packetDecrypt(ctx, packet);
+    teomutexUnlock(&ctx->receiveGuard);
+    return result;
+}
+
 const char *STRING_teoLNullEncryptionProtocol(teoLNullEncryptionProtocol v) {
     switch (v) {
     case ENC_PROTO_DISABLED: return "ENC_PROTO_DISABLED";
     case ENC_PROTO_ECDH_AES_128_V1: return "ENC_PROTO_ECDH_AES_128_V1";
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2:
+        return "ENC_PROTO_ECDH_CHACHA20_POLY1305_V2";
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3:
+        return "ENC_PROTO_X25519_CHACHA20_POLY1305_V3";
     default: break;
     }
 
@@ -323,6 +1243,7 @@ STRING_teoLNullEncryptedSessionState(teoLNullEncryptedSessionState v) {
     switch (v) {
     case SESCRYPT_PENDING: return "SESCRYPT_PENDING";
     case SESCRYPT_ESTABLISHED: return "SESCRYPT_ESTABLISHED";
+    case SESCRYPT_RESUMING: return "SESCRYPT_RESUMING";
     default: break;
     }
 
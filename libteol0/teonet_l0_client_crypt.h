@@ -23,6 +23,10 @@ typedef enum teoLNullEncryptionProtocol {
     ENC_PROTO_DISABLED = 0,
     //! First implementation protocol
     ENC_PROTO_ECDH_AES_128_V1 = 1,
+    //! ECDH key exchange of V1, ChaCha20-Poly1305 AEAD with 16 bytes tag
+    ENC_PROTO_ECDH_CHACHA20_POLY1305_V2 = 2,
+    //! X25519 key exchange, encryption of ENC_PROTO_ECDH_CHACHA20_POLY1305_V2
+    ENC_PROTO_X25519_CHACHA20_POLY1305_V3 = 3,
 } teoLNullEncryptionProtocol;
 
 typedef enum teoLNullEncryptedSessionState {
@@ -30,19 +34,110 @@ typedef enum teoLNullEncryptedSessionState {
     SESCRYPT_PENDING,
     //! Encrypted session established
     SESCRYPT_ESTABLISHED,
+    //! Resumption ticket sent from our side, waiting for other side reply
+    SESCRYPT_RESUMING,
 } teoLNullEncryptedSessionState;
 
+/**
+ * Type of key exchange payload, high byte of KeyExchangePayload_Common
+ * protocolId, low byte is teoLNullEncryptionProtocol
+ */
+typedef enum teoLNullKEXType {
+    //! Key exchange of encryption protocol
+    KEX_TYPE_KEY_EXCHANGE = 0,
+    //! Resumption ticket issued by server in established session
+    KEX_TYPE_TICKET = 1,
+    //! Session resumption request of client or server answer to it
+    KEX_TYPE_RESUME = 2,
+    //! Server answer to resumption request with unknown or expired ticket
+    KEX_TYPE_RESUME_REJECT = 3,
+} teoLNullKEXType;
+
+#define TEOLNULL_KEX_ID(type, enc_proto)                                       \
+    ((uint16_t)(((uint16_t)(type) << 8) | (uint16_t)(enc_proto)))
+#define TEOLNULL_KEX_TYPE(protocol_id) ((teoLNullKEXType)((protocol_id) >> 8))
+#define TEOLNULL_KEX_PROTO(protocol_id)                                        \
+    ((teoLNullEncryptionProtocol)((protocol_id)&0xff))
+
+//! Maximum size of opaque resumption ticket issued by server
+#define TEOLNULL_RESUMPTION_TICKET_MAX_SIZE 255
+
+/**
+ * Session resumption ticket issued by server, allows next connection to the
+ * same server to derive session keys without key exchange
+ */
+typedef struct teoLNullResumptionTicket {
+    //! Encryption protocol of the session ticket was issued in
+    teoLNullEncryptionProtocol enc_proto;
+    //! Ticket expiration time, teotimeGetCurrentTimeMs based
+    int64_t expires_ms;
+    //! Resumption secret derived from session key
+    AES128_1_KEY secret;
+    //! Opaque ticket length, zero if there is no ticket
+    uint8_t ticket_length;
+    //! Opaque ticket to be sent to server
+    uint8_t ticket[TEOLNULL_RESUMPTION_TICKET_MAX_SIZE];
+} teoLNullResumptionTicket;
+
+/**
+ * CTR keystream precomputed for consecutive nonces
+ */
+typedef struct teoLNullKeystreamCache {
+    uint8_t *data;        ///< slots_count keystream slots
+    uint32_t slots_count; ///< Number of slots, zero if cache is disabled
+    uint32_t head;        ///< Slot of first_nonce
+    uint32_t ready;       ///< Number of precomputed slots from head
+    uint32_t first_nonce; ///< Nonce of keystream in head slot
+} teoLNullKeystreamCache;
+
+/**
+ * Encryption context of connection
+ *
+ * Key exchange is guarded by encryptionGuard, keys are written once before
+ * state is switched to SESCRYPT_ESTABLISHED and are read-only after that.
+ * Send and receive halves are synchronized independently: send nonces are
+ * reserved lock-free, receive counter is guarded by receiveGuard
+ */
 typedef struct teoLNullEncryptionContext {
-    //! Stages of session handshake
+    //! Stages of session handshake, read lock-free by send and receive halves
     teoLNullEncryptedSessionState state;
     //! Encryption protocol variant, for future extensions
     teoLNullEncryptionProtocol enc_proto;
-    //! counters for CTR-mode encryption
-    uint32_t receiveNonce, sendNonce;
-    //! Encryption keys holder
+    //! Encryption keys holder, ECDH protocols only
     PeerKeyset keys;
-    //! ensure concurrent access
+    //! Encryption keys holder, X25519 protocols only
+    PeerKeyset_X25519 x25519Keys;
+    //! Session key expanded once at KEX
+    AES128_1_SCHEDULE sessionSchedule;
+    //! AEAD key derived from session key, AEAD protocols only
+    CHACHA20_KEY aeadKey;
+    //! Ticket issued by server, or used to resume session in SESCRYPT_RESUMING
+    teoLNullResumptionTicket ticket;
+    //! Guards key exchange, see teoLNullAcquireCrypto
     teonetMutex encryptionGuard;
+
+    //! Send half: counter of next packet to encrypt, reserved atomically
+    uint32_t sendNonce;
+    //! Send half: packets with lower nonces are passed to transport
+    uint32_t sendCommitted;
+    //! Send half: senders waiting in teoLNullSendOrderWait, context isn't
+    //! destroyed until they leave
+    uint32_t sendWaiters;
+    //! Send half: senders sleeping in teoLNullSendOrderWait
+    uint32_t sendSleepers;
+    //! Send half: set by teoLNullEncryptionContextDestroy, waits fail then
+    uint32_t sendClosed;
+    //! Send half: keystream precomputed for next sendNonce values
+    teoLNullKeystreamCache sendKeystream;
+    //! Send half: guards sendKeystream
+    teonetMutex sendGuard;
+
+    //! Receive half: counter of next packet to decrypt
+    uint32_t receiveNonce;
+    //! Receive half: keystream precomputed for next receiveNonce values
+    teoLNullKeystreamCache receiveKeystream;
+    //! Receive half: guards receiveNonce and receiveKeystream
+    teonetMutex receiveGuard;
 } teoLNullEncryptionContext;
 
 // forward declaration, complete type in libteol0/teonet_l0_client.h
@@ -80,6 +175,32 @@ TEOCLI_API size_t teoLNullKEXBufferSize(teoLNullEncryptionProtocol enc_proto);
 TEOCLI_API size_t teoLNullKEXCreate(teoLNullEncryptionContext *ctx,
                                     uint8_t *buffer, size_t buffer_length);
 
+//! Buffer size sufficient to hold any session resumption request payload
+#define TEOLNULL_KEX_RESUME_MAX_SIZE                                           \
+    (sizeof(KeyExchangePayload_Common) + AES_BLOCKLEN + 1 +                     \
+     TEOLNULL_RESUMPTION_TICKET_MAX_SIZE)
+
+/**
+ * Create session resumption request payload to be sent to L0 server instead
+ * of key exchange payload, switches @a ctx to SESCRYPT_RESUMING state
+ *
+ * Server answers with KEX_TYPE_RESUME payload and session keys are derived
+ * from @a ticket secret and fresh salts of both sides, or with
+ * KEX_TYPE_RESUME_REJECT payload and @a ctx returns to SESCRYPT_PENDING state
+ * to make regular key exchange
+ *
+ * @param ctx encryption context created recently
+ * @param ticket ticket issued by server for @a ctx encryption protocol
+ * @param buffer Buffer to create payload in
+ * @param buffer_length Buffer length, TEOLNULL_KEX_RESUME_MAX_SIZE is enough
+ *
+ * @return Length of created payload or zero if failed or ticket is expired
+ */
+TEOCLI_API size_t teoLNullKEXCreateResume(teoLNullEncryptionContext *ctx,
+                                          const teoLNullResumptionTicket *ticket,
+                                          uint8_t *buffer,
+                                          size_t buffer_length);
+
 /**
  * Check if buffer supposed to be KEX payload
  *
@@ -130,6 +251,9 @@ teoLNullEncryptionContextCreate(teoLNullEncryptionProtocol enc_proto,
 
 /**
  * Destroy context internals
+ *
+ * Senders waiting in teoLNullSendOrderWait fail and leave before context
+ * guards are destroyed
  */
 TEOCLI_API void
 teoLNullEncryptionContextDestroy(teoLNullEncryptionContext *ctx);
@@ -137,6 +261,10 @@ teoLNullEncryptionContextDestroy(teoLNullEncryptionContext *ctx);
 /**
  * Apply valid KEX payload to given context
  *
+ * KEX_TYPE_TICKET payload stores resumption ticket in ctx->ticket,
+ * KEX_TYPE_RESUME and KEX_TYPE_RESUME_REJECT payloads complete or cancel
+ * resumption started by teoLNullKEXCreateResume
+ *
  * @param ctx recipient context
  * @param buffer previously validated KEX, MUST be compatibe with @a ctx
  * @param buffer_length @a buffer length in bytes
@@ -148,9 +276,100 @@ teoLNullEncryptionContextApplyKEX(teoLNullEncryptionContext *ctx,
                                   KeyExchangePayload_Common *buffer,
                                   size_t buffer_length);
 
+/**
+ * Precompute keystream for next packets up to budget set by
+ * teoLNUllSetOption_KeystreamCacheBytes
+ *
+ * @param ctx Encryption context with established session
+ * @param max_bytes Maximum number of keystream bytes to generate in this call
+ *
+ * @return Number of keystream bytes generated
+ */
+TEOCLI_API size_t
+teoLNullEncryptionContextPrecompute(teoLNullEncryptionContext *ctx,
+                                    size_t max_bytes);
+
+//! Maximum of teoLNullEncryptionContextExportSession output
+#define TEOLNULL_SESSION_EXPORT_MAX_SIZE                                       \
+    (1 + sizeof(AES128_1_KEY) + sizeof(AES128_1_BLOCK) +                      \
+     (sizeof(ECDHPubkey) > sizeof(X25519Key) ? sizeof(ECDHPubkey)              \
+                                              : sizeof(X25519Key)))
+
+/**
+ * Export keys of established session to replay packets received in it
+ *
+ * Output is protocol, session key, session salt and public key of server,
+ * private keys aren't exported. Such output decrypts whole session, so it is
+ * written to captures of test environments only.
+ *
+ * @param ctx Context with established session
+ * @param buffer Buffer of TEOLNULL_SESSION_EXPORT_MAX_SIZE bytes
+ *
+ * @return Length of exported keys or zero if session isn't established
+ */
+TEOCLI_INTERNAL size_t
+teoLNullEncryptionContextExportSession(teoLNullEncryptionContext *ctx,
+                                       uint8_t *buffer);
+
+/**
+ * Establish session of new context with keys exported by
+ * teoLNullEncryptionContextExportSession
+ *
+ * KEX answer of exported session is re-confirmed by such context, resumed
+ * session can't be re-confirmed and is broken by its KEX answer.
+ *
+ * @param ctx Context of the same protocol in pending state
+ * @param buffer Exported keys
+ * @param buffer_length @a buffer length in bytes
+ *
+ * @return true on success
+ */
+TEOCLI_INTERNAL bool
+teoLNullEncryptionContextImportSession(teoLNullEncryptionContext *ctx,
+                                       const uint8_t *buffer,
+                                       size_t buffer_length);
+
+//! Maximum of teoLNullEncryptionOverhead for all protocols
+#define TEOLNULL_ENCRYPTION_MAX_OVERHEAD POLY1305_TAG_SIZE
+
+/**
+ * Get number of bytes encryption adds to packet data
+ *
+ * AEAD protocols append authentication tag to packet data, such packets are
+ * authenticated by the tag and payload checksum isn't calculated for them
+ *
+ * @param enc_proto encryption protocol
+ *
+ * @return tag size in bytes or zero if protocol doesn't append data
+ */
+TEOCLI_API size_t
+teoLNullEncryptionOverhead(teoLNullEncryptionProtocol enc_proto);
+
+/**
+ * Check if packet may be encrypted in buffer of @a capacity bytes
+ *
+ * AEAD protocols need teoLNullEncryptionOverhead bytes after packet data and
+ * packet data with the tag must not exceed UINT16_MAX bytes. Result depends on
+ * context protocol only, not on its state
+ *
+ * @param ctx Encryption context or NULL
+ * @param packet L0 packet to be encrypted
+ * @param capacity Size of buffer packet is created in
+ *
+ * @return true if packet fits to buffer after encryption
+ */
+TEOCLI_INTERNAL bool
+teoLNullPacketEncryptionFits(const teoLNullEncryptionContext *ctx,
+                             const teoLNullCPacket *packet, size_t capacity);
+
 /**
  * Encrypt packet before sending. Encrypts inplace.
  *
+ * Nothing is appended to packet data, so packets with data aren't encrypted
+ * by AEAD protocols (error is logged), use teoLNullPacketEncryptBuffer for
+ * them. May be called concurrently, packets must reach transport in nonce
+ * order, see teoLNullPacketEncryptOrdered
+ *
  * @param ctx Encryption context, determines the way data be encrypted
  *  if ctx is NULL or session weren't established yet - no encryption performed
  * @param packet L0 packet to be encrypted
@@ -159,7 +378,71 @@ TEOCLI_API void teoLNullPacketEncrypt(teoLNullEncryptionContext *ctx,
                                       teoLNullCPacket *packet);
 
 /**
- * Decrypt received packet inplace.
+ * Encrypt packet like teoLNullPacketEncrypt in buffer of @a capacity bytes
+ *
+ * AEAD protocols append teoLNullEncryptionOverhead(ctx->enc_proto) bytes tag
+ * to packet data, data_length is increased by this value
+ *
+ * @param ctx Encryption context
+ * @param packet L0 packet to be encrypted
+ * @param capacity Size of buffer packet is created in
+ *
+ * @return false if encrypted packet doesn't fit to buffer, packet is left
+ *  unchanged then
+ */
+TEOCLI_API bool teoLNullPacketEncryptBuffer(teoLNullEncryptionContext *ctx,
+                                            teoLNullCPacket *packet,
+                                            size_t capacity);
+
+/**
+ * Encrypt packet and report nonce reserved for it
+ *
+ * Packet must fit to its buffer after encryption, see
+ * teoLNullPacketEncryptionFits, packet which data is too large for AEAD tag
+ * isn't encrypted. Senders encrypt concurrently, then call
+ * teoLNullSendOrderWait before passing packet to transport and
+ * teoLNullSendOrderCommit after that, so packets reach transport in nonce
+ * order
+ *
+ * @param ctx Encryption context
+ * @param packet L0 packet to be encrypted
+ * @param nonce Set to reserved nonce if packet is encrypted
+ *
+ * @return true if packet is encrypted and must be committed
+ */
+TEOCLI_API bool teoLNullPacketEncryptOrdered(teoLNullEncryptionContext *ctx,
+                                             teoLNullCPacket *packet,
+                                             uint32_t *nonce);
+
+/**
+ * Wait until packets with nonces before @a nonce are passed to transport
+ *
+ * Wait fails if context is destroyed meanwhile, packet mustn't be passed to
+ * transport and committed then
+ *
+ * @param ctx Encryption context
+ * @param nonce Nonce reported by teoLNullPacketEncryptOrdered
+ *
+ * @return true if it's turn of @a nonce, false if context is closed
+ */
+TEOCLI_API bool teoLNullSendOrderWait(teoLNullEncryptionContext *ctx,
+                                      uint32_t nonce);
+
+/**
+ * Mark packet with @a nonce passed to transport, whether sent successfully or
+ * not, lets the packet with next nonce go
+ *
+ * @param ctx Encryption context
+ * @param nonce Nonce reported by teoLNullPacketEncryptOrdered
+ */
+TEOCLI_API void teoLNullSendOrderCommit(teoLNullEncryptionContext *ctx,
+                                        uint32_t nonce);
+
+/**
+ * Decrypt received packet inplace. Receive half is locked inside.
+ *
+ * For AEAD protocols authentication tag is verified and removed from packet
+ * data, packet with wrong tag is left unchanged and false is returned
  *
  * @param ctx Encryption context, determines the way data be decrypted
  *  if ctx is NULL or session weren't established yet - no encryption performed
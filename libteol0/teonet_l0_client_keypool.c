@@ -0,0 +1,313 @@
+/**
+ * File:   teonet_l0_client_keypool.c
+ *
+ * Process-wide pool of pre-generated ECDH keypairs. Background thread keeps
+ * the pool filled to configured depth, teoLNullEncryptionContextCreate takes
+ * keypair from the pool instead of generating it on connecting thread. Taken
+ * keypair slot is wiped, so every keypair is used by one context only.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_keypool.h"
+
+#include <string.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+// Refill rate is updated when pool is filled or after this interval
+#define KEYPOOL_RATE_INTERVAL_US 100000
+
+typedef struct keyPoolPair {
+    ECDHPvtkey pvtkey;
+    ECDHPubkey pubkey;
+} keyPoolPair;
+
+typedef struct keyPool {
+    keyPoolPair *pairs; ///< Stack of depth keypairs, count of them are ready
+    uint32_t depth;
+    uint32_t count;
+    bool running;       ///< Refill thread is started and must keep running
+
+    uint64_t generated;
+    uint64_t taken;
+    uint64_t misses;
+    double refill_rate;
+
+    // Serializes teoLNullKeyPoolSetDepth calls, so start of refill thread
+    // can't interleave with join of previous one. Unlike lock guarding pool
+    // data it's held while thread is joined
+#if defined(TEONET_OS_WINDOWS)
+    CRITICAL_SECTION control;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+    HANDLE thread;
+#else
+    pthread_mutex_t control;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+#endif
+} keyPool;
+
+static keyPool _pool;
+
+#if defined(TEONET_OS_WINDOWS)
+static INIT_ONCE _poolOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK _poolInitOnce(PINIT_ONCE once, PVOID param,
+                                   PVOID *context) {
+    InitializeCriticalSection(&_pool.control);
+    InitializeCriticalSection(&_pool.lock);
+    InitializeConditionVariable(&_pool.cond);
+    return TRUE;
+}
+
+static void _poolInit(void) {
+    InitOnceExecuteOnce(&_poolOnce, _poolInitOnce, NULL, NULL);
+}
+
+static void _poolControlLock(void) { EnterCriticalSection(&_pool.control); }
+
+static void _poolControlUnlock(void) { LeaveCriticalSection(&_pool.control); }
+
+static void _poolLock(void) { EnterCriticalSection(&_pool.lock); }
+
+static void _poolUnlock(void) { LeaveCriticalSection(&_pool.lock); }
+
+static void _poolWait(void) {
+    SleepConditionVariableCS(&_pool.cond, &_pool.lock, INFINITE);
+}
+
+static void _poolWake(void) { WakeAllConditionVariable(&_pool.cond); }
+#else
+static pthread_once_t _poolOnce = PTHREAD_ONCE_INIT;
+
+static void _poolInitOnce(void) {
+    pthread_mutex_init(&_pool.control, NULL);
+    pthread_mutex_init(&_pool.lock, NULL);
+    pthread_cond_init(&_pool.cond, NULL);
+}
+
+static void _poolInit(void) { pthread_once(&_poolOnce, _poolInitOnce); }
+
+static void _poolControlLock(void) { pthread_mutex_lock(&_pool.control); }
+
+static void _poolControlUnlock(void) { pthread_mutex_unlock(&_pool.control); }
+
+static void _poolLock(void) { pthread_mutex_lock(&_pool.lock); }
+
+static void _poolUnlock(void) { pthread_mutex_unlock(&_pool.lock); }
+
+static void _poolWait(void) { pthread_cond_wait(&_pool.cond, &_pool.lock); }
+
+static void _poolWake(void) { pthread_cond_broadcast(&_pool.cond); }
+#endif
+
+/**
+ * Monotonic time in microseconds, keypair takes tens of them to generate
+ */
+static int64_t _poolTimeUs(void) {
+#if defined(TEONET_OS_WINDOWS)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (int64_t)(counter.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+static void _poolGenerate(keyPoolPair *pair) {
+    for (;;) {
+        randomize_bytes(pair->pvtkey.data, sizeof(pair->pvtkey.data));
+        if (ecdh_generate_keys_fixed_base(pair->pubkey.data,
+                                          pair->pvtkey.data)) {
+            break;
+        }
+    }
+}
+
+/**
+ * Refill thread, generates keypairs while pool isn't full
+ */
+static void _poolRefill(void) {
+    keyPoolPair pair;
+    int64_t burst_start_us = 0;
+    uint32_t burst_count = 0;
+
+    _poolLock();
+    while (_pool.running) {
+        if (_pool.count >= _pool.depth) {
+            burst_count = 0;
+            _poolWait();
+            continue;
+        }
+        if (burst_count == 0) { burst_start_us = _poolTimeUs(); }
+        _poolUnlock();
+
+        _poolGenerate(&pair);
+
+        _poolLock();
+        if (_pool.count < _pool.depth) {
+            memcpy(&_pool.pairs[_pool.count++], &pair, sizeof(pair));
+            _pool.generated++;
+            burst_count++;
+        }
+
+        const int64_t elapsed_us = _poolTimeUs() - burst_start_us;
+        if (elapsed_us >= KEYPOOL_RATE_INTERVAL_US ||
+            (_pool.count >= _pool.depth && elapsed_us > 0)) {
+            _pool.refill_rate = (double)burst_count * 1000000.0 / elapsed_us;
+            burst_count = 0;
+        }
+    }
+    _poolUnlock();
+
+    zero_bytes((uint8_t *)&pair, sizeof(pair));
+}
+
+#if defined(TEONET_OS_WINDOWS)
+static DWORD WINAPI _poolThread(LPVOID arg) {
+    _poolRefill();
+    return 0;
+}
+#else
+static void *_poolThread(void *arg) {
+    _poolRefill();
+    return NULL;
+}
+#endif
+
+/**
+ * Replace keypairs stack with one of @a depth size, must be called with pool
+ * locked. Extra keypairs are wiped
+ */
+static void _poolResize(uint32_t depth) {
+    keyPoolPair *pairs = NULL;
+    if (depth != 0) {
+        pairs = (keyPoolPair *)ccl_malloc(sizeof(keyPoolPair) * depth);
+        memset(pairs, 0, sizeof(keyPoolPair) * depth);
+    }
+
+    const uint32_t count = _pool.count < depth ? _pool.count : depth;
+    if (count != 0) {
+        memcpy(pairs, _pool.pairs, sizeof(keyPoolPair) * count);
+    }
+
+    if (_pool.pairs != NULL) {
+        zero_bytes((uint8_t *)_pool.pairs, sizeof(keyPoolPair) * _pool.depth);
+        free(_pool.pairs);
+    }
+
+    _pool.pairs = pairs;
+    _pool.depth = depth;
+    _pool.count = count;
+}
+
+void teoLNullKeyPoolSetDepth(uint32_t depth) {
+    _poolInit();
+
+    _poolControlLock();
+    _poolLock();
+    const bool running = _pool.running;
+    if (depth == 0) {
+        _pool.running = false;
+        _poolWake();
+    }
+    _poolUnlock();
+
+    // Thread is joined unlocked, it takes the lock to exit
+    if (depth == 0) {
+        if (running) {
+#if defined(TEONET_OS_WINDOWS)
+            WaitForSingleObject(_pool.thread, INFINITE);
+            CloseHandle(_pool.thread);
+#else
+            pthread_join(_pool.thread, NULL);
+#endif
+        }
+        _poolLock();
+        _poolResize(0);
+        _poolUnlock();
+        _poolControlUnlock();
+        return;
+    }
+
+    _poolLock();
+    _poolResize(depth);
+    if (!running) {
+        _pool.running = true;
+#if defined(TEONET_OS_WINDOWS)
+        _pool.thread = CreateThread(NULL, 0, _poolThread, NULL, 0, NULL);
+        const bool started = _pool.thread != NULL;
+#else
+        const bool started =
+            pthread_create(&_pool.thread, NULL, _poolThread, NULL) == 0;
+#endif
+        if (!started) {
+            LTRACK_E("TeonetClient", "Can't start ECDH keypair pool thread");
+            _pool.running = false;
+            _poolResize(0);
+        }
+    }
+    _poolWake();
+    _poolUnlock();
+    _poolControlUnlock();
+}
+
+bool teoLNullKeyPoolTake(PeerKeyset *keys) {
+    _poolInit();
+
+    _poolLock();
+    if (_pool.depth == 0) {
+        _poolUnlock();
+        return false;
+    }
+    if (_pool.count == 0) {
+        _pool.misses++;
+        _poolUnlock();
+        return false;
+    }
+
+    keyPoolPair *pair = &_pool.pairs[--_pool.count];
+    memcpy(&keys->pvtkeylocal, &pair->pvtkey, sizeof(pair->pvtkey));
+    memcpy(&keys->pubkeylocal, &pair->pubkey, sizeof(pair->pubkey));
+    zero_bytes((uint8_t *)pair, sizeof(keyPoolPair));
+    _pool.taken++;
+    _poolWake();
+    _poolUnlock();
+
+    // The rest is the same as initPeerKeys does
+    zero_bytes(keys->pubkeyremote.data, sizeof(keys->pubkeyremote.data));
+    zero_bytes(keys->sharedkey.data, sizeof(keys->sharedkey.data));
+
+    zero_bytes(keys->sessionkey.data, sizeof(keys->sessionkey.data));
+    randomize_bytes(keys->sessionsalt.data, sizeof(keys->sessionsalt.data));
+
+    return true;
+}
+
+void teoLNullKeyPoolGetStats(teoLNullKeyPoolStats *stats) {
+    _poolInit();
+
+    _poolLock();
+    stats->depth = _pool.depth;
+    stats->available = _pool.count;
+    stats->generated = _pool.generated;
+    stats->taken = _pool.taken;
+    stats->misses = _pool.misses;
+    stats->refill_rate = _pool.refill_rate;
+    _poolUnlock();
+}
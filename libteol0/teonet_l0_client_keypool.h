@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_KEYPOOL_H
+#define TEONET_L0_CLIENT_KEYPOOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libtinycrypt/tinycrypt.h"
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Process-wide pool of pre-generated ECDH keypairs
+/////////////////
+
+/**
+ * ECDH keypair pool statistics
+ */
+typedef struct teoLNullKeyPoolStats {
+    uint32_t depth;       ///< Configured pool depth, zero if pool is disabled
+    uint32_t available;   ///< Keypairs ready to be taken
+    uint64_t generated;   ///< Keypairs generated by refill thread
+    uint64_t taken;       ///< Keypairs taken by encryption contexts
+    uint64_t misses;      ///< Contexts generated keypair inline, pool empty
+    double refill_rate;   ///< Keypairs per second of the last refill
+} teoLNullKeyPoolStats;
+
+/**
+ * Get ECDH keypair pool statistics
+ *
+ * @param stats Statistics to fill
+ */
+TEOCLI_API void teoLNullKeyPoolGetStats(teoLNullKeyPoolStats *stats);
+
+/**
+ * Start, resize or stop (@a depth is zero) the pool and its refill thread,
+ * called by teoLNUllSetOption_KeyPoolDepth. Concurrent calls are serialized
+ *
+ * @param depth Number of keypairs kept ready
+ */
+TEOCLI_INTERNAL void teoLNullKeyPoolSetDepth(uint32_t depth);
+
+/**
+ * Take keypair from the pool and initialize @a keys like initPeerKeys does
+ *
+ * Keypair is removed from the pool and wiped there, so it is used once only
+ *
+ * @param keys Keys to initialize
+ *
+ * @return true on success, false if pool is disabled or empty
+ */
+TEOCLI_INTERNAL bool teoLNullKeyPoolTake(PeerKeyset *keys);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_KEYPOOL_H */
@@ -0,0 +1,707 @@
+/**
+ * File:   teonet_l0_client_metrics.c
+ *
+ * OpenMetrics exporter of connections statistic. Connections are registered
+ * while they exist, counters of closed connections are added to process
+ * totals. Rendering copies counters of all connections under registry lock
+ * with relaxed loads and formats the copy after the lock is released, event
+ * loops never wait for it. Optional HTTP listener serves rendered metrics to
+ * scrapers on loopback interface.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_metrics.h"
+#include "teonet_l0_client.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+// Server name is truncated to this length in labels
+#define METRICS_SERVER_MAX_LENGTH 255
+
+// HTTP request longer than this is answered as if it ends here
+#define METRICS_REQUEST_MAX_LENGTH 4096
+
+// Slow HTTP client is dropped after this time
+#define METRICS_CLIENT_TIMEOUT_S 1
+
+typedef struct metricsEntry {
+    teoLNullConnectData *con;
+    uint64_t id;
+    char server[METRICS_SERVER_MAX_LENGTH + 1];
+    uint16_t port;
+    bool tcp;
+    struct metricsEntry *next;
+} metricsEntry;
+
+/**
+ * Process totals of connection counters
+ */
+typedef struct metricsTotals {
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    uint64_t packets_received;
+    uint64_t bytes_received;
+    uint64_t send_errors;
+    uint64_t checksum_errors;
+    uint64_t decrypt_errors;
+    uint64_t reconnects;
+} metricsTotals;
+
+typedef struct metricsRegistry {
+    metricsEntry *entries;
+    size_t count;
+    uint64_t opened;      ///< Connections registered, last connection id
+    metricsTotals closed; ///< Totals of unregistered connections
+
+#if defined(TEONET_OS_WINDOWS)
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} metricsRegistry;
+
+static metricsRegistry _registry;
+
+#if defined(TEONET_OS_WINDOWS)
+static INIT_ONCE _registryOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK _registryInitOnce(PINIT_ONCE once, PVOID param,
+                                       PVOID *context) {
+    InitializeCriticalSection(&_registry.lock);
+    return TRUE;
+}
+
+static void _registryLock(void) {
+    InitOnceExecuteOnce(&_registryOnce, _registryInitOnce, NULL, NULL);
+    EnterCriticalSection(&_registry.lock);
+}
+
+static void _registryUnlock(void) { LeaveCriticalSection(&_registry.lock); }
+#else
+static pthread_once_t _registryOnce = PTHREAD_ONCE_INIT;
+
+static void _registryInitOnce(void) {
+    pthread_mutex_init(&_registry.lock, NULL);
+}
+
+static void _registryLock(void) {
+    pthread_once(&_registryOnce, _registryInitOnce);
+    pthread_mutex_lock(&_registry.lock);
+}
+
+static void _registryUnlock(void) { pthread_mutex_unlock(&_registry.lock); }
+#endif
+
+static void _totalsAdd(metricsTotals *totals, const teoLNullStats *stats) {
+    totals->packets_sent += stats->packets_sent;
+    totals->bytes_sent += stats->bytes_sent;
+    totals->packets_received += stats->packets_received;
+    totals->bytes_received += stats->bytes_received;
+    totals->send_errors += stats->send_errors;
+    totals->checksum_errors += stats->checksum_errors;
+    totals->decrypt_errors += stats->decrypt_errors;
+    totals->reconnects += stats->reconnects;
+}
+
+void teoLNullMetricsRegister(teoLNullConnectData *con, const char *server,
+                             uint16_t port) {
+    metricsEntry *entry = (metricsEntry *)ccl_malloc(sizeof(metricsEntry));
+    entry->con = con;
+    snprintf(entry->server, sizeof(entry->server), "%s", server);
+    entry->port = port;
+    entry->tcp = con->tcp_f != 0;
+
+    _registryLock();
+    entry->id = ++_registry.opened;
+    entry->next = _registry.entries;
+    _registry.entries = entry;
+    _registry.count++;
+    _registryUnlock();
+}
+
+void teoLNullMetricsUnregister(teoLNullConnectData *con) {
+    teoLNullStats *stats = (teoLNullStats *)ccl_malloc(sizeof(teoLNullStats));
+    teoLNullGetStats(con, stats);
+
+    _registryLock();
+    metricsEntry **link = &_registry.entries;
+    while (*link != NULL && (*link)->con != con) { link = &(*link)->next; }
+    metricsEntry *entry = *link;
+    if (entry != NULL) {
+        *link = entry->next;
+        _registry.count--;
+        _totalsAdd(&_registry.closed, stats);
+    }
+    _registryUnlock();
+
+    if (entry != NULL) { free(entry); }
+    free(stats);
+}
+
+/////////////////
+// Rendering
+/////////////////
+
+/**
+ * Counters of one connection copied for rendering
+ */
+typedef struct metricsSnapshot {
+    char labels[2 * METRICS_SERVER_MAX_LENGTH + 64]; ///< Connection labels
+    teoLNullStats stats;
+    bool has_stages; ///< Stage latency tracing is on
+    teoLNullStageStats stages;
+} metricsSnapshot;
+
+typedef struct metricsWriter {
+    char *buf;
+    size_t len;
+    size_t pos; ///< Length of whole output, may be more than len
+} metricsWriter;
+
+static void _writerPrintf(metricsWriter *w, const char *format, ...) {
+    char *dst = w->pos < w->len ? w->buf + w->pos : NULL;
+    const size_t left = w->pos < w->len ? w->len - w->pos : 0;
+
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(dst, left, format, args);
+    va_end(args);
+
+    if (length > 0) { w->pos += (size_t)length; }
+}
+
+/**
+ * Make label values of connection, server name is escaped
+ */
+static void _snapshotLabels(metricsSnapshot *snapshot,
+                            const metricsEntry *entry) {
+    char server[2 * METRICS_SERVER_MAX_LENGTH + 1];
+    size_t pos = 0;
+    for (const char *c = entry->server; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            server[pos++] = '\\';
+        } else if (*c == '\n') {
+            server[pos++] = '\\';
+            server[pos++] = 'n';
+            continue;
+        }
+        server[pos++] = *c;
+    }
+    server[pos] = '\0';
+
+    snprintf(snapshot->labels, sizeof(snapshot->labels),
+             "connection=\"%" PRIu64 "\",server=\"%s:%u\",transport=\"%s\"",
+             entry->id, server, (unsigned)entry->port,
+             entry->tcp ? "tcp" : "trudp");
+}
+
+static void _writeFamily(metricsWriter *w, const char *name, const char *type,
+                         const char *help) {
+    _writerPrintf(w, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+typedef enum metricsValueKind {
+    METRIC_U64,      ///< uint64_t
+    METRIC_SIZE,     ///< size_t
+    METRIC_U32_US,   ///< uint32_t in us rendered in seconds
+    METRIC_DOUBLE_US ///< double in us rendered in seconds
+} metricsValueKind;
+
+/**
+ * Scalar field of teoLNullStats rendered for every connection
+ */
+typedef struct metricsField {
+    const char *name;
+    const char *type;
+    const char *help;
+    metricsValueKind kind;
+    size_t offset;
+} metricsField;
+
+#define METRICS_FIELD(name, type, help, kind, field)                           \
+    { name, type, help, kind, offsetof(teoLNullStats, field) }
+
+static const metricsField _connectionFields[] = {
+    METRICS_FIELD("teocli_connection_send_errors", "counter",
+                  "Failed sends, packets too large included.", METRIC_U64,
+                  send_errors),
+    METRICS_FIELD("teocli_connection_checksum_errors", "counter",
+                  "Received packets dropped for wrong checksum.", METRIC_U64,
+                  checksum_errors),
+    METRICS_FIELD("teocli_connection_decrypt_errors", "counter",
+                  "Received packets failed to decrypt.",
+                  METRIC_U64, decrypt_errors),
+    METRICS_FIELD("teocli_connection_reconnects", "counter",
+                  "Times connection was established again.", METRIC_U64,
+                  reconnects),
+    METRICS_FIELD("teocli_connection_reconnect_attempts", "counter",
+                  "Managed reconnect attempts.", METRIC_U64,
+                  reconnect_attempts),
+    METRICS_FIELD("teocli_connection_reconnect_replayed", "counter",
+                  "Packets queued while link was down and sent after "
+                  "re-login.",
+                  METRIC_U64, reconnect_replayed),
+    METRICS_FIELD("teocli_connection_reconnect_dropped", "counter",
+                  "Packets dropped by full reconnect queue.", METRIC_U64,
+                  reconnect_dropped),
+    METRICS_FIELD("teocli_connection_read_buffer_bytes", "gauge",
+                  "Read buffer size.", METRIC_SIZE, read_buffer_size),
+    METRICS_FIELD("teocli_connection_read_buffer_high_water_bytes", "gauge",
+                  "Most bytes waited in read buffer.", METRIC_SIZE,
+                  read_buffer_high_water),
+    METRICS_FIELD("teocli_connection_recv_ring_bytes", "gauge",
+                  "Bytes of received packets not released from ring.",
+                  METRIC_SIZE, recv_ring_used),
+    METRICS_FIELD("teocli_connection_reconnect_queue_bytes", "gauge",
+                  "Bytes of packets waiting for re-login.", METRIC_SIZE,
+                  reconnect_queue),
+    METRICS_FIELD("teocli_connection_trudp_retransmits", "counter",
+                  "TR-UDP packets sent again after timeout.", METRIC_U64,
+                  trudp_retransmits),
+    METRICS_FIELD("teocli_connection_trudp_send_queue", "gauge",
+                  "TR-UDP packets waiting for ACK.", METRIC_SIZE,
+                  trudp_send_queue),
+    METRICS_FIELD("teocli_connection_trudp_write_queue", "gauge",
+                  "TR-UDP packets waiting for socket write.", METRIC_SIZE,
+                  trudp_write_queue),
+    METRICS_FIELD("teocli_connection_trudp_triptime_seconds", "gauge",
+                  "Last TR-UDP round trip time.", METRIC_U32_US,
+                  trudp_triptime),
+    METRICS_FIELD("teocli_connection_trudp_triptime_middle_seconds", "gauge",
+                  "Smoothed TR-UDP round trip time.", METRIC_DOUBLE_US,
+                  trudp_triptime_middle),
+};
+
+static void _writeField(metricsWriter *w, const metricsField *field,
+                        const metricsSnapshot *snapshots, size_t count) {
+    const bool counter = strcmp(field->type, "counter") == 0;
+
+    _writeFamily(w, field->name, field->type, field->help);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *value = (const uint8_t *)&snapshots[i].stats +
+                               field->offset;
+        _writerPrintf(w, "%s%s{%s} ", field->name, counter ? "_total" : "",
+                      snapshots[i].labels);
+        switch (field->kind) {
+        case METRIC_U64:
+            _writerPrintf(w, "%" PRIu64 "\n", *(const uint64_t *)value);
+            break;
+        case METRIC_SIZE:
+            _writerPrintf(w, "%" PRIu64 "\n",
+                          (uint64_t)*(const size_t *)value);
+            break;
+        case METRIC_U32_US:
+            _writerPrintf(w, "%.6f\n", *(const uint32_t *)value / 1e6);
+            break;
+        case METRIC_DOUBLE_US:
+            _writerPrintf(w, "%.6f\n", *(const double *)value / 1e6);
+            break;
+        }
+    }
+}
+
+typedef enum metricsCommandValue {
+    METRIC_PACKETS_SENT,
+    METRIC_BYTES_SENT,
+    METRIC_PACKETS_RECEIVED,
+    METRIC_BYTES_RECEIVED
+} metricsCommandValue;
+
+/**
+ * Render counter by command id, commands without packets are skipped
+ */
+static void _writeCommands(metricsWriter *w, const char *name,
+                           const char *help, metricsCommandValue kind,
+                           const metricsSnapshot *snapshots, size_t count) {
+    _writeFamily(w, name, "counter", help);
+    for (size_t i = 0; i < count; i++) {
+        for (int cmd = 0; cmd < TEOLNULL_STATS_COMMANDS; cmd++) {
+            const teoLNullCommandStats *c = &snapshots[i].stats.commands[cmd];
+            if (c->packets_sent == 0 && c->packets_received == 0) { continue; }
+
+            uint64_t value = 0;
+            switch (kind) {
+            case METRIC_PACKETS_SENT: value = c->packets_sent; break;
+            case METRIC_BYTES_SENT: value = c->bytes_sent; break;
+            case METRIC_PACKETS_RECEIVED: value = c->packets_received; break;
+            case METRIC_BYTES_RECEIVED: value = c->bytes_received; break;
+            }
+            _writerPrintf(w, "%s_total{%s,command=\"%d\"} %" PRIu64 "\n", name,
+                          snapshots[i].labels, cmd, value);
+        }
+    }
+}
+
+/**
+ * Render latency histogram of every connection in seconds
+ */
+static void _writeHistogram(metricsWriter *w, const char *name,
+                            const char *help, size_t offset,
+                            const metricsSnapshot *snapshots, size_t count) {
+    _writeFamily(w, name, "histogram", help);
+    for (size_t i = 0; i < count; i++) {
+        const teoLNullLatencyHistogram *h =
+            (const teoLNullLatencyHistogram *)((const uint8_t *)&snapshots[i]
+                                                   .stats +
+                                               offset);
+        uint64_t cumulative = 0;
+        for (int b = 0; b < TEOLNULL_LATENCY_BUCKETS; b++) {
+            cumulative += h->buckets[b];
+            if (b == TEOLNULL_LATENCY_BUCKETS - 1) {
+                _writerPrintf(w, "%s_bucket{%s,le=\"+Inf\"} %" PRIu64 "\n",
+                              name, snapshots[i].labels, cumulative);
+            } else {
+                _writerPrintf(w, "%s_bucket{%s,le=\"%.6g\"} %" PRIu64 "\n",
+                              name, snapshots[i].labels,
+                              (double)((uint64_t)1 << b) / 1e6, cumulative);
+            }
+        }
+        _writerPrintf(w, "%s_count{%s} %" PRIu64 "\n", name,
+                      snapshots[i].labels, cumulative);
+        _writerPrintf(w, "%s_sum{%s} %.6f\n", name, snapshots[i].labels,
+                      h->sum / 1e6);
+    }
+}
+
+/**
+ * Render stage time histograms of connections with latency tracing on
+ */
+static void _writeStages(metricsWriter *w, const metricsSnapshot *snapshots,
+                         size_t count) {
+    const char *name = "teocli_connection_stage_seconds";
+    _writeFamily(w, name, "histogram",
+                 "Sampled packet processing time by stage.");
+    for (size_t i = 0; i < count; i++) {
+        if (!snapshots[i].has_stages) { continue; }
+
+        for (int s = 0; s < TEOLNULL_STAGES; s++) {
+            const teoLNullStageHistogram *h = &snapshots[i].stages.stages[s];
+            const char *stage = teoLNullStageName((teoLNullStage)s);
+            uint64_t cumulative = 0;
+            for (int b = 0; b < TEOLNULL_STAGE_BUCKETS; b++) {
+                cumulative += h->buckets[b];
+                if (b == TEOLNULL_STAGE_BUCKETS - 1) {
+                    _writerPrintf(w,
+                                  "%s_bucket{%s,stage=\"%s\",le=\"+Inf\"} "
+                                  "%" PRIu64 "\n",
+                                  name, snapshots[i].labels, stage,
+                                  cumulative);
+                } else {
+                    _writerPrintf(w,
+                                  "%s_bucket{%s,stage=\"%s\",le=\"%.6g\"} "
+                                  "%" PRIu64 "\n",
+                                  name, snapshots[i].labels, stage,
+                                  (double)((uint64_t)1 << b) / 1e9,
+                                  cumulative);
+                }
+            }
+            _writerPrintf(w, "%s_count{%s,stage=\"%s\"} %" PRIu64 "\n", name,
+                          snapshots[i].labels, stage, cumulative);
+            _writerPrintf(w, "%s_sum{%s,stage=\"%s\"} %.9f\n", name,
+                          snapshots[i].labels, stage, h->sum_ns / 1e9);
+        }
+    }
+}
+
+static void _writeTotal(metricsWriter *w, const char *name, const char *help,
+                        uint64_t value) {
+    _writeFamily(w, name, "counter", help);
+    _writerPrintf(w, "%s_total %" PRIu64 "\n", name, value);
+}
+
+size_t teoLNullRenderMetrics(char *buf, size_t len) {
+    metricsWriter w = {buf, len, 0};
+    if (len > 0) { buf[0] = '\0'; }
+
+    // Snapshot, connections are neither added nor freed while it is made
+    _registryLock();
+    const size_t count = _registry.count;
+    const uint64_t opened = _registry.opened;
+    metricsTotals totals = _registry.closed;
+    metricsSnapshot *snapshots = NULL;
+    if (count > 0) {
+        snapshots =
+            (metricsSnapshot *)ccl_malloc(count * sizeof(metricsSnapshot));
+    }
+    size_t i = 0;
+    for (metricsEntry *entry = _registry.entries; entry != NULL;
+         entry = entry->next, i++) {
+        _snapshotLabels(&snapshots[i], entry);
+        teoLNullGetStats(entry->con, &snapshots[i].stats);
+        snapshots[i].has_stages =
+            teoLNullGetStageStats(entry->con, &snapshots[i].stages);
+    }
+    _registryUnlock();
+
+    for (i = 0; i < count; i++) { _totalsAdd(&totals, &snapshots[i].stats); }
+
+    _writeFamily(&w, "teocli_connections", "gauge", "Open L0 connections.");
+    _writerPrintf(&w, "teocli_connections %" PRIu64 "\n", (uint64_t)count);
+    _writeTotal(&w, "teocli_connections_opened", "L0 connections created.",
+                opened);
+    _writeTotal(&w, "teocli_packets_sent", "Packets sent by all connections.",
+                totals.packets_sent);
+    _writeTotal(&w, "teocli_bytes_sent", "Bytes sent by all connections.",
+                totals.bytes_sent);
+    _writeTotal(&w, "teocli_packets_received",
+                "Packets received by all connections.",
+                totals.packets_received);
+    _writeTotal(&w, "teocli_bytes_received",
+                "Bytes received by all connections.", totals.bytes_received);
+    _writeTotal(&w, "teocli_send_errors",
+                "Failed sends of all connections.", totals.send_errors);
+    _writeTotal(&w, "teocli_checksum_errors",
+                "Packets with wrong checksum of all connections.",
+                totals.checksum_errors);
+    _writeTotal(&w, "teocli_decrypt_errors",
+                "Packets failed to decrypt of all connections.",
+                totals.decrypt_errors);
+    _writeTotal(&w, "teocli_reconnects", "Reconnects of all connections.",
+                totals.reconnects);
+
+    _writeCommands(&w, "teocli_connection_packets_sent",
+                   "Packets sent by command.", METRIC_PACKETS_SENT, snapshots,
+                   count);
+    _writeCommands(&w, "teocli_connection_bytes_sent",
+                   "Bytes sent by command.", METRIC_BYTES_SENT, snapshots,
+                   count);
+    _writeCommands(&w, "teocli_connection_packets_received",
+                   "Packets received by command.", METRIC_PACKETS_RECEIVED,
+                   snapshots, count);
+    _writeCommands(&w, "teocli_connection_bytes_received",
+                   "Bytes received by command.", METRIC_BYTES_RECEIVED,
+                   snapshots, count);
+
+    for (size_t f = 0;
+         f < sizeof(_connectionFields) / sizeof(_connectionFields[0]); f++) {
+        _writeField(&w, &_connectionFields[f], snapshots, count);
+    }
+
+    _writeHistogram(&w, "teocli_connection_send_latency_seconds",
+                    "Time from send call to socket write.",
+                    offsetof(teoLNullStats, send_latency), snapshots, count);
+    _writeHistogram(&w, "teocli_connection_trudp_rtt_seconds",
+                    "Round trip time of TR-UDP ACKs.",
+                    offsetof(teoLNullStats, trudp_rtt), snapshots, count);
+    _writeHistogram(&w, "teocli_connection_echo_rtt_seconds",
+                    "Round trip time of echo answers.",
+                    offsetof(teoLNullStats, echo_rtt), snapshots, count);
+    _writeHistogram(&w, "teocli_connection_reconnect_downtime_seconds",
+                    "Time from link loss to re-login of managed reconnect.",
+                    offsetof(teoLNullStats, reconnect_downtime), snapshots,
+                    count);
+    _writeStages(&w, snapshots, count);
+
+    _writerPrintf(&w, "# EOF\n");
+
+    if (snapshots != NULL) { free(snapshots); }
+    return w.pos;
+}
+
+/////////////////
+// HTTP listener
+/////////////////
+
+#if !defined(TEONET_OS_WINDOWS)
+typedef struct metricsListener {
+    bool running;
+    int fd;
+    int wake[2]; ///< Pipe to stop listener thread
+    pthread_t thread;
+} metricsListener;
+
+static metricsListener _listener;
+
+#if defined(MSG_NOSIGNAL)
+#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define METRICS_SEND_FLAGS 0
+#endif
+
+static bool _listenerSendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        const ssize_t sent = send(fd, data, length, METRICS_SEND_FLAGS);
+        if (sent <= 0) { return false; }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+/**
+ * Read HTTP request and answer it with rendered metrics
+ */
+static void _listenerServe(int fd) {
+    // Slow client can't hold the listener longer than timeout
+    struct timeval timeout = {METRICS_CLIENT_TIMEOUT_S, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[METRICS_REQUEST_MAX_LENGTH + 1];
+    size_t received = 0;
+    while (received < METRICS_REQUEST_MAX_LENGTH) {
+        const ssize_t rc = recv(fd, request + received,
+                                METRICS_REQUEST_MAX_LENGTH - received, 0);
+        if (rc <= 0) { break; }
+        received += (size_t)rc;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL) { break; }
+    }
+    request[received] = '\0';
+
+    if (strncmp(request, "GET /metrics", 12) != 0) {
+        static const char not_found[] =
+            "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n"
+            "Connection: close\r\n\r\n";
+        _listenerSendAll(fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+
+    // Output may grow between sizing and rendering
+    size_t size = teoLNullRenderMetrics(NULL, 0) + 1;
+    char *body = NULL;
+    size_t body_length;
+    for (;;) {
+        body = (char *)ccl_realloc(body, size);
+        body_length = teoLNullRenderMetrics(body, size);
+        if (body_length < size) { break; }
+        size = body_length + 1 + L0_BUFFER_SIZE;
+    }
+
+    char header[256];
+    const int header_length = snprintf(
+        header, sizeof(header),
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: application/openmetrics-text; version=1.0.0; "
+        "charset=utf-8\r\n"
+        "Content-Length: %" PRIu64 "\r\nConnection: close\r\n\r\n",
+        (uint64_t)body_length);
+    if (_listenerSendAll(fd, header, (size_t)header_length)) {
+        _listenerSendAll(fd, body, body_length);
+    }
+    free(body);
+}
+
+static void *_listenerThread(void *arg) {
+    for (;;) {
+        struct pollfd fds[2] = {{_listener.wake[0], POLLIN, 0},
+                                {_listener.fd, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            LTRACK_E("TeonetClient", "Metrics listener poll error: %s",
+                     strerror(errno));
+            break;
+        }
+        if (fds[0].revents != 0) { break; }
+        if (fds[1].revents & POLLIN) {
+            const int client = accept(_listener.fd, NULL, NULL);
+            if (client >= 0) {
+                _listenerServe(client);
+                close(client);
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
+int teoLNullMetricsListen(uint16_t port) {
+#if defined(TEONET_OS_WINDOWS)
+    LTRACK_E("TeonetClient", "Metrics listener isn't supported on Windows");
+    return -1;
+#else
+    _registryLock();
+    if (_listener.running) {
+        _registryUnlock();
+        LTRACK_E("TeonetClient", "Metrics listener already runs");
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        _registryUnlock();
+        LTRACK_E("TeonetClient", "Can't create metrics socket: %s",
+                 strerror(errno));
+        return -1;
+    }
+    const int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 16) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        pipe(_listener.wake) != 0) {
+        LTRACK_E("TeonetClient", "Can't listen metrics port %u: %s",
+                 (unsigned)port, strerror(errno));
+        close(fd);
+        _registryUnlock();
+        return -1;
+    }
+
+    _listener.fd = fd;
+    if (pthread_create(&_listener.thread, NULL, _listenerThread, NULL) != 0) {
+        LTRACK_E("TeonetClient", "Can't start metrics listener thread");
+        close(_listener.wake[0]);
+        close(_listener.wake[1]);
+        close(fd);
+        _listener.fd = -1;
+        _registryUnlock();
+        return -1;
+    }
+    _listener.running = true;
+    _registryUnlock();
+
+    LTRACK_I("TeonetClient", "Metrics listener started on 127.0.0.1:%u",
+             (unsigned)ntohs(addr.sin_port));
+    return ntohs(addr.sin_port);
+#endif
+}
+
+void teoLNullMetricsStop(void) {
+#if !defined(TEONET_OS_WINDOWS)
+    _registryLock();
+    const bool running = _listener.running;
+    _listener.running = false;
+    _registryUnlock();
+    if (!running) { return; }
+
+    // Listener thread renders under registry lock, so join without it
+    const char quit = 'q';
+    if (write(_listener.wake[1], &quit, 1) != 1) {
+        LTRACK_E("TeonetClient", "Can't wake metrics listener");
+    }
+    pthread_join(_listener.thread, NULL);
+
+    close(_listener.fd);
+    close(_listener.wake[0]);
+    close(_listener.wake[1]);
+    _listener.fd = -1;
+#endif
+}
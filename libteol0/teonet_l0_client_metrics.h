@@ -0,0 +1,74 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_METRICS_H
+#define TEONET_L0_CLIENT_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// OpenMetrics exporter of connections statistic
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client.h
+typedef struct teoLNullConnectData teoLNullConnectData;
+
+/**
+ * Render statistic of all open connections and process totals in
+ * OpenMetrics text format
+ *
+ * Counters are read with teoLNullGetStats, so rendering doesn't lock
+ * connections and doesn't delay their event loops. Totals of process include
+ * connections already closed.
+ *
+ * @param buf Buffer to render to, may be NULL if @a len is 0
+ * @param len Buffer size, output is truncated and zero terminated if it
+ *  doesn't fit
+ *
+ * @return Length of whole output without terminating zero, output is
+ *  complete if it is less than @a len
+ */
+TEOCLI_API size_t teoLNullRenderMetrics(char *buf, size_t len);
+
+/**
+ * Start HTTP listener serving teoLNullRenderMetrics output on loopback
+ * interface
+ *
+ * Listener runs in its own thread and answers GET /metrics. One listener per
+ * process may run. Not supported on Windows.
+ *
+ * @param port Local TCP port, 0 to choose free one
+ *
+ * @return Port listener bound to or -1 if it can't listen or already runs
+ */
+TEOCLI_API int teoLNullMetricsListen(uint16_t port);
+
+/**
+ * Stop HTTP listener started by teoLNullMetricsListen
+ */
+TEOCLI_API void teoLNullMetricsStop(void);
+
+/**
+ * Add connection to rendered connections, called by teoLNullConnectE
+ */
+TEOCLI_INTERNAL void teoLNullMetricsRegister(teoLNullConnectData *con,
+                                             const char *server,
+                                             uint16_t port);
+
+/**
+ * Remove connection from rendered connections and add its counters to
+ * process totals, called by teoLNullDisconnect
+ */
+TEOCLI_INTERNAL void teoLNullMetricsUnregister(teoLNullConnectData *con);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_METRICS_H */
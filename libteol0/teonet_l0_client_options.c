@@ -2,9 +2,13 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "teobase/logging.h"
+#include "teoccl/memory.h"
 #include "teonet_l0_client_crypt.h"
+#include "teonet_l0_client_keypool.h"
 
 extern bool teocliOpt_DBG_packetFlow;
 bool teocliOpt_DBG_packetFlow = false;
@@ -61,8 +65,10 @@ teoLNullEncryptionProtocol teocliOpt_EncryptionProtocol =
 
 void teoLNUllSetOption_EncryptionProtocol(int protocol) {
     switch (protocol) {
-    case ENC_PROTO_DISABLED: // fallthrough
-    case ENC_PROTO_ECDH_AES_128_V1:
+    case ENC_PROTO_DISABLED:                  // fallthrough
+    case ENC_PROTO_ECDH_AES_128_V1:           // fallthrough
+    case ENC_PROTO_ECDH_CHACHA20_POLY1305_V2: // fallthrough
+    case ENC_PROTO_X25519_CHACHA20_POLY1305_V3:
         teocliOpt_EncryptionProtocol = (teoLNullEncryptionProtocol)protocol;
         break;
 
@@ -88,6 +94,122 @@ void teoLNUllSetOption_ConnectTimeoutMs(int32_t timeout_ms) {
            teocliOpt_ConnectTimeoutMs);
 }
 
+extern bool teocliOpt_TicklessIdle;
+bool teocliOpt_TicklessIdle = false;
+
+void teoLNUllSetOption_TicklessIdle(bool enable) {
+    teocliOpt_TicklessIdle = enable;
+}
+
+extern bool teocliOpt_TickEvent;
+bool teocliOpt_TickEvent = false;
+
+void teoLNUllSetOption_TickEvent(bool enable) {
+    teocliOpt_TickEvent = enable;
+}
+
+enum {
+    DEFAULT_KEEPALIVE_INTERVAL_MS = 4000,
+};
+
+extern int32_t teocliOpt_KeepaliveIntervalMs;
+int32_t teocliOpt_KeepaliveIntervalMs = DEFAULT_KEEPALIVE_INTERVAL_MS;
+
+void teoLNUllSetOption_KeepaliveIntervalMs(int32_t interval_ms) {
+    teocliOpt_KeepaliveIntervalMs =
+        (interval_ms > 0) ? interval_ms : DEFAULT_KEEPALIVE_INTERVAL_MS;
+
+    LTRACK("TeonetClient", "Set KeepaliveIntervalMs = %d ms",
+           teocliOpt_KeepaliveIntervalMs);
+}
+
+extern uint32_t teocliOpt_KeystreamCacheBytes;
+uint32_t teocliOpt_KeystreamCacheBytes = 0;
+
+void teoLNUllSetOption_KeystreamCacheBytes(uint32_t bytes) {
+    teocliOpt_KeystreamCacheBytes = bytes;
+
+    LTRACK("TeonetClient", "Set KeystreamCacheBytes = %u", bytes);
+}
+
+extern uint32_t teocliOpt_KeyPoolDepth;
+uint32_t teocliOpt_KeyPoolDepth = 0;
+
+void teoLNUllSetOption_KeyPoolDepth(uint32_t depth) {
+    teocliOpt_KeyPoolDepth = depth;
+    teoLNullKeyPoolSetDepth(depth);
+
+    LTRACK("TeonetClient", "Set KeyPoolDepth = %u", depth);
+}
+
+extern bool teocliOpt_SessionResumption;
+bool teocliOpt_SessionResumption = false;
+
+void teoLNUllSetOption_SessionResumption(bool enable) {
+    teocliOpt_SessionResumption = enable;
+}
+
+enum {
+    DEFAULT_LATENCY_SAMPLE_RATE = 16,
+};
+
+extern uint32_t teocliOpt_LatencySampleRate;
+uint32_t teocliOpt_LatencySampleRate = DEFAULT_LATENCY_SAMPLE_RATE;
+
+void teoLNUllSetOption_LatencySampleRate(uint32_t rate) {
+    teocliOpt_LatencySampleRate = rate;
+
+    LTRACK("TeonetClient", "Set LatencySampleRate = %u", rate);
+}
+
+extern char *teocliOpt_CapturePath;
+char *teocliOpt_CapturePath = NULL;
+
+extern bool teocliOpt_CaptureKeys;
+bool teocliOpt_CaptureKeys = false;
+
+void teoLNUllSetOption_Capture(const char *path, bool with_keys) {
+    if (teocliOpt_CapturePath != NULL) { free(teocliOpt_CapturePath); }
+    teocliOpt_CapturePath = NULL;
+    if (path != NULL) {
+        teocliOpt_CapturePath = (char *)ccl_malloc(strlen(path) + 1);
+        strcpy(teocliOpt_CapturePath, path);
+    }
+    teocliOpt_CaptureKeys = with_keys;
+
+    LTRACK("TeonetClient", "Set Capture = %s, keys %s",
+           path != NULL ? path : "disabled", with_keys ? "true" : "false");
+}
+
+extern const struct teoLNullDatagramTransport *teocliOpt_DatagramTransport;
+const struct teoLNullDatagramTransport *teocliOpt_DatagramTransport = NULL;
+
+void teoLNUllSetOption_DatagramTransport(
+    const struct teoLNullDatagramTransport *transport) {
+    teocliOpt_DatagramTransport = transport;
+
+    LTRACK("TeonetClient", "Set DatagramTransport = %s",
+           transport != NULL ? "custom" : "UDP socket");
+}
+
+extern uint32_t teocliOpt_ReconnectMinMs;
+uint32_t teocliOpt_ReconnectMinMs = 0;
+extern uint32_t teocliOpt_ReconnectMaxMs;
+uint32_t teocliOpt_ReconnectMaxMs = 0;
+extern uint32_t teocliOpt_ReconnectQueueBytes;
+uint32_t teocliOpt_ReconnectQueueBytes = 0;
+
+void teoLNUllSetOption_AutoReconnect(uint32_t min_delay_ms,
+                                     uint32_t max_delay_ms,
+                                     uint32_t queue_bytes) {
+    teocliOpt_ReconnectMinMs = min_delay_ms;
+    teocliOpt_ReconnectMaxMs = max_delay_ms;
+    teocliOpt_ReconnectQueueBytes = queue_bytes;
+
+    LTRACK("TeonetClient", "Set AutoReconnect = %u..%u ms, queue %u bytes",
+           min_delay_ms, max_delay_ms, queue_bytes);
+}
+
 extern teocliDataSentCallback_t teocliOpt_STAT_dataSentCallback;
 teocliDataSentCallback_t teocliOpt_STAT_dataSentCallback = NULL;
 
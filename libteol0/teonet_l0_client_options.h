@@ -76,11 +76,143 @@ TEOCLI_API void teoLNUllSetOption_MaximumReceiveInSelect(int32_t maximum_message
  * Set encryption protocol used by connections
  * by default used ENC_PROTO_ECDH_AES_128_V1
  * to disable application should explicitly set it to ENC_PROTO_DISABLED
+ * ENC_PROTO_ECDH_CHACHA20_POLY1305_V2 authenticates packets with AEAD tag and
+ * requires L0 server support, ENC_PROTO_X25519_CHACHA20_POLY1305_V3 also
+ * makes connection setup much faster with X25519 key exchange
  *
  * @param protocol one of teoLNullEncryptionProtocol values
 */
 TEOCLI_API void teoLNUllSetOption_EncryptionProtocol(int protocol);
 
+/**
+ * Enable tickless idle mode of teoLNullReadEventLoop.
+ *
+ * In tickless mode the loop sleeps until the nearest real deadline: TR-UDP
+ * retransmit, keepalive or the loop @a timeout argument, or until I/O
+ * arrives. Negative loop timeout means no user deadline. EV_L_IDLE is sent
+ * only when the loop timeout expires, EV_L_TICK only if enabled by
+ * teoLNUllSetOption_TickEvent. Keepalive is processed once per keepalive
+ * interval, together with data traffic when possible. Disabled by default.
+ *
+ * @param enable - boolean, if true - enables tickless idle mode
+ */
+TEOCLI_API void teoLNUllSetOption_TicklessIdle(bool enable);
+
+/**
+ * Send EV_L_TICK event in tickless idle mode.
+ *
+ * @param enable - boolean, if true - EV_L_TICK is sent after every
+ * teoLNullReadEventLoop call in tickless mode too. Disabled by default.
+ * Without tickless mode EV_L_TICK is always sent.
+ */
+TEOCLI_API void teoLNUllSetOption_TickEvent(bool enable);
+
+/**
+ * Set TR-UDP keepalive processing interval used in tickless idle mode.
+ *
+ * @param interval_ms should be positive integer, specifying interval between
+ * keepalive checks in milliseconds. It must be less than server disconnect
+ * timeout. Default value is 4000ms. If @a interval_ms is zero or less then
+ * interval set to default 4000ms instead.
+ */
+TEOCLI_API void teoLNUllSetOption_KeepaliveIntervalMs(int32_t interval_ms);
+
+/**
+ * Set size of CTR keystream precomputed ahead for encryption and decryption.
+ *
+ * @param bytes - keystream budget per direction in bytes. Keystream for next
+ * packets is generated by teoLNullReadEventLoop after events processing, so
+ * encryption of packets up to 512 bytes is reduced to XOR. Zero (default)
+ * disables precomputation.
+ */
+TEOCLI_API void teoLNUllSetOption_KeystreamCacheBytes(uint32_t bytes);
+
+/**
+ * Set depth of process-wide pool of pre-generated ECDH keypairs.
+ *
+ * @param depth - number of keypairs background thread keeps ready. ECDH
+ * connections take keypair from the pool instead of generating it on
+ * connecting thread, and generate it inline when the pool is empty. Every
+ * keypair is used once only. Zero (default) stops the thread and disables
+ * the pool. See teoLNullKeyPoolGetStats for pool statistics.
+ */
+TEOCLI_API void teoLNUllSetOption_KeyPoolDepth(uint32_t depth);
+
+/**
+ * Enable session resumption on reconnect.
+ *
+ * @param enable - if true, resumption tickets issued by L0 server are kept
+ * in process-wide cache and next connection to the same server sends the
+ * ticket instead of key exchange. Server that doesn't know the ticket rejects
+ * it and regular key exchange follows. Requires L0 server support, default is
+ * false.
+ */
+TEOCLI_API void teoLNUllSetOption_SessionResumption(bool enable);
+
+/**
+ * Set sample rate of per stage latency tracing.
+ *
+ * @param rate - one of @a rate event loop iterations and one of @a rate send
+ * calls of connection have their stages timestamped, see
+ * teoLNullGetStageStats. Applied to connections created later. Zero disables
+ * tracing, default is 16. Has no effect if library is built without
+ * TEOCLI_LATENCY_TRACE.
+ */
+TEOCLI_API void teoLNUllSetOption_LatencySampleRate(uint32_t rate);
+
+/**
+ * Capture bytes received by connections created later.
+ *
+ * @param path - every connection created by teoLNullConnectE writes capture
+ * to file @a path with ".N" suffix, N is number of captured connection in
+ * process starting from 1, see teoLNullCaptureLoad. NULL disables capture,
+ * default is NULL.
+ * @param with_keys - record keys of encrypted sessions, so replay decrypts
+ * packets. Use in test environments only, capture decrypts whole session.
+ */
+TEOCLI_API void teoLNUllSetOption_Capture(const char *path, bool with_keys);
+
+// forward declaration, complete type in libteol0/teonet_l0_client.h
+struct teoLNullDatagramTransport;
+
+/**
+ * Set datagram transport of TR-UDP connections created later.
+ *
+ * @param transport - teoLNullDatagramTransport used by teoLNullConnectE
+ * instead of UDP socket, e.g. network simulator of tests and benchmarks.
+ * Pointer is kept and must stay valid while connections use it. NULL
+ * restores UDP socket, default is NULL. Not supported on Windows.
+ */
+TEOCLI_API void teoLNUllSetOption_DatagramTransport(
+    const struct teoLNullDatagramTransport *transport);
+
+/**
+ * Reconnect connections created later by themselves after link loss.
+ *
+ * @param min_delay_ms - first attempt is made in @a min_delay_ms after link
+ * loss, every next one waits twice longer up to @a max_delay_ms, delays are
+ * randomly shortened down to half. Zero disables auto reconnect, default is
+ * zero.
+ * @param max_delay_ms - longest delay between attempts in milliseconds.
+ * @param queue_bytes - most bytes of packets queued while link is down.
+ *
+ * Connection established by teoLNullConnectE keeps its buffers, TR-UDP
+ * socket and encryption context memory across reconnects, and
+ * teoLNullReadEventLoop keeps returning true until teoLNullShutdown.
+ * EV_L_DISCONNECTED and EV_L_CONNECTED of every attempt are still sent, the
+ * connection must not be disconnected from the callback. Name of last
+ * teoLNullLogin is sent again if the application doesn't log in from
+ * EV_L_CONNECTED itself. Packets of teoLNullSend, teoLNullSendEcho and
+ * teoLNullPacketSend called while link is down, and packets TR-UDP
+ * connection had in its pipe, are queued and sent after re-login in the
+ * same order; the call returns packet length, or -1 if queue is full.
+ * Unreliable packets are not queued. See reconnect counters of
+ * teoLNullGetStats.
+ */
+TEOCLI_API void teoLNUllSetOption_AutoReconnect(uint32_t min_delay_ms,
+                                                uint32_t max_delay_ms,
+                                                uint32_t queue_bytes);
+
 /**
  * Callback function type for @a teocliSetOption_STAT_bytesSentCallback.
  */
@@ -88,7 +220,8 @@ typedef void (*teocliDataSentCallback_t)(int bytes);
 
 /**
  * Set callback function that get called when data sent to transport
- * layer (tcp or Trudp). Default value is NULL.
+ * layer (tcp or Trudp). Default value is NULL. Callback is process-wide, use
+ * teoLNullGetStats for statistic of a connection.
  *
  * @param callback callback function.
  */
@@ -102,7 +235,8 @@ typedef void (*teocliDataReceivedCallback_t)(int bytes);
 
 /**
  * Set callback function that get called when data received from transport
- * layer (tcp or Trudp). Default value is NULL.
+ * layer (tcp or Trudp). Default value is NULL. Callback is process-wide, use
+ * teoLNullGetStats for statistic of a connection.
  *
  * @param callback callback function.
  */
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_PROBES_H
+#define TEONET_L0_CLIENT_PROBES_H
+
+/////////////////
+// Hot path static tracepoints and debug logging
+//
+// With TEOCLI_USDT defined hot paths have USDT probes of "teocli" provider
+// from <sys/sdt.h>. Unused probe is a nop instruction, its arguments are
+// already in registers. Probes are built in by configure --enable-usdt and
+// listed with
+//
+//     bpftrace -l 'usdt:./libteocli.so:teocli:*'
+//
+// and traced live by bpftrace, perf probe or SystemTap, e.g.
+//
+//     bpftrace -e 'usdt:./libteocli.so:teocli:packet_received
+//                  { @bytes[arg1] = hist(arg0); }'
+//
+// With TEOCLI_NO_DEBUG_LOG defined debug flag logging of hot paths is compiled
+// out, teoLNUllSetOption_DBG_packetFlow, _DBG_selectLoop and _DBG_sentPackets
+// have no effect on them and packets don't pay for flag checks.
+/////////////////
+
+#if defined(TEOCLI_USDT)
+#include <sys/sdt.h>
+
+#define TEOCLI_PROBE0(name) DTRACE_PROBE(teocli, name)
+#define TEOCLI_PROBE1(name, a1) DTRACE_PROBE1(teocli, name, a1)
+#define TEOCLI_PROBE2(name, a1, a2) DTRACE_PROBE2(teocli, name, a1, a2)
+#define TEOCLI_PROBE3(name, a1, a2, a3)                                        \
+    DTRACE_PROBE3(teocli, name, a1, a2, a3)
+#else
+#define TEOCLI_PROBE0(name) ((void)0)
+#define TEOCLI_PROBE1(name, a1) ((void)0)
+#define TEOCLI_PROBE2(name, a1, a2) ((void)0)
+#define TEOCLI_PROBE3(name, a1, a2, a3) ((void)0)
+#endif
+
+#if defined(TEOCLI_NO_DEBUG_LOG)
+// Arguments stay referenced, so variables used by logs only don't warn
+#define CLTRACK_HOT(flag, tag, ...)                                            \
+    do {                                                                       \
+        if (0) { CLTRACK(flag, tag, __VA_ARGS__); }                            \
+    } while (0)
+#else
+#define CLTRACK_HOT(flag, tag, ...) CLTRACK(flag, tag, __VA_ARGS__)
+#endif
+
+#endif /* TEONET_L0_CLIENT_PROBES_H */
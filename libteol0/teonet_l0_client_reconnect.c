@@ -0,0 +1,244 @@
+/**
+ * File:   teonet_l0_client_reconnect.c
+ *
+ * Managed reconnect of connection. Event loop thread reconnects after link
+ * loss with jittered exponential backoff. Senders pass the gate with two
+ * atomic adds while link is up; when link is lost the gate is closed, event
+ * loop thread waits for senders inside it to leave and then may replace
+ * socket and encryption context. Packets sent while link is down are copied
+ * to bounded queue and sent after re-login in the same order.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_reconnect.h"
+
+#include <string.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+#include "libtinycrypt/tinycrypt.h"
+#include "teobase/time.h"
+
+#include "teoccl/memory.h"
+
+#if defined(TEONET_COMPILER_MSVC)
+#define RECONNECT_ADD(ptr, value)                                              \
+    InterlockedExchangeAdd64((volatile LONG64 *)(ptr), (LONG64)(value))
+#define RECONNECT_LOAD(ptr)                                                    \
+    ((uint64_t)InterlockedOr64((volatile LONG64 *)(ptr), 0))
+#define RECONNECT_STORE(ptr, value)                                            \
+    InterlockedExchange64((volatile LONG64 *)(ptr), (LONG64)(value))
+#define RECONNECT_YIELD() SwitchToThread()
+#else
+#define RECONNECT_ADD(ptr, value)                                              \
+    __atomic_fetch_add((ptr), (uint64_t)(value), __ATOMIC_SEQ_CST)
+#define RECONNECT_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define RECONNECT_STORE(ptr, value)                                            \
+    __atomic_store_n((ptr), (uint64_t)(value), __ATOMIC_SEQ_CST)
+#define RECONNECT_YIELD() sched_yield()
+#endif
+
+struct teoLNullReconnectPacket {
+    teoLNullReconnectPacket *next;
+    bool with_encryption;
+    size_t length;
+    size_t capacity;
+    uint8_t data[];
+};
+
+static char *_strdup(const char *str) {
+    char *copy = (char *)ccl_malloc(strlen(str) + 1);
+    strcpy(copy, str);
+    return copy;
+}
+
+teoLNullReconnect *teoLNullReconnectCreate(const char *server, uint16_t port,
+                                           int enc_proto, uint32_t min_ms,
+                                           uint32_t max_ms,
+                                           size_t queue_limit) {
+    teoLNullReconnect *rc =
+        (teoLNullReconnect *)ccl_malloc(sizeof(teoLNullReconnect));
+    memset(rc, 0, sizeof(teoLNullReconnect));
+
+    rc->server = _strdup(server);
+    rc->port = port;
+    rc->enc_proto = enc_proto;
+    rc->min_ms = min_ms;
+    rc->max_ms = max_ms > min_ms ? max_ms : min_ms;
+    rc->queue_limit = queue_limit;
+    teomutexInitialize(&rc->queue_lock);
+
+    return rc;
+}
+
+void teoLNullReconnectDestroy(teoLNullReconnect *rc) {
+    if (rc == NULL) { return; }
+
+    while (rc->queue_head != NULL) { teoLNullReconnectQueuePop(rc); }
+    teomutexDestroy(&rc->queue_lock);
+    free(rc->server);
+    if (rc->host_name != NULL) { free(rc->host_name); }
+    free(rc);
+}
+
+void teoLNullReconnectSetLogin(teoLNullReconnect *rc, const char *host_name) {
+    // Re-login passes remembered name itself
+    if (host_name != rc->host_name) {
+        if (rc->host_name != NULL) { free(rc->host_name); }
+        rc->host_name = _strdup(host_name);
+    }
+    rc->login_f = true;
+}
+
+bool teoLNullReconnectEnter(teoLNullReconnect *rc) {
+    // Sender is published before down is checked and link down handler
+    // publishes down before it checks senders, so one of them sees the other
+    RECONNECT_ADD(&rc->senders, 1);
+    if (RECONNECT_LOAD(&rc->down) == 0) { return true; }
+
+    RECONNECT_ADD(&rc->senders, -1);
+    return false;
+}
+
+void teoLNullReconnectLeave(teoLNullReconnect *rc) {
+    RECONNECT_ADD(&rc->senders, -1);
+}
+
+void teoLNullReconnectLinkDown(teoLNullReconnect *rc,
+                               teoLNullReconnectDrainCb drain, void *arg) {
+    // Draining is published first, sender seeing the gate closed waits for
+    // packets of senders inside it to be queued before its own packet
+    RECONNECT_STORE(&rc->draining, 1);
+    RECONNECT_STORE(&rc->down, 1);
+    while (RECONNECT_LOAD(&rc->senders) != 0) {
+        if (drain != NULL) { drain(arg); }
+        RECONNECT_YIELD();
+    }
+    if (drain != NULL) { drain(arg); }
+    RECONNECT_STORE(&rc->draining, 0);
+
+    rc->down_ms = teotimeGetCurrentTimeMs();
+    rc->attempts = 0;
+    teoLNullReconnectScheduleNext(rc);
+}
+
+void teoLNullReconnectScheduleNext(teoLNullReconnect *rc) {
+    uint64_t backoff_ms = rc->min_ms;
+    for (uint32_t i = 0; i < rc->attempts && backoff_ms < rc->max_ms; i++) {
+        backoff_ms *= 2;
+    }
+    if (backoff_ms > rc->max_ms) { backoff_ms = rc->max_ms; }
+
+    // Clients lost the same server don't come back all at once
+    uint32_t random;
+    randomize_bytes((volatile uint8_t *)&random, sizeof(random));
+    const uint64_t half_ms = backoff_ms / 2;
+    const uint64_t delay_ms = half_ms + random % (backoff_ms - half_ms + 1);
+
+    rc->attempts++;
+    rc->next_attempt_ms = teotimeGetCurrentTimeMs() + (int64_t)delay_ms;
+}
+
+bool teoLNullReconnectLinkUp(teoLNullReconnect *rc) {
+    teomutexLock(&rc->queue_lock);
+    const bool empty = rc->queue_head == NULL;
+    if (empty) { RECONNECT_STORE(&rc->down, 0); }
+    teomutexUnlock(&rc->queue_lock);
+    return empty;
+}
+
+bool teoLNullReconnectIsDown(teoLNullReconnect *rc) {
+    return RECONNECT_LOAD(&rc->down) != 0;
+}
+
+void teoLNullReconnectStop(teoLNullReconnect *rc) {
+    RECONNECT_STORE(&rc->stopped, 1);
+}
+
+bool teoLNullReconnectIsStopped(teoLNullReconnect *rc) {
+    return RECONNECT_LOAD(&rc->stopped) != 0;
+}
+
+teoLNullReconnectQueueResult
+teoLNullReconnectQueuePush(teoLNullReconnect *rc, bool with_encryption,
+                           const void *packet, size_t length, size_t capacity,
+                           bool force) {
+    if (capacity < length) { capacity = length; }
+
+    teomutexLock(&rc->queue_lock);
+    while (!force && RECONNECT_LOAD(&rc->draining) != 0) {
+        teomutexUnlock(&rc->queue_lock);
+        RECONNECT_YIELD();
+        teomutexLock(&rc->queue_lock);
+    }
+
+    // Gate is opened under the lock when queue is empty, so packet is
+    // either queued before replay ends or sent by caller after it
+    if (RECONNECT_LOAD(&rc->down) == 0) {
+        teomutexUnlock(&rc->queue_lock);
+        return RECONNECT_LINK_UP;
+    }
+    if (!force && rc->queue_bytes + length > rc->queue_limit) {
+        teomutexUnlock(&rc->queue_lock);
+        return RECONNECT_QUEUE_FULL;
+    }
+
+    teoLNullReconnectPacket *item = (teoLNullReconnectPacket *)ccl_malloc(
+        sizeof(teoLNullReconnectPacket) + capacity);
+    item->next = NULL;
+    item->with_encryption = with_encryption;
+    item->length = length;
+    item->capacity = capacity;
+    memcpy(item->data, packet, length);
+
+    if (rc->queue_tail != NULL) {
+        rc->queue_tail->next = item;
+    } else {
+        rc->queue_head = item;
+    }
+    rc->queue_tail = item;
+    rc->queue_bytes += length;
+    teomutexUnlock(&rc->queue_lock);
+
+    return RECONNECT_QUEUED;
+}
+
+bool teoLNullReconnectQueueFront(teoLNullReconnect *rc, bool *with_encryption,
+                                 void **packet, size_t *length,
+                                 size_t *capacity) {
+    teomutexLock(&rc->queue_lock);
+    teoLNullReconnectPacket *item = rc->queue_head;
+    teomutexUnlock(&rc->queue_lock);
+    if (item == NULL) { return false; }
+
+    *with_encryption = item->with_encryption;
+    *packet = item->data;
+    *length = item->length;
+    *capacity = item->capacity;
+    return true;
+}
+
+void teoLNullReconnectQueuePop(teoLNullReconnect *rc) {
+    teomutexLock(&rc->queue_lock);
+    teoLNullReconnectPacket *item = rc->queue_head;
+    if (item != NULL) {
+        rc->queue_head = item->next;
+        if (rc->queue_head == NULL) { rc->queue_tail = NULL; }
+        rc->queue_bytes -= item->length;
+    }
+    teomutexUnlock(&rc->queue_lock);
+
+    if (item != NULL) { free(item); }
+}
+
+size_t teoLNullReconnectQueueUsed(teoLNullReconnect *rc) {
+    teomutexLock(&rc->queue_lock);
+    const size_t used = rc->queue_bytes;
+    teomutexUnlock(&rc->queue_lock);
+    return used;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_RECONNECT_H
+#define TEONET_L0_CLIENT_RECONNECT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+#include "teobase/mutex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Managed reconnect of connection and queue of packets sent while link is down
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client_reconnect.c
+typedef struct teoLNullReconnectPacket teoLNullReconnectPacket;
+
+/**
+ * Managed reconnect state of connection
+ *
+ * Fields of the first group are used by event loop thread only. Senders of
+ * any thread pass the gate of teoLNullReconnectEnter while link is up and
+ * put packets to the queue while it's down.
+ */
+typedef struct teoLNullReconnect {
+
+    char *server;      ///< Server IP or name to reconnect to
+    uint16_t port;     ///< Server port
+    int enc_proto;     ///< teoLNullEncryptionProtocol of connection
+    char *host_name;   ///< Name of last teoLNullLogin, NULL before login
+    uint32_t min_ms;   ///< Backoff of first attempt
+    uint32_t max_ms;   ///< Backoff limit
+    bool established;  ///< Connection was established once
+    bool attempting;   ///< Attempt runs nested event loop
+    bool login_f;      ///< teoLNullLogin was called during attempt
+    uint32_t attempts; ///< Failed attempts since link was lost
+    int64_t down_ms;   ///< Time link was lost
+    int64_t next_attempt_ms; ///< Time of next attempt
+
+    uint64_t down;     ///< Link is down, senders queue packets
+    uint64_t draining; ///< Packets of senders passed the gate are queued
+    uint64_t senders;  ///< Senders passed the gate
+    uint64_t stopped;  ///< teoLNullShutdown was called
+
+    teonetMutex queue_lock;
+    teoLNullReconnectPacket *queue_head;
+    teoLNullReconnectPacket *queue_tail;
+    size_t queue_bytes; ///< Packet bytes in queue
+    size_t queue_limit; ///< Most packet bytes in queue
+
+} teoLNullReconnect;
+
+/**
+ * Result of teoLNullReconnectQueuePush
+ */
+typedef enum teoLNullReconnectQueueResult {
+    RECONNECT_QUEUED,     ///< Packet is sent after re-login
+    RECONNECT_QUEUE_FULL, ///< Packet doesn't fit to queue and is dropped
+    RECONNECT_LINK_UP,    ///< Link is up again, packet must be sent now
+} teoLNullReconnectQueueResult;
+
+/**
+ * Create reconnect state of connection to @a server
+ *
+ * @param server Server IP or name
+ * @param port Server port
+ * @param enc_proto Encryption protocol of connection
+ * @param min_ms Backoff of first attempt in ms
+ * @param max_ms Backoff limit in ms
+ * @param queue_limit Most bytes of packets queued while link is down
+ *
+ * @return Pointer to created state
+ */
+TEOCLI_INTERNAL teoLNullReconnect *
+teoLNullReconnectCreate(const char *server, uint16_t port, int enc_proto,
+                        uint32_t min_ms, uint32_t max_ms, size_t queue_limit);
+
+/**
+ * Destroy reconnect state and queued packets, NULL is ignored
+ */
+TEOCLI_INTERNAL void teoLNullReconnectDestroy(teoLNullReconnect *rc);
+
+/**
+ * Remember login name for re-login and mark login of current attempt done
+ */
+TEOCLI_INTERNAL void teoLNullReconnectSetLogin(teoLNullReconnect *rc,
+                                               const char *host_name);
+
+/**
+ * Enter send gate, may be called by any thread
+ *
+ * @return true if link is up and caller must send packet and call
+ *  teoLNullReconnectLeave, false if link is down
+ */
+TEOCLI_INTERNAL bool teoLNullReconnectEnter(teoLNullReconnect *rc);
+
+/**
+ * Leave send gate entered by teoLNullReconnectEnter
+ */
+TEOCLI_INTERNAL void teoLNullReconnectLeave(teoLNullReconnect *rc);
+
+/**
+ * Callback of teoLNullReconnectLinkDown moving packets which senders passed
+ * the gate with to the queue
+ */
+typedef void (*teoLNullReconnectDrainCb)(void *arg);
+
+/**
+ * Close send gate, wait for senders inside it to leave and schedule first
+ * attempt, called by event loop thread when link is lost
+ *
+ * Senders may be blocked by transport only event loop thread empties, so
+ * @a drain is called while they are waited for and once after they left.
+ * Packets of senders which didn't pass the gate are queued after it.
+ *
+ * @param rc Reconnect state
+ * @param drain Callback queueing packets of senders inside the gate or NULL
+ * @param arg Argument of @a drain
+ */
+TEOCLI_INTERNAL void teoLNullReconnectLinkDown(teoLNullReconnect *rc,
+                                               teoLNullReconnectDrainCb drain,
+                                               void *arg);
+
+/**
+ * Schedule next attempt after failed one, backoff grows twice per attempt
+ * up to max_ms and is jittered down to its half
+ */
+TEOCLI_INTERNAL void teoLNullReconnectScheduleNext(teoLNullReconnect *rc);
+
+/**
+ * Open send gate if queue is empty, called by event loop thread after
+ * replay
+ *
+ * @return true if gate is open, false if packets were queued meanwhile
+ */
+TEOCLI_INTERNAL bool teoLNullReconnectLinkUp(teoLNullReconnect *rc);
+
+/**
+ * Check link is down, may be called by any thread
+ */
+TEOCLI_INTERNAL bool teoLNullReconnectIsDown(teoLNullReconnect *rc);
+
+/**
+ * Stop reconnecting, may be called by any thread
+ */
+TEOCLI_INTERNAL void teoLNullReconnectStop(teoLNullReconnect *rc);
+
+/**
+ * Check teoLNullReconnectStop was called
+ */
+TEOCLI_INTERNAL bool teoLNullReconnectIsStopped(teoLNullReconnect *rc);
+
+/**
+ * Copy packet to queue while link is down, may be called by any thread
+ *
+ * @param rc Reconnect state
+ * @param with_encryption Flag allowing encryption of packet
+ * @param packet Packet, not sealed
+ * @param length Packet length
+ * @param capacity Size of queued packet buffer, room for encryption overhead
+ * @param force Queue packet even if queue is full, for packets accepted
+ *  before link was lost. Packets which aren't forced wait for forced ones
+ *  of teoLNullReconnectLinkDown
+ *
+ * @return One of teoLNullReconnectQueueResult
+ */
+TEOCLI_INTERNAL teoLNullReconnectQueueResult
+teoLNullReconnectQueuePush(teoLNullReconnect *rc, bool with_encryption,
+                           const void *packet, size_t length, size_t capacity,
+                           bool force);
+
+/**
+ * Get oldest queued packet, called by event loop thread only, packet stays
+ * valid until teoLNullReconnectQueuePop
+ *
+ * @return false if queue is empty
+ */
+TEOCLI_INTERNAL bool teoLNullReconnectQueueFront(teoLNullReconnect *rc,
+                                                 bool *with_encryption,
+                                                 void **packet, size_t *length,
+                                                 size_t *capacity);
+
+/**
+ * Remove oldest queued packet, called by event loop thread only
+ */
+TEOCLI_INTERNAL void teoLNullReconnectQueuePop(teoLNullReconnect *rc);
+
+/**
+ * Get bytes of queued packets, may be called by any thread
+ */
+TEOCLI_INTERNAL size_t teoLNullReconnectQueueUsed(teoLNullReconnect *rc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_RECONNECT_H */
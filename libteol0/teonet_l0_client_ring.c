@@ -0,0 +1,385 @@
+/**
+ * File:   teonet_l0_client_ring.c
+ *
+ * Single producer single consumer ring of received packets. Event loop thread
+ * puts assembled packets to the ring, consumer thread takes them in batches
+ * and releases them when processed. Packets are stored as variable length
+ * records: 8 bytes header followed by packet data aligned to 8 bytes. Record
+ * which doesn't fit to the ring end is written from the ring start, the rest
+ * of the ring end is marked by wrap record. Wrap record is published before
+ * the record is written, so producer waits for record size only and ring
+ * smallest size holds the largest L0 packet.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_ring.h"
+#include "teonet_l0_client.h"
+#include "teonet_l0_client_crypt.h"
+
+#include <string.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "teobase/logging.h"
+
+#include "teoccl/memory.h"
+
+#if defined(TEONET_COMPILER_MSVC)
+#define RING_LOAD_ACQUIRE(ptr)                                                 \
+    ((uint64_t)InterlockedOr64((volatile LONG64 *)(ptr), 0))
+#define RING_STORE_RELEASE(ptr, value)                                         \
+    InterlockedExchange64((volatile LONG64 *)(ptr), (LONG64)(value))
+#define RING_FENCE() MemoryBarrier()
+#else
+#define RING_LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define RING_STORE_RELEASE(ptr, value)                                         \
+    __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define RING_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#define RING_ALIGN(len) (((uint64_t)(len) + 7) & ~(uint64_t)7)
+#define RING_WRAP_MARK UINT32_MAX
+#define RING_CACHE_LINE 64
+
+//! Record of the largest L0 packet: 8 bits peer name length, 16 bits data
+//! length and authentication tag
+#define RING_MIN_SIZE                                                          \
+    (sizeof(ringRecordHeader) +                                                \
+     RING_ALIGN(teoLNullBufferSize(UINT8_MAX, UINT16_MAX) +                   \
+                TEOLNULL_ENCRYPTION_MAX_OVERHEAD))
+
+typedef struct ringRecordHeader {
+    uint32_t length; ///< Packet length or RING_WRAP_MARK
+    uint32_t event;  ///< teoLNullEvents
+} ringRecordHeader;
+
+struct teoLNullRecvRing {
+    uint8_t *data;
+    uint64_t size;
+
+    //! Producer write position, published to consumer
+    uint64_t head;
+    uint8_t head_pad[RING_CACHE_LINE - sizeof(uint64_t)];
+
+    //! Consumer release position, published to producer
+    uint64_t tail;
+    //! Consumer read position, consumer only
+    uint64_t read;
+    uint8_t tail_pad[RING_CACHE_LINE - 2 * sizeof(uint64_t)];
+
+    //! Sides sleeping in _ringWait, checked after position is published
+    uint64_t consumer_waiting;
+    uint64_t producer_waiting;
+
+#if defined(TEONET_OS_WINDOWS)
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+static void _ringLock(teoLNullRecvRing *ring) {
+#if defined(TEONET_OS_WINDOWS)
+    EnterCriticalSection(&ring->lock);
+#else
+    pthread_mutex_lock(&ring->lock);
+#endif
+}
+
+static void _ringUnlock(teoLNullRecvRing *ring) {
+#if defined(TEONET_OS_WINDOWS)
+    LeaveCriticalSection(&ring->lock);
+#else
+    pthread_mutex_unlock(&ring->lock);
+#endif
+}
+
+/**
+ * Wait for ring state change, must be called with ring locked
+ *
+ * Timeout is measured by monotonic clock, wall clock steps don't change it
+ *
+ * @param timeout Time to wait in ms, negative - infinite
+ */
+static void _ringWait(teoLNullRecvRing *ring, int timeout) {
+#if defined(TEONET_OS_WINDOWS)
+    SleepConditionVariableCS(&ring->cond, &ring->lock,
+                             timeout < 0 ? INFINITE : (DWORD)timeout);
+#else
+    if (timeout < 0) {
+        pthread_cond_wait(&ring->cond, &ring->lock);
+        return;
+    }
+
+#if defined(TEONET_OS_MACOS) || defined(TEONET_OS_IOS)
+    struct timespec relative;
+    relative.tv_sec = timeout / 1000;
+    relative.tv_nsec = (long)(timeout % 1000) * 1000000;
+    pthread_cond_timedwait_relative_np(&ring->cond, &ring->lock, &relative);
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    int64_t nsec =
+        (int64_t)deadline.tv_nsec + (int64_t)(timeout % 1000) * 1000000;
+    deadline.tv_sec += timeout / 1000 + nsec / 1000000000;
+    deadline.tv_nsec = nsec % 1000000000;
+
+    pthread_cond_timedwait(&ring->cond, &ring->lock, &deadline);
+#endif
+#endif
+}
+
+/**
+ * Get monotonic time in ms for poll deadline
+ */
+static int64_t _ringNowMs(void) {
+#if defined(TEONET_OS_WINDOWS)
+    return (int64_t)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+/**
+ * Wake other side, must be called with ring locked
+ */
+static void _ringBroadcast(teoLNullRecvRing *ring) {
+#if defined(TEONET_OS_WINDOWS)
+    WakeAllConditionVariable(&ring->cond);
+#else
+    pthread_cond_broadcast(&ring->cond);
+#endif
+}
+
+/**
+ * Wake other side if it is waiting, position must be published before call
+ */
+static void _ringWake(teoLNullRecvRing *ring, uint64_t *waiting) {
+    RING_FENCE();
+    if (RING_LOAD_ACQUIRE(waiting) == 0) { return; }
+
+    _ringLock(ring);
+    _ringBroadcast(ring);
+    _ringUnlock(ring);
+}
+
+static inline ringRecordHeader *_ringRecord(teoLNullRecvRing *ring,
+                                            uint64_t position) {
+    return (ringRecordHeader *)(ring->data + position % ring->size);
+}
+
+/**
+ * Get position of the record next to the record at @a position
+ */
+static inline uint64_t _ringNext(teoLNullRecvRing *ring, uint64_t position) {
+    const ringRecordHeader *header = _ringRecord(ring, position);
+    if (header->length == RING_WRAP_MARK) {
+        return position + ring->size - position % ring->size;
+    }
+
+    return position + sizeof(ringRecordHeader) + RING_ALIGN(header->length);
+}
+
+/**
+ * Wait until ring has @a size free bytes, called by producer thread only
+ */
+static void _ringWaitFree(teoLNullRecvRing *ring, uint64_t head,
+                          uint64_t size) {
+    if (ring->size - (head - RING_LOAD_ACQUIRE(&ring->tail)) >= size) {
+        return;
+    }
+
+    _ringLock(ring);
+    RING_STORE_RELEASE(&ring->producer_waiting, 1);
+    RING_FENCE();
+    while (ring->size - (head - RING_LOAD_ACQUIRE(&ring->tail)) < size) {
+        _ringWait(ring, -1);
+    }
+    RING_STORE_RELEASE(&ring->producer_waiting, 0);
+    _ringUnlock(ring);
+}
+
+/**
+ * Pass wrap records at read position up to @a head, called by consumer
+ * thread only. Wrap record all packets before which are released is released
+ * too, so producer waiting for the ring start is woken
+ *
+ * @return true if tail is moved
+ */
+static bool _ringSkipWraps(teoLNullRecvRing *ring, uint64_t head) {
+    bool released = false;
+    while (ring->read != head &&
+           _ringRecord(ring, ring->read)->length == RING_WRAP_MARK) {
+        const bool at_tail = ring->tail == ring->read;
+        ring->read = _ringNext(ring, ring->read);
+        if (at_tail) {
+            RING_STORE_RELEASE(&ring->tail, ring->read);
+            released = true;
+        }
+    }
+    return released;
+}
+
+teoLNullRecvRing *teoLNullRecvRingCreate(size_t size) {
+    // Any received packet must fit, smaller rings are enlarged
+    size = (size_t)RING_ALIGN(size);
+    if (size < RING_MIN_SIZE) { size = RING_MIN_SIZE; }
+
+    teoLNullRecvRing *ring =
+        (teoLNullRecvRing *)ccl_malloc(sizeof(teoLNullRecvRing));
+    memset(ring, 0, sizeof(teoLNullRecvRing));
+
+    ring->data = (uint8_t *)ccl_malloc(size);
+    ring->size = size;
+
+#if defined(TEONET_OS_WINDOWS)
+    InitializeCriticalSection(&ring->lock);
+    InitializeConditionVariable(&ring->cond);
+#else
+    pthread_mutex_init(&ring->lock, NULL);
+#if defined(TEONET_OS_MACOS) || defined(TEONET_OS_IOS)
+    pthread_cond_init(&ring->cond, NULL);
+#else
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ring->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+#endif
+#endif
+
+    return ring;
+}
+
+void teoLNullRecvRingDestroy(teoLNullRecvRing *ring) {
+    if (ring == NULL) { return; }
+
+#if defined(TEONET_OS_WINDOWS)
+    DeleteCriticalSection(&ring->lock);
+#else
+    pthread_cond_destroy(&ring->cond);
+    pthread_mutex_destroy(&ring->lock);
+#endif
+
+    free(ring->data);
+    free(ring);
+}
+
+bool teoLNullRecvRingPush(teoLNullRecvRing *ring, int event,
+                          const void *packet, size_t packet_len) {
+    const uint64_t record_size =
+        sizeof(ringRecordHeader) + RING_ALIGN(packet_len);
+    if (record_size > ring->size) {
+        LTRACK_E("TeonetClient",
+                 "Packet of %u bytes doesn't fit to receive ring, dropped",
+                 (uint32_t)packet_len);
+        return false;
+    }
+
+    // Received data must not be lost, wait until consumer releases packets.
+    // Wrap record is published first: waiting for it together with the
+    // record could need more than the whole ring
+    uint64_t head = ring->head;
+    const uint64_t offset = head % ring->size;
+    if (ring->size - offset < record_size) {
+        const uint64_t skip = ring->size - offset;
+        _ringWaitFree(ring, head, skip);
+
+        ringRecordHeader *wrap = _ringRecord(ring, head);
+        wrap->length = RING_WRAP_MARK;
+        wrap->event = 0;
+        head += skip;
+
+        RING_STORE_RELEASE(&ring->head, head);
+        _ringWake(ring, &ring->consumer_waiting);
+    }
+    _ringWaitFree(ring, head, record_size);
+
+    ringRecordHeader *header = _ringRecord(ring, head);
+    header->length = (uint32_t)packet_len;
+    header->event = (uint32_t)event;
+    memcpy(header + 1, packet, packet_len);
+
+    RING_STORE_RELEASE(&ring->head, head + record_size);
+    _ringWake(ring, &ring->consumer_waiting);
+
+    return true;
+}
+
+size_t teoLNullRecvRingPoll(teoLNullRecvRing *ring, teoLNullPacketView *out,
+                            size_t max, int timeout) {
+    uint64_t head = RING_LOAD_ACQUIRE(&ring->head);
+    if (_ringSkipWraps(ring, head)) {
+        _ringWake(ring, &ring->producer_waiting);
+    }
+
+    if (head == ring->read && timeout != 0) {
+        const int64_t deadline_ms = _ringNowMs() + timeout;
+
+        _ringLock(ring);
+        RING_STORE_RELEASE(&ring->consumer_waiting, 1);
+        RING_FENCE();
+        for (;;) {
+            head = RING_LOAD_ACQUIRE(&ring->head);
+            if (_ringSkipWraps(ring, head)) { _ringBroadcast(ring); }
+            if (head != ring->read) { break; }
+
+            int wait_ms = -1;
+            if (timeout > 0) {
+                const int64_t left_ms =
+                    deadline_ms - _ringNowMs();
+                if (left_ms <= 0) { break; }
+                wait_ms = (int)left_ms;
+            }
+            _ringWait(ring, wait_ms);
+        }
+        RING_STORE_RELEASE(&ring->consumer_waiting, 0);
+        _ringUnlock(ring);
+    }
+
+    size_t count = 0;
+    while (count < max && ring->read != head) {
+        ringRecordHeader *header = _ringRecord(ring, ring->read);
+        if (header->length != RING_WRAP_MARK) {
+            out[count].event = (teoLNullEvents)header->event;
+            out[count].packet = (teoLNullCPacket *)(header + 1);
+            out[count].packet_len = header->length;
+            ++count;
+        }
+        ring->read = _ringNext(ring, ring->read);
+    }
+
+    return count;
+}
+
+void teoLNullRecvRingRelease(teoLNullRecvRing *ring, size_t count) {
+    uint64_t tail = ring->tail;
+
+    while (count > 0 && tail != ring->read) {
+        if (_ringRecord(ring, tail)->length != RING_WRAP_MARK) { --count; }
+        tail = _ringNext(ring, tail);
+    }
+    // Wrap record after released packets is released with them
+    while (tail != ring->read &&
+           _ringRecord(ring, tail)->length == RING_WRAP_MARK) {
+        tail = _ringNext(ring, tail);
+    }
+
+    RING_STORE_RELEASE(&ring->tail, tail);
+    _ringWake(ring, &ring->producer_waiting);
+}
+
+size_t teoLNullRecvRingUsed(teoLNullRecvRing *ring) {
+    const uint64_t tail = RING_LOAD_ACQUIRE(&ring->tail);
+    return (size_t)(RING_LOAD_ACQUIRE(&ring->head) - tail);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_RING_H
+#define TEONET_L0_CLIENT_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Single producer single consumer ring of received packets
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client_ring.c
+typedef struct teoLNullRecvRing teoLNullRecvRing;
+
+// forward declaration, complete type in libteol0/teonet_l0_client.h
+typedef struct teoLNullPacketView teoLNullPacketView;
+
+/**
+ * Create receive ring
+ *
+ * @param size Ring size in bytes, holds packets and 8 bytes header per packet.
+ *  Smaller size than the largest L0 packet record is enlarged to it
+ *
+ * @return Pointer to created ring or NULL if failed
+ */
+TEOCLI_INTERNAL teoLNullRecvRing *teoLNullRecvRingCreate(size_t size);
+
+/**
+ * Destroy receive ring, views returned by teoLNullRecvRingPoll became invalid
+ */
+TEOCLI_INTERNAL void teoLNullRecvRingDestroy(teoLNullRecvRing *ring);
+
+/**
+ * Put packet to the ring, called by producer (event loop) thread only
+ *
+ * Waits for free space if ring is full, so received data is never dropped
+ *
+ * @param ring Receive ring
+ * @param event Event the packet was received with
+ * @param packet Packet data
+ * @param packet_len Packet length
+ *
+ * @return true on success, false if packet is larger than the largest L0
+ *  packet
+ */
+TEOCLI_INTERNAL bool teoLNullRecvRingPush(teoLNullRecvRing *ring, int event,
+                                          const void *packet,
+                                          size_t packet_len);
+
+/**
+ * Get up to @a max packets from the ring, called by consumer thread only
+ *
+ * @param ring Receive ring
+ * @param out Array of packet views to fill
+ * @param max @a out array size
+ * @param timeout Time to wait for first packet in ms, negative - infinite
+ *
+ * @return Number of packet views filled
+ */
+TEOCLI_INTERNAL size_t teoLNullRecvRingPoll(teoLNullRecvRing *ring,
+                                            teoLNullPacketView *out,
+                                            size_t max, int timeout);
+
+/**
+ * Release @a count oldest packets returned by teoLNullRecvRingPoll
+ */
+TEOCLI_INTERNAL void teoLNullRecvRingRelease(teoLNullRecvRing *ring,
+                                             size_t count);
+
+/**
+ * Get bytes used by packets not released yet, may be called by any thread
+ */
+TEOCLI_INTERNAL size_t teoLNullRecvRingUsed(teoLNullRecvRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_RING_H */
@@ -0,0 +1,236 @@
+/**
+ * File:   teonet_l0_client_stats.c
+ *
+ * Per connection statistic counters. Counters are updated with relaxed
+ * atomic adds: senders of different threads don't lock each other and
+ * counting costs a few uncontended instructions per packet, so statistic is
+ * always on. Counters are read without stopping writers, values of one
+ * snapshot may be a few packets apart. Counting functions ignore NULL
+ * counters of connection data made outside of teoLNullConnectE.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_stats.h"
+#include "teonet_l0_client.h"
+
+#include <string.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#endif
+
+#include "teoccl/memory.h"
+
+#if defined(TEONET_COMPILER_MSVC)
+#define STATS_ADD(ptr, value)                                                  \
+    InterlockedExchangeAdd64((volatile LONG64 *)(ptr), (LONG64)(value))
+#define STATS_LOAD(ptr) ((uint64_t)InterlockedOr64((volatile LONG64 *)(ptr), 0))
+#define STATS_STORE(ptr, value)                                                \
+    InterlockedExchange64((volatile LONG64 *)(ptr), (LONG64)(value))
+#else
+#define STATS_ADD(ptr, value)                                                  \
+    __atomic_fetch_add((ptr), (uint64_t)(value), __ATOMIC_RELAXED)
+#define STATS_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define STATS_STORE(ptr, value)                                                \
+    __atomic_store_n((ptr), (uint64_t)(value), __ATOMIC_RELAXED)
+#endif
+
+struct teoLNullStatCounters {
+    teoLNullCommandStats commands[TEOLNULL_STATS_COMMANDS];
+    uint64_t send_errors;
+    uint64_t checksum_errors;
+    uint64_t decrypt_errors;
+    uint64_t connects;
+    uint64_t reconnect_attempts;
+    uint64_t reconnect_replayed;
+    uint64_t reconnect_dropped;
+    uint64_t read_buffer_high_water;
+    uint64_t read_buffer_size;
+    uint64_t trudp_retransmits;
+    uint64_t trudp_triptime;
+    uint64_t trudp_triptime_middle; ///< Bits of double
+    uint64_t trudp_send_queue;
+    uint64_t trudp_write_queue;
+    teoLNullLatencyHistogram send_latency;
+    teoLNullLatencyHistogram trudp_rtt;
+    teoLNullLatencyHistogram echo_rtt;
+    teoLNullLatencyHistogram reconnect_downtime;
+};
+
+static void _histogramRecord(teoLNullLatencyHistogram *histogram,
+                             uint64_t value_us) {
+    int bucket = 0;
+    while (bucket < TEOLNULL_LATENCY_BUCKETS - 1 &&
+           ((uint64_t)1 << bucket) < value_us) {
+        bucket++;
+    }
+    STATS_ADD(&histogram->buckets[bucket], 1);
+    STATS_ADD(&histogram->count, 1);
+    STATS_ADD(&histogram->sum, value_us);
+}
+
+static void _histogramRead(teoLNullLatencyHistogram *src,
+                           teoLNullLatencyHistogram *dst) {
+    for (int i = 0; i < TEOLNULL_LATENCY_BUCKETS; i++) {
+        dst->buckets[i] = STATS_LOAD(&src->buckets[i]);
+    }
+    dst->count = STATS_LOAD(&src->count);
+    dst->sum = STATS_LOAD(&src->sum);
+}
+
+teoLNullStatCounters *teoLNullStatsCreate(void) {
+    teoLNullStatCounters *counters =
+        (teoLNullStatCounters *)ccl_malloc(sizeof(teoLNullStatCounters));
+    memset(counters, 0, sizeof(teoLNullStatCounters));
+    return counters;
+}
+
+void teoLNullStatsDestroy(teoLNullStatCounters *counters) {
+    if (counters != NULL) { free(counters); }
+}
+
+void teoLNullStatsCountSent(teoLNullStatCounters *counters, uint8_t cmd,
+                            size_t bytes) {
+    if (counters == NULL) { return; }
+    STATS_ADD(&counters->commands[cmd].packets_sent, 1);
+    STATS_ADD(&counters->commands[cmd].bytes_sent, bytes);
+}
+
+void teoLNullStatsCountReceived(teoLNullStatCounters *counters, uint8_t cmd,
+                                size_t bytes) {
+    if (counters == NULL) { return; }
+    STATS_ADD(&counters->commands[cmd].packets_received, 1);
+    STATS_ADD(&counters->commands[cmd].bytes_received, bytes);
+}
+
+void teoLNullStatsCountError(teoLNullStatCounters *counters,
+                             teoLNullStatError error) {
+    if (counters == NULL) { return; }
+    switch (error) {
+    case STAT_ERROR_SEND: STATS_ADD(&counters->send_errors, 1); break;
+    case STAT_ERROR_CHECKSUM: STATS_ADD(&counters->checksum_errors, 1); break;
+    case STAT_ERROR_DECRYPT: STATS_ADD(&counters->decrypt_errors, 1); break;
+    default: break;
+    }
+}
+
+void teoLNullStatsRecordLatency(teoLNullStatCounters *counters,
+                                teoLNullStatLatency latency,
+                                uint64_t value_us) {
+    if (counters == NULL) { return; }
+    switch (latency) {
+    case STAT_LATENCY_SEND:
+        _histogramRecord(&counters->send_latency, value_us);
+        break;
+    case STAT_LATENCY_TRUDP_RTT:
+        _histogramRecord(&counters->trudp_rtt, value_us);
+        break;
+    case STAT_LATENCY_ECHO_RTT:
+        _histogramRecord(&counters->echo_rtt, value_us);
+        break;
+    case STAT_LATENCY_RECONNECT:
+        _histogramRecord(&counters->reconnect_downtime, value_us);
+        break;
+    default: break;
+    }
+}
+
+void teoLNullStatsCountConnect(teoLNullStatCounters *counters) {
+    if (counters == NULL) { return; }
+    STATS_ADD(&counters->connects, 1);
+}
+
+void teoLNullStatsCountReconnect(teoLNullStatCounters *counters,
+                                 teoLNullStatReconnect event) {
+    if (counters == NULL) { return; }
+    switch (event) {
+    case STAT_RECONNECT_ATTEMPT:
+        STATS_ADD(&counters->reconnect_attempts, 1);
+        break;
+    case STAT_RECONNECT_REPLAYED:
+        STATS_ADD(&counters->reconnect_replayed, 1);
+        break;
+    case STAT_RECONNECT_DROPPED:
+        STATS_ADD(&counters->reconnect_dropped, 1);
+        break;
+    default: break;
+    }
+}
+
+void teoLNullStatsReadBufferUsed(teoLNullStatCounters *counters, size_t used,
+                                 size_t size) {
+    if (counters == NULL) { return; }
+    // Single writer, no compare and swap needed
+    if (used > STATS_LOAD(&counters->read_buffer_high_water)) {
+        STATS_STORE(&counters->read_buffer_high_water, used);
+    }
+    if (size != STATS_LOAD(&counters->read_buffer_size)) {
+        STATS_STORE(&counters->read_buffer_size, size);
+    }
+}
+
+void teoLNullStatsStoreTrudp(teoLNullStatCounters *counters,
+                             const teoLNullStatTrudp *trudp) {
+    if (counters == NULL) { return; }
+
+    teoLNullStatTrudp zero;
+    if (trudp == NULL) {
+        memset(&zero, 0, sizeof(zero));
+        trudp = &zero;
+    }
+
+    uint64_t triptime_middle;
+    memcpy(&triptime_middle, &trudp->triptime_middle, sizeof(uint64_t));
+
+    STATS_STORE(&counters->trudp_retransmits, trudp->retransmits);
+    STATS_STORE(&counters->trudp_triptime, trudp->triptime);
+    STATS_STORE(&counters->trudp_triptime_middle, triptime_middle);
+    STATS_STORE(&counters->trudp_send_queue, trudp->send_queue);
+    STATS_STORE(&counters->trudp_write_queue, trudp->write_queue);
+}
+
+void teoLNullStatsRead(teoLNullStatCounters *counters, teoLNullStats *stats) {
+    stats->packets_sent = 0;
+    stats->bytes_sent = 0;
+    stats->packets_received = 0;
+    stats->bytes_received = 0;
+    for (int i = 0; i < TEOLNULL_STATS_COMMANDS; i++) {
+        teoLNullCommandStats *src = &counters->commands[i];
+        teoLNullCommandStats *dst = &stats->commands[i];
+        dst->packets_sent = STATS_LOAD(&src->packets_sent);
+        dst->bytes_sent = STATS_LOAD(&src->bytes_sent);
+        dst->packets_received = STATS_LOAD(&src->packets_received);
+        dst->bytes_received = STATS_LOAD(&src->bytes_received);
+
+        stats->packets_sent += dst->packets_sent;
+        stats->bytes_sent += dst->bytes_sent;
+        stats->packets_received += dst->packets_received;
+        stats->bytes_received += dst->bytes_received;
+    }
+
+    stats->send_errors = STATS_LOAD(&counters->send_errors);
+    stats->checksum_errors = STATS_LOAD(&counters->checksum_errors);
+    stats->decrypt_errors = STATS_LOAD(&counters->decrypt_errors);
+    stats->connects = STATS_LOAD(&counters->connects);
+    stats->reconnects = stats->connects > 1 ? stats->connects - 1 : 0;
+    stats->reconnect_attempts = STATS_LOAD(&counters->reconnect_attempts);
+    stats->reconnect_replayed = STATS_LOAD(&counters->reconnect_replayed);
+    stats->reconnect_dropped = STATS_LOAD(&counters->reconnect_dropped);
+    stats->read_buffer_high_water =
+        (size_t)STATS_LOAD(&counters->read_buffer_high_water);
+    stats->read_buffer_size = (size_t)STATS_LOAD(&counters->read_buffer_size);
+
+    const uint64_t triptime_middle =
+        STATS_LOAD(&counters->trudp_triptime_middle);
+    memcpy(&stats->trudp_triptime_middle, &triptime_middle, sizeof(double));
+    stats->trudp_retransmits = STATS_LOAD(&counters->trudp_retransmits);
+    stats->trudp_triptime = (uint32_t)STATS_LOAD(&counters->trudp_triptime);
+    stats->trudp_send_queue = (size_t)STATS_LOAD(&counters->trudp_send_queue);
+    stats->trudp_write_queue =
+        (size_t)STATS_LOAD(&counters->trudp_write_queue);
+    _histogramRead(&counters->send_latency, &stats->send_latency);
+    _histogramRead(&counters->trudp_rtt, &stats->trudp_rtt);
+    _histogramRead(&counters->echo_rtt, &stats->echo_rtt);
+    _histogramRead(&counters->reconnect_downtime, &stats->reconnect_downtime);
+}
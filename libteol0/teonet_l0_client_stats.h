@@ -0,0 +1,143 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_STATS_H
+#define TEONET_L0_CLIENT_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Per connection statistic counters
+/////////////////
+
+// forward declaration, complete type in libteol0/teonet_l0_client_stats.c
+typedef struct teoLNullStatCounters teoLNullStatCounters;
+
+// forward declaration, complete type in libteol0/teonet_l0_client.h
+typedef struct teoLNullStats teoLNullStats;
+
+/**
+ * Connection errors counted by teoLNullStatsCountError
+ */
+typedef enum teoLNullStatError {
+    STAT_ERROR_SEND,     ///< Socket send failed
+    STAT_ERROR_CHECKSUM, ///< Received packet checksum is wrong
+    STAT_ERROR_DECRYPT,  ///< Received packet can't be decrypted
+} teoLNullStatError;
+
+/**
+ * Latencies recorded by teoLNullStatsRecordLatency
+ */
+typedef enum teoLNullStatLatency {
+    STAT_LATENCY_SEND,      ///< Send call to socket write
+    STAT_LATENCY_TRUDP_RTT, ///< TR-UDP ACK round trip time
+    STAT_LATENCY_ECHO_RTT,  ///< Echo answer round trip time
+    STAT_LATENCY_RECONNECT, ///< Link loss to re-login of managed reconnect
+} teoLNullStatLatency;
+
+/**
+ * Managed reconnect events counted by teoLNullStatsCountReconnect
+ */
+typedef enum teoLNullStatReconnect {
+    STAT_RECONNECT_ATTEMPT,  ///< Reconnect attempt started
+    STAT_RECONNECT_REPLAYED, ///< Queued packet sent after re-login
+    STAT_RECONNECT_DROPPED,  ///< Packet dropped by full reconnect queue
+} teoLNullStatReconnect;
+
+/**
+ * TR-UDP channel state copied by event loop thread, see teoLNullStatsStoreTrudp
+ */
+typedef struct teoLNullStatTrudp {
+    uint64_t retransmits;   ///< Packets sent again after timeout
+    uint32_t triptime;      ///< Last round trip time in us
+    double triptime_middle; ///< Smoothed round trip time in us
+    size_t send_queue;      ///< Packets waiting for ACK
+    size_t write_queue;     ///< Packets waiting for socket write
+} teoLNullStatTrudp;
+
+/**
+ * Create zeroed counters
+ */
+TEOCLI_INTERNAL teoLNullStatCounters *teoLNullStatsCreate(void);
+
+/**
+ * Destroy counters, NULL is ignored
+ */
+TEOCLI_INTERNAL void teoLNullStatsDestroy(teoLNullStatCounters *counters);
+
+/**
+ * Count packet of command @a cmd sent, may be called by any thread
+ */
+TEOCLI_INTERNAL void teoLNullStatsCountSent(teoLNullStatCounters *counters,
+                                            uint8_t cmd, size_t bytes);
+
+/**
+ * Count packet of command @a cmd received
+ */
+TEOCLI_INTERNAL void
+teoLNullStatsCountReceived(teoLNullStatCounters *counters, uint8_t cmd,
+                           size_t bytes);
+
+/**
+ * Count error, may be called by any thread
+ */
+TEOCLI_INTERNAL void teoLNullStatsCountError(teoLNullStatCounters *counters,
+                                             teoLNullStatError error);
+
+/**
+ * Record latency of @a value_us to histogram, may be called by any thread
+ */
+TEOCLI_INTERNAL void
+teoLNullStatsRecordLatency(teoLNullStatCounters *counters,
+                           teoLNullStatLatency latency, uint64_t value_us);
+
+/**
+ * Count established connection, connections after the first one are
+ * reported as reconnects
+ */
+TEOCLI_INTERNAL void teoLNullStatsCountConnect(teoLNullStatCounters *counters);
+
+/**
+ * Count managed reconnect event, may be called by any thread
+ */
+TEOCLI_INTERNAL void
+teoLNullStatsCountReconnect(teoLNullStatCounters *counters,
+                            teoLNullStatReconnect event);
+
+/**
+ * Update read buffer size and high-water mark, called by event loop thread
+ * only
+ */
+TEOCLI_INTERNAL void
+teoLNullStatsReadBufferUsed(teoLNullStatCounters *counters, size_t used,
+                            size_t size);
+
+/**
+ * Store TR-UDP channel state, called by event loop thread only. Channel
+ * belongs to event loop thread, so other threads read this copy instead of
+ * the channel which may be destroyed meanwhile
+ *
+ * @param counters Counters
+ * @param trudp Channel state or NULL if there is no connected channel
+ */
+TEOCLI_INTERNAL void teoLNullStatsStoreTrudp(teoLNullStatCounters *counters,
+                                             const teoLNullStatTrudp *trudp);
+
+/**
+ * Copy counters to @a stats, totals are summed over commands, may be called
+ * by any thread
+ */
+TEOCLI_INTERNAL void teoLNullStatsRead(teoLNullStatCounters *counters,
+                                       teoLNullStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_STATS_H */
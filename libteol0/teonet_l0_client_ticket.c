@@ -0,0 +1,141 @@
+/**
+ * File:   teonet_l0_client_ticket.c
+ *
+ * Process-wide cache of session resumption tickets. Tickets are received in
+ * established sessions and taken by next connection to the same server to
+ * skip key exchange. Taken ticket is wiped, so every ticket is used once.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_ticket.h"
+
+#include <string.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "teobase/time.h"
+
+// Number of servers tickets are kept for
+#define TICKET_CACHE_SIZE 16
+
+// Server name longer than this isn't cached
+#define TICKET_SERVER_MAX_LENGTH 255
+
+typedef struct ticketCacheEntry {
+    bool used;
+    char server[TICKET_SERVER_MAX_LENGTH + 1];
+    uint16_t port;
+    teoLNullResumptionTicket ticket;
+} ticketCacheEntry;
+
+typedef struct ticketCache {
+    ticketCacheEntry entries[TICKET_CACHE_SIZE];
+
+#if defined(TEONET_OS_WINDOWS)
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} ticketCache;
+
+static ticketCache _cache;
+
+#if defined(TEONET_OS_WINDOWS)
+static INIT_ONCE _cacheOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK _cacheInitOnce(PINIT_ONCE once, PVOID param,
+                                    PVOID *context) {
+    InitializeCriticalSection(&_cache.lock);
+    return TRUE;
+}
+
+static void _cacheLock(void) {
+    InitOnceExecuteOnce(&_cacheOnce, _cacheInitOnce, NULL, NULL);
+    EnterCriticalSection(&_cache.lock);
+}
+
+static void _cacheUnlock(void) { LeaveCriticalSection(&_cache.lock); }
+#else
+static pthread_once_t _cacheOnce = PTHREAD_ONCE_INIT;
+
+static void _cacheInitOnce(void) { pthread_mutex_init(&_cache.lock, NULL); }
+
+static void _cacheLock(void) {
+    pthread_once(&_cacheOnce, _cacheInitOnce);
+    pthread_mutex_lock(&_cache.lock);
+}
+
+static void _cacheUnlock(void) { pthread_mutex_unlock(&_cache.lock); }
+#endif
+
+static void _entryWipe(ticketCacheEntry *entry) {
+    zero_bytes((uint8_t *)entry, sizeof(ticketCacheEntry));
+}
+
+static bool _entryMatch(const ticketCacheEntry *entry, const char *server,
+                        uint16_t port, teoLNullEncryptionProtocol enc_proto) {
+    return entry->used && entry->port == port &&
+           entry->ticket.enc_proto == enc_proto &&
+           strcmp(entry->server, server) == 0;
+}
+
+void teoLNullResumptionTicketStore(const char *server, uint16_t port,
+                                   const teoLNullResumptionTicket *ticket) {
+    if (strlen(server) > TICKET_SERVER_MAX_LENGTH ||
+        ticket->ticket_length == 0) {
+        return;
+    }
+
+    _cacheLock();
+    const int64_t now_ms = teotimeGetCurrentTimeMs();
+    ticketCacheEntry *slot = NULL;
+    for (int i = 0; i < TICKET_CACHE_SIZE; i++) {
+        ticketCacheEntry *entry = &_cache.entries[i];
+        if (_entryMatch(entry, server, port, ticket->enc_proto)) {
+            slot = entry;
+            break;
+        }
+        if (entry->used && entry->ticket.expires_ms <= now_ms) {
+            _entryWipe(entry);
+        }
+        if (slot == NULL || (slot->used && (!entry->used ||
+                                            entry->ticket.expires_ms <
+                                                slot->ticket.expires_ms))) {
+            slot = entry;
+        }
+    }
+
+    _entryWipe(slot);
+    slot->used = true;
+    strcpy(slot->server, server);
+    slot->port = port;
+    slot->ticket = *ticket;
+    _cacheUnlock();
+}
+
+bool teoLNullResumptionTicketTake(const char *server, uint16_t port,
+                                  teoLNullEncryptionProtocol enc_proto,
+                                  teoLNullResumptionTicket *ticket) {
+    bool found = false;
+
+    _cacheLock();
+    for (int i = 0; i < TICKET_CACHE_SIZE; i++) {
+        ticketCacheEntry *entry = &_cache.entries[i];
+        if (!_entryMatch(entry, server, port, enc_proto)) { continue; }
+
+        if (entry->ticket.expires_ms > teotimeGetCurrentTimeMs()) {
+            *ticket = entry->ticket;
+            found = true;
+        }
+        _entryWipe(entry);
+        break;
+    }
+    _cacheUnlock();
+
+    return found;
+}
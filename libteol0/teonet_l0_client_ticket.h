@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_TICKET_H
+#define TEONET_L0_CLIENT_TICKET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+#include "teonet_l0_client_crypt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Process-wide cache of session resumption tickets
+/////////////////
+
+/**
+ * Store resumption ticket received from @a server to process-wide cache
+ *
+ * Ticket replaces older one of the same server, port and protocol, or the
+ * ticket expiring first if cache is full
+ *
+ * @param server Server IP or name the ticket was received from
+ * @param port Server port
+ * @param ticket Ticket to store
+ */
+TEOCLI_API void
+teoLNullResumptionTicketStore(const char *server, uint16_t port,
+                              const teoLNullResumptionTicket *ticket);
+
+/**
+ * Take resumption ticket of @a server from process-wide cache
+ *
+ * Ticket is removed from cache and wiped there, so it is used once only
+ *
+ * @param server Server IP or name
+ * @param port Server port
+ * @param enc_proto Encryption protocol the ticket must be issued for
+ * @param ticket Ticket to fill
+ *
+ * @return true if not expired ticket found
+ */
+TEOCLI_API bool
+teoLNullResumptionTicketTake(const char *server, uint16_t port,
+                             teoLNullEncryptionProtocol enc_proto,
+                             teoLNullResumptionTicket *ticket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_TICKET_H */
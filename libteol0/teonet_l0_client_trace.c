@@ -0,0 +1,136 @@
+/**
+ * File:   teonet_l0_client_trace.c
+ *
+ * Per stage latency tracing. Stage boundaries are timestamped with monotonic
+ * clock in one of sample rate event loop iterations or send calls, so
+ * tracing costs a counter increment on other packets. Histograms are updated
+ * with relaxed atomic adds like statistic counters. Without
+ * TEOCLI_LATENCY_TRACE connections get no tracing data and hot paths have no
+ * tracing code at all.
+ */
+
+#include "teobase/platform.h"
+
+#include "teonet_l0_client_trace.h"
+
+#include <string.h>
+#include <time.h>
+
+#if defined(TEONET_OS_WINDOWS)
+#include <windows.h>
+#endif
+
+#include "teoccl/memory.h"
+
+#if defined(TEONET_COMPILER_MSVC)
+#define TRACE_ADD(ptr, value)                                                  \
+    InterlockedExchangeAdd64((volatile LONG64 *)(ptr), (LONG64)(value))
+#define TRACE_LOAD(ptr) ((uint64_t)InterlockedOr64((volatile LONG64 *)(ptr), 0))
+#else
+#define TRACE_ADD(ptr, value)                                                  \
+    __atomic_fetch_add((ptr), (uint64_t)(value), __ATOMIC_RELAXED)
+#define TRACE_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#endif
+
+extern uint32_t teocliOpt_LatencySampleRate;
+
+teoLNullTrace *teoLNullTraceCreate(void) {
+#if defined(TEOCLI_LATENCY_TRACE)
+    if (teocliOpt_LatencySampleRate == 0) { return NULL; }
+
+    teoLNullTrace *trace = (teoLNullTrace *)ccl_malloc(sizeof(teoLNullTrace));
+    memset(trace, 0, sizeof(teoLNullTrace));
+    trace->sample_rate = teocliOpt_LatencySampleRate;
+    return trace;
+#else
+    return NULL;
+#endif
+}
+
+void teoLNullTraceDestroy(teoLNullTrace *trace) {
+    if (trace != NULL) { free(trace); }
+}
+
+uint64_t teoLNullTraceNow(void) {
+#if defined(TEONET_OS_WINDOWS)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(counter.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+}
+
+void teoLNullTraceRecord(teoLNullTrace *trace, teoLNullStage stage,
+                         uint64_t ns) {
+    teoLNullStageHistogram *histogram = &trace->stages[stage];
+    int bucket = 0;
+    while (bucket < TEOLNULL_STAGE_BUCKETS - 1 &&
+           ((uint64_t)1 << bucket) < ns) {
+        bucket++;
+    }
+    TRACE_ADD(&histogram->buckets[bucket], 1);
+    TRACE_ADD(&histogram->count, 1);
+    TRACE_ADD(&histogram->sum_ns, ns);
+}
+
+void teoLNullTraceRecvSample(teoLNullTrace *trace) {
+    if (trace == NULL) { return; }
+    trace->recv_sampled = trace->recv_iterations++ % trace->sample_rate == 0;
+    trace->nested_ns = 0;
+}
+
+void teoLNullTraceSpanBegin(teoLNullTrace *trace, teoLNullTraceSpan *span) {
+    if (trace == NULL || !trace->recv_sampled) {
+        span->start_ns = 0;
+        return;
+    }
+    span->outer_nested_ns = trace->nested_ns;
+    trace->nested_ns = 0;
+    span->start_ns = teoLNullTraceNow();
+}
+
+void teoLNullTraceSpanEnd(teoLNullTrace *trace, teoLNullTraceSpan *span,
+                          teoLNullStage stage) {
+    if (span->start_ns == 0) { return; }
+
+    const uint64_t elapsed = teoLNullTraceNow() - span->start_ns;
+    const uint64_t nested = trace->nested_ns;
+    teoLNullTraceRecord(trace, stage, elapsed > nested ? elapsed - nested : 0);
+
+    // Outer stage excludes this one with its nested stages
+    trace->nested_ns = span->outer_nested_ns + elapsed;
+}
+
+uint64_t teoLNullTraceSendStart(teoLNullTrace *trace) {
+    if (trace == NULL) { return 0; }
+    if (TRACE_ADD(&trace->send_calls, 1) % trace->sample_rate != 0) {
+        return 0;
+    }
+    return teoLNullTraceNow();
+}
+
+void teoLNullTraceSendStage(teoLNullTrace *trace, teoLNullTraceSpan *span,
+                            teoLNullStage stage) {
+    if (span->start_ns == 0) { return; }
+
+    const uint64_t now = teoLNullTraceNow();
+    teoLNullTraceRecord(trace, stage, now - span->start_ns);
+    span->start_ns = now;
+}
+
+void teoLNullTraceRead(teoLNullTrace *trace, teoLNullStageStats *stats) {
+    stats->sample_rate = trace->sample_rate;
+    for (int s = 0; s < TEOLNULL_STAGES; s++) {
+        teoLNullStageHistogram *src = &trace->stages[s];
+        teoLNullStageHistogram *dst = &stats->stages[s];
+        for (int i = 0; i < TEOLNULL_STAGE_BUCKETS; i++) {
+            dst->buckets[i] = TRACE_LOAD(&src->buckets[i]);
+        }
+        dst->count = TRACE_LOAD(&src->count);
+        dst->sum_ns = TRACE_LOAD(&src->sum_ns);
+    }
+}
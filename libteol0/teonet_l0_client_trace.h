@@ -0,0 +1,142 @@
+#pragma once
+
+#ifndef TEONET_L0_CLIENT_TRACE_H
+#define TEONET_L0_CLIENT_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "teocli_api.h"
+#include "teonet_l0_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////
+// Per stage latency tracing
+//
+// Built in with TEOCLI_LATENCY_TRACE defined only, TRACE_* macros are empty
+// otherwise and connections have no tracing data.
+/////////////////
+
+/**
+ * Stage histograms of connection
+ */
+struct teoLNullTrace {
+    teoLNullStageHistogram stages[TEOLNULL_STAGES];
+    uint32_t sample_rate; ///< One of sample_rate iterations is measured
+
+    // Receive side, event loop thread only
+    uint64_t recv_iterations; ///< Event loop iterations
+    bool recv_sampled;        ///< Current iteration is measured
+    uint64_t nested_ns;       ///< Time of stages measured in current stage
+
+    uint64_t send_calls; ///< Send calls of all threads, atomic
+};
+
+/**
+ * Stage being measured, start_ns is 0 if it isn't sampled
+ */
+typedef struct teoLNullTraceSpan {
+    uint64_t start_ns;
+    uint64_t outer_nested_ns;
+} teoLNullTraceSpan;
+
+/**
+ * Create tracing data of connection
+ *
+ * @return Tracing data or NULL if built without TEOCLI_LATENCY_TRACE or
+ *  sample rate option is 0
+ */
+TEOCLI_INTERNAL teoLNullTrace *teoLNullTraceCreate(void);
+
+/**
+ * Destroy tracing data, NULL is ignored
+ */
+TEOCLI_INTERNAL void teoLNullTraceDestroy(teoLNullTrace *trace);
+
+/**
+ * Monotonic time in ns
+ */
+TEOCLI_INTERNAL uint64_t teoLNullTraceNow(void);
+
+/**
+ * Record stage time to histogram, may be called by any thread
+ */
+TEOCLI_INTERNAL void teoLNullTraceRecord(teoLNullTrace *trace,
+                                         teoLNullStage stage, uint64_t ns);
+
+/**
+ * Decide whether event loop iteration is measured, called at iteration start
+ */
+TEOCLI_INTERNAL void teoLNullTraceRecvSample(teoLNullTrace *trace);
+
+/**
+ * Start receive stage, stages may nest
+ */
+TEOCLI_INTERNAL void teoLNullTraceSpanBegin(teoLNullTrace *trace,
+                                            teoLNullTraceSpan *span);
+
+/**
+ * Record receive stage time without time of stages nested in it
+ */
+TEOCLI_INTERNAL void teoLNullTraceSpanEnd(teoLNullTrace *trace,
+                                          teoLNullTraceSpan *span,
+                                          teoLNullStage stage);
+
+/**
+ * Decide whether send call is measured, may be called by any thread
+ *
+ * @return Start time in ns or 0 if send isn't measured
+ */
+TEOCLI_INTERNAL uint64_t teoLNullTraceSendStart(teoLNullTrace *trace);
+
+/**
+ * Record time since previous send stage and start next one
+ */
+TEOCLI_INTERNAL void teoLNullTraceSendStage(teoLNullTrace *trace,
+                                            teoLNullTraceSpan *span,
+                                            teoLNullStage stage);
+
+/**
+ * Copy histograms to @a stats
+ */
+TEOCLI_INTERNAL void teoLNullTraceRead(teoLNullTrace *trace,
+                                       teoLNullStageStats *stats);
+
+#if defined(TEOCLI_LATENCY_TRACE)
+#define TRACE_RECV_SAMPLE(con) teoLNullTraceRecvSample((con)->trace)
+#define TRACE_RECV_BEGIN(con, span)                                            \
+    teoLNullTraceSpan span;                                                    \
+    teoLNullTraceSpanBegin((con)->trace, &span)
+#define TRACE_RECV_END(con, span, stage)                                       \
+    teoLNullTraceSpanEnd((con)->trace, &span, (stage))
+#define TRACE_RECV_RECORD(con, stage, ns)                                      \
+    do {                                                                       \
+        if ((con)->trace != NULL && (con)->trace->recv_sampled) {              \
+            teoLNullTraceRecord((con)->trace, (stage), (ns));                  \
+        }                                                                      \
+    } while (0)
+#define TRACE_SEND_BEGIN(con, span)                                            \
+    teoLNullTraceSpan span = {teoLNullTraceSendStart((con)->trace), 0}
+#define TRACE_SEND_STAGE(con, span, stage)                                     \
+    teoLNullTraceSendStage((con)->trace, &span, (stage))
+#define TRACE_SEND_SAVE(span, field) ((field) = (span).start_ns)
+#define TRACE_SEND_RESTORE(span, field) teoLNullTraceSpan span = {(field), 0}
+#else
+#define TRACE_RECV_SAMPLE(con) ((void)0)
+#define TRACE_RECV_BEGIN(con, span) ((void)0)
+#define TRACE_RECV_END(con, span, stage) ((void)0)
+#define TRACE_RECV_RECORD(con, stage, ns) ((void)0)
+#define TRACE_SEND_BEGIN(con, span) ((void)0)
+#define TRACE_SEND_STAGE(con, span, stage) ((void)0)
+#define TRACE_SEND_SAVE(span, field) ((void)0)
+#define TRACE_SEND_RESTORE(span, field) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEONET_L0_CLIENT_TRACE_H */
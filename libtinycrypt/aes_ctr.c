@@ -0,0 +1,328 @@
+// AES-128-CTR with hardware acceleration, selected at runtime:
+//  - AES-NI on x86 and x86-64, 8 blocks in flight to hide aesenc latency
+//  - ARMv8 crypto extensions on AArch64, 8 blocks in flight as well
+//  - tiny-AES-c AES_CTR_xcrypt_buffer otherwise
+// All backends produce the same keystream: IV is a 128-bit big-endian counter
+// incremented once per block, as in tiny-AES-c.
+
+#include <stdint.h>
+#include <string.h>
+#include "tinycrypt.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define TINYCRYPT_AESNI 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TINYCRYPT_TARGET_AESNI
+#else
+#define TINYCRYPT_TARGET_AESNI __attribute__((target("aes,ssse3")))
+#endif
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define TINYCRYPT_ARMV8_CE 1
+#if defined(_MSC_VER) || defined(__ARM_FEATURE_CRYPTO) || \
+    defined(__ARM_FEATURE_AES)
+#define TINYCRYPT_TARGET_ARMV8_CE
+#elif defined(__clang__)
+#define TINYCRYPT_TARGET_ARMV8_CE __attribute__((target("aes")))
+#else
+#define TINYCRYPT_TARGET_ARMV8_CE __attribute__((target("+crypto")))
+#endif
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#define CTR_AES128_ROUNDS 10
+#define CTR_AES128_PIPELINE 8
+
+typedef void (*ctr_kernel)(const uint8_t* round_keys, uint8_t* iv,
+                           uint8_t* buf, size_t length);
+
+static inline uint64_t load_be64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int it = 0; it < 8; ++it) {
+    v = (v << 8) | p[it];
+  }
+  return v;
+}
+
+static inline void store_be64(uint8_t* p, uint64_t v) {
+  for (int it = 7; it >= 0; --it) {
+    p[it] = (uint8_t)v;
+    v >>= 8;
+  }
+}
+
+static void ctr_software(const uint8_t* round_keys, uint8_t* iv, uint8_t* buf,
+                         size_t length) {
+  struct AES_ctx ctx;
+  memcpy(ctx.RoundKey, round_keys, sizeof(ctx.RoundKey));
+  memcpy(ctx.Iv, iv, sizeof(ctx.Iv));
+  AES_CTR_xcrypt_buffer(&ctx, buf, length);
+  memcpy(iv, ctx.Iv, sizeof(ctx.Iv));
+  zero_bytes(ctx.RoundKey, sizeof(ctx.RoundKey));
+}
+
+#if defined(TINYCRYPT_AESNI)
+TINYCRYPT_TARGET_AESNI
+static inline __m128i ctr_aesni_next(uint64_t* hi, uint64_t* lo) {
+  const __m128i bswap =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i block =
+      _mm_shuffle_epi8(_mm_set_epi64x((int64_t)*hi, (int64_t)*lo), bswap);
+  if (++*lo == 0) {
+    ++*hi;
+  }
+  return block;
+}
+
+TINYCRYPT_TARGET_AESNI
+static void ctr_aesni(const uint8_t* round_keys, uint8_t* iv, uint8_t* buf,
+                      size_t length) {
+  __m128i rk[CTR_AES128_ROUNDS + 1];
+  for (int r = 0; r <= CTR_AES128_ROUNDS; ++r) {
+    rk[r] = _mm_loadu_si128((const __m128i*)(round_keys + r * AES_BLOCKLEN));
+  }
+
+  uint64_t hi = load_be64(iv);
+  uint64_t lo = load_be64(iv + 8);
+
+  while (length >= CTR_AES128_PIPELINE * AES_BLOCKLEN) {
+    __m128i b[CTR_AES128_PIPELINE];
+    for (int it = 0; it < CTR_AES128_PIPELINE; ++it) {
+      b[it] = _mm_xor_si128(ctr_aesni_next(&hi, &lo), rk[0]);
+    }
+    for (int r = 1; r < CTR_AES128_ROUNDS; ++r) {
+      for (int it = 0; it < CTR_AES128_PIPELINE; ++it) {
+        b[it] = _mm_aesenc_si128(b[it], rk[r]);
+      }
+    }
+    for (int it = 0; it < CTR_AES128_PIPELINE; ++it) {
+      __m128i* p = (__m128i*)(buf + it * AES_BLOCKLEN);
+      b[it] = _mm_aesenclast_si128(b[it], rk[CTR_AES128_ROUNDS]);
+      _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), b[it]));
+    }
+    buf += CTR_AES128_PIPELINE * AES_BLOCKLEN;
+    length -= CTR_AES128_PIPELINE * AES_BLOCKLEN;
+  }
+
+  while (length > 0) {
+    __m128i b = _mm_xor_si128(ctr_aesni_next(&hi, &lo), rk[0]);
+    for (int r = 1; r < CTR_AES128_ROUNDS; ++r) {
+      b = _mm_aesenc_si128(b, rk[r]);
+    }
+    b = _mm_aesenclast_si128(b, rk[CTR_AES128_ROUNDS]);
+
+    if (length >= AES_BLOCKLEN) {
+      __m128i* p = (__m128i*)buf;
+      _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), b));
+      buf += AES_BLOCKLEN;
+      length -= AES_BLOCKLEN;
+    } else {
+      uint8_t keystream[AES_BLOCKLEN];
+      _mm_storeu_si128((__m128i*)keystream, b);
+      xor_bytes(buf, keystream, length);
+      zero_bytes(keystream, sizeof(keystream));
+      length = 0;
+    }
+  }
+
+  store_be64(iv, hi);
+  store_be64(iv + 8, lo);
+}
+
+static int ctr_aesni_supported(void) {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 25)) != 0 && (info[2] & (1 << 9)) != 0;
+#else
+  return __builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3");
+#endif
+}
+#endif
+
+#if defined(TINYCRYPT_ARMV8_CE)
+TINYCRYPT_TARGET_ARMV8_CE
+static inline uint8x16_t ctr_armv8_next(uint64_t* hi, uint64_t* lo) {
+  uint8x16_t block = vcombine_u8(vrev64_u8(vcreate_u8(*hi)),
+                                 vrev64_u8(vcreate_u8(*lo)));
+  if (++*lo == 0) {
+    ++*hi;
+  }
+  return block;
+}
+
+TINYCRYPT_TARGET_ARMV8_CE
+static inline uint8x16_t ctr_armv8_encrypt(uint8x16_t b,
+                                           const uint8x16_t* rk) {
+  for (int r = 0; r < CTR_AES128_ROUNDS - 1; ++r) {
+    b = vaesmcq_u8(vaeseq_u8(b, rk[r]));
+  }
+  b = vaeseq_u8(b, rk[CTR_AES128_ROUNDS - 1]);
+  return veorq_u8(b, rk[CTR_AES128_ROUNDS]);
+}
+
+TINYCRYPT_TARGET_ARMV8_CE
+static void ctr_armv8(const uint8_t* round_keys, uint8_t* iv, uint8_t* buf,
+                      size_t length) {
+  uint8x16_t rk[CTR_AES128_ROUNDS + 1];
+  for (int r = 0; r <= CTR_AES128_ROUNDS; ++r) {
+    rk[r] = vld1q_u8(round_keys + r * AES_BLOCKLEN);
+  }
+
+  uint64_t hi = load_be64(iv);
+  uint64_t lo = load_be64(iv + 8);
+
+  while (length >= CTR_AES128_PIPELINE * AES_BLOCKLEN) {
+    uint8x16_t b[CTR_AES128_PIPELINE];
+    for (int it = 0; it < CTR_AES128_PIPELINE; ++it) {
+      b[it] = ctr_armv8_next(&hi, &lo);
+    }
+    for (int r = 0; r < CTR_AES128_ROUNDS - 1; ++r) {
+      for (int it = 0; it < CTR_AES128_PIPELINE; ++it) {
+        b[it] = vaesmcq_u8(vaeseq_u8(b[it], rk[r]));
+      }
+    }
+    for (int it = 0; it < CTR_AES128_PIPELINE; ++it) {
+      uint8_t* p = buf + it * AES_BLOCKLEN;
+      b[it] = veorq_u8(vaeseq_u8(b[it], rk[CTR_AES128_ROUNDS - 1]),
+                       rk[CTR_AES128_ROUNDS]);
+      vst1q_u8(p, veorq_u8(vld1q_u8(p), b[it]));
+    }
+    buf += CTR_AES128_PIPELINE * AES_BLOCKLEN;
+    length -= CTR_AES128_PIPELINE * AES_BLOCKLEN;
+  }
+
+  while (length > 0) {
+    uint8x16_t b = ctr_armv8_encrypt(ctr_armv8_next(&hi, &lo), rk);
+
+    if (length >= AES_BLOCKLEN) {
+      vst1q_u8(buf, veorq_u8(vld1q_u8(buf), b));
+      buf += AES_BLOCKLEN;
+      length -= AES_BLOCKLEN;
+    } else {
+      uint8_t keystream[AES_BLOCKLEN];
+      vst1q_u8(keystream, b);
+      xor_bytes(buf, keystream, length);
+      zero_bytes(keystream, sizeof(keystream));
+      length = 0;
+    }
+  }
+
+  store_be64(iv, hi);
+  store_be64(iv + 8, lo);
+}
+
+static int ctr_armv8_supported(void) {
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES) || \
+    defined(__APPLE__)
+  return 1;
+#elif defined(_WIN32)
+  return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(__linux__) && defined(HWCAP_AES)
+  return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+  return 0;
+#endif
+}
+#endif
+
+static ctr_kernel hardware_kernel(const char** name) {
+#if defined(TINYCRYPT_AESNI)
+  if (ctr_aesni_supported()) {
+    *name = "aes-ni";
+    return ctr_aesni;
+  }
+#endif
+#if defined(TINYCRYPT_ARMV8_CE)
+  if (ctr_armv8_supported()) {
+    *name = "armv8-ce";
+    return ctr_armv8;
+  }
+#endif
+  *name = "tiny-aes";
+  return ctr_software;
+}
+
+// Hardware kernel is selected once and isn't changed after, software kernel
+// is forced by CTR_AES128_use_hardware(0) flag
+static ctr_kernel hw_kernel = NULL;
+static const char* hw_name = NULL;
+static volatile long software_forced = 0;
+
+static void hw_kernel_init(void) { hw_kernel = hardware_kernel(&hw_name); }
+
+#if defined(_WIN32)
+static INIT_ONCE hw_kernel_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK hw_kernel_init_once(PINIT_ONCE once, PVOID param,
+                                         PVOID* context) {
+  hw_kernel_init();
+  return TRUE;
+}
+
+static void hw_kernel_ensure(void) {
+  InitOnceExecuteOnce(&hw_kernel_once, hw_kernel_init_once, NULL, NULL);
+}
+
+static int software_forced_load(void) {
+  return InterlockedCompareExchange(&software_forced, 0, 0) != 0;
+}
+
+static void software_forced_store(int forced) {
+  InterlockedExchange(&software_forced, forced);
+}
+#else
+static pthread_once_t hw_kernel_once = PTHREAD_ONCE_INIT;
+
+static void hw_kernel_ensure(void) {
+  pthread_once(&hw_kernel_once, hw_kernel_init);
+}
+
+static int software_forced_load(void) {
+  return __atomic_load_n(&software_forced, __ATOMIC_RELAXED) != 0;
+}
+
+static void software_forced_store(int forced) {
+  __atomic_store_n(&software_forced, forced, __ATOMIC_RELAXED);
+}
+#endif
+
+static ctr_kernel current_kernel(void) {
+  hw_kernel_ensure();
+  return software_forced_load() ? ctr_software : hw_kernel;
+}
+
+void CTR_AES128_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf,
+                              size_t length) {
+  current_kernel()(ctx->RoundKey, ctx->Iv, buf, length);
+}
+
+void CTR_AES128_xcrypt_keys(const uint8_t* round_keys, uint8_t* iv,
+                            uint8_t* buf, size_t length) {
+  current_kernel()(round_keys, iv, buf, length);
+}
+
+int CTR_AES128_use_hardware(int enable) {
+  software_forced_store(!enable);
+  return current_kernel() != ctr_software;
+}
+
+const char* CTR_AES128_backend(void) {
+  return current_kernel() != ctr_software ? hw_name : "tiny-aes";
+}
@@ -0,0 +1,361 @@
+// ChaCha20-Poly1305 AEAD as specified in RFC 8439.
+// ChaCha20 keystream is generated 4 blocks at once with compiler vector
+// extensions (SSE2 / NEON) where available, scalar code otherwise.
+// Poly1305 uses 26-bit limbs and 64-bit products, so it runs the same way
+// with any compiler.
+
+#include <stdint.h>
+#include <string.h>
+#include "tinycrypt.h"
+
+#define CHACHA20_BLOCK_SIZE 64
+#define CHACHA20_BLOCKS_IN_PARALLEL 4
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHACHA20_VECTOR 1
+typedef uint32_t chacha20_v4 __attribute__((vector_size(16)));
+#endif
+
+static inline uint32_t load_le32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static inline void store_le32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void store_le64(uint8_t* p, uint64_t v) {
+  store_le32(p, (uint32_t)v);
+  store_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+#define CHACHA20_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define CHACHA20_QUARTERROUND(x, a, b, c, d) \
+  do {                                       \
+    x[a] += x[b];                            \
+    x[d] = CHACHA20_ROTL(x[d] ^ x[a], 16);   \
+    x[c] += x[d];                            \
+    x[b] = CHACHA20_ROTL(x[b] ^ x[c], 12);   \
+    x[a] += x[b];                            \
+    x[d] = CHACHA20_ROTL(x[d] ^ x[a], 8);    \
+    x[c] += x[d];                            \
+    x[b] = CHACHA20_ROTL(x[b] ^ x[c], 7);    \
+  } while (0)
+
+#define CHACHA20_DOUBLEROUND(x)                \
+  do {                                         \
+    CHACHA20_QUARTERROUND(x, 0, 4, 8, 12);     \
+    CHACHA20_QUARTERROUND(x, 1, 5, 9, 13);     \
+    CHACHA20_QUARTERROUND(x, 2, 6, 10, 14);    \
+    CHACHA20_QUARTERROUND(x, 3, 7, 11, 15);    \
+    CHACHA20_QUARTERROUND(x, 0, 5, 10, 15);    \
+    CHACHA20_QUARTERROUND(x, 1, 6, 11, 12);    \
+    CHACHA20_QUARTERROUND(x, 2, 7, 8, 13);     \
+    CHACHA20_QUARTERROUND(x, 3, 4, 9, 14);     \
+  } while (0)
+
+static void chacha20_init(uint32_t state[16], const CHACHA20_KEY* key,
+                          uint32_t counter, const uint8_t* nonce) {
+  state[0] = 0x61707865;
+  state[1] = 0x3320646e;
+  state[2] = 0x79622d32;
+  state[3] = 0x6b206574;
+  for (int it = 0; it < 8; ++it) {
+    state[4 + it] = load_le32(key->data + 4 * it);
+  }
+  state[12] = counter;
+  state[13] = load_le32(nonce);
+  state[14] = load_le32(nonce + 4);
+  state[15] = load_le32(nonce + 8);
+}
+
+static void chacha20_block(const uint32_t state[16], uint8_t* out) {
+  uint32_t x[16];
+  memcpy(x, state, sizeof(x));
+  for (int it = 0; it < 10; ++it) {
+    CHACHA20_DOUBLEROUND(x);
+  }
+  for (int it = 0; it < 16; ++it) {
+    store_le32(out + 4 * it, x[it] + state[it]);
+  }
+}
+
+#if defined(CHACHA20_VECTOR)
+// Keystream of 4 consecutive blocks, lane N of each word vector is block N
+static void chacha20_blocks4(const uint32_t state[16], uint8_t* out) {
+  chacha20_v4 x[16], input[16];
+  for (int it = 0; it < 16; ++it) {
+    input[it] = (chacha20_v4){state[it], state[it], state[it], state[it]};
+  }
+  input[12] += (chacha20_v4){0, 1, 2, 3};
+  memcpy(x, input, sizeof(x));
+
+  for (int it = 0; it < 10; ++it) {
+    CHACHA20_DOUBLEROUND(x);
+  }
+
+  uint32_t words[16][CHACHA20_BLOCKS_IN_PARALLEL];
+  for (int it = 0; it < 16; ++it) {
+    chacha20_v4 v = x[it] + input[it];
+    memcpy(words[it], &v, sizeof(v));
+  }
+  for (int block = 0; block < CHACHA20_BLOCKS_IN_PARALLEL; ++block) {
+    for (int it = 0; it < 16; ++it) {
+      store_le32(out + block * CHACHA20_BLOCK_SIZE + 4 * it, words[it][block]);
+    }
+  }
+}
+#endif
+
+static void chacha20_xor(const CHACHA20_KEY* key, uint32_t counter,
+                         const uint8_t* nonce, uint8_t* message,
+                         size_t message_len) {
+  uint32_t state[16];
+  uint8_t keystream[CHACHA20_BLOCKS_IN_PARALLEL * CHACHA20_BLOCK_SIZE];
+  chacha20_init(state, key, counter, nonce);
+
+#if defined(CHACHA20_VECTOR)
+  while (message_len >= sizeof(keystream)) {
+    chacha20_blocks4(state, keystream);
+    xor_keystream(message, keystream, sizeof(keystream));
+    state[12] += CHACHA20_BLOCKS_IN_PARALLEL;
+    message += sizeof(keystream);
+    message_len -= sizeof(keystream);
+  }
+#endif
+
+  while (message_len > 0) {
+    size_t len = message_len < CHACHA20_BLOCK_SIZE ? message_len
+                                                   : CHACHA20_BLOCK_SIZE;
+    chacha20_block(state, keystream);
+    xor_keystream(message, keystream, len);
+    state[12]++;
+    message += len;
+    message_len -= len;
+  }
+
+  zero_bytes(keystream, sizeof(keystream));
+  zero_bytes((uint8_t*)state, sizeof(state));
+}
+
+typedef struct {
+  uint32_t r[5];
+  uint32_t h[5];
+  uint32_t pad[4];
+} poly1305_state;
+
+static void poly1305_init(poly1305_state* st, const uint8_t key[32]) {
+  st->r[0] = load_le32(key + 0) & 0x3ffffff;
+  st->r[1] = (load_le32(key + 3) >> 2) & 0x3ffff03;
+  st->r[2] = (load_le32(key + 6) >> 4) & 0x3ffc0ff;
+  st->r[3] = (load_le32(key + 9) >> 6) & 0x3f03fff;
+  st->r[4] = (load_le32(key + 12) >> 8) & 0x00fffff;
+  memset(st->h, 0, sizeof(st->h));
+  for (int it = 0; it < 4; ++it) {
+    st->pad[it] = load_le32(key + 16 + 4 * it);
+  }
+}
+
+// Process full 16-byte blocks
+static void poly1305_blocks(poly1305_state* st, const uint8_t* m,
+                            size_t bytes) {
+  const uint32_t hibit = 1UL << 24;
+  const uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3],
+                 r4 = st->r[4];
+  const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3],
+           h4 = st->h[4];
+
+  while (bytes >= 16) {
+    h0 += load_le32(m + 0) & 0x3ffffff;
+    h1 += (load_le32(m + 3) >> 2) & 0x3ffffff;
+    h2 += (load_le32(m + 6) >> 4) & 0x3ffffff;
+    h3 += (load_le32(m + 9) >> 6) & 0x3ffffff;
+    h4 += (load_le32(m + 12) >> 8) | hibit;
+
+    uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 +
+                  (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+    uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 +
+                  (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+    uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 +
+                  (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+    uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 +
+                  (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+    uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 +
+                  (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+    uint32_t c = (uint32_t)(d0 >> 26);
+    h0 = (uint32_t)d0 & 0x3ffffff;
+    d1 += c;
+    c = (uint32_t)(d1 >> 26);
+    h1 = (uint32_t)d1 & 0x3ffffff;
+    d2 += c;
+    c = (uint32_t)(d2 >> 26);
+    h2 = (uint32_t)d2 & 0x3ffffff;
+    d3 += c;
+    c = (uint32_t)(d3 >> 26);
+    h3 = (uint32_t)d3 & 0x3ffffff;
+    d4 += c;
+    c = (uint32_t)(d4 >> 26);
+    h4 = (uint32_t)d4 & 0x3ffffff;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= 0x3ffffff;
+    h1 += c;
+
+    m += 16;
+    bytes -= 16;
+  }
+
+  st->h[0] = h0;
+  st->h[1] = h1;
+  st->h[2] = h2;
+  st->h[3] = h3;
+  st->h[4] = h4;
+}
+
+// Process data padded with zeros to 16 bytes, as AEAD construction requires
+static void poly1305_update_padded(poly1305_state* st, const uint8_t* m,
+                                   size_t bytes) {
+  const size_t full = bytes & ~(size_t)15;
+  poly1305_blocks(st, m, full);
+  if (bytes > full) {
+    uint8_t block[16];
+    memset(block, 0, sizeof(block));
+    memcpy(block, m + full, bytes - full);
+    poly1305_blocks(st, block, sizeof(block));
+  }
+}
+
+static void poly1305_finish(poly1305_state* st, uint8_t mac[16]) {
+  uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3],
+           h4 = st->h[4];
+
+  // fully carry h
+  uint32_t c = h1 >> 26;
+  h1 &= 0x3ffffff;
+  h2 += c;
+  c = h2 >> 26;
+  h2 &= 0x3ffffff;
+  h3 += c;
+  c = h3 >> 26;
+  h3 &= 0x3ffffff;
+  h4 += c;
+  c = h4 >> 26;
+  h4 &= 0x3ffffff;
+  h0 += c * 5;
+  c = h0 >> 26;
+  h0 &= 0x3ffffff;
+  h1 += c;
+
+  // compute h - p and select it if h >= p, in constant time
+  uint32_t g0 = h0 + 5;
+  c = g0 >> 26;
+  g0 &= 0x3ffffff;
+  uint32_t g1 = h1 + c;
+  c = g1 >> 26;
+  g1 &= 0x3ffffff;
+  uint32_t g2 = h2 + c;
+  c = g2 >> 26;
+  g2 &= 0x3ffffff;
+  uint32_t g3 = h3 + c;
+  c = g3 >> 26;
+  g3 &= 0x3ffffff;
+  uint32_t g4 = h4 + c - (1UL << 26);
+
+  uint32_t mask = (g4 >> 31) - 1;
+  g0 &= mask;
+  g1 &= mask;
+  g2 &= mask;
+  g3 &= mask;
+  g4 &= mask;
+  mask = ~mask;
+  h0 = (h0 & mask) | g0;
+  h1 = (h1 & mask) | g1;
+  h2 = (h2 & mask) | g2;
+  h3 = (h3 & mask) | g3;
+  h4 = (h4 & mask) | g4;
+
+  // h = h % 2^128 + pad
+  h0 = h0 | (h1 << 26);
+  h1 = (h1 >> 6) | (h2 << 20);
+  h2 = (h2 >> 12) | (h3 << 14);
+  h3 = (h3 >> 18) | (h4 << 8);
+
+  uint64_t f = (uint64_t)h0 + st->pad[0];
+  store_le32(mac + 0, (uint32_t)f);
+  f = (uint64_t)h1 + st->pad[1] + (f >> 32);
+  store_le32(mac + 4, (uint32_t)f);
+  f = (uint64_t)h2 + st->pad[2] + (f >> 32);
+  store_le32(mac + 8, (uint32_t)f);
+  f = (uint64_t)h3 + st->pad[3] + (f >> 32);
+  store_le32(mac + 12, (uint32_t)f);
+
+  zero_bytes((uint8_t*)st, sizeof(*st));
+}
+
+static void aead_tag(const CHACHA20_KEY* key, const uint8_t* nonce,
+                     const uint8_t* aad, size_t aad_len,
+                     const uint8_t* ciphertext, size_t ciphertext_len,
+                     uint8_t tag[POLY1305_TAG_SIZE]) {
+  uint8_t block0[CHACHA20_BLOCK_SIZE];
+  uint32_t state[16];
+  chacha20_init(state, key, 0, nonce);
+  chacha20_block(state, block0);
+  zero_bytes((uint8_t*)state, sizeof(state));
+
+  poly1305_state st;
+  poly1305_init(&st, block0);
+  zero_bytes(block0, sizeof(block0));
+
+  poly1305_update_padded(&st, aad, aad_len);
+  poly1305_update_padded(&st, ciphertext, ciphertext_len);
+
+  uint8_t lengths[16];
+  store_le64(lengths, aad_len);
+  store_le64(lengths + 8, ciphertext_len);
+  poly1305_blocks(&st, lengths, sizeof(lengths));
+
+  poly1305_finish(&st, tag);
+}
+
+void Keystream_CHACHA20(const CHACHA20_KEY* key,
+                        const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                        uint32_t counter, uint8_t* out, size_t out_len) {
+  memset(out, 0, out_len);
+  chacha20_xor(key, counter, nonce, out, out_len);
+}
+
+void Seal_CHACHA20_POLY1305(const CHACHA20_KEY* key,
+                            const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                            const uint8_t* aad, size_t aad_len,
+                            uint8_t* message, size_t message_len,
+                            uint8_t tag[POLY1305_TAG_SIZE]) {
+  chacha20_xor(key, 1, nonce, message, message_len);
+  aead_tag(key, nonce, aad, aad_len, message, message_len, tag);
+}
+
+int Open_CHACHA20_POLY1305(const CHACHA20_KEY* key,
+                           const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                           const uint8_t* aad, size_t aad_len,
+                           uint8_t* message, size_t message_len,
+                           const uint8_t tag[POLY1305_TAG_SIZE]) {
+  uint8_t expected[POLY1305_TAG_SIZE];
+  aead_tag(key, nonce, aad, aad_len, message, message_len, expected);
+
+  uint8_t diff = 0;
+  for (size_t it = 0; it < sizeof(expected); ++it) {
+    diff |= expected[it] ^ tag[it];
+  }
+  if (diff != 0) {
+    return 0;
+  }
+
+  chacha20_xor(key, 1, nonce, message, message_len);
+  return 1;
+}
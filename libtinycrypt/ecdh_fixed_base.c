@@ -0,0 +1,454 @@
+// Fixed-base ECDH key generation for tiny-ECDH-c curve NIST B-163.
+// Public key is priv * G computed with precomputed multiples of generator G:
+// table[i][j - 1] = j * 2^(4 * i) * G for every 4-bit window i of private
+// key and digit j, so key generation takes one point addition per window and
+// no doublings. Table is computed once per process on first use. Points are
+// added in Lopez-Dahab projective coordinates, digits are selected from table
+// without secret dependent branches or memory accesses. Result is the same as
+// ecdh_generate_keys returns: private key is clamped the same way, public key
+// is affine (x, y) stored as 32-bit words of tiny-ECDH-c bit vectors.
+
+#include <stdint.h>
+#include <string.h>
+#include "tinycrypt.h"
+
+#if ECC_CURVE == NIST_B163
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TINYCRYPT_PCLMUL 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TINYCRYPT_TARGET_PCLMUL
+#else
+#define TINYCRYPT_TARGET_PCLMUL __attribute__((target("pclmul,sse2")))
+#endif
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#define GF_WORDS 3
+#define GF_TOP_BITS 35  // 163 - 2 * 64
+#define GF_TOP_MASK (((uint64_t)1 << GF_TOP_BITS) - 1)
+
+#define COMB_WIDTH 4
+#define COMB_DIGITS ((1 << COMB_WIDTH) - 1)
+// private key is clamped below 2^162 by the base point order
+#define COMB_SCALAR_BITS 162
+#define COMB_WINDOWS ((COMB_SCALAR_BITS + COMB_WIDTH - 1) / COMB_WIDTH)
+
+#define KEY_WORDS (ECC_PRV_KEY_SIZE / 4)
+
+typedef uint64_t gf_t[GF_WORDS];
+
+typedef struct {
+  gf_t x, y;
+} point_affine;
+
+typedef struct {
+  gf_t x, y, z;
+} point_ld;
+
+static const point_affine base_point = {
+    {0xd4994637e8343e36ULL, 0x86a2d57ea0991168ULL, 0x00000003f0eba162ULL},
+    {0xb11c5c0c797324f1ULL, 0x71a0094fa2cdd545ULL, 0x00000000d51fbc6cULL}};
+static const gf_t coeff_b = {0x512f78744a3205fdULL, 0xb8c953ca1481eb10ULL,
+                             0x000000020a601907ULL};
+static const uint32_t base_order_words[KEY_WORDS] = {
+    0xa4234c33, 0x77e70c12, 0x000292fe, 0x00000000, 0x00000000, 0x00000004};
+
+static point_affine comb_table[COMB_WINDOWS][COMB_DIGITS];
+
+static inline void gf_copy(gf_t r, const gf_t a) { memcpy(r, a, sizeof(gf_t)); }
+
+static inline void gf_add(gf_t r, const gf_t a, const gf_t b) {
+  for (int it = 0; it < GF_WORDS; ++it) {
+    r[it] = a[it] ^ b[it];
+  }
+}
+
+static inline int gf_is_zero(const gf_t a) {
+  return (a[0] | a[1] | a[2]) == 0;
+}
+
+// reduce 326-bit product modulo x^163 + x^7 + x^6 + x^3 + 1
+static inline void gf_reduce(gf_t r, uint64_t c[2 * GF_WORDS]) {
+  for (int it = 2 * GF_WORDS - 1; it >= GF_WORDS; --it) {
+    const uint64_t t = c[it];
+    c[it - 3] ^= (t << 29) ^ (t << 32) ^ (t << 35) ^ (t << 36);
+    c[it - 2] ^= (t >> 35) ^ (t >> 32) ^ (t >> 29) ^ (t >> 28);
+  }
+  const uint64_t t = c[2] >> GF_TOP_BITS;
+  c[0] ^= t ^ (t << 3) ^ (t << 6) ^ (t << 7);
+  r[0] = c[0];
+  r[1] = c[1];
+  r[2] = c[2] & GF_TOP_MASK;
+}
+
+// carry-less a * b of 64-bit words with 4-bit window multiples of b
+static inline void clmul_table(uint64_t u[16], uint64_t b) {
+  // top 3 bits of b are added separately so multiples fit in 64 bits
+  const uint64_t bl = b & 0x1fffffffffffffffULL;
+  u[0] = 0;
+  u[1] = bl;
+  for (int it = 2; it < 16; it += 2) {
+    u[it] = u[it / 2] << 1;
+    u[it + 1] = u[it] ^ bl;
+  }
+}
+
+static inline void clmul_word(const uint64_t u[16], uint64_t b, uint64_t a,
+                              uint64_t* lo, uint64_t* hi) {
+  uint64_t l = u[a & 15], h = 0;
+  for (int it = 4; it < 64; it += 4) {
+    const uint64_t g = u[(a >> it) & 15];
+    l ^= g << it;
+    h ^= g >> (64 - it);
+  }
+  for (int it = 61; it < 64; ++it) {
+    const uint64_t mask = 0 - ((b >> it) & 1);
+    l ^= (a << it) & mask;
+    h ^= (a >> (64 - it)) & mask;
+  }
+  *lo ^= l;
+  *hi ^= h;
+}
+
+static void gf_mul_software(gf_t r, const gf_t a, const gf_t b) {
+  uint64_t c[2 * GF_WORDS] = {0};
+  uint64_t u[16];
+  for (int j = 0; j < GF_WORDS; ++j) {
+    clmul_table(u, b[j]);
+    for (int i = 0; i < GF_WORDS; ++i) {
+      clmul_word(u, b[j], a[i], &c[i + j], &c[i + j + 1]);
+    }
+  }
+  gf_reduce(r, c);
+}
+
+#if defined(TINYCRYPT_PCLMUL)
+TINYCRYPT_TARGET_PCLMUL
+static void gf_mul_pclmul(gf_t r, const gf_t a, const gf_t b) {
+  __m128i av[GF_WORDS], bv[GF_WORDS];
+  for (int it = 0; it < GF_WORDS; ++it) {
+    av[it] = _mm_cvtsi64_si128((long long)a[it]);
+    bv[it] = _mm_cvtsi64_si128((long long)b[it]);
+  }
+  __m128i c[2 * GF_WORDS - 1];
+  c[0] = _mm_clmulepi64_si128(av[0], bv[0], 0x00);
+  c[1] = _mm_xor_si128(_mm_clmulepi64_si128(av[0], bv[1], 0x00),
+                       _mm_clmulepi64_si128(av[1], bv[0], 0x00));
+  c[2] = _mm_xor_si128(_mm_clmulepi64_si128(av[0], bv[2], 0x00),
+                       _mm_xor_si128(_mm_clmulepi64_si128(av[1], bv[1], 0x00),
+                                     _mm_clmulepi64_si128(av[2], bv[0], 0x00)));
+  c[3] = _mm_xor_si128(_mm_clmulepi64_si128(av[1], bv[2], 0x00),
+                       _mm_clmulepi64_si128(av[2], bv[1], 0x00));
+  c[4] = _mm_clmulepi64_si128(av[2], bv[2], 0x00);
+
+  uint64_t w[2 * GF_WORDS] = {0};
+  for (int it = 0; it < 2 * GF_WORDS - 1; ++it) {
+    w[it] ^= (uint64_t)_mm_cvtsi128_si64(c[it]);
+    w[it + 1] ^= (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(c[it], 8));
+  }
+  gf_reduce(r, w);
+}
+
+TINYCRYPT_TARGET_PCLMUL
+static void gf_sq_pclmul(gf_t r, const gf_t a) {
+  uint64_t w[2 * GF_WORDS];
+  for (int it = 0; it < GF_WORDS; ++it) {
+    const __m128i v = _mm_cvtsi64_si128((long long)a[it]);
+    const __m128i c = _mm_clmulepi64_si128(v, v, 0x00);
+    w[2 * it] = (uint64_t)_mm_cvtsi128_si64(c);
+    w[2 * it + 1] = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(c, 8));
+  }
+  gf_reduce(r, w);
+}
+
+static int gf_pclmul_supported(void) {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 1)) != 0;
+#else
+  return __builtin_cpu_supports("pclmul");
+#endif
+}
+#endif
+
+// interleave zero bits, carry-less square of 32 bits
+static inline uint64_t gf_spread(uint32_t v) {
+  uint64_t x = v;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+  x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+  x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x << 2)) & 0x3333333333333333ULL;
+  x = (x | (x << 1)) & 0x5555555555555555ULL;
+  return x;
+}
+
+static void gf_sq_software(gf_t r, const gf_t a) {
+  uint64_t c[2 * GF_WORDS];
+  for (int it = 0; it < GF_WORDS; ++it) {
+    c[2 * it] = gf_spread((uint32_t)a[it]);
+    c[2 * it + 1] = gf_spread((uint32_t)(a[it] >> 32));
+  }
+  gf_reduce(r, c);
+}
+
+// selected in comb_table_init, before any key is generated
+static void (*gf_mul)(gf_t r, const gf_t a, const gf_t b) = gf_mul_software;
+static void (*gf_sq)(gf_t r, const gf_t a) = gf_sq_software;
+
+static void gf_sq_times(gf_t r, const gf_t a, int count) {
+  gf_sq(r, a);
+  for (int it = 1; it < count; ++it) {
+    gf_sq(r, r);
+  }
+}
+
+// r = 1 / a = a^(2^163 - 2), Itoh-Tsujii with chain 1 2 4 5 10 20 40 80 81 162
+static void gf_inv(gf_t r, const gf_t a) {
+  gf_t b1, b2, b4, b5, b10, b20, b40, b80, b81, t;
+  gf_copy(b1, a);
+  gf_sq(t, b1);
+  gf_mul(b2, t, b1);
+  gf_sq_times(t, b2, 2);
+  gf_mul(b4, t, b2);
+  gf_sq(t, b4);
+  gf_mul(b5, t, b1);
+  gf_sq_times(t, b5, 5);
+  gf_mul(b10, t, b5);
+  gf_sq_times(t, b10, 10);
+  gf_mul(b20, t, b10);
+  gf_sq_times(t, b20, 20);
+  gf_mul(b40, t, b20);
+  gf_sq_times(t, b40, 40);
+  gf_mul(b80, t, b40);
+  gf_sq(t, b80);
+  gf_mul(b81, t, b1);
+  gf_sq_times(t, b81, 81);
+  gf_mul(t, t, b81);
+  gf_sq(r, t);
+}
+
+// r = 2 * p, curve coefficient a = 1
+static void point_double(point_ld* r, const point_ld* p) {
+  gf_t x2, z2, bz4, t;
+  gf_sq(x2, p->x);
+  gf_sq(z2, p->z);
+  gf_sq(t, z2);
+  gf_mul(bz4, coeff_b, t);
+
+  gf_mul(r->z, x2, z2);
+  gf_sq(t, x2);
+  gf_add(r->x, t, bz4);
+
+  gf_sq(t, p->y);
+  gf_add(t, t, bz4);
+  gf_add(t, t, r->z);
+  gf_mul(t, t, r->x);
+  gf_mul(r->y, bz4, r->z);
+  gf_add(r->y, r->y, t);
+}
+
+// r = p + q, p must not be infinity and p != +-q, curve coefficient a = 1
+static void point_add_mixed(point_ld* r, const point_ld* p,
+                            const point_affine* q) {
+  gf_t t1, t2, t3, x3, y3, z3;
+  gf_mul(t1, p->z, q->x);
+  gf_sq(t2, p->z);
+  gf_add(x3, p->x, t1);
+  gf_mul(t1, p->z, x3);
+  gf_mul(t3, t2, q->y);
+  gf_add(y3, p->y, t3);
+  gf_sq(z3, t1);
+  gf_mul(t3, t1, y3);
+  gf_add(t1, t1, t2);
+  gf_sq(t2, x3);
+  gf_mul(x3, t2, t1);
+  gf_sq(t2, y3);
+  gf_add(x3, x3, t2);
+  gf_add(x3, x3, t3);
+  gf_mul(t2, q->x, z3);
+  gf_add(t2, t2, x3);
+  gf_sq(t1, z3);
+  gf_add(t3, t3, z3);
+  gf_mul(y3, t3, t2);
+  gf_add(t2, q->x, q->y);
+  gf_mul(t3, t1, t2);
+  gf_add(r->y, y3, t3);
+  gf_copy(r->x, x3);
+  gf_copy(r->z, z3);
+}
+
+static void point_to_affine(point_affine* r, const point_ld* p) {
+  gf_t zi;
+  gf_inv(zi, p->z);
+  gf_mul(r->x, p->x, zi);
+  gf_sq(zi, zi);
+  gf_mul(r->y, p->y, zi);
+}
+
+static void point_from_affine(point_ld* r, const point_affine* p) {
+  gf_copy(r->x, p->x);
+  gf_copy(r->y, p->y);
+  memset(r->z, 0, sizeof(gf_t));
+  r->z[0] = 1;
+}
+
+static void comb_table_init(void) {
+#if defined(TINYCRYPT_PCLMUL)
+  if (gf_pclmul_supported()) {
+    gf_mul = gf_mul_pclmul;
+    gf_sq = gf_sq_pclmul;
+  }
+#endif
+
+  point_affine window_base = base_point;
+  for (int i = 0; i < COMB_WINDOWS; ++i) {
+    point_ld multiples[COMB_DIGITS];
+    point_from_affine(&multiples[0], &window_base);
+    point_double(&multiples[1], &multiples[0]);
+    for (int j = 2; j < COMB_DIGITS; ++j) {
+      point_add_mixed(&multiples[j], &multiples[j - 1], &window_base);
+    }
+    for (int j = 0; j < COMB_DIGITS; ++j) {
+      point_to_affine(&comb_table[i][j], &multiples[j]);
+    }
+
+    // 2^COMB_WIDTH * window_base
+    point_ld next;
+    point_double(&next, &multiples[COMB_DIGITS / 2]);
+    point_to_affine(&window_base, &next);
+  }
+}
+
+#if defined(_WIN32)
+static INIT_ONCE comb_table_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK comb_table_init_once(PINIT_ONCE once, PVOID param,
+                                          PVOID* context) {
+  comb_table_init();
+  return TRUE;
+}
+
+static void comb_table_ensure(void) {
+  InitOnceExecuteOnce(&comb_table_once, comb_table_init_once, NULL, NULL);
+}
+#else
+static pthread_once_t comb_table_once = PTHREAD_ONCE_INIT;
+
+static void comb_table_ensure(void) {
+  pthread_once(&comb_table_once, comb_table_init);
+}
+#endif
+
+static inline void point_select(point_affine* r, const point_affine* row,
+                                uint32_t digit) {
+  memset(r, 0, sizeof(point_affine));
+  for (uint32_t j = 1; j <= COMB_DIGITS; ++j) {
+    const uint64_t mask = 0 - (uint64_t)(j == digit);
+    for (int it = 0; it < GF_WORDS; ++it) {
+      r->x[it] |= row[j - 1].x[it] & mask;
+      r->y[it] |= row[j - 1].y[it] & mask;
+    }
+  }
+}
+
+static inline void point_cmov(point_ld* r, const point_ld* p, uint64_t flag) {
+  const uint64_t mask = 0 - flag;
+  for (int it = 0; it < GF_WORDS; ++it) {
+    r->x[it] ^= (r->x[it] ^ p->x[it]) & mask;
+    r->y[it] ^= (r->y[it] ^ p->y[it]) & mask;
+    r->z[it] ^= (r->z[it] ^ p->z[it]) & mask;
+  }
+}
+
+static int key_degree(const uint32_t key[KEY_WORDS]) {
+  for (int it = KEY_WORDS * 32 - 1; it >= 0; --it) {
+    if ((key[it / 32] >> (it % 32)) & 1) {
+      return it + 1;
+    }
+  }
+  return 0;
+}
+
+static void store_gf(uint8_t* out, const gf_t a) {
+  uint32_t words[KEY_WORDS];
+  for (int it = 0; it < KEY_WORDS; ++it) {
+    words[it] = (uint32_t)(a[it / 2] >> (32 * (it % 2)));
+  }
+  memcpy(out, words, sizeof(words));
+}
+
+int ecdh_generate_keys_fixed_base(uint8_t* public_key, uint8_t* private_key) {
+  uint32_t key[KEY_WORDS];
+  memcpy(key, private_key, sizeof(key));
+
+  // The same checks as ecdh_generate_keys, public key is set to base point on
+  // failure like there
+  if (key_degree(key) < CURVE_DEGREE / 2) {
+    store_gf(public_key, base_point.x);
+    store_gf(public_key + ECC_PRV_KEY_SIZE, base_point.y);
+    zero_bytes((uint8_t*)key, sizeof(key));
+    return 0;
+  }
+  for (int it = key_degree(base_order_words) - 1; it < KEY_WORDS * 32; ++it) {
+    key[it / 32] &= ~((uint32_t)1 << (it % 32));
+  }
+  memcpy(private_key, key, sizeof(key));
+
+  comb_table_ensure();
+
+  // Accumulator is below 2^(4 * i) and digit point is j * 2^(4 * i) * G with
+  // sum below the base point order, so they never coincide and mixed addition
+  // has no special cases. Empty accumulator and zero digit are replaced with
+  // dummy points from other windows and the result is discarded by masks.
+  point_ld acc, sum, dummy;
+  uint64_t acc_is_zero = 1;
+  memset(&acc, 0, sizeof(acc));
+  for (int i = 0; i < COMB_WINDOWS; ++i) {
+    const int bit = i * COMB_WIDTH;
+    const uint32_t digit = (key[bit / 32] >> (bit % 32)) & COMB_DIGITS;
+    const uint64_t has_digit = (uint64_t)(digit != 0);
+
+    point_affine q;
+    point_select(&q, comb_table[i], digit | (uint32_t)(has_digit ^ 1));
+
+    point_from_affine(&dummy, &comb_table[(i + 1) % COMB_WINDOWS][0]);
+    point_cmov(&acc, &dummy, acc_is_zero);
+    point_add_mixed(&sum, &acc, &q);
+
+    // acc = empty acc ? q : acc + q, unchanged if digit is zero
+    point_from_affine(&dummy, &q);
+    point_cmov(&sum, &dummy, acc_is_zero);
+    point_cmov(&acc, &sum, has_digit);
+    acc_is_zero &= has_digit ^ 1;
+  }
+
+  point_affine result;
+  point_to_affine(&result, &acc);
+  store_gf(public_key, result.x);
+  store_gf(public_key + ECC_PRV_KEY_SIZE, result.y);
+
+  zero_bytes((uint8_t*)key, sizeof(key));
+  zero_bytes((uint8_t*)&acc, sizeof(acc));
+  zero_bytes((uint8_t*)&sum, sizeof(sum));
+  zero_bytes((uint8_t*)&dummy, sizeof(dummy));
+  return 1;
+}
+
+#else
+
+int ecdh_generate_keys_fixed_base(uint8_t* public_key, uint8_t* private_key) {
+  // Precomputed tables are implemented for NIST B-163 only
+  return ecdh_generate_keys(public_key, private_key);
+}
+
+#endif
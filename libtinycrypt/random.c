@@ -0,0 +1,175 @@
+// Random bytes for keys and salts: per-thread ChaCha20 DRBG with fast key
+// erasure. Every refill generates RNG_BUFFER_SIZE bytes of keystream, the
+// first key-sized part of it becomes the next key and the rest is handed out
+// and wiped as used, so neither past nor buffered future output can be
+// recovered from the thread state. Key is seeded from the operating system
+// source (getrandom, getentropy or RtlGenRandom) on first use, mixed with
+// fresh seed every RNG_RESEED_BYTES of output and after fork in child.
+// Threads don't share any state, so there is no lock on this path.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tinycrypt.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+// RtlGenRandom, exported by advapi32 as SystemFunction036
+BOOLEAN NTAPI SystemFunction036(PVOID buffer, ULONG length);
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define RNG_THREAD_LOCAL __declspec(thread)
+#else
+#define RNG_THREAD_LOCAL __thread
+#endif
+
+#define RNG_BUFFER_SIZE 512
+#define RNG_RESEED_BYTES (1024 * 1024)
+
+typedef struct {
+  CHACHA20_KEY key;
+  uint8_t buffer[RNG_BUFFER_SIZE];
+  size_t available;  ///< unused bytes at the end of buffer
+  size_t generated;  ///< output since last reseed
+  uint32_t fork_generation;
+  int seeded;
+} rng_state;
+
+static RNG_THREAD_LOCAL rng_state rng;
+
+// Incremented in child after fork, child threads reseed on next use
+static volatile uint32_t rng_fork_generation;
+
+#if defined(_WIN32)
+static void rng_os_bytes(uint8_t* out, size_t out_len) {
+  if (!SystemFunction036(out, (ULONG)out_len)) {
+    abort();
+  }
+}
+
+static void rng_fork_ensure(void) {}
+#else
+#if defined(__linux__) && defined(SYS_getrandom)
+static int rng_getrandom(uint8_t* out, size_t out_len) {
+  while (out_len > 0) {
+    long got = syscall(SYS_getrandom, out, out_len, 0);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 0;
+    }
+    out += got;
+    out_len -= (size_t)got;
+  }
+  return 1;
+}
+#elif defined(__APPLE__) || defined(__OpenBSD__) || defined(__FreeBSD__)
+int getentropy(void* buffer, size_t length);
+
+static int rng_getrandom(uint8_t* out, size_t out_len) {
+  // seed is far below 256 bytes limit of getentropy
+  return getentropy(out, out_len) == 0;
+}
+#else
+static int rng_getrandom(uint8_t* out, size_t out_len) { return 0; }
+#endif
+
+// Kernels without getrandom
+static int rng_urandom(uint8_t* out, size_t out_len) {
+  int fd;
+  do {
+    fd = open("/dev/urandom", O_RDONLY);
+  } while (fd < 0 && errno == EINTR);
+  if (fd < 0) {
+    return 0;
+  }
+  while (out_len > 0) {
+    ssize_t got = read(fd, out, out_len);
+    if (got <= 0) {
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      close(fd);
+      return 0;
+    }
+    out += got;
+    out_len -= (size_t)got;
+  }
+  close(fd);
+  return 1;
+}
+
+static void rng_os_bytes(uint8_t* out, size_t out_len) {
+  if (!rng_getrandom(out, out_len) && !rng_urandom(out, out_len)) {
+    abort();
+  }
+}
+
+static pthread_once_t rng_fork_once = PTHREAD_ONCE_INIT;
+
+static void rng_fork_child(void) { rng_fork_generation++; }
+
+static void rng_fork_init(void) {
+  pthread_atfork(NULL, NULL, rng_fork_child);
+}
+
+static void rng_fork_ensure(void) {
+  pthread_once(&rng_fork_once, rng_fork_init);
+}
+#endif
+
+static void rng_reseed(void) {
+  uint8_t seed[CHACHA20_KEY_SIZE];
+  rng_os_bytes(seed, sizeof(seed));
+  xor_bytes(rng.key.data, seed, sizeof(seed));
+  zero_bytes(seed, sizeof(seed));
+
+  // buffered output of previous key must not survive the reseed
+  zero_bytes(rng.buffer, sizeof(rng.buffer));
+  rng.available = 0;
+  rng.generated = 0;
+  rng.fork_generation = rng_fork_generation;
+}
+
+static void rng_refill(void) {
+  static const uint8_t nonce[CHACHA20_NONCE_SIZE] = {0};
+  Keystream_CHACHA20(&rng.key, nonce, 0, rng.buffer, sizeof(rng.buffer));
+  memcpy(rng.key.data, rng.buffer, sizeof(rng.key.data));
+  zero_bytes(rng.buffer, sizeof(rng.key.data));
+  rng.available = sizeof(rng.buffer) - sizeof(rng.key.data);
+}
+
+void randomize_bytes(volatile uint8_t* bytes, size_t size) {
+  if (!rng.seeded) {
+    rng_fork_ensure();
+    rng_reseed();
+    rng.seeded = 1;
+  } else if (rng.generated >= RNG_RESEED_BYTES ||
+             rng.fork_generation != rng_fork_generation) {
+    rng_reseed();
+  }
+  rng.generated += size;
+
+  while (size > 0) {
+    if (rng.available == 0) {
+      rng_refill();
+    }
+    size_t len = size < rng.available ? size : rng.available;
+    uint8_t* source = rng.buffer + sizeof(rng.buffer) - rng.available;
+    memcpy((uint8_t*)bytes, source, len);
+    zero_bytes(source, len);
+    rng.available -= len;
+    bytes += len;
+    size -= len;
+  }
+}
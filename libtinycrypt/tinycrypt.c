@@ -6,14 +6,6 @@
 #include <assert.h>
 #include "tinycrypt.h"
 
-void randomize_bytes(volatile uint8_t* bytes, size_t size) {
-  // random source via traits/strategy
-  const unsigned D = RAND_MAX / 256;
-  for (size_t it = 0; it < size; ++it) {
-    bytes[it] = rand() / D;
-  }
-}
-
 void zero_bytes(volatile uint8_t* bytes, size_t size) {
   for (size_t it = 0; it < size; ++it) {
     bytes[it] = 0;
@@ -26,11 +18,26 @@ void xor_bytes(volatile uint8_t* dest, const uint8_t* source, size_t size) {
   }
 }
 
+void xor_keystream(uint8_t* dest, const uint8_t* source, size_t size) {
+  size_t it = 0;
+  for (; it + sizeof(uint64_t) <= size; it += sizeof(uint64_t)) {
+    uint64_t d, s;
+    memcpy(&d, dest + it, sizeof(d));
+    memcpy(&s, source + it, sizeof(s));
+    d ^= s;
+    memcpy(dest + it, &d, sizeof(d));
+  }
+  for (; it < size; ++it) {
+    dest[it] ^= source[it];
+  }
+}
+
 void initPeerKeys(PeerKeyset* keys) {
   // compute public key based on private one and curve parameters
   for (;;) {
     randomize_bytes(keys->pvtkeylocal.data, sizeof(keys->pvtkeylocal.data));
-    int ok = ecdh_generate_keys(keys->pubkeylocal.data, keys->pvtkeylocal.data);
+    int ok = ecdh_generate_keys_fixed_base(keys->pubkeylocal.data,
+                                           keys->pvtkeylocal.data);
     if (ok) {
       break;
     }
@@ -76,6 +83,61 @@ const char* initApplyRemoteKey(PeerKeyset* keys, const ECDHPubkey* remote,
   return NULL;
 };
 
+void initPeerKeys_X25519(PeerKeyset_X25519* keys) {
+  // any 32 bytes are valid private key, no retries needed
+  randomize_bytes(keys->pvtkeylocal.data, sizeof(keys->pvtkeylocal.data));
+  X25519_public_key(&keys->pubkeylocal, &keys->pvtkeylocal);
+
+  zero_bytes(keys->pubkeyremote.data, sizeof(keys->pubkeyremote.data));
+  zero_bytes(keys->sharedkey.data, sizeof(keys->sharedkey.data));
+
+  zero_bytes(keys->sessionkey.data, sizeof(keys->sessionkey.data));
+  randomize_bytes(keys->sessionsalt.data, sizeof(keys->sessionsalt.data));
+}
+
+const char* initApplyRemoteKey_X25519(PeerKeyset_X25519* keys,
+                                      const X25519Key* remote,
+                                      const AES128_1_BLOCK* sessionsalt) {
+  keys->pubkeyremote = *remote;
+
+  if (!X25519_shared_secret(&keys->sharedkey, &keys->pvtkeylocal,
+                            &keys->pubkeyremote)) {
+    zero_bytes(keys->pubkeyremote.data, sizeof(keys->pubkeyremote.data));
+    zero_bytes(keys->sharedkey.data, sizeof(keys->sharedkey.data));
+    return "remote public key is of small order";
+  }
+
+  keys->sessionsalt = *sessionsalt;
+
+  // the same derivation as initApplyRemoteKey
+  AES128_1_KEY clamped_key;
+  static_assert(sizeof(clamped_key.data) <= sizeof(keys->sharedkey.data),
+                "must fit");
+  memcpy(clamped_key.data, keys->sharedkey.data, sizeof(clamped_key.data));
+
+  PBKDF2_AES128_1(&clamped_key, &keys->sessionsalt, 30, keys->sessionkey.data,
+                  sizeof(keys->sessionkey.data));
+  zero_bytes(clamped_key.data, sizeof(clamped_key.data));
+  return NULL;
+}
+
+void initResumptionSecret(const AES128_1_KEY* sessionkey,
+                          const AES128_1_BLOCK* nonce, AES128_1_KEY* secret) {
+  PBKDF2_AES128_1(sessionkey, nonce, 1, secret->data, sizeof(secret->data));
+}
+
+void initResumedSessionKey(const AES128_1_KEY* secret,
+                           const AES128_1_BLOCK* client_salt,
+                           const AES128_1_BLOCK* server_salt,
+                           AES128_1_KEY* sessionkey,
+                           AES128_1_BLOCK* sessionsalt) {
+  // secret is a key already, single round is enough like for AEAD key
+  *sessionsalt = *client_salt;
+  xor_bytes(sessionsalt->data, server_salt->data, sizeof(sessionsalt->data));
+  PBKDF2_AES128_1(secret, sessionsalt, 1, sessionkey->data,
+                  sizeof(sessionkey->data));
+}
+
 void HMAC_AES128_1(const AES128_1_KEY* key, uint8_t* message,
                    size_t message_len) {
   AES128_1_BLOCK iv;
@@ -87,12 +149,36 @@ void HMAC_AES128_1(const AES128_1_KEY* key, uint8_t* message,
 
   struct AES_ctx ctx;
   AES_init_ctx_iv(&ctx, key->data, iv.data);
-  AES_CTR_xcrypt_buffer(&ctx, message, message_len);
+  CTR_AES128_xcrypt_buffer(&ctx, message, message_len);
 }
 
 void XCrypt_AES128_1(const AES128_1_KEY* key, uint32_t nonce, uint8_t* message,
                      size_t message_len) {
+  AES128_1_SCHEDULE schedule;
+  ExpandKey_AES128_1(key, &schedule);
+  XCryptScheduled_AES128_1(&schedule, nonce, message, message_len);
+  zero_bytes(schedule.round_keys, sizeof(schedule.round_keys));
+}
+
+void ExpandKey_AES128_1(const AES128_1_KEY* key, AES128_1_SCHEDULE* schedule) {
   static_assert(sizeof(key->data) == AES_KEYLEN, "Must be equivalent");
+
+  struct AES_ctx ctx;
+  static_assert(sizeof(schedule->round_keys) == sizeof(ctx.RoundKey),
+                "Must be equivalent");
+  AES_init_ctx(&ctx, key->data);
+  memcpy(schedule->round_keys, ctx.RoundKey, sizeof(schedule->round_keys));
+  zero_bytes(ctx.RoundKey, sizeof(ctx.RoundKey));
+}
+
+void XCryptScheduled_AES128_1(const AES128_1_SCHEDULE* schedule, uint32_t nonce,
+                              uint8_t* message, size_t message_len) {
+  XCryptScheduledAt_AES128_1(schedule, nonce, 0, message, message_len);
+}
+
+void XCryptScheduledAt_AES128_1(const AES128_1_SCHEDULE* schedule,
+                                uint32_t nonce, uint64_t block,
+                                uint8_t* message, size_t message_len) {
   // HINT hardcoded init vector
   static uint8_t hardIv[] = {
       0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
@@ -108,9 +194,14 @@ void XCrypt_AES128_1(const AES128_1_KEY* key, uint32_t nonce, uint8_t* message,
   const size_t ofs = sizeof(iv.data) - sizeof(nonce);
   xor_bytes(iv.data + ofs, (const uint8_t*)(&nonce), sizeof(nonce));
 
-  struct AES_ctx ctx;
-  AES_init_ctx_iv(&ctx, key->data, iv.data);
-  AES_CTR_xcrypt_buffer(&ctx, message, message_len);
+  // advance big-endian counter by block
+  for (size_t it = sizeof(iv.data); it > 0 && block != 0; --it) {
+    block += iv.data[it - 1];
+    iv.data[it - 1] = (uint8_t)block;
+    block >>= 8;
+  }
+
+  CTR_AES128_xcrypt_keys(schedule->round_keys, iv.data, message, message_len);
 }
 
 // TODO add different algos
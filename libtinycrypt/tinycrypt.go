@@ -9,14 +9,63 @@ package tinycrypt
 //#include "tiny-AES-c/aes.c"
 import "C"
 import (
+	"encoding/binary"
 	"errors"
+	"time"
 	"unsafe"
 )
 
+// Encryption protocols, teoLNullEncryptionProtocol of L0 client
+const (
+	// ProtoECDHAES128V1 is ECDH key exchange and AES-128-CTR encryption
+	ProtoECDHAES128V1             uint16 = 1
+	// ProtoECDHChaCha20Poly1305V2 is ECDH key exchange of ProtoECDHAES128V1
+	// and ChaCha20-Poly1305 AEAD encryption with 16 bytes tag
+	ProtoECDHChaCha20Poly1305V2   uint16 = 2
+	// ProtoX25519ChaCha20Poly1305V3 is X25519 key exchange and encryption of
+	// ProtoECDHChaCha20Poly1305V2
+	ProtoX25519ChaCha20Poly1305V3 uint16 = 3
+)
+
+// Key exchange payload types, high byte of protocol id, teoLNullKEXType of L0
+// client
+const (
+	kexTypeTicket       uint16 = 1
+	kexTypeResume       uint16 = 2
+	kexTypeResumeReject uint16 = 3
+)
+
+// Session resumption ticket layout, the ticket is opaque for L0 client
+const (
+	ticketKeySize       = 32
+	ticketMaxSize       = 255
+	ticketPlaintextSize = 2 + 8 + 16 // protocol, expiry unix ms, secret
+	ticketSize          = aeadNonceSize + ticketPlaintextSize + aeadTagSize
+)
+
+// L0 packet layout, teoLNullCPacket of L0 client
+const (
+	packetHeaderSize      = 8
+	packetEncryptedFlag   = 0x80
+	aeadTagSize           = 16
+	aeadNonceSize         = 12
+	aeadClientToServerDir = 0
+	aeadServerToClientDir = 1
+)
+
 // Tcrypt is the tinycrypt receiver
 type Tcrypt struct {
-	c   C.PeerKeyset
-	num uint32
+	c     C.PeerKeyset
+	x     C.PeerKeyset_X25519
+	s     C.AES128_1_SCHEDULE
+	num   uint32
+	proto uint16
+
+	// ProtoECDHChaCha20Poly1305V2 state
+	a       C.CHACHA20_KEY
+	sendDir byte
+	sendNum uint32
+	recvNum uint32
 }
 
 // binBuffer is structure used in Marshal binary buffer
@@ -26,18 +75,44 @@ type binBuffer struct {
 	salt  C.AES128_1_BLOCK
 }
 
+// binBufferX25519 is binBuffer of ProtoX25519ChaCha20Poly1305V3
+type binBufferX25519 struct {
+	proto uint16
+	key   C.X25519Key
+	salt  C.AES128_1_BLOCK
+}
+
 // New create and initialize Tcrypt packet receiver
 func New() (pk *Tcrypt) {
-	pk = &Tcrypt{}
+	return NewProto(ProtoECDHAES128V1)
+}
+
+// NewProto create and initialize Tcrypt packet receiver of L0 server side for
+// encryption protocol proto. Protocol is changed to the one requested by
+// client in UnmarshalBinary
+func NewProto(proto uint16) (pk *Tcrypt) {
+	pk = &Tcrypt{proto: proto, sendDir: aeadServerToClientDir, sendNum: 1,
+		recvNum: 1}
 	C.initPeerKeys((*C.PeerKeyset)(&pk.c))
+	C.initPeerKeys_X25519(&pk.x)
+	C.ExpandKey_AES128_1(&pk.c.sessionkey, &pk.s)
 	return
 }
 
 // MarshalBinary marshal Tcrypt keys to binary buffer
 func (pk *Tcrypt) MarshalBinary() (data []byte, err error) {
+	if pk.proto == ProtoX25519ChaCha20Poly1305V3 {
+		nb := binBufferX25519{}
+		l := unsafe.Sizeof(nb)
+		nb.proto = pk.proto
+		nb.key = pk.x.pubkeylocal
+		nb.salt = pk.x.sessionsalt
+		data = (*[1 << 28]byte)(unsafe.Pointer(&nb))[:l:l]
+		return
+	}
 	nb := binBuffer{}
 	l := unsafe.Sizeof(nb)
-	nb.proto = 1
+	nb.proto = pk.proto
 	nb.key = pk.c.pubkeylocal
 	nb.salt = pk.c.sessionsalt
 	data = (*[1 << 28]byte)(unsafe.Pointer(&nb))[:l:l]
@@ -51,14 +126,351 @@ func (pk *Tcrypt) UnmarshalBinary(data []byte) (err error) {
 		err = errors.New("input data is empty")
 		return
 	}
+	if len(data) >= 2 &&
+		binary.LittleEndian.Uint16(data) == ProtoX25519ChaCha20Poly1305V3 {
+		return pk.unmarshalX25519(data)
+	}
 	if len(data) != int(unsafe.Sizeof(nb)) {
 		err = errors.New("wrong size of input data")
 		return
 	}
 	nbptr := (*binBuffer)(unsafe.Pointer(&data[0]))
+	switch nbptr.proto {
+	case ProtoECDHAES128V1, ProtoECDHChaCha20Poly1305V2:
+		pk.proto = nbptr.proto
+	default:
+		err = errors.New("unknown encryption protocol")
+		return
+	}
 	if cstr := C.initApplyRemoteKey((*C.PeerKeyset)(&pk.c), &nbptr.key,
 		&nbptr.salt); unsafe.Pointer(cstr) != C.NULL {
 		err = errors.New(C.GoString(cstr))
+		return
+	}
+	C.ExpandKey_AES128_1(&pk.c.sessionkey, &pk.s)
+	if pk.proto == ProtoECDHChaCha20Poly1305V2 {
+		C.PBKDF2_AES128_1(&pk.c.sessionkey, &pk.c.sessionsalt, 1,
+			&pk.a.data[0], C.size_t(len(pk.a.data)))
+	}
+	return
+}
+
+// unmarshalX25519 unmarshal ProtoX25519ChaCha20Poly1305V3 keys from binary
+// buffer and applay it on Tcrypt
+func (pk *Tcrypt) unmarshalX25519(data []byte) (err error) {
+	var nb binBufferX25519
+	if len(data) != int(unsafe.Sizeof(nb)) {
+		err = errors.New("wrong size of input data")
+		return
+	}
+	nbptr := (*binBufferX25519)(unsafe.Pointer(&data[0]))
+	if cstr := C.initApplyRemoteKey_X25519(&pk.x, &nbptr.key,
+		&nbptr.salt); unsafe.Pointer(cstr) != C.NULL {
+		err = errors.New(C.GoString(cstr))
+		return
+	}
+	pk.proto = ProtoX25519ChaCha20Poly1305V3
+	C.PBKDF2_AES128_1(&pk.x.sessionkey, &pk.x.sessionsalt, 1,
+		&pk.a.data[0], C.size_t(len(pk.a.data)))
+	return
+}
+
+// Proto return encryption protocol
+func (pk *Tcrypt) Proto() uint16 {
+	return pk.proto
+}
+
+// keyset return session key and salt of encryption protocol key exchange
+func (pk *Tcrypt) keyset() (key *C.AES128_1_KEY, salt *C.AES128_1_BLOCK) {
+	if pk.proto == ProtoX25519ChaCha20Poly1305V3 {
+		return &pk.x.sessionkey, &pk.x.sessionsalt
+	}
+	return &pk.c.sessionkey, &pk.c.sessionsalt
+}
+
+// IssueTicket make session resumption ticket payload of established session
+// to be sent to client. The ticket is sealed with ticketKey of ticketKeySize
+// bytes, server keeps no state of issued tickets. The ticket isn't bound to
+// client address, lifetime limits its reuse
+func (pk *Tcrypt) IssueTicket(ticketKey []byte, lifetime time.Duration) (
+	data []byte, err error) {
+	if len(ticketKey) != ticketKeySize {
+		err = errors.New("wrong size of ticket key")
+		return
+	}
+
+	var nonce C.AES128_1_BLOCK
+	var secret C.AES128_1_KEY
+	C.randomize_bytes((*C.uint8_t)(unsafe.Pointer(&nonce.data[0])),
+		C.size_t(len(nonce.data)))
+	key, _ := pk.keyset()
+	C.initResumptionSecret(key, &nonce, &secret)
+
+	ticket := make([]byte, ticketSize)
+	C.randomize_bytes((*C.uint8_t)(unsafe.Pointer(&ticket[0])),
+		aeadNonceSize)
+	plain := ticket[aeadNonceSize : aeadNonceSize+ticketPlaintextSize]
+	binary.LittleEndian.PutUint16(plain, pk.proto)
+	binary.LittleEndian.PutUint64(plain[2:],
+		uint64(time.Now().Add(lifetime).UnixNano()/int64(time.Millisecond)))
+	copy(plain[10:], C.GoBytes(unsafe.Pointer(&secret.data[0]),
+		C.int(len(secret.data))))
+	tag := aeadSeal(ticketKey, ticket[:aeadNonceSize], nil, plain)
+	copy(ticket[aeadNonceSize+ticketPlaintextSize:], tag)
+
+	data = make([]byte, 2+4+len(nonce.data)+1, 2+4+len(nonce.data)+1+
+		len(ticket))
+	binary.LittleEndian.PutUint16(data, kexTypeTicket<<8|pk.proto)
+	binary.LittleEndian.PutUint32(data[2:], uint32(lifetime/time.Second))
+	copy(data[6:], C.GoBytes(unsafe.Pointer(&nonce.data[0]),
+		C.int(len(nonce.data))))
+	data[6+len(nonce.data)] = byte(len(ticket))
+	data = append(data, ticket...)
+	return
+}
+
+// Resume apply session resumption request of client to Tcrypt created with
+// NewProto. Returns answer to be sent to client, it is resumption reject if
+// error is returned. Client makes regular key exchange after reject
+func (pk *Tcrypt) Resume(ticketKey, data []byte) (answer []byte, err error) {
+	var clientSalt, serverSalt C.AES128_1_BLOCK
+	var secret C.AES128_1_KEY
+	saltLen := len(clientSalt.data)
+
+	proto, err := openTicket(ticketKey, data, &secret)
+	if err != nil {
+		answer = make([]byte, 2)
+		if len(data) >= 2 {
+			binary.LittleEndian.PutUint16(answer,
+				kexTypeResumeReject<<8|binary.LittleEndian.Uint16(data)&0xff)
+		}
+		return
+	}
+
+	for i := range clientSalt.data {
+		clientSalt.data[i] = C.uint8_t(data[2+i])
+	}
+	C.randomize_bytes((*C.uint8_t)(unsafe.Pointer(&serverSalt.data[0])),
+		C.size_t(saltLen))
+
+	pk.proto = proto
+	key, salt := pk.keyset()
+	C.initResumedSessionKey(&secret, &clientSalt, &serverSalt, key, salt)
+	pk.applySessionKey()
+
+	answer = make([]byte, 2+saltLen+1)
+	binary.LittleEndian.PutUint16(answer, kexTypeResume<<8|proto)
+	copy(answer[2:], C.GoBytes(unsafe.Pointer(&serverSalt.data[0]),
+		C.int(saltLen)))
+	return
+}
+
+// openTicket check resumption request and open its ticket. Returns encryption
+// protocol and resumption secret of the ticket
+func openTicket(ticketKey, data []byte, secret *C.AES128_1_KEY) (
+	proto uint16, err error) {
+	const headerSize = 2 + 16 + 1
+	if len(ticketKey) != ticketKeySize {
+		err = errors.New("wrong size of ticket key")
+		return
+	}
+	if len(data) < headerSize || len(data) != headerSize+int(data[18]) ||
+		binary.LittleEndian.Uint16(data)>>8 != kexTypeResume {
+		err = errors.New("wrong resumption request")
+		return
+	}
+	ticket := data[headerSize:]
+	if len(ticket) != ticketSize {
+		err = errors.New("unknown ticket")
+		return
+	}
+
+	var k C.CHACHA20_KEY
+	for i := range k.data {
+		k.data[i] = C.uint8_t(ticketKey[i])
+	}
+	plain := append([]byte{},
+		ticket[aeadNonceSize:aeadNonceSize+ticketPlaintextSize]...)
+	if C.Open_CHACHA20_POLY1305(&k, (*C.uint8_t)(unsafe.Pointer(&ticket[0])),
+		nil, 0, (*C.uint8_t)(unsafe.Pointer(&plain[0])), C.size_t(len(plain)),
+		(*C.uint8_t)(unsafe.Pointer(&ticket[aeadNonceSize+
+			ticketPlaintextSize]))) == 0 {
+		err = errors.New("unknown ticket")
+		return
+	}
+
+	proto = binary.LittleEndian.Uint16(plain)
+	if proto != binary.LittleEndian.Uint16(data)&0xff {
+		err = errors.New("ticket protocol mismatch")
+		return
+	}
+	expires := int64(binary.LittleEndian.Uint64(plain[2:]))
+	if time.Now().UnixNano()/int64(time.Millisecond) >= expires {
+		err = errors.New("ticket expired")
+		return
+	}
+	for i := range secret.data {
+		secret.data[i] = C.uint8_t(plain[10+i])
+	}
+	return
+}
+
+// applySessionKey prepare encryption keys from session key of encryption
+// protocol keyset
+func (pk *Tcrypt) applySessionKey() {
+	key, salt := pk.keyset()
+	C.ExpandKey_AES128_1(key, &pk.s)
+	if pk.isAEAD() {
+		C.PBKDF2_AES128_1(key, salt, 1, &pk.a.data[0], C.size_t(len(pk.a.data)))
+	}
+}
+
+// isAEAD check if encryption protocol is AEAD
+func (pk *Tcrypt) isAEAD() bool {
+	return pk.proto == ProtoECDHChaCha20Poly1305V2 ||
+		pk.proto == ProtoX25519ChaCha20Poly1305V3
+}
+
+// aeadNonce make ProtoECDHChaCha20Poly1305V2 nonce of direction and packet
+// counter
+func aeadNonce(dir byte, num uint32) (nonce [aeadNonceSize]byte) {
+	nonce[0] = dir
+	binary.LittleEndian.PutUint32(nonce[4:], num)
+	return
+}
+
+// aeadAdditionalData make ProtoECDHChaCha20Poly1305V2 additional data of L0
+// packet: cmd, peer_name_length, reserved_1, reserved_2 and peer name
+func aeadAdditionalData(packet []byte, peerNameLen int) []byte {
+	aad := []byte{packet[0], packet[1], packet[4], packet[5]}
+	return append(aad, packet[packetHeaderSize:packetHeaderSize+peerNameLen]...)
+}
+
+// byteChecksum calculate L0 packet byte checksum
+func byteChecksum(data []byte) (sum byte) {
+	for _, b := range data {
+		sum += b
+	}
+	return
+}
+
+// parsePacket check L0 packet length and return peer name and data lengths
+func parsePacket(packet []byte) (peerNameLen, dataLen int, err error) {
+	if len(packet) < packetHeaderSize {
+		err = errors.New("packet is too short")
+		return
+	}
+	peerNameLen = int(packet[1])
+	dataLen = int(binary.LittleEndian.Uint16(packet[2:]))
+	if len(packet) != packetHeaderSize+peerNameLen+dataLen {
+		err = errors.New("wrong packet length")
+	}
+	return
+}
+
+// SealPacket encrypt L0 packet to be sent to client with AEAD protocol, the same as L0 client teoLNullPacketSeal does.
+// Returns new packet with authentication tag appended to packet data. Packet
+// without data is returned unencrypted
+func (pk *Tcrypt) SealPacket(packet []byte) (sealed []byte, err error) {
+	if !pk.isAEAD() {
+		err = errors.New("encryption protocol is not AEAD")
+		return
+	}
+	peerNameLen, dataLen, err := pk.checkPacket(packet)
+	if err != nil {
+		return
+	}
+	if dataLen == 0 {
+		sealed = append([]byte{}, packet...)
+		return
+	}
+	if dataLen > 0xFFFF-aeadTagSize {
+		err = errors.New("packet data is too large")
+		return
+	}
+
+	sealed = make([]byte, len(packet)+aeadTagSize)
+	copy(sealed, packet)
+	sealed[4] |= packetEncryptedFlag
+
+	nonce := aeadNonce(pk.sendDir, pk.sendNum)
+	aad := aeadAdditionalData(sealed, peerNameLen)
+	msg := sealed[packetHeaderSize+peerNameLen : len(packet)]
+	C.Seal_CHACHA20_POLY1305(&pk.a, (*C.uint8_t)(unsafe.Pointer(&nonce[0])),
+		(*C.uint8_t)(unsafe.Pointer(&aad[0])), C.size_t(len(aad)),
+		(*C.uint8_t)(unsafe.Pointer(&msg[0])), C.size_t(len(msg)),
+		(*C.uint8_t)(unsafe.Pointer(&sealed[len(packet)])))
+	pk.sendNum++
+
+	binary.LittleEndian.PutUint16(sealed[2:], uint16(dataLen+aeadTagSize))
+	sealed[6] = 0
+	sealed[7] = byteChecksum(sealed[:7])
+	return
+}
+
+// OpenPacket decrypt L0 packet received from client with AEAD protocol, the
+// same as L0 client teoLNullPacketDecrypt
+// does. Returns new unencrypted packet with valid checksums, unencrypted input
+// packet is returned as is
+func (pk *Tcrypt) OpenPacket(packet []byte) (opened []byte, err error) {
+	if !pk.isAEAD() {
+		err = errors.New("encryption protocol is not AEAD")
+		return
+	}
+	peerNameLen, dataLen, err := pk.checkPacket(packet)
+	if err != nil {
+		return
+	}
+	if packet[4]&packetEncryptedFlag == 0 {
+		opened = append([]byte{}, packet...)
+		return
+	}
+	if dataLen < aeadTagSize {
+		err = errors.New("packet has no authentication tag")
+		return
+	}
+
+	msgLen := dataLen - aeadTagSize
+	opened = append([]byte{}, packet[:len(packet)-aeadTagSize]...)
+	tag := packet[len(packet)-aeadTagSize:]
+
+	nonce := aeadNonce(pk.sendDir^1, pk.recvNum)
+	aad := aeadAdditionalData(packet, peerNameLen)
+	var msg *C.uint8_t
+	if msgLen > 0 {
+		msg = (*C.uint8_t)(unsafe.Pointer(&opened[packetHeaderSize+peerNameLen]))
+	}
+	if C.Open_CHACHA20_POLY1305(&pk.a,
+		(*C.uint8_t)(unsafe.Pointer(&nonce[0])),
+		(*C.uint8_t)(unsafe.Pointer(&aad[0])), C.size_t(len(aad)),
+		msg, C.size_t(msgLen), (*C.uint8_t)(unsafe.Pointer(&tag[0]))) == 0 {
+		opened = nil
+		err = errors.New("authentication tag mismatch")
+		return
+	}
+	pk.recvNum++
+
+	binary.LittleEndian.PutUint16(opened[2:], uint16(msgLen))
+	opened[4] &^= packetEncryptedFlag
+	opened[6] = byteChecksum(opened[packetHeaderSize:])
+	opened[7] = byteChecksum(opened[:7])
+	return
+}
+
+// checkPacket check L0 packet length and header checksum, payload checksum
+// is checked for unencrypted packets only
+func (pk *Tcrypt) checkPacket(packet []byte) (peerNameLen, dataLen int,
+	err error) {
+	if peerNameLen, dataLen, err = parsePacket(packet); err != nil {
+		return
+	}
+	if packet[7] != byteChecksum(packet[:7]) {
+		err = errors.New("wrong packet header checksum")
+		return
+	}
+	if packet[4]&packetEncryptedFlag == 0 &&
+		packet[6] != byteChecksum(packet[packetHeaderSize:]) {
+		err = errors.New("wrong packet checksum")
 	}
 	return
 }
@@ -67,7 +479,7 @@ func (pk *Tcrypt) UnmarshalBinary(data []byte) (err error) {
 // encrypted (or decrypted) data.
 func (pk *Tcrypt) CryptInPlace(data []byte) []byte {
 	if data != nil && len(data) > 0 {
-		C.XCrypt_AES128_1(&pk.c.sessionkey, C.uint32_t(pk.num),
+		C.XCryptScheduled_AES128_1(&pk.s, C.uint32_t(pk.num),
 			(*C.uint8_t)(unsafe.Pointer(&data[0])), C.size_t(len(data)))
 		pk.num++
 	}
@@ -84,3 +496,228 @@ func (pk *Tcrypt) Crypt(d []byte) (data []byte) {
 	pk.CryptInPlace(data)
 	return
 }
+
+// useHardwareAES enable or disable hardware AES, returns true if hardware AES
+// is used
+func useHardwareAES(enable bool) bool {
+	var e C.int
+	if enable {
+		e = 1
+	}
+	return C.CTR_AES128_use_hardware(e) != 0
+}
+
+// aesBackend return name of AES-128-CTR backend in use
+func aesBackend() string {
+	return C.GoString(C.CTR_AES128_backend())
+}
+
+// ctrXCrypt encode (or decode) data in place with AES-128-CTR
+func ctrXCrypt(key, iv, data []byte) {
+	var ctx C.struct_AES_ctx
+	C.AES_init_ctx_iv(&ctx, (*C.uint8_t)(unsafe.Pointer(&key[0])),
+		(*C.uint8_t)(unsafe.Pointer(&iv[0])))
+	if len(data) > 0 {
+		C.CTR_AES128_xcrypt_buffer(&ctx, (*C.uint8_t)(unsafe.Pointer(&data[0])),
+			C.size_t(len(data)))
+	}
+}
+
+// xCrypt encode (or decode) data in place with session key and nonce, the
+// same as CryptInPlace does
+func xCrypt(key []byte, nonce uint32, data []byte) {
+	var k C.AES128_1_KEY
+	for i := range k.data {
+		k.data[i] = C.uint8_t(key[i])
+	}
+	if len(data) > 0 {
+		C.XCrypt_AES128_1(&k, C.uint32_t(nonce),
+			(*C.uint8_t)(unsafe.Pointer(&data[0])), C.size_t(len(data)))
+	}
+}
+
+// newClient create and initialize Tcrypt of L0 client side, used to test L0
+// server side packets encryption
+func newClient(proto uint16) (pk *Tcrypt) {
+	pk = NewProto(proto)
+	pk.sendDir = aeadClientToServerDir
+	return
+}
+
+// clientTicket apply ticket payload of server the same as L0 client does.
+// Returns resumption secret and opaque ticket
+func (pk *Tcrypt) clientTicket(data []byte) (secret, ticket []byte,
+	err error) {
+	const headerSize = 2 + 4 + 16 + 1
+	if len(data) < headerSize || len(data) != headerSize+int(data[22]) ||
+		binary.LittleEndian.Uint16(data) != kexTypeTicket<<8|pk.proto {
+		err = errors.New("wrong ticket payload")
+		return
+	}
+	var nonce C.AES128_1_BLOCK
+	var s C.AES128_1_KEY
+	for i := range nonce.data {
+		nonce.data[i] = C.uint8_t(data[6+i])
+	}
+	key, _ := pk.keyset()
+	C.initResumptionSecret(key, &nonce, &s)
+	secret = C.GoBytes(unsafe.Pointer(&s.data[0]), C.int(len(s.data)))
+	ticket = append([]byte{}, data[headerSize:]...)
+	return
+}
+
+// resumeRequest make session resumption request of client created with
+// newClient
+func (pk *Tcrypt) resumeRequest(ticket []byte) (data []byte) {
+	_, salt := pk.keyset()
+	data = make([]byte, 2, 2+len(salt.data)+1+len(ticket))
+	binary.LittleEndian.PutUint16(data, kexTypeResume<<8|pk.proto)
+	data = append(data, C.GoBytes(unsafe.Pointer(&salt.data[0]),
+		C.int(len(salt.data)))...)
+	data = append(data, byte(len(ticket)))
+	return append(data, ticket...)
+}
+
+// clientResume apply resumption answer of server the same as L0 client does
+func (pk *Tcrypt) clientResume(secret, answer []byte) (err error) {
+	var s C.AES128_1_KEY
+	var clientSalt, serverSalt C.AES128_1_BLOCK
+	if len(answer) != 2+len(serverSalt.data)+1 ||
+		binary.LittleEndian.Uint16(answer) != kexTypeResume<<8|pk.proto {
+		err = errors.New("resumption rejected")
+		return
+	}
+	for i := range s.data {
+		s.data[i] = C.uint8_t(secret[i])
+	}
+	for i := range serverSalt.data {
+		serverSalt.data[i] = C.uint8_t(answer[2+i])
+	}
+	key, salt := pk.keyset()
+	clientSalt = *salt
+	C.initResumedSessionKey(&s, &clientSalt, &serverSalt, key, salt)
+	pk.applySessionKey()
+	return
+}
+
+// aeadSeal encrypt message in place with ChaCha20-Poly1305 and return
+// authentication tag
+func aeadSeal(key, nonce, aad, msg []byte) (tag []byte) {
+	var k C.CHACHA20_KEY
+	for i := range k.data {
+		k.data[i] = C.uint8_t(key[i])
+	}
+	var aadPtr, msgPtr *C.uint8_t
+	if len(aad) > 0 {
+		aadPtr = (*C.uint8_t)(unsafe.Pointer(&aad[0]))
+	}
+	if len(msg) > 0 {
+		msgPtr = (*C.uint8_t)(unsafe.Pointer(&msg[0]))
+	}
+	tag = make([]byte, aeadTagSize)
+	C.Seal_CHACHA20_POLY1305(&k, (*C.uint8_t)(unsafe.Pointer(&nonce[0])),
+		aadPtr, C.size_t(len(aad)), msgPtr, C.size_t(len(msg)),
+		(*C.uint8_t)(unsafe.Pointer(&tag[0])))
+	return
+}
+
+// handshakeECDH make key exchange of both sides with ECDH, the same as
+// ProtoECDHAES128V1 client and server do. Returns true if session keys match
+func handshakeECDH() bool {
+	var client, server C.PeerKeyset
+	C.initPeerKeys(&client)
+	C.initPeerKeys(&server)
+	if C.initApplyRemoteKey(&server, &client.pubkeylocal,
+		&client.sessionsalt) != nil {
+		return false
+	}
+	if C.initApplyRemoteKey(&client, &server.pubkeylocal,
+		&server.sessionsalt) != nil {
+		return false
+	}
+	return client.sessionkey == server.sessionkey
+}
+
+// handshakeX25519 make key exchange of both sides with X25519, the same as
+// ProtoX25519ChaCha20Poly1305V3 client and server do. Returns true if session
+// keys match
+func handshakeX25519() bool {
+	var client, server C.PeerKeyset_X25519
+	C.initPeerKeys_X25519(&client)
+	C.initPeerKeys_X25519(&server)
+	if C.initApplyRemoteKey_X25519(&server, &client.pubkeylocal,
+		&client.sessionsalt) != nil {
+		return false
+	}
+	if C.initApplyRemoteKey_X25519(&client, &server.pubkeylocal,
+		&server.sessionsalt) != nil {
+		return false
+	}
+	return client.sessionkey == server.sessionkey
+}
+
+// generateKeys compute ECDH public key of private key with generic point
+// multiplication of tiny-ECDH-c or with fixed-base window table. Returns
+// private key clamped by key generation and public key
+func generateKeys(fixedBase bool, pvtkey []byte) (pvt, pub []byte, ok bool) {
+	var k C.ECDHPvtkey
+	var p C.ECDHPubkey
+	for i := range k.data {
+		k.data[i] = C.uint8_t(pvtkey[i])
+	}
+	if fixedBase {
+		ok = C.ecdh_generate_keys_fixed_base(&p.data[0], &k.data[0]) != 0
+	} else {
+		ok = C.ecdh_generate_keys(&p.data[0], &k.data[0]) != 0
+	}
+	pvt = C.GoBytes(unsafe.Pointer(&k.data[0]), C.int(len(k.data)))
+	pub = C.GoBytes(unsafe.Pointer(&p.data[0]), C.int(len(p.data)))
+	return
+}
+
+// randomBytes fill buf with output of DRBG of calling thread
+func randomBytes(buf []byte) {
+	if len(buf) > 0 {
+		C.randomize_bytes((*C.uint8_t)(unsafe.Pointer(&buf[0])),
+			C.size_t(len(buf)))
+	}
+}
+
+// chacha20Keystream return n bytes of ChaCha20 keystream starting from block
+// counter
+func chacha20Keystream(key, nonce []byte, counter uint32, n int) []byte {
+	var k C.CHACHA20_KEY
+	for i := range k.data {
+		k.data[i] = C.uint8_t(key[i])
+	}
+	out := make([]byte, n)
+	C.Keystream_CHACHA20(&k, (*C.uint8_t)(unsafe.Pointer(&nonce[0])),
+		C.uint32_t(counter), (*C.uint8_t)(unsafe.Pointer(&out[0])),
+		C.size_t(n))
+	return out
+}
+
+// initKeys generate local ECDH keypair and session salt, the same as L0
+// client does on connect
+func initKeys() {
+	var keys C.PeerKeyset
+	C.initPeerKeys(&keys)
+}
+
+// ecdhPvtkeySize is size of ECDH private key of tiny-ECDH-c curve
+const ecdhPvtkeySize = len(C.ECDHPvtkey{}.data)
+
+// x25519 compute X25519 function of scalar and u-coordinate
+func x25519(scalar, point []byte) (out []byte, ok bool) {
+	var k, u, o C.X25519Key
+	for i := range k.data {
+		k.data[i] = C.uint8_t(scalar[i])
+		u.data[i] = C.uint8_t(point[i])
+	}
+	ok = C.X25519_shared_secret(&o, &k, &u) != 0
+	out = make([]byte, len(o.data))
+	for i := range o.data {
+		out[i] = byte(o.data[i])
+	}
+	return
+}
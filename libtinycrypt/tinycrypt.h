@@ -12,9 +12,13 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/// fill @a bytes with output of per-thread ChaCha20 DRBG seeded from operating
+/// system random source, aborts if the source is unavailable
 void randomize_bytes(volatile uint8_t* bytes, size_t size);
 void zero_bytes(volatile uint8_t* bytes, size_t size);
 void xor_bytes(volatile uint8_t* dest, const uint8_t* source, size_t size);
+/// xor_bytes for non-secret destination, processes 8 bytes per step
+void xor_keystream(uint8_t* dest, const uint8_t* source, size_t size);
 
 // HINT    ECC_PUB_KEY_SIZE = 2*ECC_PRV_KEY_SIZE
 /// public part of ECDH key
@@ -42,6 +46,11 @@ typedef struct {
   uint8_t data[AES_BLOCKLEN];
 } AES128_1_BLOCK;
 
+///< expanded AES key, computed once per key
+typedef struct {
+  uint8_t round_keys[AES_keyExpSize];
+} AES128_1_SCHEDULE;
+
 typedef struct {
   ECDHPvtkey pvtkeylocal;
   ECDHPubkey pubkeylocal;
@@ -53,6 +62,24 @@ typedef struct {
   AES128_1_BLOCK sessionsalt;
 } PeerKeyset;
 
+#define X25519_KEY_SIZE 32
+
+///< X25519 private, public or shared key
+typedef struct {
+  uint8_t data[X25519_KEY_SIZE];
+} X25519Key;
+
+typedef struct {
+  X25519Key pvtkeylocal;
+  X25519Key pubkeylocal;
+
+  X25519Key pubkeyremote;
+  X25519Key sharedkey;
+
+  AES128_1_KEY sessionkey;
+  AES128_1_BLOCK sessionsalt;
+} PeerKeyset_X25519;
+
 /// randomize pvtkeylocal & sessionsalt, compute pubkeylocal, zero pubkeyremote,
 /// sharedkey, sessionkey
 void initPeerKeys(PeerKeyset* keys);
@@ -61,12 +88,101 @@ void initPeerKeys(PeerKeyset* keys);
 const char* initApplyRemoteKey(PeerKeyset* keys, const ECDHPubkey* remote,
                                const AES128_1_BLOCK* sessionsalt);
 
+/// the same as initPeerKeys for X25519 keys
+void initPeerKeys_X25519(PeerKeyset_X25519* keys);
+/// the same as initApplyRemoteKey for X25519 keys
+const char* initApplyRemoteKey_X25519(PeerKeyset_X25519* keys,
+                                      const X25519Key* remote,
+                                      const AES128_1_BLOCK* sessionsalt);
+
+/// derive resumption @a secret of established session from its @a sessionkey
+/// and ticket @a nonce chosen by server
+void initResumptionSecret(const AES128_1_KEY* sessionkey,
+                          const AES128_1_BLOCK* nonce, AES128_1_KEY* secret);
+/// derive @a sessionkey of resumed session from resumption @a secret and
+/// fresh salts of both sides, @a sessionsalt is set to combined salt
+void initResumedSessionKey(const AES128_1_KEY* secret,
+                           const AES128_1_BLOCK* client_salt,
+                           const AES128_1_BLOCK* server_salt,
+                           AES128_1_KEY* sessionkey,
+                           AES128_1_BLOCK* sessionsalt);
+
+/// X25519 (RFC 7748) public key of @a pvtkey, constant time
+void X25519_public_key(X25519Key* pubkey, const X25519Key* pvtkey);
+/// X25519 shared secret of local @a pvtkey and @a remote public key, constant
+/// time, returns 0 if @a remote is of small order and secret is all zero
+int X25519_shared_secret(X25519Key* sharedkey, const X25519Key* pvtkey,
+                         const X25519Key* remote);
+
+/// the same as tiny-ECDH-c ecdh_generate_keys, uses window table of generator
+/// multiples computed once per process on first call instead of generic point
+/// multiplication, falls back to ecdh_generate_keys for curves other than
+/// NIST B-163
+int ecdh_generate_keys_fixed_base(uint8_t* public_key, uint8_t* private_key);
+
 void HMAC_AES128_1(const AES128_1_KEY* key, uint8_t* message,
                    size_t message_len);
 
 void XCrypt_AES128_1(const AES128_1_KEY* key, uint32_t nonce, uint8_t* message,
                      size_t message_len);
 
+/// expand @a key to be used in XCryptScheduled_AES128_1
+void ExpandKey_AES128_1(const AES128_1_KEY* key, AES128_1_SCHEDULE* schedule);
+/// the same as XCrypt_AES128_1 with key expanded by ExpandKey_AES128_1, only
+/// counter block is initialized per call
+void XCryptScheduled_AES128_1(const AES128_1_SCHEDULE* schedule, uint32_t nonce,
+                              uint8_t* message, size_t message_len);
+/// the same as XCryptScheduled_AES128_1 starting from keystream block @a block,
+/// used to continue keystream precomputed for first blocks of the message
+void XCryptScheduledAt_AES128_1(const AES128_1_SCHEDULE* schedule,
+                                uint32_t nonce, uint64_t block,
+                                uint8_t* message, size_t message_len);
+
+/// AES-128-CTR encryption (decryption) of buffer in place, the same as
+/// tiny-AES-c AES_CTR_xcrypt_buffer but uses AES-NI or ARMv8 crypto extensions
+/// when the CPU supports them
+void CTR_AES128_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, size_t length);
+/// the same as CTR_AES128_xcrypt_buffer with round keys expanded beforehand,
+/// @a iv is updated to the next counter value
+void CTR_AES128_xcrypt_keys(const uint8_t* round_keys, uint8_t* iv,
+                            uint8_t* buf, size_t length);
+/// enable (default) or disable hardware AES, returns 1 if hardware AES is used.
+/// Test only switch to compare backends: must be called before any encryption
+/// and not while other threads encrypt, they may still use previous backend
+int CTR_AES128_use_hardware(int enable);
+/// name of AES-128-CTR backend in use: "aes-ni", "armv8-ce" or "tiny-aes"
+const char* CTR_AES128_backend(void);
+
+#define CHACHA20_KEY_SIZE 32
+#define CHACHA20_NONCE_SIZE 12
+#define POLY1305_TAG_SIZE 16
+
+///< ChaCha20-Poly1305 key
+typedef struct {
+  uint8_t data[CHACHA20_KEY_SIZE];
+} CHACHA20_KEY;
+
+/// raw ChaCha20 (RFC 8439) keystream of @a key and @a nonce starting from block
+/// @a counter
+void Keystream_CHACHA20(const CHACHA20_KEY* key,
+                        const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                        uint32_t counter, uint8_t* out, size_t out_len);
+
+/// ChaCha20-Poly1305 (RFC 8439) encryption of @a message in place, @a aad is
+/// authenticated but not encrypted
+void Seal_CHACHA20_POLY1305(const CHACHA20_KEY* key,
+                            const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                            const uint8_t* aad, size_t aad_len,
+                            uint8_t* message, size_t message_len,
+                            uint8_t tag[POLY1305_TAG_SIZE]);
+/// ChaCha20-Poly1305 decryption of @a message in place, returns 1 on success
+/// or 0 if @a tag doesn't match, @a message is left unchanged in that case
+int Open_CHACHA20_POLY1305(const CHACHA20_KEY* key,
+                           const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                           const uint8_t* aad, size_t aad_len,
+                           uint8_t* message, size_t message_len,
+                           const uint8_t tag[POLY1305_TAG_SIZE]);
+
 void PBKDF2_AES128_1(const AES128_1_KEY* key, const AES128_1_BLOCK* salt,
                      int n_rounds, uint8_t* derived_key, size_t dk_len);
 
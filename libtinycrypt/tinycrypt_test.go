@@ -1,8 +1,15 @@
 package tinycrypt
 
 import (
+	"bytes"
+	"crypto/aes"
+	"crypto/cipher"
+	"encoding/binary"
+	"encoding/hex"
 	"fmt"
+	"math/rand"
 	"testing"
+	"time"
 )
 
 func TestPacket(t *testing.T) {
@@ -97,3 +104,535 @@ func TestPacket(t *testing.T) {
 		client()
 	})
 }
+
+func TestXCrypt(t *testing.T) {
+
+	defer useHardwareAES(true)
+	backends := []bool{false, true}
+
+	// NIST SP 800-38A F.5.1 CTR-AES128.Encrypt
+	t.Run("KnownAnswer", func(t *testing.T) {
+		key, _ := hex.DecodeString("2b7e151628aed2a6abf7158809cf4f3c")
+		iv, _ := hex.DecodeString("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff")
+		plaintext, _ := hex.DecodeString(
+			"6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51" +
+				"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710")
+		ciphertext, _ := hex.DecodeString(
+			"874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff" +
+				"5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee")
+
+		for _, hw := range backends {
+			useHardwareAES(hw)
+			for l := 1; l <= len(plaintext); l++ {
+				data := append([]byte{}, plaintext[:l]...)
+				ctrXCrypt(key, iv, data)
+				if !bytes.Equal(data, ciphertext[:l]) {
+					t.Errorf("%s: wrong ciphertext of %d bytes", aesBackend(), l)
+				}
+			}
+		}
+	})
+
+	// Keystream must be the same as standard CTR with hardcoded IV xored
+	// with nonce, to keep interoperability with L0 server
+	t.Run("Reference", func(t *testing.T) {
+		hardIv := []byte{
+			0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+			0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+		}
+		rnd := rand.New(rand.NewSource(1))
+		key := make([]byte, 16)
+		nonces := []uint32{0, 1, 0xffffffff, rnd.Uint32(), rnd.Uint32()}
+
+		for _, hw := range backends {
+			useHardwareAES(hw)
+			for _, nonce := range nonces {
+				rnd.Read(key)
+				iv := append([]byte{}, hardIv...)
+				var n [4]byte
+				binary.LittleEndian.PutUint32(n[:], nonce)
+				for i := range n {
+					iv[12+i] ^= n[i]
+				}
+				block, _ := aes.NewCipher(key)
+				for l := 0; l < 1100; l += 1 + l/16 {
+					data := make([]byte, l)
+					rnd.Read(data)
+					expected := make([]byte, l)
+					cipher.NewCTR(block, iv).XORKeyStream(expected, data)
+					xCrypt(key, nonce, data)
+					if !bytes.Equal(data, expected) {
+						t.Errorf("%s: wrong ciphertext of %d bytes, nonce %d",
+							aesBackend(), l, nonce)
+					}
+				}
+			}
+		}
+	})
+}
+
+// makePacket create unencrypted L0 packet with valid checksums
+func makePacket(cmd byte, peer string, data []byte) []byte {
+	packet := make([]byte, packetHeaderSize, packetHeaderSize+len(peer)+1+
+		len(data))
+	packet[0] = cmd
+	packet[1] = byte(len(peer) + 1)
+	binary.LittleEndian.PutUint16(packet[2:], uint16(len(data)))
+	packet = append(packet, peer...)
+	packet = append(packet, 0)
+	packet = append(packet, data...)
+	packet[6] = byteChecksum(packet[packetHeaderSize:])
+	packet[7] = byteChecksum(packet[:7])
+	return packet
+}
+
+func TestAEAD(t *testing.T) {
+
+	// RFC 8439 2.8.2 AEAD_CHACHA20_POLY1305
+	t.Run("KnownAnswer", func(t *testing.T) {
+		key, _ := hex.DecodeString(
+			"808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f")
+		nonce, _ := hex.DecodeString("070000004041424344454647")
+		aad, _ := hex.DecodeString("50515253c0c1c2c3c4c5c6c7")
+		plaintext := []byte("Ladies and Gentlemen of the class of '99: If I " +
+			"could offer you only one tip for the future, sunscreen would be it.")
+		ciphertext, _ := hex.DecodeString(
+			"d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6" +
+				"3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36" +
+				"92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc" +
+				"3ff4def08e4b7a9de576d26586cec64b6116")
+		expectedTag, _ := hex.DecodeString("1ae10b594f09e26a7e902ecbd0600691")
+
+		data := append([]byte{}, plaintext...)
+		tag := aeadSeal(key, nonce, aad, data)
+		if !bytes.Equal(data, ciphertext) {
+			t.Errorf("wrong ciphertext")
+		}
+		if !bytes.Equal(tag, expectedTag) {
+			t.Errorf("wrong tag")
+		}
+	})
+
+	// L0 server side with L0 client packets encryption
+	for _, proto := range []uint16{ProtoECDHChaCha20Poly1305V2,
+		ProtoX25519ChaCha20Poly1305V3} {
+		t.Run(fmt.Sprintf("Packet/%d", proto), func(t *testing.T) {
+
+			ch := make(chan []byte)
+			serverData := []byte("Hello world!")
+			clientString := "Hello answer!"
+
+			// In server
+			server := func() {
+
+				// Server accepts protocol requested by client
+				server := New()
+
+				buf := <-ch
+				if err := server.UnmarshalBinary(buf); err != nil {
+					t.Error(err)
+					return
+				}
+				if server.Proto() != proto {
+					t.Error("client protocol isn't accepted by server")
+				}
+				buf, err := server.MarshalBinary()
+				if err != nil {
+					t.Error(err)
+					return
+				}
+				ch <- buf
+
+				for num := 0; num < 5; num++ {
+					packet, err := server.SealPacket(makePacket(129, "client",
+						serverData))
+					if err != nil {
+						t.Error(err)
+						return
+					}
+					ch <- packet
+
+					answer, err := server.OpenPacket(<-ch)
+					if err != nil {
+						t.Error(err)
+						return
+					}
+					if string(answer[packetHeaderSize+len("server")+1:]) !=
+						clientString {
+						t.Error("data encrypted on client not equal source data")
+					}
+				}
+
+				close(ch)
+			}
+
+			// In client
+			client := func() {
+
+				client := newClient(proto)
+
+				buf, err := client.MarshalBinary()
+				if err != nil {
+					t.Error(err)
+					return
+				}
+				ch <- buf
+				if err = client.UnmarshalBinary(<-ch); err != nil {
+					t.Error(err)
+					return
+				}
+
+				for packet := range ch {
+					if len(packet) != len(makePacket(129, "client", serverData))+
+						aeadTagSize || packet[6] != 0 {
+						t.Error("wrong sealed packet layout")
+					}
+
+					// Modified packet must be rejected and left unchanged
+					for _, pos := range []int{0, 5, packetHeaderSize,
+						len(packet) - 1} {
+						packet[pos] ^= 1
+						if _, err := client.OpenPacket(packet); err == nil {
+							t.Errorf("modified byte %d isn't detected", pos)
+						}
+						packet[pos] ^= 1
+					}
+
+					opened, err := client.OpenPacket(packet)
+					if err != nil {
+						t.Error(err)
+						return
+					}
+					if !bytes.Equal(opened, makePacket(129, "client",
+						serverData)) {
+						t.Error("data encrypted on server not equal source data")
+					}
+
+					answer, err := client.SealPacket(makePacket(129, "server",
+						[]byte(clientString)))
+					if err != nil {
+						t.Error(err)
+						return
+					}
+					ch <- answer
+				}
+			}
+
+			go server()
+			client()
+		})
+	}
+}
+
+func TestX25519(t *testing.T) {
+
+	// RFC 7748 5.2 and 6.1
+	vectors := []struct{ scalar, point, out string }{
+		{"a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4",
+			"e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c",
+			"c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552"},
+		{"4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d",
+			"e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493",
+			"95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957"},
+		{"77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",
+			"0900000000000000000000000000000000000000000000000000000000000000",
+			"8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a"},
+		{"5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb",
+			"8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a",
+			"4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742"},
+	}
+	for _, v := range vectors {
+		scalar, _ := hex.DecodeString(v.scalar)
+		point, _ := hex.DecodeString(v.point)
+		out, ok := x25519(scalar, point)
+		if !ok || hex.EncodeToString(out) != v.out {
+			t.Errorf("wrong X25519 of %s", v.scalar)
+		}
+	}
+
+	// Small order point must be rejected
+	if _, ok := x25519(make([]byte, 32), make([]byte, 32)); ok {
+		t.Error("small order point isn't rejected")
+	}
+
+	for i := 0; i < 10; i++ {
+		if !handshakeX25519() {
+			t.Error("session keys mismatch")
+		}
+	}
+}
+
+func TestResumption(t *testing.T) {
+	ticketKey := make([]byte, ticketKeySize)
+	rand.Read(ticketKey)
+
+	for _, proto := range []uint16{ProtoECDHAES128V1,
+		ProtoECDHChaCha20Poly1305V2, ProtoX25519ChaCha20Poly1305V3} {
+		t.Run(fmt.Sprintf("Proto/%d", proto), func(t *testing.T) {
+
+			// Full key exchange, server issues ticket in established session
+			client, server := newClient(proto), New()
+			buf, _ := client.MarshalBinary()
+			if err := server.UnmarshalBinary(buf); err != nil {
+				t.Fatal(err)
+			}
+			buf, _ = server.MarshalBinary()
+			if err := client.UnmarshalBinary(buf); err != nil {
+				t.Fatal(err)
+			}
+			payload, err := server.IssueTicket(ticketKey, time.Minute)
+			if err != nil {
+				t.Fatal(err)
+			}
+			secret, ticket, err := client.clientTicket(payload)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			// Next connection resumes session without key exchange
+			client, server = newClient(proto), NewProto(ProtoECDHAES128V1)
+			answer, err := server.Resume(ticketKey,
+				client.resumeRequest(ticket))
+			if err != nil {
+				t.Fatal(err)
+			}
+			if server.Proto() != proto {
+				t.Error("ticket protocol isn't accepted by server")
+			}
+			if err = client.clientResume(secret, answer); err != nil {
+				t.Fatal(err)
+			}
+
+			if proto == ProtoECDHAES128V1 {
+				data := []byte("Hello world!")
+				if !bytes.Equal(client.Crypt(server.Crypt(data)), data) {
+					t.Error("resumed session keys mismatch")
+				}
+				return
+			}
+			packet := makePacket(129, "client", []byte("Hello world!"))
+			sealed, err := server.SealPacket(packet)
+			if err != nil {
+				t.Fatal(err)
+			}
+			opened, err := client.OpenPacket(sealed)
+			if err != nil || !bytes.Equal(opened, packet) {
+				t.Error("resumed session keys mismatch")
+			}
+		})
+	}
+
+	t.Run("Reject", func(t *testing.T) {
+		client, server := newClient(ProtoECDHChaCha20Poly1305V2), New()
+		buf, _ := client.MarshalBinary()
+		server.UnmarshalBinary(buf)
+		buf, _ = server.MarshalBinary()
+		client.UnmarshalBinary(buf)
+		payload, _ := server.IssueTicket(ticketKey, time.Minute)
+		_, ticket, _ := client.clientTicket(payload)
+		expired, _ := server.IssueTicket(ticketKey, -time.Second)
+		_, expiredTicket, _ := client.clientTicket(expired)
+
+		otherKey := make([]byte, ticketKeySize)
+		v2 := ProtoECDHChaCha20Poly1305V2
+		modified := append([]byte{}, ticket...)
+		modified[len(modified)-1] ^= 1
+		for name, request := range map[string][]byte{
+			"Key":      newClient(v2).resumeRequest(ticket),
+			"Modified": newClient(v2).resumeRequest(modified),
+			"Expired":  newClient(v2).resumeRequest(expiredTicket),
+			"Proto":    newClient(ProtoECDHAES128V1).resumeRequest(ticket),
+		} {
+			key := ticketKey
+			if name == "Key" {
+				key = otherKey
+			}
+			answer, err := NewProto(ProtoECDHAES128V1).Resume(key, request)
+			if err == nil {
+				t.Errorf("%s: ticket isn't rejected", name)
+			}
+			if len(answer) != 2 ||
+				binary.LittleEndian.Uint16(answer)>>8 != kexTypeResumeReject {
+				t.Errorf("%s: wrong reject answer", name)
+			}
+		}
+	})
+}
+
+func TestGenerateKeys(t *testing.T) {
+
+	// Fixed-base keys must be the same as tiny-ECDH-c generic ones including
+	// clamped private keys and rejected short keys
+	pvtkey := make([]byte, ecdhPvtkeySize)
+	for i := 0; i < 200; i++ {
+		rand.Read(pvtkey)
+		if i%4 == 0 {
+			for j := len(pvtkey) / 2; j < len(pvtkey); j++ {
+				pvtkey[j] = 0
+			}
+		}
+		pvt, pub, ok := generateKeys(false, pvtkey)
+		pvtFixed, pubFixed, okFixed := generateKeys(true, pvtkey)
+		if ok != okFixed || !bytes.Equal(pvt, pvtFixed) ||
+			!bytes.Equal(pub, pubFixed) {
+			t.Fatalf("wrong fixed-base keys of %x", pvtkey)
+		}
+	}
+}
+
+func TestRandomBytes(t *testing.T) {
+
+	// RFC 8439 2.3.2 block function test vector
+	key := make([]byte, 32)
+	for i := range key {
+		key[i] = byte(i)
+	}
+	nonce, _ := hex.DecodeString("000000090000004a00000000")
+	block, _ := hex.DecodeString(
+		"10f1e7e4d13b5915500fdd1fa32071c4c7d1f4c733c068030422aa9ac3d46c4e" +
+			"d2826446079faa0914c2d705d98b02a2b5129cd1de164eb9cbd083e8a2503c4e")
+	ks := chacha20Keystream(key, nonce, 1, len(block))
+	if !bytes.Equal(ks, block) {
+		t.Fatalf("wrong keystream %x", ks)
+	}
+
+	// Threads have own generators, no output is repeated
+	const goroutines, draws = 8, 1000
+	results := make(chan [][]byte)
+	for g := 0; g < goroutines; g++ {
+		go func() {
+			var out [][]byte
+			for i := 0; i < draws; i++ {
+				buf := make([]byte, 16)
+				randomBytes(buf)
+				out = append(out, buf)
+			}
+			results <- out
+		}()
+	}
+	seen := make(map[string]bool)
+	for g := 0; g < goroutines; g++ {
+		for _, buf := range <-results {
+			if seen[string(buf)] {
+				t.Fatalf("repeated random bytes %x", buf)
+			}
+			seen[string(buf)] = true
+		}
+	}
+}
+
+func BenchmarkRandomBytes(b *testing.B) {
+
+	for _, size := range []int{16, 32, 1024} {
+		b.Run(fmt.Sprintf("%d", size), func(b *testing.B) {
+			b.SetBytes(int64(size))
+			b.RunParallel(func(pb *testing.PB) {
+				buf := make([]byte, size)
+				for pb.Next() {
+					randomBytes(buf)
+				}
+			})
+		})
+	}
+}
+
+// Key generation of many connections at once, keypairs and salts are drawn
+// from per-thread generators without a shared lock
+func BenchmarkInitKeysParallel(b *testing.B) {
+
+	start := time.Now()
+	b.RunParallel(func(pb *testing.PB) {
+		for pb.Next() {
+			initKeys()
+		}
+	})
+	b.ReportMetric(float64(b.N)/time.Since(start).Seconds(), "keys/s")
+}
+
+func BenchmarkGenerateKeys(b *testing.B) {
+
+	pvtkey := make([]byte, ecdhPvtkeySize)
+	rand.Read(pvtkey)
+	pvtkey[len(pvtkey)-1] = 0xff
+	for _, fixedBase := range []bool{false, true} {
+		name := "generic"
+		if fixedBase {
+			name = "fixed-base"
+		}
+		b.Run(name, func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				generateKeys(fixedBase, pvtkey)
+			}
+		})
+	}
+}
+
+func BenchmarkHandshake(b *testing.B) {
+
+	handshakes := map[string]func() bool{
+		"ecdh":   handshakeECDH,
+		"x25519": handshakeX25519,
+	}
+	for _, name := range []string{"ecdh", "x25519"} {
+		handshake := handshakes[name]
+		b.Run(name, func(b *testing.B) {
+			start := time.Now()
+			for i := 0; i < b.N; i++ {
+				handshake()
+			}
+			b.ReportMetric(float64(b.N)/time.Since(start).Seconds(),
+				"handshakes/s")
+		})
+	}
+}
+
+func BenchmarkXCrypt(b *testing.B) {
+
+	defer useHardwareAES(true)
+	key := make([]byte, 16)
+
+	for _, hw := range []bool{false, true} {
+		useHardwareAES(hw)
+		for size := 64; size <= 64*1024; size *= 4 {
+			data := make([]byte, size)
+			b.Run(fmt.Sprintf("%s/%d", aesBackend(), size), func(b *testing.B) {
+				b.SetBytes(int64(size))
+				for i := 0; i < b.N; i++ {
+					xCrypt(key, uint32(i), data)
+				}
+			})
+		}
+	}
+}
+
+func BenchmarkCryptInPlace(b *testing.B) {
+
+	pk := New()
+	for size := 64; size <= 64*1024; size *= 4 {
+		data := make([]byte, size)
+		b.Run(fmt.Sprintf("%s/%d", aesBackend(), size), func(b *testing.B) {
+			b.SetBytes(int64(size))
+			for i := 0; i < b.N; i++ {
+				pk.CryptInPlace(data)
+			}
+		})
+	}
+}
+
+func BenchmarkSealPacket(b *testing.B) {
+
+	pk := New()
+	buf, _ := newClient(ProtoECDHChaCha20Poly1305V2).MarshalBinary()
+	if err := pk.UnmarshalBinary(buf); err != nil {
+		b.Fatal(err)
+	}
+	for size := 64; size <= 16*1024; size *= 4 {
+		packet := makePacket(129, "client", make([]byte, size))
+		b.Run(fmt.Sprintf("%d", size), func(b *testing.B) {
+			b.SetBytes(int64(size))
+			for i := 0; i < b.N; i++ {
+				pk.SealPacket(packet)
+			}
+		})
+	}
+}
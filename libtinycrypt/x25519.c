@@ -0,0 +1,361 @@
+// X25519 Diffie-Hellman as specified in RFC 7748.
+// Field elements are 5 limbs of 51 bits with 64x64->128 bit products, the
+// scalar multiplication is a Montgomery ladder with constant-time swaps, so
+// neither branches nor memory accesses depend on secret data.
+
+#include <stdint.h>
+#include <string.h>
+#include "tinycrypt.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#define X25519_MASK51 ((uint64_t)0x7ffffffffffff)
+#define X25519_A24 121665
+
+typedef uint64_t fe[5];
+
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128 x25519_u128;
+
+static inline void mac(x25519_u128* acc, uint64_t a, uint64_t b) {
+  *acc += (x25519_u128)a * b;
+}
+
+static inline void add64(x25519_u128* acc, uint64_t a) { *acc += a; }
+
+static inline uint64_t lo64(x25519_u128 a) { return (uint64_t)a; }
+
+static inline uint64_t shr51(x25519_u128 a) { return (uint64_t)(a >> 51); }
+#else
+typedef struct {
+  uint64_t lo, hi;
+} x25519_u128;
+
+static inline void mac(x25519_u128* acc, uint64_t a, uint64_t b) {
+  uint64_t lo, hi;
+#if defined(_MSC_VER) && defined(_M_X64)
+  lo = _umul128(a, b, &hi);
+#else
+  const uint64_t a0 = (uint32_t)a, a1 = a >> 32;
+  const uint64_t b0 = (uint32_t)b, b1 = b >> 32;
+  const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+  const uint64_t mid = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+  lo = (mid << 32) | (uint32_t)p00;
+  hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+  acc->lo += lo;
+  acc->hi += hi + (acc->lo < lo);
+}
+
+static inline void add64(x25519_u128* acc, uint64_t a) {
+  acc->lo += a;
+  acc->hi += (acc->lo < a);
+}
+
+static inline uint64_t lo64(x25519_u128 a) { return a.lo; }
+
+static inline uint64_t shr51(x25519_u128 a) {
+  return (a.lo >> 51) | (a.hi << 13);
+}
+#endif
+
+static inline uint64_t load_le64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int it = 7; it >= 0; --it) {
+    v = (v << 8) | p[it];
+  }
+  return v;
+}
+
+static inline void store_le64(uint8_t* p, uint64_t v) {
+  for (int it = 0; it < 8; ++it) {
+    p[it] = (uint8_t)v;
+    v >>= 8;
+  }
+}
+
+static void fe_frombytes(fe h, const uint8_t s[X25519_KEY_SIZE]) {
+  // The most significant bit of u-coordinate is ignored
+  h[0] = load_le64(s) & X25519_MASK51;
+  h[1] = (load_le64(s + 6) >> 3) & X25519_MASK51;
+  h[2] = (load_le64(s + 12) >> 6) & X25519_MASK51;
+  h[3] = (load_le64(s + 19) >> 1) & X25519_MASK51;
+  h[4] = (load_le64(s + 24) >> 12) & X25519_MASK51;
+}
+
+static inline void fe_carry(uint64_t t[5]) {
+  t[1] += t[0] >> 51;
+  t[0] &= X25519_MASK51;
+  t[2] += t[1] >> 51;
+  t[1] &= X25519_MASK51;
+  t[3] += t[2] >> 51;
+  t[2] &= X25519_MASK51;
+  t[4] += t[3] >> 51;
+  t[3] &= X25519_MASK51;
+  t[0] += 19 * (t[4] >> 51);
+  t[4] &= X25519_MASK51;
+}
+
+static void fe_tobytes(uint8_t s[X25519_KEY_SIZE], const fe h) {
+  uint64_t t[5];
+  memcpy(t, h, sizeof(t));
+
+  // Now t is fully carried and less than 2^255 + 2^13
+  fe_carry(t);
+  fe_carry(t);
+
+  // Add 19 to get carry out of 2^255 if t >= p, then subtract it back with
+  // 2^255 - 19 added, so the result is t mod p without branches
+  t[0] += 19;
+  fe_carry(t);
+  t[0] += ((uint64_t)1 << 51) - 19;
+  t[1] += ((uint64_t)1 << 51) - 1;
+  t[2] += ((uint64_t)1 << 51) - 1;
+  t[3] += ((uint64_t)1 << 51) - 1;
+  t[4] += ((uint64_t)1 << 51) - 1;
+  t[1] += t[0] >> 51;
+  t[0] &= X25519_MASK51;
+  t[2] += t[1] >> 51;
+  t[1] &= X25519_MASK51;
+  t[3] += t[2] >> 51;
+  t[2] &= X25519_MASK51;
+  t[4] += t[3] >> 51;
+  t[3] &= X25519_MASK51;
+  t[4] &= X25519_MASK51;
+
+  store_le64(s, t[0] | (t[1] << 51));
+  store_le64(s + 8, (t[1] >> 13) | (t[2] << 38));
+  store_le64(s + 16, (t[2] >> 26) | (t[3] << 25));
+  store_le64(s + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+static inline void fe_add(fe h, const fe f, const fe g) {
+  for (int it = 0; it < 5; ++it) {
+    h[it] = f[it] + g[it];
+  }
+}
+
+// h = f - g, 2p is added so limbs of g must be below 2^52 - 38
+static inline void fe_sub(fe h, const fe f, const fe g) {
+  h[0] = f[0] + 0xfffffffffffdaULL - g[0];
+  h[1] = f[1] + 0xffffffffffffeULL - g[1];
+  h[2] = f[2] + 0xffffffffffffeULL - g[2];
+  h[3] = f[3] + 0xffffffffffffeULL - g[3];
+  h[4] = f[4] + 0xffffffffffffeULL - g[4];
+}
+
+static inline void fe_reduce(fe h, x25519_u128 r[5]) {
+  add64(&r[1], shr51(r[0]));
+  add64(&r[2], shr51(r[1]));
+  add64(&r[3], shr51(r[2]));
+  add64(&r[4], shr51(r[3]));
+
+  h[0] = (lo64(r[0]) & X25519_MASK51) + 19 * shr51(r[4]);
+  h[1] = lo64(r[1]) & X25519_MASK51;
+  h[2] = lo64(r[2]) & X25519_MASK51;
+  h[3] = lo64(r[3]) & X25519_MASK51;
+  h[4] = lo64(r[4]) & X25519_MASK51;
+
+  h[1] += h[0] >> 51;
+  h[0] &= X25519_MASK51;
+}
+
+static void fe_mul(fe h, const fe f, const fe g) {
+  const uint64_t g1_19 = 19 * g[1], g2_19 = 19 * g[2], g3_19 = 19 * g[3],
+                 g4_19 = 19 * g[4];
+  x25519_u128 r[5];
+  memset(r, 0, sizeof(r));
+
+  mac(&r[0], f[0], g[0]);
+  mac(&r[0], f[1], g4_19);
+  mac(&r[0], f[2], g3_19);
+  mac(&r[0], f[3], g2_19);
+  mac(&r[0], f[4], g1_19);
+
+  mac(&r[1], f[0], g[1]);
+  mac(&r[1], f[1], g[0]);
+  mac(&r[1], f[2], g4_19);
+  mac(&r[1], f[3], g3_19);
+  mac(&r[1], f[4], g2_19);
+
+  mac(&r[2], f[0], g[2]);
+  mac(&r[2], f[1], g[1]);
+  mac(&r[2], f[2], g[0]);
+  mac(&r[2], f[3], g4_19);
+  mac(&r[2], f[4], g3_19);
+
+  mac(&r[3], f[0], g[3]);
+  mac(&r[3], f[1], g[2]);
+  mac(&r[3], f[2], g[1]);
+  mac(&r[3], f[3], g[0]);
+  mac(&r[3], f[4], g4_19);
+
+  mac(&r[4], f[0], g[4]);
+  mac(&r[4], f[1], g[3]);
+  mac(&r[4], f[2], g[2]);
+  mac(&r[4], f[3], g[1]);
+  mac(&r[4], f[4], g[0]);
+
+  fe_reduce(h, r);
+}
+
+static void fe_sq(fe h, const fe f) {
+  const uint64_t d0 = 2 * f[0], d1 = 2 * f[1], d2 = 2 * f[2], d3 = 2 * f[3];
+  const uint64_t f3_19 = 19 * f[3], f4_19 = 19 * f[4];
+  x25519_u128 r[5];
+  memset(r, 0, sizeof(r));
+
+  mac(&r[0], f[0], f[0]);
+  mac(&r[0], d1, f4_19);
+  mac(&r[0], d2, f3_19);
+
+  mac(&r[1], d0, f[1]);
+  mac(&r[1], d2, f4_19);
+  mac(&r[1], f[3], f3_19);
+
+  mac(&r[2], d0, f[2]);
+  mac(&r[2], f[1], f[1]);
+  mac(&r[2], d3, f4_19);
+
+  mac(&r[3], d0, f[3]);
+  mac(&r[3], d1, f[2]);
+  mac(&r[3], f[4], f4_19);
+
+  mac(&r[4], d0, f[4]);
+  mac(&r[4], d1, f[3]);
+  mac(&r[4], f[2], f[2]);
+
+  fe_reduce(h, r);
+}
+
+static void fe_sq_times(fe h, const fe f, int count) {
+  fe_sq(h, f);
+  for (int it = 1; it < count; ++it) {
+    fe_sq(h, h);
+  }
+}
+
+static void fe_mul121665(fe h, const fe f) {
+  x25519_u128 r[5];
+  memset(r, 0, sizeof(r));
+  for (int it = 0; it < 5; ++it) {
+    mac(&r[it], f[it], X25519_A24);
+  }
+  fe_reduce(h, r);
+}
+
+// h = z^(p - 2) = 1 / z
+static void fe_invert(fe h, const fe z) {
+  fe z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+  fe_sq(z2, z);
+  fe_sq_times(t, z2, 2);
+  fe_mul(z9, t, z);
+  fe_mul(z11, z9, z2);
+  fe_sq(t, z11);
+  fe_mul(z2_5_0, t, z9);
+  fe_sq_times(t, z2_5_0, 5);
+  fe_mul(z2_10_0, t, z2_5_0);
+  fe_sq_times(t, z2_10_0, 10);
+  fe_mul(z2_20_0, t, z2_10_0);
+  fe_sq_times(t, z2_20_0, 20);
+  fe_mul(t, t, z2_20_0);
+  fe_sq_times(t, t, 10);
+  fe_mul(z2_50_0, t, z2_10_0);
+  fe_sq_times(t, z2_50_0, 50);
+  fe_mul(z2_100_0, t, z2_50_0);
+  fe_sq_times(t, z2_100_0, 100);
+  fe_mul(t, t, z2_100_0);
+  fe_sq_times(t, t, 50);
+  fe_mul(t, t, z2_50_0);
+  fe_sq_times(t, t, 5);
+  fe_mul(h, t, z11);
+}
+
+static inline void fe_cswap(fe f, fe g, uint64_t swap) {
+  const uint64_t mask = 0 - swap;
+  for (int it = 0; it < 5; ++it) {
+    const uint64_t x = mask & (f[it] ^ g[it]);
+    f[it] ^= x;
+    g[it] ^= x;
+  }
+}
+
+static void x25519_scalarmult(uint8_t out[X25519_KEY_SIZE],
+                              const uint8_t scalar[X25519_KEY_SIZE],
+                              const uint8_t point[X25519_KEY_SIZE]) {
+  uint8_t e[X25519_KEY_SIZE];
+  memcpy(e, scalar, sizeof(e));
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  fe x1, x2, z2, x3, z3, a, aa, b, bb, c, d, da, cb, ee, t;
+  fe_frombytes(x1, point);
+  memset(x2, 0, sizeof(fe));
+  x2[0] = 1;
+  memset(z2, 0, sizeof(fe));
+  memcpy(x3, x1, sizeof(fe));
+  memset(z3, 0, sizeof(fe));
+  z3[0] = 1;
+
+  uint64_t swap = 0;
+  for (int pos = 254; pos >= 0; --pos) {
+    const uint64_t bit = (e[pos / 8] >> (pos & 7)) & 1;
+    swap ^= bit;
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+    swap = bit;
+
+    fe_add(a, x2, z2);
+    fe_sq(aa, a);
+    fe_sub(b, x2, z2);
+    fe_sq(bb, b);
+    fe_sub(ee, aa, bb);
+    fe_add(c, x3, z3);
+    fe_sub(d, x3, z3);
+    fe_mul(da, d, a);
+    fe_mul(cb, c, b);
+
+    fe_add(t, da, cb);
+    fe_sq(x3, t);
+    fe_sub(t, da, cb);
+    fe_sq(t, t);
+    fe_mul(z3, x1, t);
+    fe_mul(x2, aa, bb);
+    fe_mul121665(t, ee);
+    fe_add(t, t, aa);
+    fe_mul(z2, ee, t);
+  }
+  fe_cswap(x2, x3, swap);
+  fe_cswap(z2, z3, swap);
+
+  fe_invert(z2, z2);
+  fe_mul(x2, x2, z2);
+  fe_tobytes(out, x2);
+
+  zero_bytes(e, sizeof(e));
+  zero_bytes((uint8_t*)x2, sizeof(fe));
+  zero_bytes((uint8_t*)z2, sizeof(fe));
+  zero_bytes((uint8_t*)x3, sizeof(fe));
+  zero_bytes((uint8_t*)z3, sizeof(fe));
+}
+
+void X25519_public_key(X25519Key* pubkey, const X25519Key* pvtkey) {
+  static const uint8_t base_point[X25519_KEY_SIZE] = {9};
+  x25519_scalarmult(pubkey->data, pvtkey->data, base_point);
+}
+
+int X25519_shared_secret(X25519Key* sharedkey, const X25519Key* pvtkey,
+                         const X25519Key* remote) {
+  x25519_scalarmult(sharedkey->data, pvtkey->data, remote->data);
+
+  // All zero secret means remote key of small order
+  uint8_t acc = 0;
+  for (size_t it = 0; it < sizeof(sharedkey->data); ++it) {
+    acc |= sharedkey->data[it];
+  }
+  return acc != 0;
+}
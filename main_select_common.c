@@ -268,6 +268,10 @@ int main(int argc, char** argv) {
 
         if (strcmp("ECDH_AES_128_V1", cypher) == 0) {
             cypher_code = ENC_PROTO_ECDH_AES_128_V1;
+        } else if (strcmp("ECDH_CHACHA20_POLY1305_V2", cypher) == 0) {
+            cypher_code = ENC_PROTO_ECDH_CHACHA20_POLY1305_V2;
+        } else if (strcmp("X25519_CHACHA20_POLY1305_V3", cypher) == 0) {
+            cypher_code = ENC_PROTO_X25519_CHACHA20_POLY1305_V3;
         }
 
         teoLNUllSetOption_EncryptionProtocol(cypher_code);
@@ -222,15 +222,21 @@ void *send_thread(void *con)
 {
     teoLNullConnectData* connection = con;
 
-    uint64_t tsf = teoGetTimestampFull();
-    // Event loop
+    const uint64_t interval_us = 500;
+    uint64_t next_us = teoGetTimestampFull() + interval_us;
+    // Send loop, sleeps until next send time instead of polling the clock
     while(!quit_flag) {
         uint64_t now = teoGetTimestampFull();
-        if ((now - tsf > 500)&&(connection->status > 0)) {
+        if (now < next_us) {
+            usleep((useconds_t)(next_us - now));
+            continue;
+        }
+        if (connection->status > 0) {
             teoLNullSendEcho(con, "ps-server-max", "thread_send");
-            tsf = now;
-
-        } //else teoLNullSleep(1000);
+        }
+        next_us += interval_us;
+        // Don't send burst to catch up after long stall
+        if (next_us < now) next_us = now + interval_us;
     }
     return NULL;
 }
@@ -672,6 +672,11 @@ static teoLNullConnectData* trudpLNullConnect(void *user_data) {
     con->read_buffer_size = 0;
     con->event_cb = event_cb;
     con->user_data = user_data;
+    con->stats = NULL;
+    con->trace = NULL;
+    con->capture = NULL;
+    con->transport = NULL;
+    con->reconnect = NULL;
     
     con->fd = 0;
     
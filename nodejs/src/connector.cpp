@@ -11,6 +11,9 @@
 #include "teo_packet.h"
 #include "teo_aux.h"
 #include <sys/timeb.h>
+#include <sys/select.h>
+#include <errno.h>
+#include <chrono>
 #include <iostream>
 #include <thread>
 
@@ -73,12 +76,27 @@ ssize_t Connector::recv(const uint32_t& timeout) {
     if(timeout == 0)
 	return teoLNullRecv(connector_);
     else {
-	uint32_t tmp(0);
+	// Wait for socket readiness until deadline, return as soon as packet
+	// assembled
+	const auto deadline(std::chrono::steady_clock::now() +
+			    std::chrono::milliseconds(timeout));
 	ssize_t rc(0);
-	const uint32_t wait_period(50);
-	while((rc = teoLNullRecv(connector_)) == -1 && tmp < timeout) {
-	    teoLNullSleep(wait_period);
-	    tmp += wait_period;
+	while((rc = teoLNullRecv(connector_)) == -1) {
+	    auto left(std::chrono::duration_cast<std::chrono::microseconds>(
+			deadline - std::chrono::steady_clock::now()).count());
+	    if(left <= 0)
+		break;
+
+	    fd_set rfds;
+	    FD_ZERO(&rfds);
+	    FD_SET(connector_->fd, &rfds);
+
+	    struct timeval tv;
+	    tv.tv_sec = left / 1000000;
+	    tv.tv_usec = left % 1000000;
+	    if(select((int)connector_->fd + 1, &rfds, NULL, NULL, &tv) == -1 &&
+	       errno != EINTR)
+		break;
 	}
 	return rc;
     }
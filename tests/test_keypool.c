@@ -0,0 +1,99 @@
+/**
+ * \file   test_keypool.c
+ *
+ * Test of ECDH keypair pool start and stop: threads concurrently start,
+ * resize and stop the pool, refill thread of every start is joined by its
+ * stop, and pool is empty after the last stop.
+ *
+ * **Usage:** ./test_keypool
+ *
+ * Exit status is zero if all checks passed.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_keypool.h"
+
+#define TEST_TIMEOUT_S 60
+#define TEST_THREADS 4
+#define TEST_ITERATIONS 200
+#define TEST_DEPTH 4
+
+static int test_failures;
+
+#define TEST_CHECK(cond, ...)                                                  \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);               \
+            fprintf(stderr, __VA_ARGS__);                                      \
+            fprintf(stderr, "\n");                                             \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+static void *_testToggleThread(void *arg) {
+    const uint32_t id = (uint32_t)(uintptr_t)arg;
+    for (uint32_t i = 0; i < TEST_ITERATIONS; i++) {
+        // Odd threads stop the pool while even ones start or resize it
+        teoLNullKeyPoolSetDepth((id + i) % 2 != 0 ? 0 : TEST_DEPTH + id);
+    }
+    return NULL;
+}
+
+/**
+ * Concurrent start and stop leave no pool and refill thread behind
+ */
+static void _testConcurrentSetDepth(void) {
+    pthread_t threads[TEST_THREADS];
+    for (uintptr_t i = 0; i < TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, _testToggleThread, (void *)i);
+    }
+    for (int i = 0; i < TEST_THREADS; i++) { pthread_join(threads[i], NULL); }
+
+    teoLNullKeyPoolSetDepth(0);
+    teoLNullKeyPoolStats stats;
+    teoLNullKeyPoolGetStats(&stats);
+    TEST_CHECK(stats.depth == 0 && stats.available == 0,
+               "pool of depth %u with %u keypairs left after stop",
+               stats.depth, stats.available);
+}
+
+/**
+ * Pool started after concurrent calls is filled by its refill thread
+ */
+static void _testRestart(void) {
+    teoLNullKeyPoolSetDepth(TEST_DEPTH);
+
+    teoLNullKeyPoolStats stats;
+    for (int i = 0; i < 1000; i++) {
+        teoLNullKeyPoolGetStats(&stats);
+        if (stats.available == TEST_DEPTH) { break; }
+        usleep(10000);
+    }
+    TEST_CHECK(stats.depth == TEST_DEPTH && stats.available == TEST_DEPTH,
+               "pool of depth %u has %u keypairs", stats.depth,
+               stats.available);
+
+    teoLNullKeyPoolSetDepth(0);
+}
+
+int main(void) {
+    // Deadlocked join fails the test instead of hanging it
+    alarm(TEST_TIMEOUT_S);
+
+    teoLNullInit();
+    _testConcurrentSetDepth();
+    _testRestart();
+    teoLNullCleanup();
+
+    if (test_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", test_failures);
+        return 1;
+    }
+    printf("test_keypool passed\n");
+    return 0;
+}
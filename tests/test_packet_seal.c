@@ -0,0 +1,228 @@
+/**
+ * \file   test_packet_seal.c
+ *
+ * Test of packet sealing with AEAD protocol: data which leaves no room for
+ * the tag in L0 packet is rejected by send functions without crash, the
+ * largest data which fits is sent with the tag, and sealing functions don't
+ * write tag past buffer they are given.
+ *
+ * **Usage:** ./test_packet_seal
+ *
+ * Exit status is zero if all checks passed.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+
+#define TEST_TIMEOUT_S 20
+#define TEST_PEER "test-peer"
+#define TEST_CMD 129
+//! Largest data of AEAD encrypted packet
+#define TEST_MAX_DATA (UINT16_MAX - TEOLNULL_ENCRYPTION_MAX_OVERHEAD)
+
+static int test_failures;
+
+#define TEST_CHECK(cond, ...)                                                  \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);               \
+            fprintf(stderr, __VA_ARGS__);                                      \
+            fprintf(stderr, "\n");                                             \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+#pragma pack(push)
+#pragma pack(1)
+// Key exchange answer of L0 server, ECDH protocols
+typedef struct testKEX_ECDH {
+    KeyExchangePayload_Common common;
+    ECDHPubkey pubkey;
+    AES128_1_BLOCK salt;
+} testKEX_ECDH;
+#pragma pack(pop)
+
+/**
+ * Connection writing to socket pair, other end is read by sink thread
+ */
+typedef struct testConnection {
+    teoLNullConnectData con;
+    int sink[2];
+    pthread_t sink_thread;
+    size_t received; ///< Bytes read by sink thread, valid after join
+} testConnection;
+
+/**
+ * Create encryption context and establish session with keys made the same
+ * way L0 server does
+ */
+static teoLNullEncryptionContext *
+_testCryptCreate(teoLNullEncryptionProtocol proto) {
+    const size_t ctx_size = teoLNullEncryptionContextSize(proto);
+    teoLNullEncryptionContext *ctx =
+        (teoLNullEncryptionContext *)malloc(ctx_size);
+    teoLNullEncryptionContextCreate(proto, (uint8_t *)ctx, ctx_size);
+
+    uint8_t request[128];
+    teoLNullKEXCreate(ctx, request, teoLNullKEXBufferSize(proto));
+
+    const testKEX_ECDH *client = (const testKEX_ECDH *)request;
+    PeerKeyset server;
+    initPeerKeys(&server);
+    initApplyRemoteKey(&server, &client->pubkey, &client->salt);
+
+    testKEX_ECDH answer;
+    answer.common.nul_byte = 0;
+    answer.common.protocolId = proto;
+    answer.pubkey = server.pubkeylocal;
+    answer.salt = server.sessionsalt;
+    TEST_CHECK(teoLNullEncryptionContextApplyKEX(ctx, &answer.common,
+                                                 sizeof(answer)),
+               "session isn't established");
+    return ctx;
+}
+
+static void _testCryptDestroy(teoLNullEncryptionContext *ctx) {
+    teoLNullEncryptionContextDestroy(ctx);
+    free(ctx);
+}
+
+static void *_testSinkThread(void *arg) {
+    testConnection *tc = (testConnection *)arg;
+    uint8_t buf[64 * 1024];
+    ssize_t rc;
+    while ((rc = read(tc->sink[1], buf, sizeof(buf))) > 0) {
+        tc->received += (size_t)rc;
+    }
+    return NULL;
+}
+
+static void _testConnectionOpen(testConnection *tc,
+                                teoLNullEncryptionContext *ctx) {
+    memset(tc, 0, sizeof(*tc));
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, tc->sink) != 0) {
+        perror("socketpair");
+        exit(EXIT_FAILURE);
+    }
+    pthread_create(&tc->sink_thread, NULL, _testSinkThread, tc);
+
+    teomutexInitialize(&tc->con.write_guard);
+    tc->con.fd = tc->sink[0];
+    tc->con.tcp_f = 1;
+    tc->con.status = CON_STATUS_CONNECTED;
+    tc->con.client_crypt = ctx;
+}
+
+/**
+ * Close connection and wait until sink thread read all sent bytes
+ */
+static void _testConnectionClose(testConnection *tc) {
+    shutdown(tc->sink[0], SHUT_WR);
+    pthread_join(tc->sink_thread, NULL);
+    close(tc->sink[0]);
+    close(tc->sink[1]);
+    teomutexDestroy(&tc->con.write_guard);
+}
+
+/**
+ * Data too large for AEAD tag is rejected, the largest allowed is sent with
+ * the tag
+ */
+static void _testSendLimit(void) {
+    teoLNullEncryptionContext *ctx =
+        _testCryptCreate(ENC_PROTO_ECDH_CHACHA20_POLY1305_V2);
+    testConnection tc;
+    _testConnectionOpen(&tc, ctx);
+    uint8_t *data = (uint8_t *)calloc(1, UINT16_MAX);
+
+    TEST_CHECK(teoLNullSend(&tc.con, TEST_CMD, TEST_PEER, data,
+                            TEST_MAX_DATA + 1) == -1,
+               "send of %u bytes isn't rejected", TEST_MAX_DATA + 1);
+    TEST_CHECK(teoLNullSend(&tc.con, TEST_CMD, TEST_PEER, data, UINT16_MAX) ==
+                   -1,
+               "send of %u bytes isn't rejected", UINT16_MAX);
+
+    const size_t expected =
+        teoLNullBufferSize(sizeof(TEST_PEER),
+                           TEST_MAX_DATA + TEOLNULL_ENCRYPTION_MAX_OVERHEAD);
+    const ssize_t sent =
+        teoLNullSend(&tc.con, TEST_CMD, TEST_PEER, data, TEST_MAX_DATA);
+    TEST_CHECK(sent == (ssize_t)expected, "send of %u bytes returned %d",
+               TEST_MAX_DATA, (int)sent);
+
+    _testConnectionClose(&tc);
+    TEST_CHECK(tc.received == expected, "%u bytes sent, expected %u",
+               (uint32_t)tc.received, (uint32_t)expected);
+
+    free(data);
+    _testCryptDestroy(ctx);
+}
+
+/**
+ * Sealing functions append tag only if buffer has room for it
+ */
+static void _testSealCapacity(void) {
+    teoLNullEncryptionContext *ctx =
+        _testCryptCreate(ENC_PROTO_ECDH_CHACHA20_POLY1305_V2);
+    const char data[] = "sealed";
+    const size_t packet_length =
+        teoLNullBufferSize(sizeof(TEST_PEER), sizeof(data));
+    const size_t capacity = packet_length + TEOLNULL_ENCRYPTION_MAX_OVERHEAD;
+
+    // Exactly sized buffer, tag written past it is caught by sanitizers
+    teoLNullCPacket *packet = (teoLNullCPacket *)malloc(packet_length);
+    teoLNullPacketCreate(packet, packet_length, TEST_CMD, TEST_PEER,
+                         (const uint8_t *)data, sizeof(data));
+    teoLNullPacketSeal(ctx, true, packet);
+    TEST_CHECK(!teoLNullPacketIsEncrypted(packet) &&
+                   packet->data_length == sizeof(data),
+               "teoLNullPacketSeal appended tag to packet");
+
+    teoLNullPacketEncrypt(ctx, packet);
+    TEST_CHECK(!teoLNullPacketIsEncrypted(packet) &&
+                   packet->data_length == sizeof(data),
+               "teoLNullPacketEncrypt appended tag to packet");
+
+    TEST_CHECK(!teoLNullPacketSealBuffer(ctx, true, packet, packet_length),
+               "teoLNullPacketSealBuffer sealed packet without room for tag");
+    TEST_CHECK(!teoLNullPacketEncryptBuffer(ctx, packet, capacity - 1),
+               "teoLNullPacketEncryptBuffer encrypted packet without room "
+               "for tag");
+    free(packet);
+
+    packet = (teoLNullCPacket *)malloc(capacity);
+    teoLNullPacketCreate(packet, capacity, TEST_CMD, TEST_PEER,
+                         (const uint8_t *)data, sizeof(data));
+    TEST_CHECK(teoLNullPacketSealBuffer(ctx, true, packet, capacity) &&
+                   teoLNullPacketIsEncrypted(packet) &&
+                   packet->data_length ==
+                       sizeof(data) + TEOLNULL_ENCRYPTION_MAX_OVERHEAD,
+               "teoLNullPacketSealBuffer didn't seal packet with tag");
+    free(packet);
+
+    _testCryptDestroy(ctx);
+}
+
+int main(void) {
+    // Blocked send fails the test instead of hanging it
+    alarm(TEST_TIMEOUT_S);
+
+    teoLNullInit();
+    _testSendLimit();
+    _testSealCapacity();
+    teoLNullCleanup();
+
+    if (test_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", test_failures);
+        return 1;
+    }
+    printf("test_packet_seal passed\n");
+    return 0;
+}
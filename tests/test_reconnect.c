@@ -0,0 +1,397 @@
+/**
+ * \file   test_reconnect.c
+ *
+ * Test of managed reconnect (teoLNUllSetOption_AutoReconnect) against the
+ * mock L0 server which is stopped and started again on the same ports, over
+ * TCP and TR-UDP:
+ *
+ *  - echoes sent while link is down are queued up to queue limit, the rest
+ *    is dropped and counted, queued ones are answered after re-login in
+ *    order they were sent
+ *  - echoes of concurrent sender threads keep their order across several
+ *    server restarts
+ *  - teoLNullShutdown during long backoff makes teoLNullReadEventLoop
+ *    return false promptly
+ *
+ * **Usage:** ./test_reconnect [tcp|trudp]
+ *
+ * Both transports are tested by default. Exit status is zero if all checks
+ * passed.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+#include "libteol0/teonet_l0_client_options.h"
+#include "bench/teonet_l0_mock_server.h"
+
+#define TEST_TIMEOUT_S 240
+#define TEST_LINK_TIMEOUT_MS 30000
+#define TEST_QUEUE_LIMIT 1024
+#define TEST_SENDERS 2
+#define TEST_RESTARTS 3
+#define TEST_QUEUE_MAX_ECHOES 256
+
+static int test_failures;
+
+#define TEST_CHECK(cond, ...)                                                  \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);               \
+            fprintf(stderr, __VA_ARGS__);                                      \
+            fprintf(stderr, "\n");                                             \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+/**
+ * Mock server restarted on the same ports
+ */
+typedef struct testServer {
+    teoLNullMockServer *server;
+    teoLNullMockServerConfig config;
+} testServer;
+
+/**
+ * Echo answers and connection events seen by event callback
+ */
+typedef struct testEvents {
+    int connects;
+    int disconnects;
+    //! Answers of sender thread echoes: last sequence number and disorders
+    int64_t last_seq[TEST_SENDERS];
+    int answers[TEST_SENDERS];
+    int disorders;
+    //! Answers of queue test echoes in order received
+    int queue_answers[TEST_QUEUE_MAX_ECHOES];
+    int queue_answers_count;
+} testEvents;
+
+typedef struct testSender {
+    teoLNullConnectData *con;
+    int id;
+    int stop; ///< Set by main thread, read atomically
+    int sent;
+    int failed;
+} testSender;
+
+static int64_t _testNowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool _testServerStart(testServer *ts) {
+    // Port of stopped server may stay busy for a moment
+    for (int i = 0; i < 100; i++) {
+        ts->server = teoLNullMockServerStart(&ts->config);
+        if (ts->server != NULL) { break; }
+        usleep(50000);
+    }
+    if (ts->server == NULL) { return false; }
+
+    ts->config.tcp_port = teoLNullMockServerTcpPort(ts->server);
+    ts->config.udp_port = teoLNullMockServerUdpPort(ts->server);
+    return true;
+}
+
+static void _testServerStop(testServer *ts) {
+    teoLNullMockServerStop(ts->server);
+    ts->server = NULL;
+}
+
+static void _testEventCb(void *con, teoLNullEvents event, void *data,
+                         size_t data_len, void *user_data) {
+    testEvents *ev = (testEvents *)user_data;
+
+    switch (event) {
+    case EV_L_CONNECTED:
+        if (*(int *)data == CON_STATUS_CONNECTED) { ev->connects++; }
+        break;
+
+    case EV_L_DISCONNECTED: ev->disconnects++; break;
+
+    case EV_L_RECEIVED: {
+        teoLNullCPacket *packet = (teoLNullCPacket *)data;
+        if (packet->cmd != CMD_L_ECHO_ANSWER) { break; }
+
+        const char *msg = packet->peer_name + packet->peer_name_length;
+        int id;
+        long long seq;
+        if (sscanf(msg, "T%d:%lld", &id, &seq) == 2 && id >= 0 &&
+            id < TEST_SENDERS) {
+            if (seq <= ev->last_seq[id]) { ev->disorders++; }
+            ev->last_seq[id] = seq;
+            ev->answers[id]++;
+        } else if (sscanf(msg, "Q:%d", &id) == 1 &&
+                   ev->queue_answers_count < TEST_QUEUE_MAX_ECHOES) {
+            ev->queue_answers[ev->queue_answers_count++] = id;
+        }
+    } break;
+
+    default: break;
+    }
+}
+
+/**
+ * Run event loop until @a value reaches @a expected or timeout
+ */
+static bool _testLoopUntil(teoLNullConnectData *con, const int *value,
+                           int expected, int timeout_ms) {
+    const int64_t deadline_ms = _testNowMs() + timeout_ms;
+    while (*value < expected && _testNowMs() < deadline_ms) {
+        teoLNullReadEventLoop(con, 10);
+    }
+    return *value >= expected;
+}
+
+static void _testLoopFor(teoLNullConnectData *con, int duration_ms) {
+    const int64_t deadline_ms = _testNowMs() + duration_ms;
+    while (_testNowMs() < deadline_ms) { teoLNullReadEventLoop(con, 10); }
+}
+
+static teoLNullConnectData *_testConnect(testServer *ts, PROTOCOL proto,
+                                         testEvents *ev) {
+    memset(ev, 0, sizeof(testEvents));
+    for (int i = 0; i < TEST_SENDERS; i++) { ev->last_seq[i] = -1; }
+
+    const uint16_t port =
+        proto == TCP ? ts->config.tcp_port : ts->config.udp_port;
+    teoLNullConnectData *con =
+        teoLNullConnectE("127.0.0.1", port, _testEventCb, ev, proto);
+    TEST_CHECK(con != NULL && con->status == CON_STATUS_CONNECTED,
+               "connection isn't established");
+    if (con == NULL) { return NULL; }
+
+    teoLNullLogin(con, "test-reconnect");
+    return con;
+}
+
+/**
+ * Echoes sent while link is down are queued up to limit and answered in
+ * order after reconnect, the rest are dropped and counted
+ */
+static void _testQueueLimit(testServer *ts, PROTOCOL proto) {
+    teoLNUllSetOption_AutoReconnect(20, 100, TEST_QUEUE_LIMIT);
+
+    testEvents ev;
+    teoLNullConnectData *con = _testConnect(ts, proto, &ev);
+    if (con == NULL) { return; }
+
+    _testServerStop(ts);
+    TEST_CHECK(_testLoopUntil(con, &ev.disconnects, 1, TEST_LINK_TIMEOUT_MS),
+               "link loss isn't detected");
+
+    int queued = 0;
+    int dropped = 0;
+    for (int i = 0; i < TEST_QUEUE_MAX_ECHOES && dropped < 3; i++) {
+        char msg[16];
+        snprintf(msg, sizeof(msg), "Q:%d", i);
+        if (teoLNullSendEcho(con, "mock-l0", msg) < 0) {
+            dropped++;
+        } else {
+            TEST_CHECK(dropped == 0, "echo %d queued after drop", i);
+            queued++;
+        }
+    }
+
+    teoLNullStats stats;
+    teoLNullGetStats(con, &stats);
+    TEST_CHECK(queued > 0 && dropped == 3, "queued %d, dropped %d", queued,
+               dropped);
+    TEST_CHECK(stats.reconnect_dropped == (uint64_t)dropped,
+               "dropped counter %llu, expected %d",
+               (unsigned long long)stats.reconnect_dropped, dropped);
+    TEST_CHECK(stats.reconnect_queue > 0 &&
+                   stats.reconnect_queue <= TEST_QUEUE_LIMIT,
+               "queue holds %u bytes", (uint32_t)stats.reconnect_queue);
+
+    TEST_CHECK(_testServerStart(ts), "server isn't started again");
+    _testLoopUntil(con, &ev.queue_answers_count, queued,
+                   TEST_LINK_TIMEOUT_MS);
+
+    TEST_CHECK(ev.queue_answers_count == queued, "%d of %d queued answered",
+               ev.queue_answers_count, queued);
+    for (int i = 0; i < ev.queue_answers_count; i++) {
+        TEST_CHECK(ev.queue_answers[i] == i, "answer %d is echo %d", i,
+                   ev.queue_answers[i]);
+    }
+
+    teoLNullGetStats(con, &stats);
+    TEST_CHECK(stats.reconnect_replayed == (uint64_t)queued,
+               "replayed counter %llu, expected %d",
+               (unsigned long long)stats.reconnect_replayed, queued);
+    TEST_CHECK(stats.reconnect_queue == 0, "%u bytes left in queue",
+               (uint32_t)stats.reconnect_queue);
+    TEST_CHECK(stats.reconnect_downtime.count == 1,
+               "downtime recorded %llu times",
+               (unsigned long long)stats.reconnect_downtime.count);
+
+    teoLNullShutdown(con);
+    teoLNullDisconnect(con);
+}
+
+static void *_testSenderThread(void *arg) {
+    testSender *sender = (testSender *)arg;
+
+    for (int64_t seq = 0; !__atomic_load_n(&sender->stop, __ATOMIC_RELAXED);
+         seq++) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "T%d:%lld", sender->id, (long long)seq);
+        if (teoLNullSendEcho(sender->con, "mock-l0", msg) < 0) {
+            sender->failed++;
+        } else {
+            sender->sent++;
+        }
+        usleep(200);
+    }
+
+    return NULL;
+}
+
+/**
+ * Echoes of sender threads keep their order across server restarts, echoes
+ * sent while link is down are replayed
+ */
+static void _testConcurrentSenders(testServer *ts, PROTOCOL proto) {
+    teoLNUllSetOption_AutoReconnect(20, 200, 1 << 20);
+
+    testEvents ev;
+    teoLNullConnectData *con = _testConnect(ts, proto, &ev);
+    if (con == NULL) { return; }
+
+    testSender senders[TEST_SENDERS];
+    pthread_t threads[TEST_SENDERS];
+    for (int i = 0; i < TEST_SENDERS; i++) {
+        memset(&senders[i], 0, sizeof(testSender));
+        senders[i].con = con;
+        senders[i].id = i;
+        pthread_create(&threads[i], NULL, _testSenderThread, &senders[i]);
+    }
+
+    for (int restart = 1; restart <= TEST_RESTARTS; restart++) {
+        _testLoopFor(con, 200);
+        _testServerStop(ts);
+        TEST_CHECK(_testLoopUntil(con, &ev.disconnects, restart,
+                                  TEST_LINK_TIMEOUT_MS),
+                   "link loss %d isn't detected", restart);
+        // Senders fill the queue meanwhile
+        _testLoopFor(con, 100);
+        TEST_CHECK(_testServerStart(ts), "server isn't started again");
+        TEST_CHECK(_testLoopUntil(con, &ev.connects, restart + 1,
+                                  TEST_LINK_TIMEOUT_MS),
+                   "reconnect %d isn't made", restart);
+    }
+
+    for (int i = 0; i < TEST_SENDERS; i++) {
+        __atomic_store_n(&senders[i].stop, 1, __ATOMIC_RELAXED);
+        pthread_join(threads[i], NULL);
+    }
+    _testLoopFor(con, 500);
+
+    teoLNullStats stats;
+    teoLNullGetStats(con, &stats);
+    TEST_CHECK(ev.disorders == 0, "%d echoes answered out of order",
+               ev.disorders);
+    for (int i = 0; i < TEST_SENDERS; i++) {
+        TEST_CHECK(senders[i].failed == 0, "sender %d failed %d sends", i,
+                   senders[i].failed);
+        TEST_CHECK(ev.answers[i] > 0, "sender %d got no answers", i);
+    }
+    TEST_CHECK(stats.reconnects == TEST_RESTARTS, "%llu reconnects",
+               (unsigned long long)stats.reconnects);
+    TEST_CHECK(stats.reconnect_replayed > 0, "no echo was replayed");
+    TEST_CHECK(stats.reconnect_dropped == 0, "%llu echoes dropped",
+               (unsigned long long)stats.reconnect_dropped);
+
+    teoLNullShutdown(con);
+    teoLNullDisconnect(con);
+}
+
+static void *_testShutdownThread(void *arg) {
+    usleep(100000);
+    teoLNullShutdown((teoLNullConnectData *)arg);
+    return NULL;
+}
+
+/**
+ * teoLNullShutdown from other thread stops long backoff wait of event loop
+ */
+static void _testShutdownDuringBackoff(testServer *ts, PROTOCOL proto) {
+    teoLNUllSetOption_AutoReconnect(10000, 10000, TEST_QUEUE_LIMIT);
+
+    testEvents ev;
+    teoLNullConnectData *con = _testConnect(ts, proto, &ev);
+    if (con == NULL) { return; }
+
+    _testServerStop(ts);
+    TEST_CHECK(_testLoopUntil(con, &ev.disconnects, 1, TEST_LINK_TIMEOUT_MS),
+               "link loss isn't detected");
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, _testShutdownThread, con);
+
+    const int64_t start_ms = _testNowMs();
+    bool stopped = false;
+    while (!stopped && _testNowMs() - start_ms < 20000) {
+        stopped = !teoLNullReadEventLoop(con, -1);
+    }
+    const int64_t elapsed_ms = _testNowMs() - start_ms;
+    pthread_join(thread, NULL);
+
+    TEST_CHECK(stopped, "event loop isn't stopped by teoLNullShutdown");
+    TEST_CHECK(elapsed_ms < 1000, "event loop stopped in %d ms",
+               (int)elapsed_ms);
+
+    teoLNullDisconnect(con);
+    TEST_CHECK(_testServerStart(ts), "server isn't started again");
+}
+
+static void _testTransport(PROTOCOL proto) {
+    testServer ts;
+    memset(&ts, 0, sizeof(ts));
+    ts.config.disable_tcp = proto != TCP;
+    ts.config.disable_trudp = proto != TRUDP;
+    if (!_testServerStart(&ts)) {
+        TEST_CHECK(false, "mock server isn't started");
+        return;
+    }
+
+    _testQueueLimit(&ts, proto);
+    _testConcurrentSenders(&ts, proto);
+    _testShutdownDuringBackoff(&ts, proto);
+
+    _testServerStop(&ts);
+    teoLNUllSetOption_AutoReconnect(0, 0, 0);
+}
+
+int main(int argc, char **argv) {
+    // Deadlocked event loop fails the test instead of hanging it
+    alarm(TEST_TIMEOUT_S);
+
+    teoLNullInit();
+    teoLNUllSetOption_EncryptionProtocol(ENC_PROTO_ECDH_AES_128_V1);
+
+    const char *transport = argc > 1 ? argv[1] : NULL;
+    if (transport == NULL || strcmp(transport, "tcp") == 0) {
+        _testTransport(TCP);
+    }
+    if (transport == NULL || strcmp(transport, "trudp") == 0) {
+        _testTransport(TRUDP);
+    }
+
+    teoLNullCleanup();
+
+    if (test_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", test_failures);
+        return 1;
+    }
+    printf("test_reconnect passed\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * \file   test_recv_ring.c
+ *
+ * Test of receive ring: records larger than half of the ring which don't fit
+ * to the ring end, so every push wraps, must pass from producer to consumer
+ * thread in order and unchanged, and the producer must not wait forever for
+ * free space of empty ring. Poll timeout is checked too.
+ *
+ * **Usage:** ./test_recv_ring
+ *
+ * Exit status is zero if all checks passed.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_ring.h"
+
+#define TEST_TIMEOUT_S 20
+#define TEST_PACKETS 2000
+#define TEST_MAX_PACKET 65535
+
+static int test_failures;
+
+#define TEST_CHECK(cond, ...)                                                  \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);               \
+            fprintf(stderr, __VA_ARGS__);                                      \
+            fprintf(stderr, "\n");                                             \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+/**
+ * Packet sizes cycle: small packet moves the ring position, large ones don't
+ * fit to the rest of the ring and are written from its start
+ */
+static const size_t test_sizes[] = {100, 40000, 4000, TEST_MAX_PACKET, 33000,
+                                    8, 60000, 1};
+
+static size_t _testSize(uint32_t seq) {
+    return test_sizes[seq % (sizeof(test_sizes) / sizeof(test_sizes[0]))];
+}
+
+static void _testFill(uint8_t *data, size_t len, uint32_t seq) {
+    for (size_t i = 0; i < len; i++) { data[i] = (uint8_t)(seq * 31 + i); }
+}
+
+static bool _testVerify(const uint8_t *data, size_t len, uint32_t seq) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != (uint8_t)(seq * 31 + i)) { return false; }
+    }
+    return true;
+}
+
+static int64_t _testNowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void *_testProducer(void *arg) {
+    teoLNullRecvRing *ring = (teoLNullRecvRing *)arg;
+    uint8_t *packet = (uint8_t *)malloc(TEST_MAX_PACKET);
+
+    for (uint32_t seq = 0; seq < TEST_PACKETS; seq++) {
+        const size_t len = _testSize(seq);
+        _testFill(packet, len, seq);
+        if (!teoLNullRecvRingPush(ring, EV_L_RECEIVED, packet, len)) {
+            fprintf(stderr, "FAIL push of %u bytes\n", (uint32_t)len);
+            exit(1);
+        }
+    }
+
+    free(packet);
+    return NULL;
+}
+
+/**
+ * Producer pushes packets of wrapping sizes while consumer takes them one by
+ * one, so the ring is often empty when the next record needs to wrap
+ */
+static void _testWrapAround(size_t batch) {
+    teoLNullRecvRing *ring = teoLNullRecvRingCreate(L0_BUFFER_SIZE);
+    TEST_CHECK(ring != NULL, "ring of L0_BUFFER_SIZE isn't created");
+    if (ring == NULL) { return; }
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, _testProducer, ring);
+
+    teoLNullPacketView views[16];
+    uint32_t seq = 0;
+    while (seq < TEST_PACKETS) {
+        size_t count = teoLNullRecvRingPoll(ring, views, batch, 1000);
+        TEST_CHECK(count > 0, "no packet %u in 1 s", seq);
+        if (count == 0) { break; }
+
+        for (size_t i = 0; i < count; i++, seq++) {
+            TEST_CHECK(views[i].event == EV_L_RECEIVED, "packet %u event %d",
+                       seq, (int)views[i].event);
+            TEST_CHECK(views[i].packet_len == _testSize(seq),
+                       "packet %u length %u, expected %u", seq,
+                       (uint32_t)views[i].packet_len,
+                       (uint32_t)_testSize(seq));
+            TEST_CHECK(views[i].packet_len != _testSize(seq) ||
+                           _testVerify((const uint8_t *)views[i].packet,
+                                       views[i].packet_len, seq),
+                       "packet %u data differs", seq);
+        }
+        teoLNullRecvRingRelease(ring, count);
+    }
+
+    pthread_join(producer, NULL);
+    TEST_CHECK(teoLNullRecvRingUsed(ring) == 0, "%u bytes left in ring",
+               (uint32_t)teoLNullRecvRingUsed(ring));
+    teoLNullRecvRingDestroy(ring);
+}
+
+/**
+ * Poll of empty ring returns after its timeout
+ */
+static void _testPollTimeout(void) {
+    teoLNullRecvRing *ring = teoLNullRecvRingCreate(L0_BUFFER_SIZE);
+    teoLNullPacketView view;
+
+    const int64_t start_ms = _testNowMs();
+    size_t count = teoLNullRecvRingPoll(ring, &view, 1, 100);
+    const int64_t elapsed_ms = _testNowMs() - start_ms;
+
+    TEST_CHECK(count == 0, "poll of empty ring returned %u", (uint32_t)count);
+    TEST_CHECK(elapsed_ms >= 90 && elapsed_ms < 1000,
+               "poll timeout of 100 ms took %d ms", (int)elapsed_ms);
+    teoLNullRecvRingDestroy(ring);
+}
+
+int main(void) {
+    // Deadlocked producer or consumer fails the test instead of hanging it
+    alarm(TEST_TIMEOUT_S);
+
+    _testWrapAround(1);
+    _testWrapAround(16);
+    _testPollTimeout();
+
+    if (test_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", test_failures);
+        return 1;
+    }
+    printf("test_recv_ring passed\n");
+    return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * \file   test_send_order.c
+ *
+ * Test of send order of encrypted packets: sender waiting for its nonce goes
+ * after the previous one is committed, and senders waiting for nonces which
+ * will never be committed fail when context is destroyed, destroy waits for
+ * them to leave.
+ *
+ * **Usage:** ./test_send_order
+ *
+ * Exit status is zero if all checks passed.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libteol0/teonet_l0_client.h"
+#include "libteol0/teonet_l0_client_crypt.h"
+
+#define TEST_TIMEOUT_S 20
+#define TEST_WAITERS 4
+//! Time for waiters to reach sleep in teoLNullSendOrderWait
+#define TEST_SETTLE_US 100000
+
+static int test_failures;
+
+#define TEST_CHECK(cond, ...)                                                  \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);               \
+            fprintf(stderr, __VA_ARGS__);                                      \
+            fprintf(stderr, "\n");                                             \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+typedef struct testWaiter {
+    teoLNullEncryptionContext *ctx;
+    uint32_t nonce;
+    int done; ///< Set by waiter thread, read atomically
+    bool turn;
+} testWaiter;
+
+static void *_testWaiterThread(void *arg) {
+    testWaiter *waiter = (testWaiter *)arg;
+    waiter->turn = teoLNullSendOrderWait(waiter->ctx, waiter->nonce);
+    __atomic_store_n(&waiter->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static teoLNullEncryptionContext *_testCryptCreate(void) {
+    const size_t ctx_size =
+        teoLNullEncryptionContextSize(ENC_PROTO_ECDH_AES_128_V1);
+    teoLNullEncryptionContext *ctx =
+        (teoLNullEncryptionContext *)malloc(ctx_size);
+    teoLNullEncryptionContextCreate(ENC_PROTO_ECDH_AES_128_V1, (uint8_t *)ctx,
+                                    ctx_size);
+    return ctx;
+}
+
+/**
+ * Sender of the next nonce goes after commit of the previous one
+ */
+static void _testOrder(void) {
+    teoLNullEncryptionContext *ctx = _testCryptCreate();
+    const uint32_t first = ctx->sendCommitted;
+
+    testWaiter waiter = {ctx, first + 1, 0, false};
+    pthread_t thread;
+    pthread_create(&thread, NULL, _testWaiterThread, &waiter);
+
+    usleep(TEST_SETTLE_US);
+    TEST_CHECK(__atomic_load_n(&waiter.done, __ATOMIC_ACQUIRE) == 0,
+               "nonce %u went before commit of %u", first + 1, first);
+
+    TEST_CHECK(teoLNullSendOrderWait(ctx, first), "turn of nonce %u failed",
+               first);
+    teoLNullSendOrderCommit(ctx, first);
+    pthread_join(thread, NULL);
+    TEST_CHECK(waiter.turn, "turn of nonce %u failed", first + 1);
+    teoLNullSendOrderCommit(ctx, first + 1);
+
+    teoLNullEncryptionContextDestroy(ctx);
+    free(ctx);
+}
+
+/**
+ * Waiters of nonces which are never committed fail on destroy
+ */
+static void _testDestroyWithWaiters(void) {
+    teoLNullEncryptionContext *ctx = _testCryptCreate();
+    const uint32_t first = ctx->sendCommitted;
+
+    testWaiter waiters[TEST_WAITERS];
+    pthread_t threads[TEST_WAITERS];
+    for (int i = 0; i < TEST_WAITERS; i++) {
+        // Nonce first is never committed, every waiter waits for it
+        waiters[i] = (testWaiter){ctx, first + 1 + (uint32_t)i, 0, true};
+        pthread_create(&threads[i], NULL, _testWaiterThread, &waiters[i]);
+    }
+
+    usleep(TEST_SETTLE_US);
+    teoLNullEncryptionContextDestroy(ctx);
+
+    // Destroy returns after waiters left
+    for (int i = 0; i < TEST_WAITERS; i++) {
+        TEST_CHECK(__atomic_load_n(&waiters[i].done, __ATOMIC_ACQUIRE) != 0,
+                   "waiter of nonce %u is still waiting after destroy",
+                   waiters[i].nonce);
+    }
+    for (int i = 0; i < TEST_WAITERS; i++) {
+        pthread_join(threads[i], NULL);
+        TEST_CHECK(!waiters[i].turn, "waiter of nonce %u got its turn",
+                   waiters[i].nonce);
+    }
+    free(ctx);
+}
+
+int main(void) {
+    // Deadlocked waiter or destroy fails the test instead of hanging it
+    alarm(TEST_TIMEOUT_S);
+
+    teoLNullInit();
+    _testOrder();
+    _testDestroyWithWaiters();
+    teoLNullCleanup();
+
+    if (test_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", test_failures);
+        return 1;
+    }
+    printf("test_send_order passed\n");
+    return 0;
+}